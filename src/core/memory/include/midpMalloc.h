@@ -209,7 +209,27 @@ void  midpFreeImpl(void*, char*, int);
  */
 int midpMallocDumpMemory(int countMemoryLeaksOnly);
 
-#if REPORT_LEVEL <= LOG_WARNING
+#if ENABLE_MALLOC_SITE_STATS
+
+/**
+ * Reports, on channel <code>LC_MALLOC</code>, the live blocks and bytes,
+ * the peak live bytes and the allocation counts of every call site that
+ * allocated through midpMalloc, largest live bytes first. Only available
+ * when the build sets <code>ENABLE_MALLOC_SITE_STATS</code>, which also
+ * makes the allocation macros pass the call site regardless of
+ * <code>REPORT_LEVEL</code>.
+ *
+ * @param reset if non-zero, the counts of allocations since the last reset
+ *        are cleared after the report, so that successive dumps show the
+ *        allocation rate of each call site
+ *
+ * @return the number of call sites reported
+ */
+int midpMallocDumpSites(int reset);
+
+#endif /* ENABLE_MALLOC_SITE_STATS */
+
+#if REPORT_LEVEL <= LOG_WARNING || ENABLE_MALLOC_SITE_STATS
 
 /**
  * Allocates the given number of bytes from the private MIDP memory
@@ -271,7 +291,7 @@ int midpMallocDumpMemory(int countMemoryLeaksOnly);
  */
 #define midpFree(x)       midpFreeImpl((x), NULL, 0)
 
-#endif /* if REPORT_LEVEL <= LOG_WARNING */
+#endif /* if REPORT_LEVEL <= LOG_WARNING || ENABLE_MALLOC_SITE_STATS */
 
 #else /* DON'T ENABLE_MIDP_MALLOC */
 
@@ -359,6 +379,56 @@ extern char* strdup(const char*);
 
 #endif /* ENABLE_MIDP_MALLOC */
 
+/**
+ * Common type for routines that give back memory held by a native cache
+ * when memory runs short.
+ *
+ * @param cache pointer given when the routine was registered
+ * @param needed number of bytes wanted
+ * @return number of bytes released, or 0 if the cache holds nothing
+ */
+typedef int (*MidpReclaimProc)(void* cache, int needed);
+
+/**
+ * Registers a native cache that can release memory under pressure. With
+ * ENABLE_MIDP_MALLOC, the reclaimProc is called before an allocation
+ * when the free native heap has fallen below a low-memory watermark, and
+ * when an allocation fails, which is then retried once. In every build
+ * it is also called when a request for image memory from the resource
+ * manager would cross a limit. A cache that releases objects counted by
+ * the resource manager must also decrement their counts.
+ * <p>
+ * Since the reclaimProc can run inside any midpMalloc call, the cache
+ * must keep its data consistent across its own allocations, or refuse to
+ * release anything while it is changing it. A reclaimProc may free memory
+ * but must not allocate it.
+ *
+ * @param cache pointer to the cache, identifies the registration
+ * @param reclaimProc routine that releases memory held by the cache
+ * @return 0 on success, -1 if the table of caches is full
+ */
+int midpRegisterReclaimProc(void* cache, MidpReclaimProc reclaimProc);
+
+/**
+ * Unregisters a native cache. Must be called before the cache is
+ * destroyed.
+ *
+ * @param cache pointer to the cache; caches are considered to be the same
+ *        if the pointers are equal
+ */
+void midpUnregisterReclaimProc(void* cache);
+
+/**
+ * Asks the registered caches to release memory until at least the given
+ * number of bytes has been released or every cache has been asked. The
+ * caches are asked in turn, starting after the one that was asked last,
+ * so that no single cache is always emptied first.
+ *
+ * @param needed number of bytes wanted
+ * @return number of bytes released
+ */
+int midpReclaimMemory(int needed);
+
 #ifdef __cplusplus
 }
 #endif
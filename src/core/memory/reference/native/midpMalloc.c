@@ -57,6 +57,27 @@
  *
  * @note  In this midpMalloc implementation we wrap the pcslMemory functions
  * defined in pcsl_memory.h.
+ *
+ * <p>Requests of up to SLAB_MAX_SIZE bytes are served from a slab arena
+ * that is taken from the PCSL heap once, at initialization. The arena is
+ * split into pages of SLAB_PAGE_SIZE bytes; a page in use holds blocks of
+ * one size class only, and goes back to the pool of free pages as soon as
+ * its last block is freed, so small blocks never fragment the PCSL heap.
+ * A block pointer is recognized by its address falling into the arena, so
+ * blocks carry no header. Small requests fall back to the PCSL heap when
+ * the arena has no free page left, and larger requests always go there.
+ *
+ * <p>Having no header, slab blocks are not seen by pcsl_mem_malloc_dump()
+ * and carry none of the tracing items above. midpMallocDumpMemory() lists
+ * the live blocks of each slab page besides the PCSL dump, and counts them
+ * in its result; to find where a leaked small block was allocated, build
+ * with ENABLE_MALLOC_SITE_STATS, which records the call site of every block.
+ *
+ * <p>Native caches registered with midpRegisterReclaimProc() are asked to
+ * release memory before an allocation once the free heap has fallen below
+ * RECLAIM_WATERMARK, and again when an allocation fails. The registry is
+ * also built without ENABLE_MIDP_MALLOC, where only the resource manager
+ * asks the caches, as an image limit is about to be crossed.
  */
 
 #include <stdio.h>
@@ -70,8 +91,805 @@
 extern "C" {
 #endif
 
+/** Maximum number of registered reclaim routines */
+#define MAX_RECLAIM_PROCS 16
+
+/** A registered native cache */
+typedef struct _ReclaimEntry {
+    /** Pointer identifying the cache, NULL for a free entry */
+    void* cache;
+    /** Routine that releases memory held by the cache */
+    MidpReclaimProc reclaimProc;
+} ReclaimEntry;
+
+/**
+ * Registered caches. Kept in static memory, since they are needed when
+ * the heap has no memory left.
+ */
+static ReclaimEntry reclaimEntries[MAX_RECLAIM_PROCS];
+
+/** Index of the entry to ask first on the next reclaim */
+static int nextReclaimEntry = 0;
+
+/** Number of registered caches */
+static int reclaimEntryCount = 0;
+
+/** Set while the caches are being asked, to stop recursion */
+static int reclaiming = 0;
+
+/**
+ * Registers a native cache that can release memory under pressure.
+ *
+ * @param cache pointer to the cache, identifies the registration
+ * @param reclaimProc routine that releases memory held by the cache
+ * @return 0 on success, -1 if the table of caches is full
+ */
+int
+midpRegisterReclaimProc(void* cache, MidpReclaimProc reclaimProc) {
+    int i;
+
+    for (i = 0; i < MAX_RECLAIM_PROCS; i++) {
+        if (reclaimEntries[i].cache == NULL) {
+            reclaimEntries[i].cache = cache;
+            reclaimEntries[i].reclaimProc = reclaimProc;
+            reclaimEntryCount++;
+            return 0;
+        }
+    }
+
+    REPORT_WARN(LC_MALLOC, "midpRegisterReclaimProc: table is full\n");
+    return -1;
+}
+
+/**
+ * Unregisters a native cache.
+ *
+ * @param cache pointer to the cache
+ */
+void
+midpUnregisterReclaimProc(void* cache) {
+    int i;
+
+    for (i = 0; i < MAX_RECLAIM_PROCS; i++) {
+        if (cache != NULL && reclaimEntries[i].cache == cache) {
+            reclaimEntries[i].cache = NULL;
+            reclaimEntries[i].reclaimProc = NULL;
+            reclaimEntryCount--;
+        }
+    }
+}
+
+/**
+ * Asks the registered caches to release memory.
+ *
+ * @param needed number of bytes wanted
+ * @return number of bytes released
+ */
+int
+midpReclaimMemory(int needed) {
+    int released = 0;
+    int n;
+    int i;
+
+    if (reclaiming) {
+        return 0;
+    }
+
+    reclaiming = 1;
+
+    for (n = 0; n < MAX_RECLAIM_PROCS && released < needed; n++) {
+        i = nextReclaimEntry;
+        nextReclaimEntry = (nextReclaimEntry + 1) % MAX_RECLAIM_PROCS;
+
+        if (reclaimEntries[i].cache != NULL) {
+            released += reclaimEntries[i].reclaimProc(
+                reclaimEntries[i].cache, needed - released);
+        }
+    }
+
+    reclaiming = 0;
+
+    if (released > 0) {
+        REPORT_INFO2(LC_MALLOC, "midpReclaimMemory: %d of %d bytes\n",
+                     released, needed);
+    }
+
+    return released;
+}
+
 #if ENABLE_MIDP_MALLOC
 
+/**
+ * Free native heap below which the registered caches are asked to release
+ * memory before an allocation, so that they shrink before it fails.
+ */
+#ifndef RECLAIM_WATERMARK
+#define RECLAIM_WATERMARK (32 * 1024)
+#endif
+
+/**
+ * Bytes allocated between two checks of the free heap. Finding the free
+ * heap may walk the PCSL heap, so it is not done on every allocation.
+ */
+#define RECLAIM_CHECK_INTERVAL (4 * 1024)
+
+/** Bytes allocated since the free heap was last checked */
+static unsigned int reclaimCheckBytes = 0;
+
+/**
+ * Asks the registered caches for memory if the free heap, less an
+ * allocation about to be made, is below RECLAIM_WATERMARK. The free heap
+ * is only checked every RECLAIM_CHECK_INTERVAL bytes, or when the
+ * allocation alone would cross the watermark.
+ *
+ * @param size size of the allocation
+ */
+static void
+reclaimIfLow(unsigned int size) {
+    int freeHeap;
+
+    if (reclaimEntryCount == 0 || reclaiming) {
+        return;
+    }
+
+    reclaimCheckBytes += size;
+    if (reclaimCheckBytes < RECLAIM_CHECK_INTERVAL &&
+            size < RECLAIM_WATERMARK) {
+        return;
+    }
+
+    reclaimCheckBytes = 0;
+    freeHeap = midpGetFreeHeap();
+    if (freeHeap >= 0 && freeHeap - (int)size < RECLAIM_WATERMARK) {
+        midpReclaimMemory(RECLAIM_WATERMARK - freeHeap + (int)size);
+    }
+}
+
+/**
+ * Evaluates an allocation. The registered caches are asked for memory
+ * first if the free heap is running low, and again if the allocation
+ * fails, after which it is tried once more.
+ */
+#define PCSL_ALLOC(ptr, expr, size) \
+    do { \
+        reclaimIfLow((unsigned int)(size)); \
+        (ptr) = (expr); \
+        if ((ptr) == NULL && midpReclaimMemory((int)(size)) > 0) { \
+            (ptr) = (expr); \
+        } \
+    } while (0)
+
+/** Size of the slab arena taken from the PCSL heap, 0 to disable it */
+#ifndef SLAB_ARENA_SIZE
+#define SLAB_ARENA_SIZE (64 * 1024)
+#endif
+
+/** Size of one slab page */
+#define SLAB_PAGE_SIZE 1024
+
+/** Largest request served from the slab arena */
+#define SLAB_MAX_SIZE 256
+
+/** Number of slab size classes */
+#define SLAB_CLASSES 8
+
+/** Block size of each size class */
+static const unsigned int slabClassSize[SLAB_CLASSES] = {
+    16, 32, 48, 64, 96, 128, 192, 256
+};
+
+/** Size class of a request, indexed by the size in 16 byte units */
+static const unsigned char slabClassOf[SLAB_MAX_SIZE / 16 + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7
+};
+
+/** Descriptor of a slab page, kept outside the page itself */
+typedef struct _SlabPage {
+    /** Next page on the free page list or the partial list of the class */
+    struct _SlabPage* next;
+    /** Previous page on the partial list of the class */
+    struct _SlabPage* prev;
+    /** Freed blocks, linked through their first word */
+    void* freeBlocks;
+    /** Number of blocks handed out */
+    unsigned short used;
+    /** Number of blocks carved from the page so far */
+    unsigned short carved;
+    /** Size class of the blocks */
+    unsigned char sizeClass;
+} SlabPage;
+
+/** The slab arena, or NULL if slab allocation is off */
+static char* slabArena = NULL;
+
+/** End of the slab arena */
+static char* slabArenaEnd = NULL;
+
+/** One descriptor per arena page */
+static SlabPage* slabPages = NULL;
+
+/** Pages that hold no blocks */
+static SlabPage* slabFreePages = NULL;
+
+/** Per size class, pages that have room for another block */
+static SlabPage* slabPartial[SLAB_CLASSES];
+
+/** Bytes of the arena that are not handed out */
+static int slabFreeBytes = 0;
+
+/**
+ * Takes the slab arena from the PCSL heap. Slab allocation stays off if
+ * the heap cannot spare it.
+ */
+static void
+slabInitialize() {
+    int count = SLAB_ARENA_SIZE / SLAB_PAGE_SIZE;
+    int i;
+
+    if (count == 0) {
+        return;
+    }
+
+    slabPages = (SlabPage*)pcsl_mem_malloc(count * sizeof (SlabPage));
+    slabArena = (char*)pcsl_mem_malloc(count * SLAB_PAGE_SIZE);
+    if (slabPages == NULL || slabArena == NULL) {
+        if (slabPages != NULL) {
+            pcsl_mem_free(slabPages);
+        }
+
+        if (slabArena != NULL) {
+            pcsl_mem_free(slabArena);
+        }
+
+        slabPages = NULL;
+        slabArena = NULL;
+        return;
+    }
+
+    slabArenaEnd = slabArena + count * SLAB_PAGE_SIZE;
+    slabFreeBytes = count * SLAB_PAGE_SIZE;
+
+    slabFreePages = NULL;
+    for (i = count - 1; i >= 0; i--) {
+        slabPages[i].next = slabFreePages;
+        slabFreePages = &slabPages[i];
+    }
+
+    for (i = 0; i < SLAB_CLASSES; i++) {
+        slabPartial[i] = NULL;
+    }
+}
+
+/**
+ * Returns the slab arena to the PCSL heap.
+ */
+static void
+slabFinalize() {
+    if (slabArena == NULL) {
+        return;
+    }
+
+    pcsl_mem_free(slabPages);
+    pcsl_mem_free(slabArena);
+    slabPages = NULL;
+    slabArena = NULL;
+    slabArenaEnd = NULL;
+    slabFreePages = NULL;
+    slabFreeBytes = 0;
+}
+
+/**
+ * Tells whether a pointer is a block of the slab arena.
+ */
+#define SLAB_OWNS(ptr) \
+    ((char*)(ptr) >= slabArena && (char*)(ptr) < slabArenaEnd)
+
+/**
+ * Returns the descriptor of the page holding a slab block.
+ */
+#define SLAB_PAGE_OF(ptr) \
+    (&slabPages[((char*)(ptr) - slabArena) / SLAB_PAGE_SIZE])
+
+/**
+ * Returns the first byte of the page described by a descriptor.
+ */
+#define SLAB_PAGE_BASE(page) \
+    (slabArena + ((page) - slabPages) * SLAB_PAGE_SIZE)
+
+/**
+ * Unlinks a page from the partial list of its size class.
+ */
+static void
+slabUnlinkPartial(SlabPage* page) {
+    if (page->prev != NULL) {
+        page->prev->next = page->next;
+    } else {
+        slabPartial[page->sizeClass] = page->next;
+    }
+
+    if (page->next != NULL) {
+        page->next->prev = page->prev;
+    }
+}
+
+/**
+ * Links a page at the head of the partial list of its size class.
+ */
+static void
+slabLinkPartial(SlabPage* page) {
+    page->prev = NULL;
+    page->next = slabPartial[page->sizeClass];
+    if (page->next != NULL) {
+        page->next->prev = page;
+    }
+
+    slabPartial[page->sizeClass] = page;
+}
+
+/**
+ * Allocates a block of the given size class from the slab arena.
+ *
+ * @return the block, or NULL if the arena has no room for it
+ */
+static void*
+slabAlloc(int sizeClass) {
+    SlabPage* page = slabPartial[sizeClass];
+    unsigned int blockSize = slabClassSize[sizeClass];
+    void* block;
+
+    if (page == NULL) {
+        page = slabFreePages;
+        if (page == NULL) {
+            return NULL;
+        }
+
+        slabFreePages = page->next;
+        page->freeBlocks = NULL;
+        page->used = 0;
+        page->carved = 0;
+        page->sizeClass = (unsigned char)sizeClass;
+        slabLinkPartial(page);
+    }
+
+    if (page->freeBlocks != NULL) {
+        block = page->freeBlocks;
+        page->freeBlocks = *(void**)block;
+    } else {
+        /* carve blocks lazily so that taking a page costs nothing */
+        block = SLAB_PAGE_BASE(page) + page->carved * blockSize;
+        page->carved++;
+    }
+
+    page->used++;
+    slabFreeBytes -= blockSize;
+
+    if (page->freeBlocks == NULL &&
+            page->carved == SLAB_PAGE_SIZE / blockSize) {
+        /* full pages are on no list until a block comes back */
+        slabUnlinkPartial(page);
+    }
+
+    return block;
+}
+
+/**
+ * Frees a block of the slab arena.
+ */
+static void
+slabFree(void* block) {
+    SlabPage* page = SLAB_PAGE_OF(block);
+    unsigned int blockSize = slabClassSize[page->sizeClass];
+    int wasFull = page->freeBlocks == NULL &&
+        page->carved == SLAB_PAGE_SIZE / blockSize;
+
+    *(void**)block = page->freeBlocks;
+    page->freeBlocks = block;
+    page->used--;
+    slabFreeBytes += blockSize;
+
+    if (page->used == 0) {
+        /* an empty page can serve any size class again */
+        if (!wasFull) {
+            slabUnlinkPartial(page);
+        }
+
+        page->next = slabFreePages;
+        slabFreePages = page;
+    } else if (wasFull) {
+        slabLinkPartial(page);
+    }
+}
+
+/**
+ * Allocates a block from the slab arena or the PCSL heap.
+ */
+static void*
+allocSlabOrPcsl(unsigned int size) {
+    void* ptr;
+
+    if (size <= SLAB_MAX_SIZE && slabArena != NULL) {
+        ptr = slabAlloc(slabClassOf[(size + 15) >> 4]);
+        if (ptr != NULL) {
+            return ptr;
+        }
+    }
+
+    return pcsl_mem_malloc(size);
+}
+
+/**
+ * Allocates a block from the slab arena or the PCSL heap, asking the
+ * registered caches for memory if both are exhausted.
+ */
+static void*
+allocBlock(unsigned int size) {
+    void* ptr;
+
+    PCSL_ALLOC(ptr, allocSlabOrPcsl(size), size);
+    return ptr;
+}
+
+/**
+ * Frees a block of the slab arena or the PCSL heap.
+ */
+static void
+freeBlock(void* ptr) {
+    if (SLAB_OWNS(ptr)) {
+        slabFree(ptr);
+    } else {
+        pcsl_mem_free(ptr);
+    }
+}
+
+#if ENABLE_MALLOC_SITE_STATS
+
+/**
+ * @name Call site accounting
+ *
+ * Every block allocated through midpMalloc and friends is recorded in a
+ * hash table keyed by its address, together with its size and the call
+ * site (file name and line number) that allocated it. Each call site keeps
+ * counters of its live blocks and bytes, the peak of its live bytes, and
+ * the number of allocations and bytes allocated since startup and since
+ * the last reset. midpMallocDumpSites() reports them, and they are dumped
+ * once more when the memory pool is finalized, which lists what every call
+ * site leaked. Blocks freed with midpFree that were not allocated through
+ * midpMalloc are not found in the table and are not counted.
+ * @{
+ */
+
+/** Number of call sites that can be told apart, a power of two */
+#define SITE_TABLE_SIZE 512
+
+/** Initial number of slots of the block table, a power of two */
+#define BLOCK_TABLE_INITIAL_SIZE 1024
+
+/** Counters of one call site */
+typedef struct _MallocSite {
+    /** File of the call site, NULL for an unused entry */
+    const char* filename;
+    /** Line of the call site */
+    int lineno;
+    /** Number of blocks allocated here and not yet freed */
+    int liveBlocks;
+    /** Bytes allocated here and not yet freed */
+    unsigned long liveBytes;
+    /** Highest value of liveBytes */
+    unsigned long peakBytes;
+    /** Number of allocations since startup */
+    unsigned long totalAllocs;
+    /** Bytes allocated since startup */
+    unsigned long totalBytes;
+    /** Number of allocations since the last reset */
+    unsigned long recentAllocs;
+    /** Bytes allocated since the last reset */
+    unsigned long recentBytes;
+} MallocSite;
+
+/** A live block, a slot of the block table */
+typedef struct _TrackedBlock {
+    /** Address of the block, NULL for an empty slot */
+    void* ptr;
+    /** Requested size of the block */
+    unsigned int size;
+    /** Index of the allocating call site */
+    unsigned int site;
+} TrackedBlock;
+
+/**
+ * Call sites. The last entry collects the allocations of call sites that
+ * did not fit into the table.
+ */
+static MallocSite sites[SITE_TABLE_SIZE + 1];
+
+/** Live blocks, open addressing with linear probing */
+static TrackedBlock* blocks = NULL;
+
+/** Number of slots of the block table */
+static unsigned int blockSlots = 0;
+
+/** Number of used slots of the block table */
+static unsigned int blockCount = 0;
+
+/** Allocations that could not be recorded for lack of memory */
+static unsigned long untrackedAllocs = 0;
+
+/** Unknown call site name */
+static const char unknownSite[] = "(unknown)";
+
+/** Call site name of the overflow entry */
+static const char otherSites[] = "(other sites)";
+
+/**
+ * Returns the home slot of a block address in the block table.
+ */
+#define BLOCK_HASH(ptr) \
+    ((unsigned int)(((unsigned long)(ptr) >> 3) * 2654435761UL) & \
+        (blockSlots - 1))
+
+/**
+ * Returns the index of the entry for a call site, creating the entry if
+ * needed. File names are compared by address, since every caller passes
+ * __FILE__ of its own translation unit.
+ */
+static unsigned int
+siteIndex(const char* filename, int lineno) {
+    unsigned int i;
+    unsigned int n;
+
+    if (filename == NULL) {
+        filename = unknownSite;
+    }
+
+    i = ((unsigned int)((unsigned long)filename >> 2) ^
+         (unsigned int)lineno * 2654435761U) & (SITE_TABLE_SIZE - 1);
+
+    for (n = 0; n < SITE_TABLE_SIZE; n++) {
+        if (sites[i].filename == NULL) {
+            sites[i].filename = filename;
+            sites[i].lineno = lineno;
+            return i;
+        }
+
+        if (sites[i].filename == filename && sites[i].lineno == lineno) {
+            return i;
+        }
+
+        i = (i + 1) & (SITE_TABLE_SIZE - 1);
+    }
+
+    sites[SITE_TABLE_SIZE].filename = otherSites;
+    return SITE_TABLE_SIZE;
+}
+
+/**
+ * Doubles the block table, or allocates the first one.
+ *
+ * @return 0 on success, -1 if there is no memory for it
+ */
+static int
+growBlockTable() {
+    TrackedBlock* oldBlocks = blocks;
+    unsigned int oldSlots = blockSlots;
+    unsigned int newSlots =
+        oldSlots == 0 ? BLOCK_TABLE_INITIAL_SIZE : oldSlots * 2;
+    TrackedBlock* newBlocks;
+    unsigned int i;
+    unsigned int j;
+
+    /* the table itself is not accounted, so it bypasses the slab too */
+    newBlocks = (TrackedBlock*)pcsl_mem_malloc(newSlots *
+                                               sizeof (TrackedBlock));
+    if (newBlocks == NULL) {
+        return -1;
+    }
+
+    memset(newBlocks, 0, newSlots * sizeof (TrackedBlock));
+    blocks = newBlocks;
+    blockSlots = newSlots;
+
+    for (i = 0; i < oldSlots; i++) {
+        if (oldBlocks[i].ptr != NULL) {
+            j = BLOCK_HASH(oldBlocks[i].ptr);
+            while (blocks[j].ptr != NULL) {
+                j = (j + 1) & (blockSlots - 1);
+            }
+
+            blocks[j] = oldBlocks[i];
+        }
+    }
+
+    if (oldBlocks != NULL) {
+        pcsl_mem_free(oldBlocks);
+    }
+
+    return 0;
+}
+
+/**
+ * Records a new block for its call site.
+ */
+static void
+siteRecordAlloc(void* ptr, unsigned int size,
+                const char* filename, int lineno) {
+    MallocSite* site;
+    unsigned int index;
+    unsigned int i;
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    /* keep the table at most three quarters full */
+    if ((blockCount + 1) * 4 > blockSlots * 3 && growBlockTable() != 0) {
+        untrackedAllocs++;
+        return;
+    }
+
+    index = siteIndex(filename, lineno);
+    site = &sites[index];
+    site->liveBlocks++;
+    site->liveBytes += size;
+    if (site->liveBytes > site->peakBytes) {
+        site->peakBytes = site->liveBytes;
+    }
+
+    site->totalAllocs++;
+    site->totalBytes += size;
+    site->recentAllocs++;
+    site->recentBytes += size;
+
+    i = BLOCK_HASH(ptr);
+    while (blocks[i].ptr != NULL) {
+        i = (i + 1) & (blockSlots - 1);
+    }
+
+    blocks[i].ptr = ptr;
+    blocks[i].size = size;
+    blocks[i].site = index;
+    blockCount++;
+}
+
+/**
+ * Removes a block from the live counters of its call site.
+ */
+static void
+siteRecordFree(void* ptr) {
+    unsigned int i;
+    unsigned int j;
+    unsigned int home;
+    MallocSite* site;
+
+    if (ptr == NULL || blockSlots == 0) {
+        return;
+    }
+
+    for (i = BLOCK_HASH(ptr); blocks[i].ptr != ptr;
+             i = (i + 1) & (blockSlots - 1)) {
+        if (blocks[i].ptr == NULL) {
+            /* not allocated through midpMalloc, or not recorded */
+            return;
+        }
+    }
+
+    site = &sites[blocks[i].site];
+    site->liveBlocks--;
+    site->liveBytes -= blocks[i].size;
+
+    /* close the gap so that later probes do not stop early */
+    blocks[i].ptr = NULL;
+    for (j = (i + 1) & (blockSlots - 1); blocks[j].ptr != NULL;
+             j = (j + 1) & (blockSlots - 1)) {
+        home = BLOCK_HASH(blocks[j].ptr);
+        if (((j - home) & (blockSlots - 1)) >=
+                ((j - i) & (blockSlots - 1))) {
+            blocks[i] = blocks[j];
+            blocks[j].ptr = NULL;
+            i = j;
+        }
+    }
+
+    blockCount--;
+}
+
+/**
+ * Reports the counters of every call site that has live blocks or
+ * allocated since the last reset, largest live bytes first, on the
+ * LC_MALLOC channel.
+ *
+ * @param reset if non-zero, the counters of allocations since the last
+ *        reset are cleared afterwards, so that the next dump shows the
+ *        allocation rate over the time in between
+ *
+ * @return the number of call sites reported
+ */
+int
+midpMallocDumpSites(int reset) {
+    static unsigned short order[SITE_TABLE_SIZE + 1];
+    unsigned long liveBytes = 0;
+    unsigned short index;
+    int count = 0;
+    int i;
+    int j;
+
+    for (i = 0; i <= SITE_TABLE_SIZE; i++) {
+        if (sites[i].filename == NULL ||
+                (sites[i].liveBlocks == 0 && sites[i].recentAllocs == 0)) {
+            continue;
+        }
+
+        /* insertion sort by live bytes */
+        for (j = count; j > 0 &&
+                 sites[order[j - 1]].liveBytes < sites[i].liveBytes; j--) {
+            order[j] = order[j - 1];
+        }
+
+        order[j] = (unsigned short)i;
+        count++;
+        liveBytes += sites[i].liveBytes;
+    }
+
+    reportToLog(LOG_WARNING, LC_MALLOC,
+                "midpMalloc call sites: %d, live bytes: %lu, "
+                "untracked allocations: %lu",
+                count, liveBytes, untrackedAllocs);
+    reportToLog(LOG_WARNING, LC_MALLOC,
+                "live blocks/live bytes/peak bytes/allocs/bytes"
+                "/recent allocs/recent bytes  site");
+
+    for (i = 0; i < count; i++) {
+        index = order[i];
+        reportToLog(LOG_WARNING, LC_MALLOC,
+                    "%d/%lu/%lu/%lu/%lu/%lu/%lu  %s:%d",
+                    sites[index].liveBlocks, sites[index].liveBytes,
+                    sites[index].peakBytes, sites[index].totalAllocs,
+                    sites[index].totalBytes, sites[index].recentAllocs,
+                    sites[index].recentBytes, sites[index].filename,
+                    sites[index].lineno);
+    }
+
+    if (reset) {
+        for (i = 0; i <= SITE_TABLE_SIZE; i++) {
+            sites[i].recentAllocs = 0;
+            sites[i].recentBytes = 0;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Dumps the remaining blocks of each call site and frees the block table.
+ */
+static void
+siteFinalize() {
+    midpMallocDumpSites(0);
+
+    if (blocks != NULL) {
+        pcsl_mem_free(blocks);
+    }
+
+    blocks = NULL;
+    blockSlots = 0;
+    blockCount = 0;
+    memset(sites, 0, sizeof (sites));
+}
+
+/** @} */
+
+#define SITE_RECORD_ALLOC(ptr, size, filename, lineno) \
+    siteRecordAlloc((ptr), (size), (filename), (lineno))
+#define SITE_RECORD_FREE(ptr) siteRecordFree((ptr))
+#define SITE_FINALIZE() siteFinalize()
+
+#else
+
+#define SITE_RECORD_ALLOC(ptr, size, filename, lineno)
+#define SITE_RECORD_FREE(ptr)
+#define SITE_FINALIZE()
+
+#endif /* ENABLE_MALLOC_SITE_STATS */
+
 /**
  * FUNCTION:      midpInitializeMemory()
  * TYPE:          public operation
@@ -85,9 +903,13 @@ extern "C" {
  */
 int
 midpInitializeMemory(int size) {
-    int tmp = size;
-    tmp++; /* avoid compile warning for unused variable */
-    return pcsl_mem_initialize(NULL, size);
+    int status = pcsl_mem_initialize(NULL, size);
+
+    if (status == 0) {
+        slabInitialize();
+    }
+
+    return status;
 }
 
 
@@ -103,6 +925,8 @@ midpInitializeMemory(int size) {
 void
 midpFinalizeMemory() {
 
+    SITE_FINALIZE();
+    slabFinalize();
     pcsl_mem_finalize();
 }
 
@@ -119,9 +943,15 @@ midpFinalizeMemory() {
  */
 void*
 midpMallocImpl(unsigned int size, char* filename, int lineno) {
+    void* ptr;
+
     (void) filename;
     (void) lineno;
-    return pcsl_mem_malloc(size);
+
+    ptr = allocBlock(size);
+    SITE_RECORD_ALLOC(ptr, size, filename, lineno);
+
+    return ptr;
 }
 
 
@@ -141,9 +971,24 @@ midpMallocImpl(unsigned int size, char* filename, int lineno) {
 void*
 midpCallocImpl(unsigned int nelem, unsigned int elsize,
                char* filename, int lineno) {
+    unsigned int size = nelem * elsize;
+    void* ptr;
+
     (void) filename;
     (void) lineno;
-    return pcsl_mem_calloc(nelem, elsize);
+
+    if (elsize != 0 && size / elsize == nelem && size <= SLAB_MAX_SIZE) {
+        ptr = allocBlock(size);
+        if (ptr != NULL) {
+            memset(ptr, 0, size);
+        }
+    } else {
+        PCSL_ALLOC(ptr, pcsl_mem_calloc(nelem, elsize), size);
+    }
+
+    SITE_RECORD_ALLOC(ptr, size, filename, lineno);
+
+    return ptr;
 }
 
 /**
@@ -160,9 +1005,37 @@ midpCallocImpl(unsigned int nelem, unsigned int elsize,
  */
 void*
 midpReallocImpl(void* ptr, unsigned int size, char* filename, int lineno) {
+    unsigned int blockSize;
+    void* newPtr;
+
     (void) filename;
     (void) lineno;
-    return pcsl_mem_realloc(ptr, size);
+
+    if (!SLAB_OWNS(ptr)) {
+        PCSL_ALLOC(newPtr, pcsl_mem_realloc(ptr, size), size);
+    } else if (size == 0) {
+        slabFree(ptr);
+        newPtr = NULL;
+    } else {
+        blockSize = slabClassSize[SLAB_PAGE_OF(ptr)->sizeClass];
+        if (size <= blockSize) {
+            newPtr = ptr;
+        } else {
+            newPtr = allocBlock(size);
+            if (newPtr != NULL) {
+                memcpy(newPtr, ptr, blockSize);
+                slabFree(ptr);
+            }
+        }
+    }
+
+    /* a failed realloc leaves the original block in place */
+    if (newPtr != NULL || size == 0) {
+        SITE_RECORD_FREE(ptr);
+        SITE_RECORD_ALLOC(newPtr, size, filename, lineno);
+    }
+
+    return newPtr;
 }
 
 #ifdef UNDER_CE
@@ -188,9 +1061,24 @@ char * strdup(const char *s) {
  */
 char*
 midpStrdupImpl(const char *s1, char* filename, int lineno) {
+    unsigned int size = strlen(s1) + 1;
+    char* s2;
+
     (void) filename;
     (void) lineno;
-    return (char*)pcsl_mem_strdup(s1);
+
+    if (size <= SLAB_MAX_SIZE) {
+        s2 = (char*)allocBlock(size);
+        if (s2 != NULL) {
+            memcpy(s2, s1, size);
+        }
+    } else {
+        PCSL_ALLOC(s2, (char*)pcsl_mem_strdup(s1), size);
+    }
+
+    SITE_RECORD_ALLOC(s2, size, filename, lineno);
+
+    return s2;
 }
 
 
@@ -209,7 +1097,9 @@ void
 midpFreeImpl(void *ptr, char *filename, int lineno) {
     (void) filename;
     (void) lineno;
-    pcsl_mem_free(ptr);
+
+    SITE_RECORD_FREE(ptr);
+    freeBlock(ptr);
 }
 
 /**
@@ -240,15 +1130,52 @@ midpGetTotalHeap() {
  */
 int
 midpGetFreeHeap() {
+    int freeHeap = pcsl_mem_get_free_heap();
+
+    /* the unused part of the slab arena is free for small blocks */
+    return freeHeap < 0 ? freeHeap : freeHeap + slabFreeBytes;
+}
+
+/**
+ * Reports the pages of the slab arena that hold live blocks, which the
+ * PCSL heap dump cannot see.
+ *
+ * @return the number of live slab blocks
+ */
+static int
+slabDump() {
+    int count;
+    int blocks = 0;
+    int i;
+
+    if (slabArena == NULL) {
+        return 0;
+    }
 
-    return pcsl_mem_get_free_heap();
+    count = (slabArenaEnd - slabArena) / SLAB_PAGE_SIZE;
+    for (i = 0; i < count; i++) {
+        if (slabPages[i].used > 0) {
+            reportToLog(LOG_WARNING, LC_MALLOC,
+                        "slab page %d: %d live blocks of %u bytes",
+                        i, slabPages[i].used,
+                        slabClassSize[slabPages[i].sizeClass]);
+            blocks += slabPages[i].used;
+        }
+    }
+
+    reportToLog(LOG_WARNING, LC_MALLOC,
+                "slab arena: %d live blocks, %d free bytes",
+                blocks, slabFreeBytes);
+
+    return blocks;
 }
 
 /* Set countMemoryLeaksOnly = 0 in order to get more verbose information */
 int midpMallocDumpMemory(int countMemoryLeaksOnly) {
-    int tmp = countMemoryLeaksOnly;
-    tmp++; /* avoid compile warning for unused variable */
-    return pcsl_mem_malloc_dump(countMemoryLeaksOnly);
+    int count = pcsl_mem_malloc_dump(countMemoryLeaksOnly);
+    int slabBlocks = slabDump();
+
+    return count < 0 ? count : count + slabBlocks;
 }
 
 #endif  /* ENABLE_MIDP_MALLOC*/
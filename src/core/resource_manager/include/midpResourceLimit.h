@@ -86,6 +86,9 @@ extern int midpCheckResourceLimit (RscType type, int requestSize);
  * internally be fetched from getCurrentIsolateId() as defined in midpServices.h
  * This function should be called strictly from the Java native function 
  * which would have been triggered by corresponding Java thread.
+ * If an image memory request would cross a limit, the native caches
+ * registered with midpRegisterReclaimProc() are asked to release memory
+ * and the request is tried once more.
  *
  * @param type Resource type
  * mode the resource limit is always checked against the global limit.  
@@ -142,10 +142,33 @@ static int gResourcesAvailable[RSC_TYPE_COUNT] = {
     IMAGE_IMMUT_GLOBAL_LIMIT - IMAGE_IMMUT_AMS_RESERVED  /*RSC_TYPE_IMAGE_IMMUT*/
 };
 
+/**
+ * Tells whether native caches may hold memory of the given resource type,
+ * so that asking them to release memory can make room for a request.
+ */
+#define IS_RECLAIMABLE(type) \
+    ((type) == RSC_TYPE_IMAGE_MUT || (type) == RSC_TYPE_IMAGE_IMMUT)
+
 static int isInitialized = KNI_FALSE;
 static _IsolateResourceUsage* gIsolateResourceUsage;
 static int max_isolates = 0;
 
+/**
+ * Index of the gIsolateResourceUsage entry last assigned to an isolate,
+ * hashed by isolate ID, or -1. A hit is confirmed by comparing the ID,
+ * so collisions only cost a fallback to the linear search.
+ */
+static int* gIsolateSlot = NULL;
+
+/** Number of gIsolateSlot entries, a power of two */
+static int isolateSlotCount = 0;
+
+/**
+ * Returns the gIsolateSlot entry for an isolate ID.
+ */
+#define ISOLATE_SLOT(isolateId) \
+    gIsolateSlot[(unsigned int)(isolateId) & (isolateSlotCount - 1)]
+
 
 /**
  * Initialize the Resource limit structures.
@@ -182,6 +205,20 @@ static void initResourceLimit(void) {
     gIsolateResourceUsage[0].isolateId = 1;
     gIsolateResourceUsage[0].inUse = 1;
 
+    /* twice as many slots as isolates keeps collisions rare */
+    i = 1;
+    while (i < 2 * max_isolates) {
+        i <<= 1;
+    }
+
+    gIsolateSlot = (int*)midpMalloc(sizeof (int) * i);
+    if (gIsolateSlot != NULL) {
+        isolateSlotCount = i;
+        for (j = 0; j < isolateSlotCount; j++) {
+            gIsolateSlot[j] = -1;
+        }
+    }
+
     isInitialized = KNI_TRUE;
 }
 
@@ -194,6 +231,11 @@ void midpFinalizeResourceLimit(void) {
             midpFree(gIsolateResourceUsage);
             gIsolateResourceUsage = NULL;
         }
+        if (gIsolateSlot) {
+            midpFree(gIsolateSlot);
+            gIsolateSlot = NULL;
+            isolateSlotCount = 0;
+        }
         isInitialized = KNI_FALSE;
     }
 }
@@ -218,8 +260,19 @@ static _IsolateResourceUsage *findIsolateResourceUsageStruct(int isolateId) {
         return &(gIsolateResourceUsage[0]);
     }
 
+    if (isolateSlotCount > 0) {
+        i = ISOLATE_SLOT(isolateId);
+        if (i >= 0 && isolateId == gIsolateResourceUsage[i].isolateId) {
+            return &(gIsolateResourceUsage[i]);
+        }
+    }
+
     for (i = 0; i < max_isolates; i++) {
         if (isolateId == gIsolateResourceUsage[i].isolateId) {
+            if (isolateSlotCount > 0) {
+                ISOLATE_SLOT(isolateId) = i;
+            }
+
             return &(gIsolateResourceUsage[i]);
         }
     }
@@ -283,7 +336,13 @@ int midpCheckResourceLimit(RscType type, int requestSize) {
                  isolateId, type, requestSize);
 
     if (entry != 0 && entry->inUse) {
-        return checkResourceLimit(entry, type, requestSize);
+        if (checkResourceLimit(entry, type, requestSize)) {
+            return 1;
+        }
+
+        /* the caches give memory back under pressure, then try again */
+        return IS_RECLAIMABLE(type) && midpReclaimMemory(requestSize) > 0 &&
+            checkResourceLimit(entry, type, requestSize);
     }
 
     REPORT_INFO1(LC_CORE, "RESOURCES [%d] midpCheckResourceLimit FAILED\n",
@@ -292,18 +351,16 @@ int midpCheckResourceLimit(RscType type, int requestSize) {
     return 0; /* failed */
 }
 
-/*
- * Increment the resource consumption count. IsolateID will internally be
- * fetched from getCurrentIsolateId() as defined in midpServices.h
+/**
+ * Increments the resource consumption count of the current isolate if
+ * the limits allow it.
  *
  * @param type Resource type
- * mode the resource limit is always checked against the global limit.
  * @param delta requesting size
  *
  * @return 1 if count is successfully incremented, otherwise 0
- *
  */
-int midpIncResourceCount(RscType type, int delta) {
+static int incResourceCount(RscType type, int delta) {
     int isolateId = getCurrentIsolateId();
     _IsolateResourceUsage *entry = findIsolateResourceUsageStruct(isolateId);
 
@@ -354,6 +411,27 @@ int midpIncResourceCount(RscType type, int delta) {
     return 0; /* failed */
 }
 
+/*
+ * Increment the resource consumption count. IsolateID will internally be
+ * fetched from getCurrentIsolateId() as defined in midpServices.h
+ *
+ * @param type Resource type
+ * mode the resource limit is always checked against the global limit.
+ * @param delta requesting size
+ *
+ * @return 1 if count is successfully incremented, otherwise 0
+ *
+ */
+int midpIncResourceCount(RscType type, int delta) {
+    if (incResourceCount(type, delta)) {
+        return 1;
+    }
+
+    /* the caches give memory back under pressure, then try again */
+    return IS_RECLAIMABLE(type) && midpReclaimMemory(delta) > 0 &&
+        incResourceCount(type, delta);
+}
+
 /*
  * Decrement the resource consumption count.  IsolateID will internally
  * be fetched from getCurrentIsolateId() as defined in midpServices.h
@@ -496,6 +574,10 @@ int midpAllocateReservedResources() {
             gIsolateResourceUsage[idx].isolateId = isolateId;
             gIsolateResourceUsage[idx].inUse = 1;
 
+            if (isolateSlotCount > 0) {
+                ISOLATE_SLOT(isolateId) = idx;
+            }
+
         }
     } else {
         status = KNI_FALSE;
@@ -33,6 +33,12 @@ import java.io.*;
 final class IsolateSystemServiceRequestHandler 
     implements SystemServiceRequestListener {
 
+    /**
+     * Number of messages a service connection link queues before send()
+     * blocks, so that requests and responses don't wait for the peer.
+     */
+    private static final int CONNECTION_QUEUE_SIZE = 8;
+
     private Isolate serviceIsolate = null;
     private Isolate clientIsolate = null;
 
@@ -76,8 +82,10 @@ final class IsolateSystemServiceRequestHandler
             return null;
         }
 
-        Link serviceToClient = Link.newLink(serviceIsolate, clientIsolate);
-        Link clientToService = Link.newLink(clientIsolate, serviceIsolate);
+        Link serviceToClient = Link.newLink(serviceIsolate, clientIsolate,
+                CONNECTION_QUEUE_SIZE);
+        Link clientToService = Link.newLink(clientIsolate, serviceIsolate,
+                CONNECTION_QUEUE_SIZE);
         SystemServiceConnectionLinks connectionLinks = 
             new SystemServiceConnectionLinks(serviceToClient, clientToService);
 
@@ -65,7 +65,8 @@ jlong get_timer_wakeup(const TimerHandle *timer);
 
 
 /**
- * Set bsoulte wakeup time for the timer
+ * Set bsoulte wakeup time for the timer.
+ * A queued timer is moved to its new place in the queue.
  *
  * @param timer instance of the timer to set wakeup time to
  * @param timeToWakeup absolute time when the timer should wakeup
@@ -112,7 +113,7 @@ TimerHandle* remove_timer(TimerHandle* timer);
 
 /**
  * Remove a specific entry indicated by user data.
- * Only first element matching the userData is removed.
+ * Only the earliest timer matching the userData is removed.
  *
  * @param userdata user specified data used to identify the entry to remove
  */
@@ -141,4 +142,32 @@ TimerHandle* peek_timer();
  */
 void wakeup_timer(TimerHandle *timer);
 
+/**
+ * Get the descriptor that becomes readable when the earliest timer
+ * in the queue expires. It lets the master mode loop wait for timer
+ * alarms together with other descriptors.
+ *
+ * @return timer descriptor, or -1 if the platform does not support it
+ *    or no timer has been queued yet
+ */
+int get_timer_queue_fd();
+
+/**
+ * Check if the timer descriptor is armed for the earliest timer in the
+ * queue. If arming it has failed, the descriptor will not wake the
+ * master mode loop up in time, and the loop has to shorten its wait
+ * timeout to the earliest timer instead.
+ *
+ * @return KNI_TRUE if waiting on the timer descriptor does not miss
+ *    timer alarms, KNI_FALSE otherwise
+ */
+jboolean is_timer_queue_fd_armed();
+
+/**
+ * Acknowledge expiration of the timer descriptor, so that it stops
+ * being readable until the next expiration. Should be called after
+ * the expired timers have been processed.
+ */
+void clear_timer_queue_fd();
+
 #endif /*_TIMER_QUEUE_H_*/
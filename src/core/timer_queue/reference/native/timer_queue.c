@@ -33,30 +33,249 @@
 
 #include <kni.h>
 #include <stdlib.h>
+#include <string.h>
 #include <midpMalloc.h>
+#include <midp_logging.h>
 #include <timer_queue.h>
 
+#if ENABLE_TIMER_QUEUE_FD
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
 /**
  *  TimerHandle
  *
- *  Implementation of data structure to keep an ordered list of
- *  upcoming timers. Operations on data structure:
- *    add    : insert new timer into ordered timers list
- *    get    : fetch first pending timer
+ *  Implementation of data structure to keep upcoming timers ordered by
+ *  wakeup time. Timers are kept in a binary min-heap, each timer knows
+ *  its position in the heap, and queued timers are also hashed by user
+ *  data. Operations on data structure:
+ *    add    : insert new timer into the heap, O(log n)
+ *    get    : fetch first pending timer, O(log n)
  *    peek   : fetch first pending timer but do not remove from data-structure
  *    new    : create a new entry and enqueue in data-structure
- *    delete : remove an entry from data-structure and free its memory
- *    remove : remove a specific entry indicated by user data
+ *    delete : remove an entry from data-structure and free its memory, O(log n)
+ *    remove : remove a specific entry indicated by user data, O(log n)
  **/
 struct _TimerHandle {
     jlong timeToWakeup;             /* Absolute time to wakeup */
     void* userData;                 /* User data provided with timer */
     fTimerCallback userCallback;    /* User action on alarm */
-    struct _TimerHandle* next;      /* Next timer handle in the queue */
+    int heapIndex;                  /* Position in the heap, -1 if not queued */
+    struct _TimerHandle* nextByData; /* Next timer in the user data bucket */
 };
 
-/** Timers queue */
-static TimerHandle* rootTimer = NULL;
+/** Initial capacity of the timer heap, grown on demand */
+#define INITIAL_HEAP_CAPACITY 16
+
+/** Number of user data buckets, must be a power of two */
+#define USERDATA_BUCKETS 64
+
+/** Maps user data to its bucket */
+#define USERDATA_BUCKET(data) \
+    ((((unsigned long)(data)) >> 2) & (USERDATA_BUCKETS - 1))
+
+/** Timers heap, the earliest timer is at index 0 */
+static TimerHandle** timerHeap = NULL;
+
+/** Number of timers in the heap */
+static int heapSize = 0;
+
+/** Number of entries allocated for the heap */
+static int heapCapacity = 0;
+
+/** Queued timers hashed by user data */
+static TimerHandle* timersByData[USERDATA_BUCKETS];
+
+#if ENABLE_TIMER_QUEUE_FD
+/** Timer descriptor armed for the earliest wakeup time, -1 if not created */
+static int timerFd = -1;
+
+/** Wakeup time the timer descriptor is armed for, -1 if disarmed */
+static jlong armedWakeup = -1;
+#endif
+
+/**
+ * Arm the timer descriptor for the earliest wakeup time in the queue,
+ * or disarm it if the queue is empty. Does nothing when the earliest
+ * wakeup time has not changed.
+ */
+static void update_timer_fd() {
+#if ENABLE_TIMER_QUEUE_FD
+    struct itimerspec spec;
+    jlong wakeup = (heapSize > 0) ? timerHeap[0]->timeToWakeup : -1;
+
+    if (timerFd == -1 || wakeup == armedWakeup) {
+        return;
+    }
+
+    memset(&spec, 0, sizeof (spec));
+    if (wakeup >= 0) {
+        spec.it_value.tv_sec = (time_t)(wakeup / 1000);
+        spec.it_value.tv_nsec = (long)(wakeup % 1000) * 1000000;
+        if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0) {
+            /* Zero disarms the timer, expire as soon as possible instead */
+            spec.it_value.tv_nsec = 1;
+        }
+    }
+
+    if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, NULL) != 0) {
+        /* Left unarmed, see is_timer_queue_fd_armed() */
+        REPORT_ERROR(LC_CORE, "[update_timer_fd] timerfd_settime failed");
+        return;
+    }
+
+    armedWakeup = wakeup;
+#endif
+}
+
+/** Place a timer at a heap position and update its index */
+#define HEAP_SET(index, timer) \
+    timerHeap[(index)] = (timer); \
+    (timer)->heapIndex = (index)
+
+/**
+ * Move a timer towards the root until its parent wakes up earlier
+ *
+ * @param index heap position of the timer
+ */
+static void sift_up(int index) {
+    TimerHandle* timer = timerHeap[index];
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (timerHeap[parent]->timeToWakeup <= timer->timeToWakeup) {
+            break;
+        }
+        HEAP_SET(index, timerHeap[parent]);
+        index = parent;
+    }
+    HEAP_SET(index, timer);
+}
+
+/**
+ * Move a timer towards the leaves until its children wake up later
+ *
+ * @param index heap position of the timer
+ */
+static void sift_down(int index) {
+    TimerHandle* timer = timerHeap[index];
+
+    for (;;) {
+        int child = 2 * index + 1;
+        if (child >= heapSize) {
+            break;
+        }
+        if (child + 1 < heapSize &&
+                timerHeap[child + 1]->timeToWakeup <
+                timerHeap[child]->timeToWakeup) {
+            child++;
+        }
+        if (timer->timeToWakeup <= timerHeap[child]->timeToWakeup) {
+            break;
+        }
+        HEAP_SET(index, timerHeap[child]);
+        index = child;
+    }
+    HEAP_SET(index, timer);
+}
+
+/**
+ * Restore heap order around a timer whose wakeup time has changed
+ *
+ * @param index heap position of the timer
+ */
+static void sift(int index) {
+    if (index > 0 && timerHeap[(index - 1) / 2]->timeToWakeup >
+            timerHeap[index]->timeToWakeup) {
+        sift_up(index);
+    } else {
+        sift_down(index);
+    }
+}
+
+/**
+ * Remove a queued timer from the user data bucket it is hashed in
+ *
+ * @param timer queued timer
+ */
+static void unlink_userdata(TimerHandle* timer) {
+    TimerHandle** ptr = &timersByData[USERDATA_BUCKET(timer->userData)];
+
+    for (; *ptr != NULL; ptr = &((*ptr)->nextByData)) {
+        if (*ptr == timer) {
+            *ptr = timer->nextByData;
+            break;
+        }
+    }
+    timer->nextByData = NULL;
+}
+
+/**
+ * Detach a queued timer from the heap and the user data map
+ *
+ * @param timer queued timer
+ */
+static void unlink_timer(TimerHandle* timer) {
+    int index = timer->heapIndex;
+
+    unlink_userdata(timer);
+
+    heapSize--;
+    if (index != heapSize) {
+        HEAP_SET(index, timerHeap[heapSize]);
+        sift(index);
+    }
+    timerHeap[heapSize] = NULL;
+    timer->heapIndex = -1;
+
+    update_timer_fd();
+}
+
+/**
+ * Insert a timer into the heap and the user data map
+ *
+ * @param newTimer timer that is not queued
+ *
+ * @return 0 on success, -1 if the heap could not be grown
+ */
+static int link_timer(TimerHandle* newTimer) {
+    TimerHandle** bucket;
+
+    if (heapSize == heapCapacity) {
+        int newCapacity = heapCapacity > 0 ?
+            heapCapacity * 2 : INITIAL_HEAP_CAPACITY;
+        TimerHandle** newHeap = (TimerHandle**)midpRealloc(timerHeap,
+            newCapacity * sizeof (TimerHandle*));
+        if (newHeap == NULL) {
+            REPORT_CRIT1(LC_CORE, "[add_timer] cannot grow timer heap to %d",
+                         newCapacity);
+            return -1;
+        }
+        timerHeap = newHeap;
+        heapCapacity = newCapacity;
+    }
+
+#if ENABLE_TIMER_QUEUE_FD
+    if (timerFd == -1) {
+        timerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK);
+        if (timerFd == -1) {
+            REPORT_ERROR(LC_CORE, "[add_timer] timerfd_create failed");
+        }
+    }
+#endif
+
+    HEAP_SET(heapSize, newTimer);
+    heapSize++;
+    sift_up(newTimer->heapIndex);
+
+    bucket = &timersByData[USERDATA_BUCKET(newTimer->userData)];
+    newTimer->nextByData = *bucket;
+    *bucket = newTimer;
+
+    update_timer_fd();
+    return 0;
+}
 
 /**
  * Insert new timer to the correct place in timer queue
@@ -65,16 +284,11 @@ static TimerHandle* rootTimer = NULL;
  * @param newTimer new timer to add to queue
  */
 void add_timer(TimerHandle* newTimer) {
-    TimerHandle **ptr = &rootTimer;
     REPORT_INFO1(LC_PUSH, "[add_timer] newTimer=%p", newTimer);
 
-    for(; *ptr != NULL; ptr = &((*ptr)->next)) {
-        if ((*ptr)->timeToWakeup > newTimer->timeToWakeup) {
-           break;
-        }
+    if (newTimer != NULL && newTimer->heapIndex == -1) {
+        link_timer(newTimer);
     }
-    newTimer->next = *ptr;
-    (*ptr) = newTimer;
 }
 
 /**
@@ -95,24 +309,30 @@ TimerHandle* new_timer(
         REPORT_INFO3(LC_PUSH, "[new_timer] timeToWakeup=%#lx userData=%p userCallback=%p",
             (long)timeToWakeup, userData, (void *)userCallback);
 
-        newTimer->next = NULL;
- 		newTimer->timeToWakeup = timeToWakeup;
-		newTimer->userData = userData;
+        newTimer->timeToWakeup = timeToWakeup;
+        newTimer->userData = userData;
         newTimer->userCallback = userCallback;
-        add_timer(newTimer);
+        newTimer->heapIndex = -1;
+        newTimer->nextByData = NULL;
+        if (link_timer(newTimer) != 0) {
+            midpFree(newTimer);
+            newTimer = NULL;
+        }
     }
     return newTimer;
 }
 
-/** Search for handle instance in the sockets list and return its reference */
-static TimerHandle** get_timer_ptr(TimerHandle* timer) {
-    TimerHandle** ptr;
-    if (timer != NULL) {
-        for (ptr = &rootTimer; *ptr != NULL; ptr = &((*ptr)->next)) {
-            if (*ptr == timer) return ptr;
-        }
-    }
-    return NULL;
+/**
+ * Check that a timer handle is queued
+ *
+ * @param timer timer handle to check
+ *
+ * @return KNI_TRUE if the timer is in the heap, KNI_FALSE otherwise
+ */
+static jboolean is_queued(const TimerHandle* timer) {
+    return (timer != NULL && timer->heapIndex >= 0 &&
+            timer->heapIndex < heapSize &&
+            timerHeap[timer->heapIndex] == timer) ? KNI_TRUE : KNI_FALSE;
 }
 
 /**
@@ -121,11 +341,10 @@ static TimerHandle** get_timer_ptr(TimerHandle* timer) {
  * @param timer instance of timer that should be remove
  */
 void delete_timer(TimerHandle* timer) {
-    TimerHandle **ptr = get_timer_ptr(timer);
     REPORT_INFO1(LC_PUSH, "[delete_timer] timer=%p", timer);
 
-    if (ptr != NULL) {
-        *ptr = timer->next;
+    if (is_queued(timer)) {
+        unlink_timer(timer);
         midpFree(timer);
     }
 }
@@ -139,11 +358,10 @@ void delete_timer(TimerHandle* timer) {
  * @return poitner to timer instance that should be remove from queue
  */
 TimerHandle* remove_timer(TimerHandle* timer) {
-    TimerHandle **ptr = get_timer_ptr(timer);
     REPORT_INFO1(LC_PUSH, "[remove_timer] timer=%p", timer);
 
-    if (ptr != NULL) {
-        *ptr = timer->next;
+    if (is_queued(timer)) {
+        unlink_timer(timer);
     }
 
     return timer;
@@ -151,20 +369,26 @@ TimerHandle* remove_timer(TimerHandle* timer) {
 
 /**
  * Remove a specific entry indicated by user data.
- * Only first element matching the userData is removed.
+ * Only the earliest timer matching the userData is removed.
  *
  * @param userdata user specified data used to identify the entry to remove
  */
 void delete_timer_by_userdata(void* userdata) {
     TimerHandle* timer;
+    TimerHandle* found = NULL;
     REPORT_INFO1(LC_PUSH, "[delete_timer_by_userdata] userdata=%p", userdata);
 
-    for(timer = rootTimer; timer != NULL; timer = timer->next) {
-        if (timer->userData == userdata) {
-            delete_timer(timer);
-            return;
+    for (timer = timersByData[USERDATA_BUCKET(userdata)]; timer != NULL;
+            timer = timer->nextByData) {
+        if (timer->userData == userdata &&
+                (found == NULL || timer->timeToWakeup < found->timeToWakeup)) {
+            found = timer;
         }
     }
+
+    if (found != NULL) {
+        delete_timer(found);
+    }
 }
 
 /**
@@ -175,10 +399,9 @@ void delete_timer_by_userdata(void* userdata) {
  */
 TimerHandle* get_timer() {
     TimerHandle* timer;
-    if (rootTimer != NULL) {
-        timer = rootTimer;
-        rootTimer = rootTimer->next;
-        timer->next = NULL;
+    if (heapSize > 0) {
+        timer = timerHeap[0];
+        unlink_timer(timer);
         return timer;
     }
     return NULL;
@@ -191,7 +414,7 @@ TimerHandle* get_timer() {
  * NULL if there is not timer
  */
 TimerHandle* peek_timer() {
-    return rootTimer;
+    return (heapSize > 0) ? timerHeap[0] : NULL;
 }
 
 
@@ -224,7 +447,8 @@ jlong get_timer_wakeup(const TimerHandle *timer) {
 }
 
 /**
- * Set absoulte wakeup time for the timer
+ * Set absoulte wakeup time for the timer.
+ * A queued timer is moved to its new place in the queue.
  *
  * @param timer instance of the timer to set wakeup time to
  * @param timeToWakeup absolute time when the timer should wakeup
@@ -232,6 +456,10 @@ jlong get_timer_wakeup(const TimerHandle *timer) {
 void set_timer_wakeup(TimerHandle *timer, jlong timeToWakeup) {
     if (timer != NULL) {
         timer->timeToWakeup = timeToWakeup;
+        if (is_queued(timer)) {
+            sift(timer->heapIndex);
+            update_timer_fd();
+        }
     }
 }
 
@@ -246,3 +474,54 @@ void wakeup_timer(TimerHandle *timer) {
         timer->userCallback(timer);    
     }
 }
+
+/**
+ * Get the descriptor that becomes readable when the earliest timer
+ * in the queue expires
+ *
+ * @return timer descriptor, or -1 if the platform does not support it
+ */
+int get_timer_queue_fd() {
+#if ENABLE_TIMER_QUEUE_FD
+    return timerFd;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * Check if the timer descriptor is armed for the earliest timer in the
+ * queue
+ *
+ * @return KNI_TRUE if the descriptor is armed, KNI_FALSE otherwise
+ */
+jboolean is_timer_queue_fd_armed() {
+#if ENABLE_TIMER_QUEUE_FD
+    jlong wakeup = (heapSize > 0) ? timerHeap[0]->timeToWakeup : -1;
+
+    if (timerFd != -1 && wakeup == armedWakeup) {
+        return KNI_TRUE;
+    }
+#endif
+    return KNI_FALSE;
+}
+
+/**
+ * Acknowledge expiration of the timer descriptor, so that it stops
+ * being readable until the next expiration
+ */
+void clear_timer_queue_fd() {
+#if ENABLE_TIMER_QUEUE_FD
+    unsigned long long expirations;
+
+    if (timerFd != -1) {
+        /* Non-blocking, fails harmlessly if the timer has not expired */
+        if (read(timerFd, &expirations, sizeof (expirations)) < 0) {
+            return;
+        }
+        /* The descriptor is disarmed now, rearm it on the next update */
+        armedWakeup = -1;
+        update_timer_fd();
+    }
+#endif
+}
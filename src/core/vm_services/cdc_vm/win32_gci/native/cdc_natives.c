@@ -252,6 +252,7 @@ DUMMY(NotifySocketStatusChanged)
 DUMMY(CNIcom_sun_midp_io_j2me_socket_Protocol_open0)
 DUMMY(CNIcom_sun_midp_io_j2me_socket_Protocol_read0)
 DUMMY(CNIcom_sun_midp_io_j2me_socket_Protocol_write0)
+DUMMY(CNIcom_sun_midp_io_j2me_socket_Protocol_writev0)
 DUMMY(CNIcom_sun_midp_io_j2me_socket_Protocol_available0)
 DUMMY(CNIcom_sun_midp_io_j2me_socket_Protocol_close0)
 DUMMY(CNIcom_sun_midp_io_j2me_socket_Protocol_finalize)
@@ -264,7 +265,7 @@ DUMMY(CNIcom_sun_midp_io_j2me_socket_Protocol_shutdownOutput0)
 DUMMY(CNIcom_sun_midp_io_NetworkConnectionBase_initializeInternal)
 
 DUMMY(CNIcom_sun_midp_events_EventQueue_handleFatalError)
-DUMMY(CNIcom_sun_midp_events_NativeEventMonitor_readNativeEvent)
+DUMMY(CNIcom_sun_midp_events_NativeEventMonitor_readNativeEvents)
 
 
 DUMMY(CNIcom_sun_midp_events_EventQueue_finalize)
@@ -281,10 +282,24 @@ DUMMY(CNIcom_sun_midp_io_j2me_push_PushRegistryImpl_delAllForSuite0)
 
 DUMMY(CNIcom_sun_midp_crypto_MD5_nativeUpdate)
 DUMMY(CNIcom_sun_midp_crypto_MD5_nativeFinal)
+DUMMY(CNIcom_sun_midp_crypto_MD5_nativeReset)
+DUMMY(CNIcom_sun_midp_crypto_MD5_nativeCopy)
+DUMMY(CNIcom_sun_midp_crypto_MD5_finalize)
 DUMMY(CNIcom_sun_midp_crypto_MD2_nativeUpdate)
 DUMMY(CNIcom_sun_midp_crypto_MD2_nativeFinal)
+DUMMY(CNIcom_sun_midp_crypto_MD2_nativeReset)
+DUMMY(CNIcom_sun_midp_crypto_MD2_nativeCopy)
+DUMMY(CNIcom_sun_midp_crypto_MD2_finalize)
 DUMMY(CNIcom_sun_midp_crypto_SHA_nativeUpdate)
 DUMMY(CNIcom_sun_midp_crypto_SHA_nativeFinal)
+DUMMY(CNIcom_sun_midp_crypto_SHA_nativeReset)
+DUMMY(CNIcom_sun_midp_crypto_SHA_nativeCopy)
+DUMMY(CNIcom_sun_midp_crypto_SHA_finalize)
+DUMMY(CNIcom_sun_midp_crypto_SHA256_nativeUpdate)
+DUMMY(CNIcom_sun_midp_crypto_SHA256_nativeFinal)
+DUMMY(CNIcom_sun_midp_crypto_SHA256_nativeReset)
+DUMMY(CNIcom_sun_midp_crypto_SHA256_nativeCopy)
+DUMMY(CNIcom_sun_midp_crypto_SHA256_finalize)
 DUMMY(CNIcom_sun_midp_main_MIDletSuiteVerifier_getJarHash)
 DUMMY(CNIcom_sun_midp_main_MIDletSuiteVerifier_checkJarHash)
 DUMMY(CNIcom_sun_midp_main_MIDletSuiteVerifier_useClassVerifier)
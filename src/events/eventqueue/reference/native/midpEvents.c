@@ -60,6 +60,12 @@ typedef struct Java_com_sun_midp_events_EventQueue _eventQueue;
         KNI_SetObjectField(OBJ, ID, STRING); \
     }
 
+#define SET_STRING_EVENT_ELEMENT(VALUE, STRING, ARRAY, INDEX) \
+    if (pcsl_string_utf16_length(&VALUE) >= 0) { \
+        midp_jstring_from_pcsl_string(&VALUE, STRING); \
+        KNI_SetObjectArrayElement(ARRAY, INDEX, STRING); \
+    }
+
 #define GET_STRING_EVENT_FIELD(OBJ, ID, STRING, RESULT) \
     KNI_GetObjectField(OBJ, ID, STRING); \
     { \
@@ -119,6 +125,18 @@ static int gsMaxIsolates = 1;
 static int gsEventSpyingQueueId = 0;
 #endif
 
+/**
+ * Maximum number of events returned by one call of
+ * <tt>NativeEventMonitor.readNativeEvents</tt>.
+ */
+#define MAX_EVENTS_PER_READ 16
+
+/** Number of int buffer entries used by one event in a batched read. */
+#define EVENT_INT_SLOTS 6
+
+/** Number of string buffer entries used by one event in a batched read. */
+#define EVENT_STRING_SLOTS 6
+
 /**
  * Macro that gets the event queue associated with an queueId.
  *
@@ -750,19 +768,92 @@ Java_com_sun_midp_events_NativeEventMonitor_waitForNativeEvent(void) {
 }
 
 /**
- * Reads a native event without blocking.
+ * Reads up to a given number of native events without blocking.
+ * <p>
+ * Each event takes <tt>EVENT_INT_SLOTS</tt> consecutive entries of
+ * the int buffer: the type followed by the five int parameters, and
+ * <tt>EVENT_STRING_SLOTS</tt> consecutive entries of the string buffer.
+ * String slots of null parameters are left untouched, so the caller must
+ * clear the string buffer after consuming it. All the int parameters are
+ * copied to Java with a single raw array region call.
  *
- * @param event An empty event to be filled in if there is a queued
- *              event.
- * @return <tt>true</tt> if an event was read, otherwise <tt>false</tt>
+ * @param intBuffer buffer for the type and int parameters of the events
+ * @param stringBuffer buffer for the string parameters of the events
+ * @param maxEvents maximum number of events to read
+ * @param queueId queue ID
+ *
+ * @return number of events read, 0 if no event was pending
  */
-KNIEXPORT KNI_RETURNTYPE_BOOLEAN
-Java_com_sun_midp_events_NativeEventMonitor_readNativeEvent(void) {
+KNIEXPORT KNI_RETURNTYPE_INT
+Java_com_sun_midp_events_NativeEventMonitor_readNativeEvents(void) {
+    jint ints[MAX_EVENTS_PER_READ * EVENT_INT_SLOTS];
+    jint maxEvents;
     jint queueId;
+    jint numRead = 0;
+    MidpEvent event;
 
-    queueId = KNI_GetParameterAsInt(2);
+    maxEvents = KNI_GetParameterAsInt(3);
+    queueId = KNI_GetParameterAsInt(4);
+
+    KNI_StartHandles(3);
+    KNI_DeclareHandle(intBuffer);
+    KNI_DeclareHandle(stringBuffer);
+    KNI_DeclareHandle(stringObj);
+
+    KNI_GetParameterAsObject(1, intBuffer);
+    KNI_GetParameterAsObject(2, stringBuffer);
+
+    if (maxEvents > MAX_EVENTS_PER_READ) {
+        maxEvents = MAX_EVENTS_PER_READ;
+    }
+
+    if (maxEvents > KNI_GetArrayLength(intBuffer) / EVENT_INT_SLOTS) {
+        maxEvents = KNI_GetArrayLength(intBuffer) / EVENT_INT_SLOTS;
+    }
+
+    if (maxEvents > KNI_GetArrayLength(stringBuffer) / EVENT_STRING_SLOTS) {
+        maxEvents = KNI_GetArrayLength(stringBuffer) / EVENT_STRING_SLOTS;
+    }
+
+    while (numRead < maxEvents &&
+           getPendingMIDPEvent(&event, queueId) != -1) {
+        jint* pInts = &ints[numRead * EVENT_INT_SLOTS];
+        jint stringIndex = numRead * EVENT_STRING_SLOTS;
+
+        pInts[0] = event.type;
+        pInts[1] = event.intParam1;
+        pInts[2] = event.intParam2;
+        pInts[3] = event.intParam3;
+        pInts[4] = event.intParam4;
+        pInts[5] = event.intParam5;
+
+        SET_STRING_EVENT_ELEMENT(event.stringParam1, stringObj, stringBuffer,
+                                 stringIndex);
+        SET_STRING_EVENT_ELEMENT(event.stringParam2, stringObj, stringBuffer,
+                                 stringIndex + 1);
+        SET_STRING_EVENT_ELEMENT(event.stringParam3, stringObj, stringBuffer,
+                                 stringIndex + 2);
+        SET_STRING_EVENT_ELEMENT(event.stringParam4, stringObj, stringBuffer,
+                                 stringIndex + 3);
+        SET_STRING_EVENT_ELEMENT(event.stringParam5, stringObj, stringBuffer,
+                                 stringIndex + 4);
+        SET_STRING_EVENT_ELEMENT(event.stringParam6, stringObj, stringBuffer,
+                                 stringIndex + 5);
+
+        freeMIDPEventFields(event);
+
+        numRead++;
+    }
+
+    if (numRead > 0) {
+        KNI_SetRawArrayRegion(intBuffer, 0,
+                              numRead * EVENT_INT_SLOTS * sizeof (jint),
+                              (jbyte*)ints);
+    }
+
+    KNI_EndHandles();
 
-    KNI_ReturnBoolean(readNativeEventCommon(queueId) != -1);
+    KNI_ReturnInt(numRead);
 }
 
 /**
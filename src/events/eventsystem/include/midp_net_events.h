@@ -58,6 +58,41 @@ jboolean midp_check_net_status_signal(int* pStatus);
  */
 void midp_network_status_event(int isInit, int status);
 
+#if ENABLE_SOCKET_HANDLE_REGISTRATION
+
+/**
+ * Adds a PCSL socket, server socket or datagram handle to the handles
+ * watched for network signals, or registers it again. The protocol
+ * natives call it as soon as a handle has been opened or accepted.
+ * <p>
+ * The platform only reports changes of the handle state, so a handle
+ * must also be registered again before waiting on it without having
+ * tried the operation first, as push does when it adds a network
+ * notifier. The current state of the handle is then reported anew.
+ *
+ * @param handle the PCSL handle
+ */
+void midp_register_socket_handle(void* handle);
+
+/**
+ * Removes a PCSL handle from the handles watched for network signals.
+ * The protocol natives call it just before the handle is closed.
+ *
+ * @param handle the PCSL handle
+ */
+void midp_unregister_socket_handle(void* handle);
+
+#else
+
+/*
+ * The platform finds the handles waiting for network signals by
+ * itself, nothing has to be registered.
+ */
+#define midp_register_socket_handle(handle)
+#define midp_unregister_socket_handle(handle)
+
+#endif /* ENABLE_SOCKET_HANDLE_REGISTRATION */
+
 #ifdef __cplusplus
 }
 #endif
@@ -52,6 +52,12 @@ extern void check_extrnal_api_events(JVMSPI_BlockedThreadInfo *blocked_threads,
                                      int blocked_threads_count, jlong timeout);
 #endif /* ENABLE_API_EXTENSIONS */
 
+/**
+ * Maximum number of signals processed by one midp_check_events() call.
+ * Bounds the time spent before the VM gets control back.
+ */
+#define MAX_SIGNALS_PER_CHECK 32
+
 static MidpReentryData newSignal;
 static MidpEvent newMidpEvent;
 static MidpEvent newCompMidpEvent;
@@ -94,37 +100,17 @@ eventUnblockJavaThread(
 }
 
 /**
- * This function is called by the VM periodically. It has to check if
- * any of the blocked threads are ready for execution, and call
- * SNI_UnblockThread() on those threads that are ready.
+ * Dispatches the signal stored in <tt>newSignal</tt> and
+ * <tt>newMidpEvent</tt> by the last checkForSystemSignal() call.
  *
  * @param blocked_threads Array of blocked threads
  * @param blocked_threads_count Number of threads in blocked_threads array
- * @param timeout Values for the paramater:
- *                >0 = Block until an event happens, or until <timeout> 
- *                     milliseconds has elapsed.
- *                 0 = Check the events sources but do not block. Return to the
- *                     caller immediately regardless of the status of the event
- *                     sources.
- *                -1 = Do not timeout. Block until an event happens.
+ * @param timeout timeout the signal was waited for, passed on to
+ *                the API extensions when no MIDP signal was received
  */
-void midp_check_events(JVMSPI_BlockedThreadInfo *blocked_threads,
-		       int blocked_threads_count,
-		       jlong timeout) {
-    if (midp_waitWhileSuspended()) {
-        /* System has been requested to resume. Returning control to VM
-         * to perform java-side resume routines. Timeout may be too long
-         * here or even -1, thus do not check other events this time.
-         */
-        return;
-    }
-
-    newSignal.waitingFor = 0;
-    newSignal.pResult = NULL;
-    MIDP_EVENT_INITIALIZE(newMidpEvent);
-
-    checkForSystemSignal(&newSignal, &newMidpEvent, timeout);
-
+static void
+processSignal(JVMSPI_BlockedThreadInfo *blocked_threads,
+              int blocked_threads_count, jlong timeout) {
     switch (newSignal.waitingFor) {
 #if ENABLE_JAVA_DEBUGGER
     case VM_DEBUG_SIGNAL:
@@ -204,7 +190,7 @@ void midp_check_events(JVMSPI_BlockedThreadInfo *blocked_threads,
         eventUnblockJavaThread(blocked_threads, blocked_threads_count,
             NETWORK_WRITE_SIGNAL, newSignal.descriptor,
             newSignal.status);
-        return; 
+        break;
 
     case PUSH_ALARM_SIGNAL:
         if (findPushTimerBlockedHandle(newSignal.descriptor) != 0) {
@@ -333,6 +319,112 @@ void midp_check_events(JVMSPI_BlockedThreadInfo *blocked_threads,
     } /* switch */
 }
 
+/**
+ * Checks if the signal in <tt>newSignal</tt> is a network signal that
+ * has already been processed by the current midp_check_events() call.
+ * Socket readiness is level-triggered, so a socket whose waiting thread
+ * has not run yet is reported again; signaling it twice must be avoided.
+ * An exception signal wakes both the reader and the writer, so it is
+ * treated as a repetition of any network signal of the same descriptor.
+ *
+ * @param handledSignals signal types processed so far
+ * @param handledDescriptors descriptors of the signals processed so far
+ * @param handledCount number of signals processed so far
+ *
+ * @return KNI_TRUE if the signal repeats a processed network signal,
+ *         KNI_FALSE otherwise
+ */
+static jboolean
+isRepeatedNetworkSignal(const midpSignalType* handledSignals,
+                        const int* handledDescriptors, int handledCount) {
+    int i;
+
+    switch (newSignal.waitingFor) {
+    case NETWORK_READ_SIGNAL:
+    case NETWORK_WRITE_SIGNAL:
+    case NETWORK_EXCEPTION_SIGNAL:
+        for (i = 0; i < handledCount; i++) {
+            if (handledDescriptors[i] == newSignal.descriptor &&
+                    (handledSignals[i] == newSignal.waitingFor ||
+                     handledSignals[i] == NETWORK_EXCEPTION_SIGNAL ||
+                     newSignal.waitingFor == NETWORK_EXCEPTION_SIGNAL)) {
+                return KNI_TRUE;
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return KNI_FALSE;
+}
+
+/**
+ * This function is called by the VM periodically. It has to check if
+ * any of the blocked threads are ready for execution, and call
+ * SNI_UnblockThread() on those threads that are ready.
+ * <p>
+ * After the first signal has been received, every signal that is already
+ * pending is processed too, up to <tt>MAX_SIGNALS_PER_CHECK</tt>, so that
+ * pending signals do not wait for a VM time slice each.
+ *
+ * @param blocked_threads Array of blocked threads
+ * @param blocked_threads_count Number of threads in blocked_threads array
+ * @param timeout Values for the paramater:
+ *                >0 = Block until an event happens, or until <timeout> 
+ *                     milliseconds has elapsed.
+ *                 0 = Check the events sources but do not block. Return to the
+ *                     caller immediately regardless of the status of the event
+ *                     sources.
+ *                -1 = Do not timeout. Block until an event happens.
+ */
+void midp_check_events(JVMSPI_BlockedThreadInfo *blocked_threads,
+		       int blocked_threads_count,
+		       jlong timeout) {
+    midpSignalType handledSignals[MAX_SIGNALS_PER_CHECK];
+    int handledDescriptors[MAX_SIGNALS_PER_CHECK];
+    int handledCount = 0;
+
+    if (midp_waitWhileSuspended()) {
+        /* System has been requested to resume. Returning control to VM
+         * to perform java-side resume routines. Timeout may be too long
+         * here or even -1, thus do not check other events this time.
+         */
+        return;
+    }
+
+    do {
+        newSignal.waitingFor = 0;
+        newSignal.pResult = NULL;
+        MIDP_EVENT_INITIALIZE(newMidpEvent);
+
+        checkForSystemSignal(&newSignal, &newMidpEvent, timeout);
+
+        if (handledCount > 0) {
+            if (newSignal.waitingFor == 0 ||
+                    isRepeatedNetworkSignal(handledSignals,
+                        handledDescriptors, handledCount)) {
+                /* Nothing else is pending */
+                break;
+            }
+        }
+
+        processSignal(blocked_threads, blocked_threads_count, timeout);
+
+        if (newSignal.waitingFor == 0) {
+            break;
+        }
+
+        handledSignals[handledCount] = newSignal.waitingFor;
+        handledDescriptors[handledCount] = newSignal.descriptor;
+        handledCount++;
+
+        /* Only collect signals that are already pending */
+        timeout = 0;
+    } while (handledCount < MAX_SIGNALS_PER_CHECK);
+}
+
 /**
  * Runs the VM in either master or slave mode depending on the
  * platform. It does not return until the VM is finished. In slave mode
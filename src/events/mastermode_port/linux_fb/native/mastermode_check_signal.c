@@ -31,22 +31,23 @@
  */
 
 #include <kni.h>
+#include <jvm.h>
 
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
 #include <unistd.h>
+#include <errno.h>
+#include <string.h>
 
 #include <midp_net_events.h>
 #include <midp_logging.h>
+#include <midpMalloc.h>
 #include <pcsl_network_generic.h>
 #include <pcsl_network.h>
 #include <fbapp_export.h>
 #include <timer_queue.h>
 
-#ifdef ENABLE_JSR_82_SOCK
-#include <bt_generic.h>
-#endif
-
 #include "mastermode_check_signal.h"
 #include "mastermode_handle_signal.h"
 
@@ -68,104 +69,444 @@ fCheckForSignal checkForSignal[] = {
 int checkForSignalNum =
     sizeof(checkForSignal) / sizeof(fCheckForSignal);
 
+/** Maximum number of ready descriptors fetched by one epoll_wait() call */
+#define MAX_READY_EVENTS 64
+
+/** Initial size of the descriptor table, grown on demand */
+#define INITIAL_DESCRIPTORS 64
+
 /**
- * Check and handle socket & pointer & keyboard system signals.
- * The function groups signals that can be checked with a single system call.
+ * Events socket descriptors are registered for. Sockets are watched for
+ * state changes only: a socket that is ready but has no thread waiting
+ * for it does not wake the system up again and again.
+ */
+#define SOCKET_EVENTS (EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET)
+
+/** Input descriptor slot of the keyboard */
+#define KEYBOARD_INPUT 0
+
+/** Input descriptor slot of the mouse */
+#define MOUSE_INPUT 1
+
+/** Input descriptor slot of the timer queue */
+#define TIMER_INPUT 2
+
+/** Number of input descriptor slots */
+#define NUM_INPUTS 3
+
+/**
+ * State of a descriptor in the persistent epoll set. The table is indexed
+ * by descriptor value.
+ */
+typedef struct _DescriptorEntry {
+    /** Socket the descriptor belongs to, NULL for input devices */
+    const SocketHandle* socket;
+    /** Events the descriptor is registered for in the epoll set */
+    unsigned int events;
+    /** KNI_TRUE if the descriptor is in the epoll set */
+    jboolean registered;
+} DescriptorEntry;
+
+/** Descriptor of the persistent epoll set, -1 if not created yet */
+static int epollFd = -1;
+
+/** Descriptor table, see DescriptorEntry */
+static DescriptorEntry* descriptors = NULL;
+
+/** Number of entries allocated in the descriptor table */
+static int descriptorsSize = 0;
+
+/** Number of descriptors currently in the epoll set */
+static int numRegistered = 0;
+
+/** Registered input descriptors, -1 for an input that has none */
+static int inputDescriptors[NUM_INPUTS] = { -1, -1, -1 };
+
+/** Ready events returned by the last epoll_wait() and not handled yet */
+static struct epoll_event readyEvents[MAX_READY_EVENTS];
+
+/** Number of valid entries in readyEvents */
+static int numReadyEvents = 0;
+
+/** Index of the next entry of readyEvents to handle */
+static int nextReadyEvent = 0;
+
+/**
+ * Creates the persistent epoll set unless it has been created already.
  *
- * @param pNewSignal        OUT reentry data to unblock threads waiting for a signal
- * @param pNewMidpEvent     OUT a native MIDP event to be stored to Java event queue
- * @param timeout64         IN  >0 the time system can be blocked waiting for a signal
- *                              =0 don't block the system, check for signals instantly
- *                              <0 block the system until a signal received
+ * @return KNI_TRUE if the epoll set is usable, KNI_FALSE otherwise
+ */
+static jboolean createEpollSet(void) {
+    if (epollFd == -1) {
+        epollFd = epoll_create(MAX_READY_EVENTS);
+        if (epollFd == -1) {
+            REPORT_CRIT1(LC_CORE,
+                "[createEpollSet] epoll_create failed, errno=%d", errno);
+            return KNI_FALSE;
+        }
+    }
+
+    return KNI_TRUE;
+}
+
+/**
+ * Gets the table entry of a descriptor, growing the table if needed.
  *
- * @return KNI_TRUE if signal received, KNI_FALSE otherwise
+ * @param fd descriptor value
+ *
+ * @return the entry, or NULL if out of memory
  */
-static jboolean checkForSocketPointerAndKeyboardSignal(MidpReentryData* pNewSignal,
-    MidpEvent* pNewMidpEvent, jlong timeout64) {
+static DescriptorEntry* getDescriptorEntry(int fd) {
+    if (fd >= descriptorsSize) {
+        int newSize = descriptorsSize > 0 ? descriptorsSize : INITIAL_DESCRIPTORS;
+        DescriptorEntry* newTable;
 
-    fd_set read_fds;
-    fd_set write_fds;
-    fd_set except_fds;
-    int num_fds = 0, num_ready = 0;
-    jlong sec, usec;
-    struct timeval timeout;
+        while (newSize <= fd) {
+            newSize *= 2;
+        }
 
-    int mouse_fd = fbapp_get_mouse_fd();
-    int keyboard_fd = fbapp_get_keyboard_fd();
+        newTable = (DescriptorEntry*)midpRealloc(descriptors,
+            newSize * sizeof (DescriptorEntry));
+        if (newTable == NULL) {
+            REPORT_CRIT1(LC_CORE,
+                "[getDescriptorEntry] cannot grow descriptor table to %d",
+                newSize);
+            return NULL;
+        }
 
-    const SocketHandle* socketsList   = GetRegisteredSocketHandles();
-#ifdef ENABLE_JSR_82_SOCK
-    const SocketHandle* btSocketsList = GetRegisteredBtSocketHandles();
-#endif /* ENABLE_JSR_82_SOCK */
+        memset(newTable + descriptorsSize, 0,
+               (newSize - descriptorsSize) * sizeof (DescriptorEntry));
+        descriptors = newTable;
+        descriptorsSize = newSize;
+    }
 
-    FD_ZERO(&read_fds);
-    FD_ZERO(&write_fds);
-    FD_ZERO(&except_fds);
+    return &descriptors[fd];
+}
 
-    (void)pNewMidpEvent;
+/**
+ * Registers a descriptor in the epoll set or updates its registration.
+ * Unless forced, an unchanged registration costs no system call; a
+ * forced one also makes the kernel report the current state of the
+ * descriptor again.
+ *
+ * @param fd descriptor to register
+ * @param socket socket owning the descriptor, NULL for input devices
+ * @param events epoll events to wait for
+ * @param force KNI_TRUE to update the registration even if unchanged
+ *
+ * @return KNI_TRUE if the descriptor is registered, KNI_FALSE otherwise
+ */
+static jboolean registerDescriptor(int fd, const SocketHandle* socket,
+                                   unsigned int events, jboolean force) {
+    DescriptorEntry* entry = getDescriptorEntry(fd);
+    struct epoll_event ev;
 
-    if (keyboard_fd != -1) {
-        /* Set keyboard descriptor for select */
-        FD_SET(keyboard_fd, &read_fds);
-        if (num_fds <= keyboard_fd) {
-            num_fds = keyboard_fd + 1;
-        }
+    if (entry == NULL) {
+        return KNI_FALSE;
     }
-    if (mouse_fd != -1) {
-        /* Set pointer descriptor for select */
-        FD_SET(mouse_fd, &read_fds);
-        if (num_fds <= mouse_fd) {
-            num_fds = mouse_fd + 1;
+
+    if (entry->registered && entry->socket == socket &&
+            entry->events == events && !force) {
+        return KNI_TRUE;
+    }
+
+    memset(&ev, 0, sizeof (ev));
+    ev.events = events;
+    ev.data.fd = fd;
+
+    if (entry->registered) {
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) != 0 &&
+                errno == ENOENT) {
+            /*
+             * The descriptor was closed without being unregistered and
+             * has been reused, closing removed it from the epoll set.
+             */
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
         }
+    } else {
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            if (errno != EEXIST ||
+                    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) != 0) {
+                REPORT_ERROR2(LC_CORE,
+                    "[registerDescriptor] cannot add fd=%d, errno=%d",
+                    fd, errno);
+                return KNI_FALSE;
+            }
+        }
+        entry->registered = KNI_TRUE;
+        numRegistered++;
+    }
+
+    entry->socket = socket;
+    entry->events = events;
+
+    return KNI_TRUE;
+}
+
+/**
+ * Removes a descriptor from the epoll set.
+ *
+ * @param fd descriptor to unregister
+ */
+static void unregisterDescriptor(int fd) {
+    DescriptorEntry* entry = &descriptors[fd];
+    struct epoll_event ev;
+
+    /* Fails harmlessly if the descriptor has already been closed */
+    memset(&ev, 0, sizeof (ev));
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &ev);
+
+    entry->registered = KNI_FALSE;
+    entry->socket = NULL;
+    entry->events = 0;
+    numRegistered--;
+}
+
+/**
+ * Adds a PCSL socket handle to the epoll set, or registers it again so
+ * that its current state is reported anew. Called by the protocol
+ * natives when a handle has been opened or accepted, and by push
+ * before it waits on a handle.
+ *
+ * @param handle the PCSL handle, a SocketHandle
+ */
+void midp_register_socket_handle(void* handle) {
+    const SocketHandle* socket = (const SocketHandle*)handle;
+
+    if (handle == INVALID_HANDLE || socket == NULL || !createEpollSet()) {
+        return;
+    }
+
+    registerDescriptor(socket->fd, socket, SOCKET_EVENTS, KNI_TRUE);
+}
+
+/**
+ * Removes a PCSL socket handle from the epoll set. Called by the
+ * protocol natives before the handle is closed.
+ *
+ * @param handle the PCSL handle, a SocketHandle
+ */
+void midp_unregister_socket_handle(void* handle) {
+    const SocketHandle* socket = (const SocketHandle*)handle;
+    int fd;
+
+    if (handle == INVALID_HANDLE || socket == NULL) {
+        return;
+    }
+
+    fd = socket->fd;
+    if (fd >= 0 && fd < descriptorsSize && descriptors[fd].registered &&
+            descriptors[fd].socket == socket) {
+        unregisterDescriptor(fd);
+    }
+}
+
+/**
+ * Keeps the registered descriptor of an input in line with the
+ * descriptor the input currently has.
+ *
+ * @param input input descriptor slot
+ * @param fd current descriptor of the input, -1 if it has none
+ */
+static void syncInputDescriptor(int input, int fd) {
+    int oldFd = inputDescriptors[input];
+
+    if (fd == oldFd) {
+        return;
+    }
+
+    if (oldFd != -1 && descriptors[oldFd].registered &&
+            descriptors[oldFd].socket == NULL) {
+        unregisterDescriptor(oldFd);
+    }
+
+    inputDescriptors[input] = -1;
+    if (fd != -1 && registerDescriptor(fd, NULL, EPOLLIN, KNI_FALSE)) {
+        inputDescriptors[input] = fd;
+    }
+}
+
+/**
+ * Brings the input devices and the timer queue descriptor in the epoll
+ * set in line with the descriptors they currently have. Sockets are
+ * added and removed by the protocol natives when they are opened and
+ * closed, see midp_register_socket_handle().
+ *
+ * @return KNI_TRUE if the epoll set is usable, KNI_FALSE otherwise
+ */
+static jboolean syncInputSet(void) {
+    if (!createEpollSet()) {
+        return KNI_FALSE;
     }
 
-    /* Set the sockets to be checked during select */
-    setSockets(socketsList, &read_fds, &write_fds, &except_fds, &num_fds);
-#ifdef ENABLE_JSR_82_SOCK
-    setSockets(btSocketsList, &read_fds, &write_fds, &except_fds, &num_fds);
-#endif /* ENABLE_JSR_82_SOCK */
-
-    /* Listen to collected descriptors during specified time interval */
-    if (num_fds > 0) {
-
-        if (timeout64 < 0) {
-            num_ready = select(
-                num_fds, &read_fds, &write_fds, &except_fds, NULL);
-        } else {
-            sec  = timeout64 / 1000;
-            usec = (timeout64 % 1000) * 1000;
-            timeout.tv_sec  = sec  & 0x7fffffff;
-            timeout.tv_usec = usec & 0x7fffffff;
-            num_ready = select(
-                num_fds, &read_fds, &write_fds, &except_fds, &timeout);
+    syncInputDescriptor(KEYBOARD_INPUT, fbapp_get_keyboard_fd());
+    syncInputDescriptor(MOUSE_INPUT, fbapp_get_mouse_fd());
+    syncInputDescriptor(TIMER_INPUT, get_timer_queue_fd());
+
+    return KNI_TRUE;
+}
+
+/**
+ * Gets the events of a ready socket that are left to handle once a
+ * signal has been raised for some of them. Sockets are only reported
+ * when their state changes, so a writer must not miss the event that
+ * woke up a reader of the same socket.
+ *
+ * @param events events reported for the socket
+ * @param waitingFor the signal raised for the socket
+ *
+ * @return the events left to handle
+ */
+static unsigned int getRemainingSocketEvents(unsigned int events,
+                                             midpSignalType waitingFor) {
+    switch (waitingFor) {
+    case NETWORK_EXCEPTION_SIGNAL:
+        return events & ~EPOLLPRI;
+    case NETWORK_READ_SIGNAL:
+        events &= ~EPOLLIN;
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            /* the error ends waiting for write too */
+            events = (events & ~(EPOLLERR | EPOLLHUP)) | EPOLLOUT;
         }
+        return events;
+    default:
+        return 0;
     }
+}
+
+/**
+ * Handles the next ready descriptor left from the last epoll_wait() call.
+ * Stale entries, whose descriptors have been unregistered or whose sockets
+ * no longer wait for the reported events, are skipped.
+ *
+ * @param pNewSignal        OUT reentry data to unblock threads waiting for a signal
+ * @param pNewMidpEvent     OUT a native MIDP event to be stored to Java event queue
+ *
+ * @return KNI_TRUE if a signal was handled, KNI_FALSE otherwise
+ */
+static jboolean handleReadyDescriptor(MidpReentryData* pNewSignal,
+                                      MidpEvent* pNewMidpEvent) {
+    while (nextReadyEvent < numReadyEvents) {
+        struct epoll_event* ev = &readyEvents[nextReadyEvent++];
+        int fd = ev->data.fd;
+        DescriptorEntry* entry;
+
+        if (fd < 0 || fd >= descriptorsSize) {
+            continue;
+        }
+
+        entry = &descriptors[fd];
+        if (!entry->registered) {
+            continue;
+        }
 
-    if (num_ready > 0) {
-        if (keyboard_fd != -1 && FD_ISSET(keyboard_fd, &read_fds)) {
+        if (entry->socket != NULL) {
+            if (handleSocket(entry->socket, ev->events, pNewSignal)) {
+                REPORT_INFO(LC_CORE, "[checkForSocketPointerAndKeyboardSignal] socket signal detected");
+                ev->events = getRemainingSocketEvents(ev->events,
+                                                      pNewSignal->waitingFor);
+                if (ev->events != 0) {
+                    /* hand out the rest with the next call */
+                    nextReadyEvent--;
+                }
+                return KNI_TRUE;
+            }
+        } else if (fd == inputDescriptors[KEYBOARD_INPUT]) {
             /* Handle keyboard event */
             REPORT_INFO(LC_CORE, "[checkForSocketPointerAndKeyboardSignal] keyboard signal detected");
             handleKey(pNewSignal, pNewMidpEvent);
-        } else if (mouse_fd != -1 && FD_ISSET(mouse_fd, &read_fds)) {
+            return KNI_TRUE;
+        } else if (fd == inputDescriptors[MOUSE_INPUT]) {
             /* Handle pointer event */
             REPORT_INFO(LC_CORE, "[checkForSocketPointerAndKeyboardSignal] pointer signal detected");
             handlePointer(pNewSignal, pNewMidpEvent);
-        } else {
-            REPORT_INFO(LC_CORE, "[checkForSocketPointerAndKeyboardSignal] socket signal detected");
-            handleSockets(socketsList,
-                          &read_fds, &write_fds, &except_fds, pNewSignal);
-#ifdef ENABLE_JSR_82_SOCK
-            handleSockets(btSocketsList,
-                          &read_fds, &write_fds, &except_fds, pNewSignal);
-#endif /* ENABLE_JSR_82_SOCK */
+            return KNI_TRUE;
+        } else if (fd == inputDescriptors[TIMER_INPUT]) {
+            /* Process expired timer alarms, timer handlers signal threads */
+            REPORT_INFO(LC_CORE, "[checkForSocketPointerAndKeyboardSignal] timer signal detected");
+            checkForPendingTimerSignal(JVM_JavaMilliSeconds());
+            clear_timer_queue_fd();
+            return KNI_TRUE;
         }
-        return KNI_TRUE;
-    } /* num_ready > 0 */
-    
-    /* No pending signals were detected */
+    }
+
     return KNI_FALSE;
 }
 
+/**
+ * Check and handle socket & pointer & keyboard system signals.
+ * The function groups signals that can be checked with a single system call.
+ * <p>
+ * Descriptors are kept in a persistent epoll set, so a wakeup costs
+ * time proportional to the number of ready descriptors rather than to
+ * the number of open sockets. Sockets enter the set when they are opened
+ * and leave it when they are closed. All the descriptors reported ready by one
+ * epoll_wait() call are handed out one per call before waiting again,
+ * so a busy descriptor cannot starve the others. Input devices and
+ * the timer queue descriptor are handled first within a batch.
+ *
+ * @param pNewSignal        OUT reentry data to unblock threads waiting for a signal
+ * @param pNewMidpEvent     OUT a native MIDP event to be stored to Java event queue
+ * @param timeout64         IN  >0 the time system can be blocked waiting for a signal
+ *                              =0 don't block the system, check for signals instantly
+ *                              <0 block the system until a signal received
+ *
+ * @return KNI_TRUE if signal received, KNI_FALSE otherwise
+ */
+static jboolean checkForSocketPointerAndKeyboardSignal(MidpReentryData* pNewSignal,
+    MidpEvent* pNewMidpEvent, jlong timeout64) {
+
+    int num_ready;
+    int timeout;
+    int front = 0;
+    int i;
+
+    if (!syncInputSet()) {
+        return KNI_FALSE;
+    }
+
+    /* Hand out descriptors that are left from the previous wakeup */
+    if (handleReadyDescriptor(pNewSignal, pNewMidpEvent)) {
+        return KNI_TRUE;
+    }
+
+    if (numRegistered == 0) {
+        return KNI_FALSE;
+    }
+
+    if (timeout64 < 0) {
+        timeout = -1;
+    } else if (timeout64 > 0x7fffffff) {
+        timeout = 0x7fffffff;
+    } else {
+        timeout = (int)timeout64;
+    }
+
+    /* Listen to registered descriptors during specified time interval */
+    num_ready = epoll_wait(epollFd, readyEvents, MAX_READY_EVENTS, timeout);
+    if (num_ready <= 0) {
+        numReadyEvents = 0;
+        nextReadyEvent = 0;
+        return KNI_FALSE;
+    }
+
+    /* Move input devices to the front so they keep their priority */
+    for (i = 0; i < num_ready; i++) {
+        int fd = readyEvents[i].data.fd;
+        if (fd >= 0 && fd < descriptorsSize && descriptors[fd].socket == NULL) {
+            struct epoll_event tmp = readyEvents[front];
+            readyEvents[front] = readyEvents[i];
+            readyEvents[i] = tmp;
+            front++;
+        }
+    }
+
+    numReadyEvents = num_ready;
+    nextReadyEvent = 0;
+
+    return handleReadyDescriptor(pNewSignal, pNewMidpEvent);
+}
+
 /**
  * Check and handle network status (up/down) system signal.
  *
@@ -69,6 +69,15 @@ typedef jboolean (*fCheckForSignal)(/*OUT*/ MidpReentryData* pNewSignal,
 jboolean checkForPendingSignals(/*OUT*/ MidpReentryData* pNewSignal,
     /*OUT*/ MidpEvent* pNewMidpEvent, jlong currentTime);
 
+/**
+ * Check and handle all timer alarms expired to the current time.
+ *
+ * @param currentTime       current system time to check timers expiration
+ *
+ * @return KNI_TRUE if expired timer detected, KNI_FALSE otherwise
+ */
+jboolean checkForPendingTimerSignal(jlong currentTime);
+
 /** Static list of registered system signal checkers */
 extern fCheckForSignal checkForSignal[];
 
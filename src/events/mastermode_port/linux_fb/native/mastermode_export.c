@@ -78,8 +78,11 @@ void checkForSystemSignal(MidpReentryData* pNewSignal,
             pNewSignal, pNewMidpEvent, currentTime);
 
     if (!pendingSignal) {
-        /* Adjust timeout regarding near timers */
-        adjustTimeout(currentTime, &timeout);
+        /* Adjust timeout regarding near timers, unless the timer queue
+         * descriptor is armed to wake the wait up by itself */
+        if (!is_timer_queue_fd_armed()) {
+            adjustTimeout(currentTime, &timeout);
+        }
         /* Call all registered signal checkers during timeout */
         checkForAllSignals(pNewSignal, pNewMidpEvent, timeout);
     }
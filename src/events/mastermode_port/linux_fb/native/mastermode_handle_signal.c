@@ -31,6 +31,7 @@
  */
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
 #include <unistd.h>
 
 #include <midpServices.h>
@@ -43,73 +44,40 @@
 #include <jvm.h>
 
 /**
- * Prepare read/write/exception descriptor sets with data from
- * socket list for suceeded select() query
+ * Handle socket signal reported by epoll and prepare reentry data
+ * to unblock a thread waiting for the signal. Error and hang-up
+ * conditions are reported as read or write signals, the same way
+ * select() reports them.
  *
- * @param socketsList list of sockets registered for read/write notifications
- * @param pRead_fds set of descriptors to check for read signals
- * @param pWrite_fds set of descriptors to check for write signals
- * @param pExcept_fds set of descriptors to check for exception signals
- * @param pNum_fds upper bound of checked descriptor values
- */
-void setSockets(const SocketHandle* socketsList,
-        /*OUT*/ fd_set* pRead_fds, /*OUT*/ fd_set* pWrite_fds,
-        /*OUT*/ fd_set* pExcept_fds, /*OUT*/ int* pNum_fds) {
-
-    if (socketsList != NULL) {
-        const SocketHandle *socket = (const SocketHandle *)socketsList;
-        for(; socket != NULL; socket = socket->next) {
-            if (socket->check_flags & CHECK_READ) {
-                FD_SET(socket->fd, pRead_fds);
-            }
-            if (socket->check_flags & CHECK_WRITE) {
-                FD_SET(socket->fd, pWrite_fds);
-            }
-            FD_SET(socket->fd, pExcept_fds);
-            if (*pNum_fds <= socket->fd) {
-               *pNum_fds = socket->fd + 1;
-            }
-        }
-    }
-}
-
-/**
- * Handle received socket signal and prepare reentry data
- * to unblock a thread waiting for the signal.
+ * @param socket socket the signal was received for
+ * @param events epoll events reported for the socket descriptor
+ * @param pNewSignal reentry data to unblock a thread waiting for a socket signal
  *
- * @param socketsList list of sockets registered for read/write notifications
- * @param pRead_fds set of descriptors to check for read signals
- * @param pWrite_fds set of descriptors to check for write signals
- * @param pExcept_fds set of descriptors to check for exception signals
- * @param pNewSignal reentry data to unblock a threads waiting for a socket signal
+ * @return KNI_TRUE if the events match a signal the socket waits for,
+ *         KNI_FALSE otherwise
  */
-void handleSockets(const SocketHandle* socketsList,
-        fd_set* pRead_fds, fd_set* pWrite_fds, fd_set* pExcept_fds,
+jboolean handleSocket(const SocketHandle* socket, unsigned int events,
         /*OUT*/ MidpReentryData* pNewSignal) {
 
-    if (socketsList != NULL) {
-        /* Handle socket events */
-        const SocketHandle *socket = (const SocketHandle *)socketsList;
-        for(; socket != NULL; socket = socket->next) {
-            if (FD_ISSET(socket->fd, pExcept_fds)) {
-                pNewSignal->descriptor = (int)socket;
-                pNewSignal->waitingFor = NETWORK_EXCEPTION_SIGNAL;
-                break;
-            }
-            if ((socket->check_flags & CHECK_READ) &&
-                    FD_ISSET(socket->fd, pRead_fds)) {
-                pNewSignal->descriptor = (int)socket;
-                pNewSignal->waitingFor = NETWORK_READ_SIGNAL;
-                break;
-            }
-            if ((socket->check_flags & CHECK_WRITE) &&
-                    FD_ISSET(socket->fd, pWrite_fds)) {
-                pNewSignal->descriptor = (int)socket;
-                pNewSignal->waitingFor = NETWORK_WRITE_SIGNAL;
-                break;
-            }
-        } /* for */
-    } /* socketList != NULL */
+    if (events & EPOLLPRI) {
+        pNewSignal->descriptor = (int)socket;
+        pNewSignal->waitingFor = NETWORK_EXCEPTION_SIGNAL;
+        return KNI_TRUE;
+    }
+    if ((socket->check_flags & CHECK_READ) &&
+            (events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+        pNewSignal->descriptor = (int)socket;
+        pNewSignal->waitingFor = NETWORK_READ_SIGNAL;
+        return KNI_TRUE;
+    }
+    if ((socket->check_flags & CHECK_WRITE) &&
+            (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+        pNewSignal->descriptor = (int)socket;
+        pNewSignal->waitingFor = NETWORK_WRITE_SIGNAL;
+        return KNI_TRUE;
+    }
+
+    return KNI_FALSE;
 }
 
 /**
@@ -41,31 +41,17 @@ extern "C" {
 #endif
 
 /**
- * Prepare read/write/exception descriptor sets with data from
- * socket list for suceeded select() query
- *
- * @param socketsList list of sockets registered for read/write notifications
- * @param pRead_fds set of descriptors to check for read signals
- * @param pWrite_fds set of descriptors to check for write signals
- * @param pExcept_fds set of descriptors to check for exception signals
- * @param pNum_fds upper bound of checked descriptor values
- */
-void setSockets(const SocketHandle* socketsList,
-        /*OUT*/ fd_set* pRead_fds, /*OUT*/ fd_set* pWrite_fds,
-        /*OUT*/ fd_set* pExcept_fds, /*OUT*/ int* pNum_fds);
-
-/**
- * Handle received socket signal and prepare reentry data
+ * Handle socket signal reported by epoll and prepare reentry data
  * to unblock a thread waiting for the signal.
  *
- * @param socketsList list of sockets registered for read/write notifications
- * @param pRead_fds set of descriptors to check for read signals
- * @param pWrite_fds set of descriptors to check for write signals
- * @param pExcept_fds set of descriptors to check for exception signals
- * @param pNewSignal reentry data to unblock a threads waiting for a socket signal
+ * @param socket socket the signal was received for
+ * @param events epoll events reported for the socket descriptor
+ * @param pNewSignal reentry data to unblock a thread waiting for a socket signal
+ *
+ * @return KNI_TRUE if the events match a signal the socket waits for,
+ *         KNI_FALSE otherwise
  */
-void handleSockets(const SocketHandle* socketsList,
-        fd_set* pRead_fds, fd_set* pWrite_fds, fd_set* pExcept_fds,
+jboolean handleSocket(const SocketHandle* socket, unsigned int events,
         /*OUT*/ MidpReentryData* pNewSignal);
 
 /**
@@ -34,9 +34,69 @@ public class Link {
 
     private Link emptyLinkCache; // = null
 
+    private SharedBuffer emptyBufferCache; // = null
+
     private int nativePointer; // set and get only by native code
 
     public static Link newLink(Isolate sender, Isolate receiver) {
+        return newLink(sender, receiver, 0);
+    }
+
+    /**
+     * Creates a new link between the given isolates. If queueSize is zero,
+     * the link is synchronous: send() blocks until the message has been
+     * received. Otherwise send() copies the message into a native queue of
+     * at most queueSize messages and returns, blocking only while the queue
+     * is full. Messages queued before the link is closed are still delivered
+     * to the receiver.
+     *
+     * (Note: the asynchronous mode is an extension of the JSR-121
+     * specification.)
+     *
+     * @param sender the isolate that will send messages
+     * @param receiver the isolate that will receive messages
+     * @param queueSize the maximum number of queued messages, or 0
+     * @return the new link
+     */
+    public static Link newLink(Isolate sender, Isolate receiver,
+                               int queueSize) {
+        if (queueSize < 0) {
+            throw new IllegalArgumentException();
+        }
+
+        return create(sender, receiver, queueSize, 0);
+    }
+
+    /**
+     * Creates a new stream link between the given isolates. A stream link
+     * carries bytes instead of messages, through a native ring buffer of at
+     * least bufferSize bytes shared by the two isolates: write() blocks only
+     * while the ring is full and read() only while it is empty. After the
+     * link is closed, read() returns the bytes still in the ring and then
+     * -1. The send() and receive() methods throw IllegalStateException on a
+     * stream link.
+     *
+     * (Note: stream links are an extension of the JSR-121 specification.)
+     *
+     * @param sender the isolate that will write bytes
+     * @param receiver the isolate that will read bytes
+     * @param bufferSize the minimum size of the ring buffer in bytes
+     * @return the new link
+     */
+    public static Link newStreamLink(Isolate sender, Isolate receiver,
+                                     int bufferSize) {
+        if (bufferSize <= 0) {
+            throw new IllegalArgumentException();
+        }
+
+        return create(sender, receiver, 0, bufferSize);
+    }
+
+    /**
+     * Creates a new link of any kind after checking the isolates.
+     */
+    private static Link create(Isolate sender, Isolate receiver,
+                               int queueSize, int bufferSize) {
         int rid = receiver.id();  // throws NullPointerException
         int sid = sender.id();    // throws NullPointerException
 
@@ -51,7 +111,7 @@ public class Link {
          */
 
         Link link = new Link();
-        link.init0(sender.id(), receiver.id());
+        link.init0(sender.id(), receiver.id(), queueSize, bufferSize);
         return link;
     }
 
@@ -83,6 +143,7 @@ public class Link {
                    InterruptedIOException,
                    IOException {
         Link emptyLink;
+        SharedBuffer emptyBuffer;
         LinkMessage msg = new LinkMessage();
 
         synchronized (this) {
@@ -92,15 +153,24 @@ public class Link {
                 emptyLink = emptyLinkCache;
                 emptyLinkCache = null;
             }
+
+            if (emptyBufferCache == null) {
+                emptyBuffer = new SharedBuffer();
+            } else {
+                emptyBuffer = emptyBufferCache;
+                emptyBufferCache = null;
+            }
         }
 
-        receive0(msg, emptyLink);
+        receive0(msg, emptyLink, emptyBuffer);
 
-        if (!msg.containsLink()) {
-            synchronized (this) {
-                if (emptyLinkCache == null) {
-                    emptyLinkCache = emptyLink;
-                }
+        synchronized (this) {
+            if (!msg.containsLink() && emptyLinkCache == null) {
+                emptyLinkCache = emptyLink;
+            }
+
+            if (!msg.containsSharedBuffer() && emptyBufferCache == null) {
+                emptyBufferCache = emptyBuffer;
             }
         }
 
@@ -126,6 +196,61 @@ public class Link {
         send0(lm);
     }
 
+    /**
+     * Reads up to len bytes from a stream link into b, blocking until at
+     * least one byte is available. Returns the number of bytes read, or -1
+     * if the link has been closed and all bytes have been read.
+     *
+     * Throws IllegalArgumentException if the calling thread is not in the
+     * receiving isolate for this link, and IllegalStateException if this is
+     * not a stream link.
+     */
+    public int read(byte[] b, int off, int len)
+            throws ClosedLinkException,
+                   InterruptedIOException,
+                   IOException {
+        if (off < 0 || len < 0 || off + len < 0 || off + len > b.length) {
+            throw new IndexOutOfBoundsException();
+        }
+
+        if (len == 0) {
+            return 0;
+        }
+
+        return read0(b, off, len);
+    }
+
+    /**
+     * Writes len bytes from b to a stream link, blocking while the ring
+     * buffer is full.
+     *
+     * Throws IllegalArgumentException if the calling thread is not in the
+     * sending isolate for this link, and IllegalStateException if this is
+     * not a stream link.
+     */
+    public void write(byte[] b, int off, int len)
+            throws ClosedLinkException,
+                   InterruptedIOException,
+                   IOException {
+        if (off < 0 || len < 0 || off + len < 0 || off + len > b.length) {
+            throw new IndexOutOfBoundsException();
+        }
+
+        while (len > 0) {
+            int n = write0(b, off, len);
+            off += n;
+            len -= n;
+        }
+    }
+
+    /**
+     * Returns the number of bytes that can be read from a stream link
+     * without blocking.
+     */
+    public int available() {
+        return available0();
+    }
+
     /**
      * Creates a new, empty link. This link must be filled in by native code 
      * before it can be used.
@@ -135,9 +260,11 @@ public class Link {
 
     private native void finalize();
 
-    private native void init0(int sender, int receiver);
+    private native void init0(int sender, int receiver, int queueSize,
+                              int bufferSize);
 
-    private native void receive0(LinkMessage msg, Link link)
+    private native void receive0(LinkMessage msg, Link link,
+                                 SharedBuffer buffer)
             throws ClosedLinkException,
                    InterruptedIOException,
                    IOException;
@@ -146,4 +273,16 @@ public class Link {
             throws ClosedLinkException,
                    InterruptedIOException,
                    IOException;
+
+    private native int read0(byte[] b, int off, int len)
+            throws ClosedLinkException,
+                   InterruptedIOException,
+                   IOException;
+
+    private native int write0(byte[] b, int off, int len)
+            throws ClosedLinkException,
+                   InterruptedIOException,
+                   IOException;
+
+    private native int available0();
 }
@@ -31,26 +31,33 @@ package com.sun.midp.links;
  */
 public class LinkMessage {
 
-    // IMPL_NOTE: force classloading of byte[] so that
-    // KNI_FindClass() will always find it.
-    static {
-        try {
-            Class.forName("[B");
-        } catch (ClassNotFoundException ignore) { }
-    }
+    /*
+     * Kinds of contents. Native code uses the kind to tell the contents
+     * apart, and checks only that they are of the class of their kind. The
+     * values must match those in midp_link.c.
+     */
+    static final int KIND_NONE = 0;
+    static final int KIND_DATA = 1;
+    static final int KIND_STRING = 2;
+    static final int KIND_LINK = 3;
+    static final int KIND_SHARED = 4;
 
     Object contents;
 
+    int kind; // = KIND_NONE
+
     // used only for data (byte-array) messages, otherwise zeroes
     int offset; // = 0
     int length; // = 0
 
     /**
-     * Constructs a LinkMessage with the given contents, length, and offset 
-     * values. Called only by the static factory methods.
+     * Constructs a LinkMessage with the given contents, kind, length, and 
+     * offset values. Called only by the static factory methods.
      */
-    private LinkMessage(Object newContents, int newOffset, int newLength) {
+    private LinkMessage(Object newContents, int newKind, int newOffset,
+                        int newLength) {
         contents = newContents;
+        kind = newKind;
         offset = newOffset;
         length = newLength;
     }
@@ -59,7 +66,7 @@ public class LinkMessage {
      * Constructs an empty LinkMessage. This is used only by Link.receive().
      */
     LinkMessage() {
-        this(null, 0, 0);
+        this(null, KIND_NONE, 0, 0);
     }
 
     /**
@@ -83,6 +90,13 @@ public class LinkMessage {
         return contents instanceof String;
     }
 
+    /**
+     * Queries whether the LinkMessage contains a SharedBuffer.
+     */
+    public boolean containsSharedBuffer() {
+        return contents instanceof SharedBuffer;
+    }
+
     /**
      * Returns the contents of the LinkMessage as an Object. The caller must 
      * test the reference returned using <code>instanceof</code> and cast it 
@@ -138,8 +152,21 @@ public class LinkMessage {
         }
     }
 
+    /**
+     * Returns the contents of the LinkMessage if it contains a SharedBuffer.
+     * If the message does not contain a SharedBuffer, throws
+     * IllegalStateException.
+     */
+    public SharedBuffer extractSharedBuffer() {
+        if (contents instanceof SharedBuffer) {
+            return (SharedBuffer)contents;
+        } else {
+            throw new IllegalStateException();
+        }
+    }
+
     public static LinkMessage newDataMessage(byte[] data) {
-        return new LinkMessage(data, 0, data.length);
+        return new LinkMessage(data, KIND_DATA, 0, data.length);
     }
 
     public static LinkMessage newDataMessage(
@@ -152,15 +179,24 @@ public class LinkMessage {
             throw new IndexOutOfBoundsException();
         }
 
-        return new LinkMessage(data, offset, length);
+        return new LinkMessage(data, KIND_DATA, offset, length);
     }
 
     public static LinkMessage newLinkMessage(Link link) {
-        return new LinkMessage(link, 0, 0);
+        return new LinkMessage(link, KIND_LINK, 0, 0);
     }
 
     public static LinkMessage newStringMessage(String string) {
-        return new LinkMessage(string, 0, 0);
+        return new LinkMessage(string, KIND_STRING, 0, 0);
+    }
+
+    /**
+     * Creates a message that passes the given buffer by reference. The
+     * receiver gets a SharedBuffer for the same native bytes, which are not
+     * copied however many links the buffer travels through.
+     */
+    public static LinkMessage newSharedBufferMessage(SharedBuffer buffer) {
+        return new LinkMessage(buffer, KIND_SHARED, 0, 0);
     }
 
 }
@@ -0,0 +1,127 @@
+/*
+ *
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+package com.sun.midp.links;
+
+/**
+ * An immutable block of bytes kept in native memory. A SharedBuffer sent in
+ * a LinkMessage is passed by reference: the receiving isolate gets its own
+ * SharedBuffer object for the same bytes, so large payloads are copied once
+ * when the buffer is created rather than once per link they travel through.
+ * The bytes are freed when every SharedBuffer referring to them has been
+ * released or garbage collected.
+ */
+public final class SharedBuffer {
+
+    private long nativePointer; // set and get only by native code
+
+    /**
+     * Creates a new SharedBuffer holding a copy of the given range of bytes.
+     *
+     * @param data the bytes to copy
+     * @param offset offset of the first byte to copy
+     * @param length number of bytes to copy
+     * @return the new buffer
+     */
+    public static SharedBuffer newSharedBuffer(
+            byte[] data, int offset, int length) {
+        if (offset < 0
+                || offset > data.length
+                || length < 0
+                || offset + length < 0
+                || offset + length > data.length) {
+            throw new IndexOutOfBoundsException();
+        }
+
+        SharedBuffer buffer = new SharedBuffer();
+        buffer.init0(data, offset, length);
+        return buffer;
+    }
+
+    /**
+     * Returns the number of bytes in the buffer. Throws
+     * IllegalStateException if the buffer has been released.
+     */
+    public native int length();
+
+    /**
+     * Copies bytes out of the buffer. Throws IllegalStateException if the
+     * buffer has been released.
+     *
+     * @param srcOffset offset within the buffer of the first byte to copy
+     * @param dst array that receives the bytes
+     * @param dstOffset offset within dst to store the first byte
+     * @param length number of bytes to copy
+     */
+    public void getBytes(int srcOffset, byte[] dst, int dstOffset,
+                         int length) {
+        int size = length();
+
+        if (srcOffset < 0
+                || dstOffset < 0
+                || length < 0
+                || srcOffset + length < 0
+                || srcOffset + length > size
+                || dstOffset + length < 0
+                || dstOffset + length > dst.length) {
+            throw new IndexOutOfBoundsException();
+        }
+
+        getBytes0(srcOffset, dst, dstOffset, length);
+    }
+
+    /**
+     * Returns a new array holding all bytes of the buffer. Throws
+     * IllegalStateException if the buffer has been released.
+     */
+    public byte[] toByteArray() {
+        byte[] data = new byte[length()];
+
+        getBytes0(0, data, 0, data.length);
+        return data;
+    }
+
+    /**
+     * Drops this object's reference to the native bytes, freeing them if no
+     * other SharedBuffer refers to them. The buffer cannot be used or sent
+     * afterwards. Releasing it again has no effect.
+     */
+    public native void release();
+
+    /**
+     * Creates a new, empty buffer. This buffer must be filled in by native
+     * code before it can be used.
+     */
+    SharedBuffer() {
+    }
+
+    private native void finalize();
+
+    private native void init0(byte[] data, int offset, int length);
+
+    private native void getBytes0(int srcOffset, byte[] dst, int dstOffset,
+                                  int length);
+}
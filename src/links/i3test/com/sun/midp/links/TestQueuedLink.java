@@ -0,0 +1,215 @@
+/*
+ *
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+package com.sun.midp.links;
+
+import com.sun.cldc.isolate.Isolate;
+import com.sun.midp.i3test.TestCase;
+import java.io.IOException;
+
+/**
+ * Tests links created with a message queue, where send() returns without
+ * waiting for a receiver.
+ */
+public class TestQueuedLink extends TestCase {
+
+
+    /**
+     * Tests that messages of each kind are queued without a receiver and
+     * come out in order.
+     */
+    void testOrder() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newLink(i, i, 3);
+        Link sentlink = Link.newLink(i, i);
+        byte[] sendarr = new byte[100];
+        Utils.fillRandom(sendarr);
+
+        link.send(LinkMessage.newStringMessage("foo"));
+        link.send(LinkMessage.newDataMessage(sendarr, 10, 20));
+        link.send(LinkMessage.newLinkMessage(sentlink));
+
+        assertEquals("first message should be the string", "foo",
+            link.receive().extractString());
+
+        byte[] recvarr = link.receive().extractData();
+        assertTrue("data range should be equal",
+            Utils.bytesEqual(sendarr, 10, 20, recvarr));
+
+        Link recvlink = link.receive().extractLink();
+        assertTrue("links must be equal", sentlink.equals(recvlink));
+        assertEquals("refcount must be 2", 2, Utils.getRefCount(sentlink));
+
+        link.close();
+        sentlink.close();
+    }
+
+
+    /**
+     * Tests that the data is copied when send() is called, not when the
+     * message is received.
+     */
+    void testCopyOnSend() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newLink(i, i, 1);
+        byte[] sendarr = new byte[10];
+        Utils.fillRandom(sendarr);
+        byte[] orig = new byte[10];
+        System.arraycopy(sendarr, 0, orig, 0, 10);
+
+        link.send(LinkMessage.newDataMessage(sendarr));
+        sendarr[0] ^= 0xff;
+
+        assertTrue("received data should be the data at send time",
+            Utils.bytesEqual(orig, link.receive().extractData()));
+        link.close();
+    }
+
+
+    /**
+     * Tests that send() blocks while the queue is full and continues once
+     * a message has been received.
+     */
+    void testFull() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newLink(i, i, 1);
+
+        link.send(LinkMessage.newStringMessage("one"));
+
+        Sender sender = new Sender(link, LinkMessage.newStringMessage("two"));
+        Utils.sleep(50L);
+        assertFalse("sender should be blocked", sender.done);
+
+        assertEquals("first message", "one", link.receive().extractString());
+        sender.await();
+        assertTrue("sender should be done", sender.done);
+        assertNull("sender should have no exceptions", sender.exception);
+        assertEquals("second message", "two", link.receive().extractString());
+        link.close();
+    }
+
+
+    /**
+     * Tests that a receiver blocked on an empty queue gets the next message.
+     */
+    void testReceiveFirst() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newLink(i, i, 2);
+        Receiver receiver = new Receiver(link);
+
+        link.send(LinkMessage.newStringMessage("bar"));
+        receiver.await();
+
+        assertTrue("receiver should be done", receiver.done);
+        assertNull("receiver should have no exceptions", receiver.exception);
+        assertEquals("received string", "bar",
+            receiver.msg.extractString());
+        link.close();
+    }
+
+
+    /**
+     * Tests that messages queued before close() are still delivered, and
+     * that ClosedLinkException follows them.
+     */
+    void testDrainAfterClose() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newLink(i, i, 2);
+        boolean thrown;
+
+        link.send(LinkMessage.newStringMessage("queued"));
+        Link copy = passLink(link);
+        link.close();
+
+        assertEquals("queued message must survive close", "queued",
+            copy.receive().extractString());
+
+        thrown = false;
+        try {
+            copy.receive();
+        } catch (ClosedLinkException cle) {
+            thrown = true;
+        }
+        assertTrue("receive on drained closed link should throw", thrown);
+    }
+
+
+    /**
+     * Returns a second Link object for the same link, by sending it over a
+     * synchronous link.
+     */
+    Link passLink(Link link) throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link carrier = Link.newLink(i, i);
+        Sender sender = new Sender(carrier, LinkMessage.newLinkMessage(link));
+        Link copy = carrier.receive().extractLink();
+
+        sender.await();
+        carrier.close();
+        return copy;
+    }
+
+
+    /**
+     * Tests that a negative queue size is rejected.
+     */
+    void testBadQueueSize() {
+        Isolate i = Isolate.currentIsolate();
+        boolean thrown = false;
+
+        try {
+            Link.newLink(i, i, -1);
+        } catch (IllegalArgumentException iae) {
+            thrown = true;
+        }
+        assertTrue("negative queue size should throw", thrown);
+    }
+
+
+    /**
+     * Runs all tests.
+     */
+    public void runTests() throws IOException {
+        declare("testOrder");
+        testOrder();
+
+        declare("testCopyOnSend");
+        testCopyOnSend();
+
+        declare("testFull");
+        testFull();
+
+        declare("testReceiveFirst");
+        testReceiveFirst();
+
+        declare("testDrainAfterClose");
+        testDrainAfterClose();
+
+        declare("testBadQueueSize");
+        testBadQueueSize();
+    }
+
+}
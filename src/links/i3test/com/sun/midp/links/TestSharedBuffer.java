@@ -0,0 +1,170 @@
+/*
+ *
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+package com.sun.midp.links;
+
+import com.sun.cldc.isolate.Isolate;
+import com.sun.midp.i3test.TestCase;
+import java.io.IOException;
+
+/**
+ * Tests passing SharedBuffer objects through links.
+ */
+public class TestSharedBuffer extends TestCase {
+
+
+    /**
+     * Tests creation and reading of a buffer.
+     */
+    void testCreate() {
+        byte[] data = new byte[100];
+        Utils.fillRandom(data);
+
+        SharedBuffer buffer = SharedBuffer.newSharedBuffer(data, 10, 50);
+        assertEquals("length", 50, buffer.length());
+        assertTrue("contents should be the range",
+            Utils.bytesEqual(data, 10, 50, buffer.toByteArray()));
+
+        byte[] part = new byte[5];
+        buffer.getBytes(45, part, 0, 5);
+        assertTrue("tail should match",
+            Utils.bytesEqual(data, 55, 5, part));
+
+        boolean thrown = false;
+        try {
+            buffer.getBytes(46, part, 0, 5);
+        } catch (IndexOutOfBoundsException ioobe) {
+            thrown = true;
+        }
+        assertTrue("reading past the end should throw", thrown);
+
+        buffer.release();
+        thrown = false;
+        try {
+            buffer.length();
+        } catch (IllegalStateException ise) {
+            thrown = true;
+        }
+        assertTrue("released buffer should throw", thrown);
+    }
+
+
+    /**
+     * Tests sending a buffer through a synchronous link. The received
+     * buffer must stay valid after the sender releases its own.
+     */
+    void testSend() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newLink(i, i);
+        byte[] data = new byte[1000];
+        Utils.fillRandom(data);
+        SharedBuffer sent = SharedBuffer.newSharedBuffer(data, 0, 1000);
+        Sender sender = new Sender(link,
+            LinkMessage.newSharedBufferMessage(sent));
+
+        LinkMessage lm = link.receive();
+        sender.await();
+
+        assertTrue("sender should be done", sender.done);
+        assertNull("sender should have no exceptions", sender.exception);
+        assertTrue("message should contain a shared buffer",
+            lm.containsSharedBuffer());
+
+        SharedBuffer received = lm.extractSharedBuffer();
+        assertTrue("buffers shouldn't be identical", sent != received);
+
+        sent.release();
+        assertTrue("received bytes should be equal",
+            Utils.bytesEqual(data, received.toByteArray()));
+        received.release();
+        link.close();
+    }
+
+
+    /**
+     * Tests sending a buffer through a queued link and forwarding the
+     * received message through another link.
+     */
+    void testForward() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link first = Link.newLink(i, i, 1);
+        Link second = Link.newLink(i, i, 1);
+        byte[] data = new byte[64];
+        Utils.fillRandom(data);
+        SharedBuffer sent = SharedBuffer.newSharedBuffer(data, 0, 64);
+
+        first.send(LinkMessage.newSharedBufferMessage(sent));
+        sent.release();
+        second.send(first.receive());
+
+        SharedBuffer received = second.receive().extractSharedBuffer();
+        assertTrue("forwarded bytes should be equal",
+            Utils.bytesEqual(data, received.toByteArray()));
+
+        first.close();
+        second.close();
+    }
+
+
+    /**
+     * Tests that a released buffer cannot be sent.
+     */
+    void testSendReleased() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newLink(i, i, 1);
+        SharedBuffer buffer = SharedBuffer.newSharedBuffer(new byte[1], 0, 1);
+
+        buffer.release();
+
+        boolean thrown = false;
+        try {
+            link.send(LinkMessage.newSharedBufferMessage(buffer));
+        } catch (IOException ioe) {
+            thrown = true;
+        }
+        assertTrue("sending a released buffer should throw", thrown);
+        link.close();
+    }
+
+
+    /**
+     * Runs all tests.
+     */
+    public void runTests() throws IOException {
+        declare("testCreate");
+        testCreate();
+
+        declare("testSend");
+        testSend();
+
+        declare("testForward");
+        testForward();
+
+        declare("testSendReleased");
+        testSendReleased();
+    }
+
+}
@@ -0,0 +1,218 @@
+/*
+ *
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+package com.sun.midp.links;
+
+import com.sun.cldc.isolate.Isolate;
+import com.sun.midp.i3test.TestCase;
+import java.io.IOException;
+
+/**
+ * Tests stream links, which carry bytes through a native ring buffer.
+ */
+public class TestStreamLink extends TestCase {
+
+
+    /**
+     * A thread that writes an array to a stream link.
+     */
+    class Writer extends Thread {
+        Link link;
+        byte[] data;
+        boolean done = false;
+        Throwable exception = null;
+
+        Writer(Link link, byte[] data) {
+            this.link = link;
+            this.data = data;
+            start();
+        }
+
+        public void run() {
+            try {
+                link.write(data, 0, data.length);
+            } catch (Throwable t) {
+                exception = t;
+            }
+            done = true;
+        }
+
+        void await() {
+            try {
+                join();
+            } catch (InterruptedException ignore) { }
+        }
+    }
+
+
+    /**
+     * Tests that bytes written come out in order, and that available()
+     * counts them.
+     */
+    void testWriteRead() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newStreamLink(i, i, 64);
+        byte[] sendarr = new byte[40];
+        byte[] recvarr = new byte[40];
+        Utils.fillRandom(sendarr);
+
+        link.write(sendarr, 0, 40);
+        assertEquals("all bytes should be available", 40, link.available());
+
+        assertEquals("first read", 25, link.read(recvarr, 0, 25));
+        assertEquals("second read", 15, link.read(recvarr, 25, 15));
+        assertTrue("data should be equal",
+            Utils.bytesEqual(sendarr, recvarr));
+        assertEquals("ring should be empty", 0, link.available());
+        link.close();
+    }
+
+
+    /**
+     * Tests data that wraps around the end of the ring.
+     */
+    void testWrap() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newStreamLink(i, i, 16);
+        byte[] sendarr = new byte[12];
+        byte[] recvarr = new byte[12];
+
+        for (int n = 0; n < 4; n++) {
+            Utils.fillRandom(sendarr);
+            link.write(sendarr, 0, 12);
+            assertEquals("read should return all bytes", 12,
+                link.read(recvarr, 0, 12));
+            assertTrue("data should be equal after wrap",
+                Utils.bytesEqual(sendarr, recvarr));
+        }
+
+        link.close();
+    }
+
+
+    /**
+     * Tests that write() blocks while the ring is full and continues once
+     * bytes have been read.
+     */
+    void testFull() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newStreamLink(i, i, 16);
+        byte[] sendarr = new byte[24];
+        byte[] recvarr = new byte[24];
+        Utils.fillRandom(sendarr);
+
+        Writer writer = new Writer(link, sendarr);
+        Utils.sleep(50L);
+        assertFalse("writer should be blocked", writer.done);
+
+        int total = 0;
+        while (total < 24) {
+            total += link.read(recvarr, total, 24 - total);
+        }
+
+        writer.await();
+        assertTrue("writer should be done", writer.done);
+        assertNull("writer should have no exceptions", writer.exception);
+        assertTrue("data should be equal", Utils.bytesEqual(sendarr, recvarr));
+        link.close();
+    }
+
+
+    /**
+     * Tests that bytes written before close() can still be read, and that
+     * read() then returns -1.
+     */
+    void testEOF() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newStreamLink(i, i, 16);
+        Link copy = Link.newLink(i, i);
+        byte[] buf = new byte[8];
+        Sender sender;
+
+        sender = new Sender(copy, LinkMessage.newLinkMessage(link));
+        Link reader = copy.receive().extractLink();
+        sender.await();
+        copy.close();
+
+        link.write(new byte[] { 1, 2, 3 }, 0, 3);
+        link.close();
+
+        assertEquals("bytes should survive close", 3, reader.read(buf, 0, 8));
+        assertEquals("read after drain should be EOF", -1,
+            reader.read(buf, 0, 8));
+        reader.close();
+    }
+
+
+    /**
+     * Tests that message operations are rejected on a stream link, and
+     * that a bad buffer size is rejected.
+     */
+    void testMisuse() throws IOException {
+        Isolate i = Isolate.currentIsolate();
+        Link link = Link.newStreamLink(i, i, 16);
+        boolean thrown;
+
+        thrown = false;
+        try {
+            link.send(LinkMessage.newStringMessage("foo"));
+        } catch (IllegalStateException ise) {
+            thrown = true;
+        }
+        assertTrue("send on stream link should throw", thrown);
+
+        thrown = false;
+        try {
+            Link.newStreamLink(i, i, 0);
+        } catch (IllegalArgumentException iae) {
+            thrown = true;
+        }
+        assertTrue("zero buffer size should throw", thrown);
+        link.close();
+    }
+
+
+    /**
+     * Runs all tests.
+     */
+    public void runTests() throws IOException {
+        declare("testWriteRead");
+        testWriteRead();
+
+        declare("testWrap");
+        testWrap();
+
+        declare("testFull");
+        testFull();
+
+        declare("testEOF");
+        testEOF();
+
+        declare("testMisuse");
+        testMisuse();
+    }
+
+}
@@ -61,6 +61,22 @@ static const char* const midpClosedLinkException =
  * they're sending the same object, it doesn't matter which thread is 
  * considered to have processed it -- the order of execution doesn't matter.
  *
+ * A link created with a non-zero queue size works asynchronously instead. 
+ * The sender copies the message contents into a native message queue owned 
+ * by the rendezvous point and returns at once; it blocks only while the 
+ * queue is full. The receiver takes messages from the head of the queue and 
+ * blocks only while it is empty. The rendezvous states below are not used 
+ * by such links, except for IDLE, RECEIVING (a receiver waits for the queue 
+ * to become non-empty) and CLOSED. Messages already queued when the link is 
+ * closed are still delivered before the receiver sees ClosedLinkException.
+ *
+ * A stream link carries bytes rather than messages. Its rendezvous point 
+ * owns a byte ring that the sender writes and the receiver reads, each 
+ * blocking only while the ring is full or empty respectively. A waiting 
+ * writer sets the state to SENDING and a waiting reader to RECEIVING, so 
+ * that the other side knows to signal it. Once the link is closed, the 
+ * reader gets the remaining bytes and then end of stream.
+ *
  * IMPL_NOTE - use AddStrongReference or AddWeakReference?
  *
  * IMPL_NOTE - test for out-of-memory after AddStrongReference
@@ -126,6 +142,64 @@ typedef enum {
 } retcode_t;
 
 
+/**
+ * The kind of contents of a LinkMessage. These values must match the 
+ * constants in LinkMessage.java; they let the native code tell the kinds 
+ * apart by looking up one class instead of trying each in turn.
+ */
+#define KIND_NONE   0   /* an empty message */
+#define KIND_DATA   1   /* a byte array range */
+#define KIND_STRING 2   /* a string */
+#define KIND_LINK   3   /* a link */
+#define KIND_SHARED 4   /* a shared buffer */
+
+
+/**
+ * An immutable block of bytes underlying one or more SharedBuffer objects, 
+ * possibly in different isolates. The bytes follow the structure in the same 
+ * allocation. It's freed when the last SharedBuffer is released.
+ */
+typedef struct _shared_buffer {
+    int refcount;   /* num Java objs and queued messages pointing to it */
+    int length;     /* number of bytes */
+} shared_buffer;
+
+#define SHARED_BYTES(sb) ((jbyte *)((shared_buffer *)(sb) + 1))
+
+
+/**
+ * A message copied out of the sender's heap into the queue of an
+ * asynchronous link. The payload, if any, follows the structure in the same
+ * allocation. Length is in bytes for KIND_DATA and in characters for
+ * KIND_STRING.
+ */
+typedef struct _queued_message {
+    struct _queued_message *next;   /* next message in the queue */
+    int kind;                       /* kind of contents */
+    int length;                     /* length of the payload */
+    struct _rendezvous *link;       /* counted reference for KIND_LINK */
+    shared_buffer *buffer;          /* counted reference for KIND_SHARED */
+} queued_message;
+
+#define QUEUED_PAYLOAD(qm) ((void *)((queued_message *)(qm) + 1))
+
+
+/**
+ * A single-producer, single-consumer byte ring for stream links. Head and 
+ * tail count all the bytes ever written and read, so head - tail is the 
+ * number of bytes in the ring even after the counters wrap around. Size is 
+ * a power of two. The data follows the structure in the same allocation.
+ * All native methods run on the VM thread, so the ring needs no locking.
+ */
+typedef struct _byte_ring {
+    unsigned int size;  /* capacity in bytes */
+    unsigned int head;  /* number of bytes written */
+    unsigned int tail;  /* number of bytes read */
+} byte_ring;
+
+#define RING_BYTES(r) ((jbyte *)((byte_ring *)(r) + 1))
+
+
 /**
  * Implements the concept of a "rendezvous point" as defined in the JSR-121 
  * specification.
@@ -137,6 +211,11 @@ typedef struct _rendezvous {
     jint        msg;        /* refId for the sender's pending message */
     int         sender;     /* the isolate ID of the sender */
     int         receiver;   /* the isolate ID of the receiver */
+    int         capacity;   /* max queued messages, 0 if synchronous */
+    int         queued;     /* number of messages in the queue */
+    queued_message *head;   /* oldest queued message, or NULL */
+    queued_message *tail;   /* newest queued message, or NULL */
+    byte_ring   *ring;      /* byte ring of a stream link, or NULL */
 } rendezvous;
 
 
@@ -168,11 +247,13 @@ static void log_rp_free(rendezvous *);
 
 
 /**
- * Creates a new rendezvous point with the given sender and receiver. Returns 
- * a pointer to the rendezvous point, otherwise NULL if out of memory.
+ * Creates a new rendezvous point with the given sender and receiver. A 
+ * non-zero capacity makes the link asynchronous with a queue of at most 
+ * that many messages. Returns a pointer to the rendezvous point, otherwise 
+ * NULL if out of memory.
  */
 static rendezvous *
-rp_create(int sender, int receiver) {
+rp_create(int sender, int receiver, int capacity) {
     rendezvous *rp;
 
     rp = (rendezvous *)pcsl_mem_malloc(sizeof(rendezvous));
@@ -186,6 +267,11 @@ rp_create(int sender, int receiver) {
     rp->msg = INVALID_REFERENCE_ID;
     rp->sender = sender;
     rp->receiver = receiver;
+    rp->capacity = capacity;
+    rp->queued = 0;
+    rp->head = NULL;
+    rp->tail = NULL;
+    rp->ring = NULL;
 
     return rp;
 }
@@ -198,6 +284,37 @@ rp_incref(rendezvous *rp)
 }
 
 
+static void rp_decref(rendezvous *rp);
+
+
+/**
+ * Drops a reference to a shared buffer, freeing it with the last one.
+ */
+static void
+sb_decref(shared_buffer *sb)
+{
+    sb->refcount -= 1;
+    if (sb->refcount == 0) {
+        pcsl_mem_free(sb);
+    }
+}
+
+
+/**
+ * Frees a queued message, dropping the reference it may hold.
+ */
+static void
+qm_free(queued_message *qm)
+{
+    if (qm->kind == KIND_LINK) {
+        rp_decref(qm->link);
+    } else if (qm->kind == KIND_SHARED) {
+        sb_decref(qm->buffer);
+    }
+    pcsl_mem_free(qm);
+}
+
+
 static void
 rp_decref(rendezvous *rp)
 {
@@ -207,6 +324,19 @@ rp_decref(rendezvous *rp)
             /* IMPL_NOTE: really should be an assertion failure */
             KNI_FatalError("rp_decref refcount 0 with stale refid!");
         }
+
+        /* nobody can receive the undelivered messages any more */
+        while (rp->head != NULL) {
+            queued_message *qm = rp->head;
+            rp->head = qm->next;
+            qm_free(qm);
+        }
+        rp->tail = NULL;
+        rp->queued = 0;
+
+        if (rp->ring != NULL) {
+            pcsl_mem_free(rp->ring);
+        }
 #if ENABLE_I3_TEST
         log_rp_free(rp);
 #endif
@@ -239,177 +369,428 @@ getReference(int refId, char *msg, jobject obj)
 }
 
 
-static void
-setNativePointer(jobject linkObj, rendezvous *rp)
-{
-    jfieldID nativePointerField;
-
-    KNI_StartHandles(1);
-    KNI_DeclareHandle(linkClass);
-
-    KNI_GetObjectClass(linkObj, linkClass);
-    nativePointerField = KNI_GetFieldID(linkClass, "nativePointer", "I");
-    KNI_SetIntField(linkObj, nativePointerField, (jint)rp);
-
-    KNI_EndHandles();
-}
+/*
+ * Looking up field IDs takes some time, but they do not change during a VM
+ * session, so they are cached the first time an object of the class is
+ * seen. They are only accessed by native methods running in the VM thread.
+ */
+static jfieldID linkPointerField = NULL;
+static jfieldID bufferPointerField = NULL;
+static jfieldID contentsField = NULL;
+static jfieldID offsetField = NULL;
+static jfieldID lengthField = NULL;
+static jfieldID kindField = NULL;
 
 
-static rendezvous *
-getNativePointer(jobject linkObj)
+/**
+ * Gets the field ID of the nativePointer field of objects of the same class 
+ * as obj and caches it in *pField. The field is an int in a Link and a long 
+ * in a SharedBuffer, as given by sig.
+ */
+static jfieldID
+getPointerField(jobject obj, jfieldID *pField, const char *sig)
 {
-    rendezvous *rp;
-    jfieldID nativePointerField;
+    if (*pField == NULL) {
+        KNI_StartHandles(1);
+        KNI_DeclareHandle(objClass);
 
-    KNI_StartHandles(1);
-    KNI_DeclareHandle(linkClass);
+        KNI_GetObjectClass(obj, objClass);
+        *pField = KNI_GetFieldID(objClass, "nativePointer", sig);
 
-    KNI_GetObjectClass(linkObj, linkClass);
-    nativePointerField = KNI_GetFieldID(linkClass, "nativePointer", "I");
-    rp = (rendezvous *)KNI_GetIntField(linkObj, nativePointerField);
+        KNI_EndHandles();
+    }
 
-    KNI_EndHandles();
-    return rp;
+    return *pField;
 }
 
 
+/**
+ * Caches the field IDs of the LinkMessage class, given an instance of it.
+ */
 static void
-getContents(jobject linkMessageObj, jobject contentsObj)
+cacheMessageFieldIDs(jobject linkMessageObj)
 {
-    jfieldID contentsField;
+    if (contentsField != NULL) {
+        return;
+    }
 
     KNI_StartHandles(1);
     KNI_DeclareHandle(linkMessageClass);
 
     KNI_GetObjectClass(linkMessageObj, linkMessageClass);
+    offsetField = KNI_GetFieldID(linkMessageClass, "offset", "I");
+    lengthField = KNI_GetFieldID(linkMessageClass, "length", "I");
+    kindField = KNI_GetFieldID(linkMessageClass, "kind", "I");
     contentsField = KNI_GetFieldID(linkMessageClass, "contents",
         "Ljava/lang/Object;");
-    KNI_GetObjectField(linkMessageObj, contentsField, contentsObj);
 
     KNI_EndHandles();
 }
 
 
 static void
-setContents(jobject linkMessageObj, jobject contentsObj)
+setNativePointer(jobject linkObj, rendezvous *rp)
 {
-    jfieldID contentsField;
+    KNI_SetIntField(linkObj,
+        getPointerField(linkObj, &linkPointerField, "I"), (jint)rp);
+}
 
-    KNI_StartHandles(1);
-    KNI_DeclareHandle(linkMessageClass);
 
-    KNI_GetObjectClass(linkMessageObj, linkMessageClass);
-    contentsField = KNI_GetFieldID(linkMessageClass, "contents",
-        "Ljava/lang/Object;");
-    KNI_SetObjectField(linkMessageObj, contentsField, contentsObj);
+static rendezvous *
+getNativePointer(jobject linkObj)
+{
+    return (rendezvous *)KNI_GetIntField(linkObj,
+        getPointerField(linkObj, &linkPointerField, "I"));
+}
 
-    KNI_EndHandles();
+
+/*
+ * The address of a shared buffer is kept in a long field, so that a pointer 
+ * of any width fits.
+ */
+static void
+setBufferPointer(jobject bufferObj, shared_buffer *sb)
+{
+    KNI_SetLongField(bufferObj,
+        getPointerField(bufferObj, &bufferPointerField, "J"),
+        (jlong)(long)sb);
+}
+
+
+static shared_buffer *
+getBufferPointer(jobject bufferObj)
+{
+    return (shared_buffer *)(long)KNI_GetLongField(bufferObj,
+        getPointerField(bufferObj, &bufferPointerField, "J"));
+}
+
+
+static int
+getKind(jobject linkMessageObj)
+{
+    cacheMessageFieldIDs(linkMessageObj);
+    return KNI_GetIntField(linkMessageObj, kindField);
 }
 
 
 static void
-getRange(jobject linkMessageObj, int *offset, int *length)
+getContents(jobject linkMessageObj, jobject contentsObj)
+{
+    cacheMessageFieldIDs(linkMessageObj);
+    KNI_GetObjectField(linkMessageObj, contentsField, contentsObj);
+}
+
+
+/**
+ * Sets the contents of a LinkMessage together with their kind.
+ */
+static void
+setContents(jobject linkMessageObj, jobject contentsObj, int kind)
 {
-    jfieldID offsetField;
-    jfieldID lengthField;
+    cacheMessageFieldIDs(linkMessageObj);
+    KNI_SetObjectField(linkMessageObj, contentsField, contentsObj);
+    KNI_SetIntField(linkMessageObj, kindField, kind);
+}
 
-    KNI_StartHandles(1);
-    KNI_DeclareHandle(linkMessageClass);
 
-    KNI_GetObjectClass(linkMessageObj, linkMessageClass);
-    offsetField = KNI_GetFieldID(linkMessageClass, "offset", "I");
-    lengthField = KNI_GetFieldID(linkMessageClass, "length", "I");
+static void
+getRange(jobject linkMessageObj, int *offset, int *length)
+{
+    cacheMessageFieldIDs(linkMessageObj);
     *offset = KNI_GetIntField(linkMessageObj, offsetField);
     *length = KNI_GetIntField(linkMessageObj, lengthField);
-
-    KNI_EndHandles();
 }
 
 
 static void
 setRange(jobject linkMessageObj, int offset, int length)
 {
-    jfieldID offsetField;
-    jfieldID lengthField;
+    cacheMessageFieldIDs(linkMessageObj);
+    KNI_SetIntField(linkMessageObj, offsetField, offset);
+    KNI_SetIntField(linkMessageObj, lengthField, length);
+}
+
+
+/**
+ * Checks that the contents of a LinkMessage, which must not be null, are 
+ * what its kind says, before the native code relies on their layout. Only 
+ * the class of that kind is looked up. For a byte array the range must lie 
+ * within the array. Returns KNI_TRUE if the contents match.
+ */
+static jboolean
+checkContents(jobject linkMessageObj, jobject contentsObj, int kind)
+{
+    jboolean retval = KNI_FALSE;
+    const char *className;
+
+    switch (kind) {
+        case KIND_DATA:
+            className = "[B";
+            break;
+        case KIND_STRING:
+            className = "java/lang/String";
+            break;
+        case KIND_LINK:
+            className = "com/sun/midp/links/Link";
+            break;
+        case KIND_SHARED:
+            className = "com/sun/midp/links/SharedBuffer";
+            break;
+        default:
+            return KNI_FALSE;
+    }
 
     KNI_StartHandles(1);
-    KNI_DeclareHandle(linkMessageClass);
+    KNI_DeclareHandle(kindClass);
 
-    KNI_GetObjectClass(linkMessageObj, linkMessageClass);
-    offsetField = KNI_GetFieldID(linkMessageClass, "offset", "I");
-    lengthField = KNI_GetFieldID(linkMessageClass, "length", "I");
-    KNI_SetIntField(linkMessageObj, offsetField, offset);
-    KNI_SetIntField(linkMessageObj, lengthField, length);
+    KNI_FindClass(className, kindClass);
+    if (!KNI_IsNullHandle(kindClass) &&
+            KNI_IsInstanceOf(contentsObj, kindClass)) {
+        retval = KNI_TRUE;
+
+        if (kind == KIND_DATA) {
+            jint offset;
+            jint length;
+
+            getRange(linkMessageObj, &offset, &length);
+            if (offset < 0 || length < 0 ||
+                    length > KNI_GetArrayLength(contentsObj) - offset) {
+                retval = KNI_FALSE;
+            }
+        }
+    }
 
     KNI_EndHandles();
+    return retval;
 }
 
 
 /**
  * Copies the contents of fromMsg to the contents of toMsg. Both must be
  * instances of LinkMessage. The toLink object must be an instance of Link.
- * It's filled in if the contents of fromMsg are a Link.  Returns KNI_TRUE if
- * successful, otherwise KNI_FALSE.
+ * It's filled in if the contents of fromMsg are a Link. Likewise, toBuffer 
+ * must be an instance of SharedBuffer and is filled in if the contents are 
+ * a SharedBuffer, whose bytes are shared rather than copied. Returns 
+ * KNI_TRUE if successful, otherwise KNI_FALSE.
  */
 static jboolean
-copy(jobject fromMsg, jobject toMsg, jobject toLink) {
-    jboolean retval;
+copy(jobject fromMsg, jobject toMsg, jobject toLink, jobject toBuffer) {
+    jboolean retval = KNI_FALSE;
+    int kind;
 
-    KNI_StartHandles(6);
-    KNI_DeclareHandle(byteArrayClass);
-    KNI_DeclareHandle(stringClass);
-    KNI_DeclareHandle(linkClass);
+    KNI_StartHandles(3);
     KNI_DeclareHandle(fromContents);
     KNI_DeclareHandle(newString);
     KNI_DeclareHandle(newByteArray);
 
-    KNI_FindClass("[B", byteArrayClass);
-    KNI_FindClass("java/lang/String", stringClass);
-    KNI_FindClass("com/sun/midp/links/Link", linkClass);
     getContents(fromMsg, fromContents);
-    
-    if (KNI_IsInstanceOf(fromContents, byteArrayClass)) {
-        /* do a byte array copy */
-        jint fromOffset;
-        jint fromLength;
+    kind = getKind(fromMsg);
+
+    /* a message with null or mismatched contents cannot be copied */
+    if (!KNI_IsNullHandle(fromContents) &&
+            checkContents(fromMsg, fromContents, kind)) {
+        switch (kind) {
+            case KIND_DATA: {
+                /* do a byte array copy */
+                jint fromOffset;
+                jint fromLength;
+
+                getRange(fromMsg, &fromOffset, &fromLength);
+
+                SNI_NewArray(SNI_BYTE_ARRAY, fromLength, newByteArray);
+                if (!KNI_IsNullHandle(newByteArray)) {
+                    KNI_GetRawArrayRegion(fromContents, fromOffset, fromLength,
+                        SNI_GetRawArrayPointer(newByteArray));
+                    setContents(toMsg, newByteArray, KIND_DATA);
+                    setRange(toMsg, 0, fromLength);
+                    retval = KNI_TRUE;
+                }
+                break;
+            }
+
+            case KIND_STRING: {
+                /* do a string copy */
+                jchar *buf;
+                jsize slen = KNI_GetStringLength(fromContents);
+
+                SNI_NewArray(SNI_BYTE_ARRAY, slen*sizeof(jchar), newByteArray);
+
+                if (!KNI_IsNullHandle(newByteArray)) {
+                    buf = SNI_GetRawArrayPointer(newByteArray);
+                    KNI_GetStringRegion(fromContents, 0, slen, buf);
+                    KNI_NewString(buf, slen, newString);
+                    setContents(toMsg, newString, KIND_STRING);
+                    retval = KNI_TRUE;
+                }
+                break;
+            }
+
+            case KIND_LINK: {
+                /* copy the link */
+                rendezvous *rp = getNativePointer(fromContents);
+                if (rp != NULL) {
+                    setNativePointer(toLink, rp);
+                    rp_incref(rp);
+                    setContents(toMsg, toLink, KIND_LINK);
+                    retval = KNI_TRUE;
+                }
+                break;
+            }
+
+            case KIND_SHARED: {
+                /* share the buffer */
+                shared_buffer *sb = getBufferPointer(fromContents);
+                if (sb != NULL) {
+                    setBufferPointer(toBuffer, sb);
+                    sb->refcount += 1;
+                    setContents(toMsg, toBuffer, KIND_SHARED);
+                    retval = KNI_TRUE;
+                }
+                break;
+            }
+        }
+    }
+
+    KNI_EndHandles();
+    return retval;
+}
+
+
+/**
+ * Copies the contents of msgObj, which must be an instance of LinkMessage, 
+ * into a newly allocated queued message. Returns the message, otherwise NULL 
+ * with an exception thrown: IOException if the contents cannot be sent, or 
+ * OutOfMemoryError.
+ */
+static queued_message *
+qm_create(jobject msgObj) {
+    queued_message *qm = NULL;
+    int kind = getKind(msgObj);
+
+    KNI_StartHandles(1);
+    KNI_DeclareHandle(contents);
+
+    getContents(msgObj, contents);
 
-        getRange(fromMsg, &fromOffset, &fromLength);
+    if (KNI_IsNullHandle(contents) || !checkContents(msgObj, contents, kind)) {
+        KNI_ThrowNew(midpIOException, NULL);
+    } else if (kind == KIND_DATA) {
+        jint offset;
+        jint length;
 
-        SNI_NewArray(SNI_BYTE_ARRAY, fromLength, newByteArray);
-        if (KNI_IsNullHandle(newByteArray)) {
-            retval = KNI_FALSE;
+        getRange(msgObj, &offset, &length);
+        qm = (queued_message *)pcsl_mem_malloc(sizeof(queued_message)
+            + length);
+        if (qm == NULL) {
+            KNI_ThrowNew(midpOutOfMemoryError, NULL);
         } else {
-            KNI_GetRawArrayRegion(fromContents, fromOffset, fromLength,
-                SNI_GetRawArrayPointer(newByteArray));
-            setContents(toMsg, newByteArray);
-            setRange(toMsg, 0, fromLength);
-            retval = KNI_TRUE;
+            qm->length = length;
+            KNI_GetRawArrayRegion(contents, offset, length,
+                (jbyte *)QUEUED_PAYLOAD(qm));
         }
-    } else if (KNI_IsInstanceOf(fromContents, stringClass)) {
-        /* do a string copy */
-        jchar *buf;
-        jsize slen = KNI_GetStringLength(fromContents);
+    } else if (kind == KIND_STRING) {
+        jsize slen = KNI_GetStringLength(contents);
 
-        SNI_NewArray(SNI_BYTE_ARRAY, slen*sizeof(jchar), newByteArray);
+        qm = (queued_message *)pcsl_mem_malloc(sizeof(queued_message)
+            + slen * sizeof(jchar));
+        if (qm == NULL) {
+            KNI_ThrowNew(midpOutOfMemoryError, NULL);
+        } else {
+            qm->length = slen;
+            KNI_GetStringRegion(contents, 0, slen,
+                (jchar *)QUEUED_PAYLOAD(qm));
+        }
+    } else if (kind == KIND_LINK) {
+        rendezvous *rp = getNativePointer(contents);
 
-        if (KNI_IsNullHandle(newByteArray)) {
-            retval = KNI_FALSE;
+        if (rp == NULL) {
+            KNI_ThrowNew(midpIOException, NULL);
         } else {
-            buf = SNI_GetRawArrayPointer(newByteArray);
-            KNI_GetStringRegion(fromContents, 0, slen, buf);
-            KNI_NewString(buf, slen, newString);
-            setContents(toMsg, newString);
-            retval = KNI_TRUE;
+            qm = (queued_message *)pcsl_mem_malloc(sizeof(queued_message));
+            if (qm == NULL) {
+                KNI_ThrowNew(midpOutOfMemoryError, NULL);
+            } else {
+                qm->length = 0;
+                qm->link = rp;
+                rp_incref(rp);
+            }
+        }
+    } else if (kind == KIND_SHARED) {
+        shared_buffer *sb = getBufferPointer(contents);
+
+        if (sb == NULL) {
+            KNI_ThrowNew(midpIOException, NULL);
+        } else {
+            qm = (queued_message *)pcsl_mem_malloc(sizeof(queued_message));
+            if (qm == NULL) {
+                KNI_ThrowNew(midpOutOfMemoryError, NULL);
+            } else {
+                qm->length = 0;
+                qm->buffer = sb;
+                sb->refcount += 1;
+            }
         }
-    } else if (KNI_IsInstanceOf(fromContents, linkClass)) {
-        /* copy the link */
-        rendezvous *rp = getNativePointer(fromContents);
-        setNativePointer(toLink, rp);
-        rp_incref(rp);
-        setContents(toMsg, toLink);
-        retval = KNI_TRUE;
     } else {
-        retval = KNI_FALSE;
+        KNI_ThrowNew(midpIOException, NULL);
+    }
+
+    if (qm != NULL) {
+        qm->next = NULL;
+        qm->kind = kind;
+    }
+
+    KNI_EndHandles();
+    return qm;
+}
+
+
+/**
+ * Fills in toMsg, an instance of LinkMessage, from the queued message. The 
+ * toLink object must be an instance of Link and toBuffer an instance of 
+ * SharedBuffer; the one matching the kind of message is filled in and takes 
+ * over the message's reference. Returns KNI_TRUE if successful, otherwise 
+ * KNI_FALSE.
+ */
+static jboolean
+qm_deliver(queued_message *qm, jobject toMsg, jobject toLink,
+           jobject toBuffer) {
+    jboolean retval = KNI_TRUE;
+
+    KNI_StartHandles(1);
+    KNI_DeclareHandle(newContents);
+
+    switch (qm->kind) {
+        case KIND_DATA:
+            SNI_NewArray(SNI_BYTE_ARRAY, qm->length, newContents);
+            if (KNI_IsNullHandle(newContents)) {
+                retval = KNI_FALSE;
+            } else {
+                KNI_SetRawArrayRegion(newContents, 0, qm->length,
+                    (jbyte *)QUEUED_PAYLOAD(qm));
+                setContents(toMsg, newContents, KIND_DATA);
+                setRange(toMsg, 0, qm->length);
+            }
+            break;
+
+        case KIND_STRING:
+            KNI_NewString((jchar *)QUEUED_PAYLOAD(qm), qm->length,
+                newContents);
+            if (KNI_IsNullHandle(newContents)) {
+                retval = KNI_FALSE;
+            } else {
+                setContents(toMsg, newContents, KIND_STRING);
+            }
+            break;
+
+        case KIND_LINK:
+            setNativePointer(toLink, qm->link);
+            setContents(toMsg, toLink, KIND_LINK);
+            break;
+
+        case KIND_SHARED:
+            setBufferPointer(toBuffer, qm->buffer);
+            setContents(toMsg, toBuffer, KIND_SHARED);
+            break;
     }
 
     KNI_EndHandles();
@@ -417,6 +798,84 @@ copy(jobject fromMsg, jobject toMsg, jobject toLink) {
 }
 
 
+/**
+ * Handles send0() on an asynchronous link: queues a copy of messageObj and 
+ * returns, or blocks while the queue is full.
+ */
+static void
+send_queued(rendezvous *rp, jobject thisObj, jobject messageObj) {
+    queued_message *qm;
+
+    if (rp->state == CLOSED) {
+        setNativePointer(thisObj, NULL);
+        rp_decref(rp);
+        if (SNI_GetReentryData(NULL) == NULL) {
+            KNI_ThrowNew(midpClosedLinkException, NULL);
+        } else {
+            KNI_ThrowNew(midpInterruptedIOException, NULL);
+        }
+    } else if (rp->queued >= rp->capacity) {
+        midp_thread_wait(LINK_READY_SIGNAL, (int)rp, NULL);
+    } else {
+        qm = qm_create(messageObj);
+        if (qm != NULL) {
+            if (rp->tail == NULL) {
+                rp->head = qm;
+            } else {
+                rp->tail->next = qm;
+            }
+            rp->tail = qm;
+            rp->queued += 1;
+
+            if (rp->state == RECEIVING) {
+                rp->state = IDLE;
+                midp_thread_signal(LINK_READY_SIGNAL, (int)rp, 0);
+            }
+        }
+    }
+}
+
+
+/**
+ * Handles receive0() on an asynchronous link: takes the oldest queued 
+ * message, or blocks while the queue is empty.
+ */
+static void
+receive_queued(rendezvous *rp, jobject thisObj, jobject recvMessageObj,
+               jobject linkObj, jobject bufferObj) {
+    queued_message *qm = rp->head;
+
+    if (qm != NULL) {
+        if (!qm_deliver(qm, recvMessageObj, linkObj, bufferObj)) {
+            KNI_ThrowNew(midpIOException, NULL);
+        } else {
+            rp->head = qm->next;
+            if (rp->head == NULL) {
+                rp->tail = NULL;
+            }
+
+            /* wake up senders waiting for room in the queue */
+            if (rp->queued-- == rp->capacity) {
+                midp_thread_signal(LINK_READY_SIGNAL, (int)rp, 0);
+            }
+            /* any reference was handed over to linkObj or bufferObj */
+            pcsl_mem_free(qm);
+        }
+    } else if (rp->state == CLOSED) {
+        setNativePointer(thisObj, NULL);
+        rp_decref(rp);
+        if (SNI_GetReentryData(NULL) == NULL) {
+            KNI_ThrowNew(midpClosedLinkException, NULL);
+        } else {
+            KNI_ThrowNew(midpInterruptedIOException, NULL);
+        }
+    } else {
+        rp->state = RECEIVING;
+        midp_thread_wait(LINK_READY_SIGNAL, (int)rp, NULL);
+    }
+}
+
+
 /**
  * public native void close();
  */
@@ -461,13 +920,17 @@ Java_com_sun_midp_links_Link_finalize(void)
 
 
 /**
- * private native void init0(int sender, int receiver);
+ * private native void init0(int sender, int receiver, int queueSize,
+ *                           int bufferSize);
  */
 KNIEXPORT KNI_RETURNTYPE_VOID
 Java_com_sun_midp_links_Link_init0(void)
 {
     int sender;
     int receiver;
+    int queueSize;
+    int bufferSize;
+    unsigned int ringSize;
     rendezvous *rp;
 
     KNI_StartHandles(1);
@@ -475,9 +938,29 @@ Java_com_sun_midp_links_Link_init0(void)
 
     sender = KNI_GetParameterAsInt(1);
     receiver = KNI_GetParameterAsInt(2);
+    queueSize = KNI_GetParameterAsInt(3);
+    bufferSize = KNI_GetParameterAsInt(4);
     KNI_GetThisPointer(thisObj);
 
-    rp = rp_create(sender, receiver);
+    rp = rp_create(sender, receiver, queueSize);
+    if (rp != NULL && bufferSize > 0) {
+        /* round up to a power of two so that offsets can be masked */
+        for (ringSize = 1; ringSize < (unsigned int)bufferSize;
+                ringSize <<= 1) {
+        }
+
+        rp->ring = (byte_ring *)pcsl_mem_malloc(sizeof(byte_ring)
+            + ringSize);
+        if (rp->ring == NULL) {
+            pcsl_mem_free(rp);
+            rp = NULL;
+        } else {
+            rp->ring->size = ringSize;
+            rp->ring->head = 0;
+            rp->ring->tail = 0;
+        }
+    }
+
     if (rp == NULL) {
         KNI_ThrowNew(midpOutOfMemoryError, NULL);
     } else {
@@ -516,7 +999,8 @@ Java_com_sun_midp_links_Link_isOpen(void)
 
 
 /**
- * private native void receive0(LinkMessage msg, Link link)
+ * private native void receive0(LinkMessage msg, Link link,
+ *                              SharedBuffer buffer)
  *         throws ClosedLinkException,
  *                InterruptedIOException,
  *                IOException;
@@ -526,15 +1010,17 @@ Java_com_sun_midp_links_Link_receive0(void)
 {
     rendezvous *rp;
 
-    KNI_StartHandles(4);
+    KNI_StartHandles(5);
     KNI_DeclareHandle(thisObj);
     KNI_DeclareHandle(recvMessageObj);
     KNI_DeclareHandle(sendMessageObj);
     KNI_DeclareHandle(linkObj);
+    KNI_DeclareHandle(bufferObj);
 
     KNI_GetThisPointer(thisObj);
     KNI_GetParameterAsObject(1, recvMessageObj);
     KNI_GetParameterAsObject(2, linkObj);
+    KNI_GetParameterAsObject(3, bufferObj);
 
     rp = getNativePointer(thisObj);
 
@@ -546,6 +1032,10 @@ Java_com_sun_midp_links_Link_receive0(void)
         }
     } else if (JVM_CurrentIsolateID() != rp->receiver) {
         KNI_ThrowNew(midpIllegalArgumentException, NULL);
+    } else if (rp->ring != NULL) {
+        KNI_ThrowNew(midpIllegalStateException, NULL);
+    } else if (rp->capacity > 0) {
+        receive_queued(rp, thisObj, recvMessageObj, linkObj, bufferObj);
     } else {
         jboolean ok;
 
@@ -558,7 +1048,8 @@ Java_com_sun_midp_links_Link_receive0(void)
             case SENDING:
                 getReference(rp->msg, "receive0/SENDING",
                     sendMessageObj);
-                ok = copy(sendMessageObj, recvMessageObj, linkObj);
+                ok = copy(sendMessageObj, recvMessageObj, linkObj,
+                    bufferObj);
                 if (ok) {
                     rp->retcode = OK;
                 } else {
@@ -571,7 +1062,8 @@ Java_com_sun_midp_links_Link_receive0(void)
 
             case RENDEZVOUS:
                 getReference(rp->msg, "receive0/RENDEZVOUS", sendMessageObj);
-                ok = copy(sendMessageObj, recvMessageObj, linkObj);
+                ok = copy(sendMessageObj, recvMessageObj, linkObj,
+                    bufferObj);
                 if (ok) {
                     rp->retcode = OK;
                 } else {
@@ -633,6 +1125,10 @@ Java_com_sun_midp_links_Link_send0(void)
         }
     } else if (JVM_CurrentIsolateID() != rp->sender) {
         KNI_ThrowNew(midpIllegalArgumentException, NULL);
+    } else if (rp->ring != NULL) {
+        KNI_ThrowNew(midpIllegalStateException, NULL);
+    } else if (rp->capacity > 0) {
+        send_queued(rp, thisObj, messageObj);
     } else {
         switch (rp->state) {
             case IDLE:
@@ -692,6 +1188,345 @@ Java_com_sun_midp_links_Link_send0(void)
 }
 
 
+/**
+ * Gets the rendezvous point of a stream link for the calling isolate, which
+ * must be the given end of the link. Returns NULL with an exception thrown
+ * if the link is closed, is not a stream link, or the isolate is not at 
+ * that end.
+ */
+static rendezvous *
+getStreamPointer(jobject linkObj, jboolean isSender)
+{
+    rendezvous *rp = getNativePointer(linkObj);
+
+    if (rp == NULL) {
+        if (SNI_GetReentryData(NULL) == NULL) {
+            KNI_ThrowNew(midpClosedLinkException, NULL);
+        } else {
+            KNI_ThrowNew(midpInterruptedIOException, NULL);
+        }
+    } else if (JVM_CurrentIsolateID() !=
+            (isSender ? rp->sender : rp->receiver)) {
+        KNI_ThrowNew(midpIllegalArgumentException, NULL);
+        rp = NULL;
+    } else if (rp->ring == NULL) {
+        KNI_ThrowNew(midpIllegalStateException, NULL);
+        rp = NULL;
+    }
+
+    return rp;
+}
+
+
+/**
+ * private native int write0(byte[] b, int off, int len)
+ *     throws ClosedLinkException,
+ *            InterruptedIOException,
+ *            IOException;
+ *
+ * Writes as many bytes as fit into the ring, at least one, and returns the
+ * number written. Blocks while the ring is full.
+ */
+KNIEXPORT KNI_RETURNTYPE_INT
+Java_com_sun_midp_links_Link_write0(void)
+{
+    rendezvous *rp;
+    byte_ring *ring;
+    jint off;
+    jint len;
+    unsigned int room;
+    unsigned int start;
+    unsigned int chunk;
+    int retval = 0;
+
+    KNI_StartHandles(2);
+    KNI_DeclareHandle(thisObj);
+    KNI_DeclareHandle(bufferObj);
+
+    KNI_GetThisPointer(thisObj);
+    KNI_GetParameterAsObject(1, bufferObj);
+    off = KNI_GetParameterAsInt(2);
+    len = KNI_GetParameterAsInt(3);
+
+    rp = getStreamPointer(thisObj, KNI_TRUE);
+    if (rp != NULL) {
+        ring = rp->ring;
+        room = ring->size - (ring->head - ring->tail);
+
+        if (rp->state == CLOSED) {
+            setNativePointer(thisObj, NULL);
+            rp_decref(rp);
+            KNI_ThrowNew(midpClosedLinkException, NULL);
+        } else if (room == 0) {
+            rp->state = SENDING;
+            midp_thread_wait(LINK_READY_SIGNAL, (int)rp, NULL);
+        } else {
+            if ((unsigned int)len > room) {
+                len = room;
+            }
+
+            /* copy in up to two pieces, the second one after wrapping */
+            start = ring->head & (ring->size - 1);
+            chunk = ring->size - start;
+            if (chunk > (unsigned int)len) {
+                chunk = len;
+            }
+
+            KNI_GetRawArrayRegion(bufferObj, off, chunk,
+                RING_BYTES(ring) + start);
+            if (chunk < (unsigned int)len) {
+                KNI_GetRawArrayRegion(bufferObj, off + chunk, len - chunk,
+                    RING_BYTES(ring));
+            }
+
+            ring->head += len;
+            retval = len;
+
+            if (rp->state == RECEIVING) {
+                rp->state = IDLE;
+                midp_thread_signal(LINK_READY_SIGNAL, (int)rp, 0);
+            }
+        }
+    }
+
+    KNI_EndHandles();
+    KNI_ReturnInt(retval);
+}
+
+
+/**
+ * private native int read0(byte[] b, int off, int len)
+ *     throws ClosedLinkException,
+ *            InterruptedIOException,
+ *            IOException;
+ *
+ * Reads as many bytes as are in the ring, up to len, and returns the number
+ * read. Blocks while the ring is empty. Returns -1 if the ring is empty and
+ * the link has been closed.
+ */
+KNIEXPORT KNI_RETURNTYPE_INT
+Java_com_sun_midp_links_Link_read0(void)
+{
+    rendezvous *rp;
+    byte_ring *ring;
+    jint off;
+    jint len;
+    unsigned int count;
+    unsigned int start;
+    unsigned int chunk;
+    int retval = 0;
+
+    KNI_StartHandles(2);
+    KNI_DeclareHandle(thisObj);
+    KNI_DeclareHandle(bufferObj);
+
+    KNI_GetThisPointer(thisObj);
+    KNI_GetParameterAsObject(1, bufferObj);
+    off = KNI_GetParameterAsInt(2);
+    len = KNI_GetParameterAsInt(3);
+
+    rp = getStreamPointer(thisObj, KNI_FALSE);
+    if (rp != NULL) {
+        ring = rp->ring;
+        count = ring->head - ring->tail;
+
+        if (count > 0) {
+            if ((unsigned int)len > count) {
+                len = count;
+            }
+
+            /* copy out in up to two pieces, the second one after wrapping */
+            start = ring->tail & (ring->size - 1);
+            chunk = ring->size - start;
+            if (chunk > (unsigned int)len) {
+                chunk = len;
+            }
+
+            KNI_SetRawArrayRegion(bufferObj, off, chunk,
+                RING_BYTES(ring) + start);
+            if (chunk < (unsigned int)len) {
+                KNI_SetRawArrayRegion(bufferObj, off + chunk, len - chunk,
+                    RING_BYTES(ring));
+            }
+
+            ring->tail += len;
+            retval = len;
+
+            if (rp->state == SENDING) {
+                rp->state = IDLE;
+                midp_thread_signal(LINK_READY_SIGNAL, (int)rp, 0);
+            }
+        } else if (rp->state == CLOSED) {
+            retval = -1;
+        } else {
+            rp->state = RECEIVING;
+            midp_thread_wait(LINK_READY_SIGNAL, (int)rp, NULL);
+        }
+    }
+
+    KNI_EndHandles();
+    KNI_ReturnInt(retval);
+}
+
+
+/**
+ * private native int available0();
+ *
+ * Returns the number of bytes that can be read from a stream link without 
+ * blocking, or 0 if the link is closed or not a stream link.
+ */
+KNIEXPORT KNI_RETURNTYPE_INT
+Java_com_sun_midp_links_Link_available0(void)
+{
+    rendezvous *rp;
+    int retval = 0;
+
+    KNI_StartHandles(1);
+    KNI_DeclareHandle(thisObj);
+
+    KNI_GetThisPointer(thisObj);
+    rp = getNativePointer(thisObj);
+
+    if (rp != NULL && rp->ring != NULL) {
+        retval = (int)(rp->ring->head - rp->ring->tail);
+    }
+
+    KNI_EndHandles();
+    KNI_ReturnInt(retval);
+}
+
+
+/**
+ * private native void init0(byte[] data, int offset, int length);
+ */
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_links_SharedBuffer_init0(void)
+{
+    jint offset;
+    jint length;
+    shared_buffer *sb;
+
+    KNI_StartHandles(2);
+    KNI_DeclareHandle(thisObj);
+    KNI_DeclareHandle(dataObj);
+
+    KNI_GetThisPointer(thisObj);
+    KNI_GetParameterAsObject(1, dataObj);
+    offset = KNI_GetParameterAsInt(2);
+    length = KNI_GetParameterAsInt(3);
+
+    sb = (shared_buffer *)pcsl_mem_malloc(sizeof(shared_buffer) + length);
+    if (sb == NULL) {
+        KNI_ThrowNew(midpOutOfMemoryError, NULL);
+    } else {
+        sb->refcount = 1;
+        sb->length = length;
+        KNI_GetRawArrayRegion(dataObj, offset, length, SHARED_BYTES(sb));
+        setBufferPointer(thisObj, sb);
+    }
+
+    KNI_EndHandles();
+    KNI_ReturnVoid();
+}
+
+
+/**
+ * public native int length();
+ */
+KNIEXPORT KNI_RETURNTYPE_INT
+Java_com_sun_midp_links_SharedBuffer_length(void)
+{
+    shared_buffer *sb;
+    int retval = 0;
+
+    KNI_StartHandles(1);
+    KNI_DeclareHandle(thisObj);
+
+    KNI_GetThisPointer(thisObj);
+    sb = getBufferPointer(thisObj);
+
+    if (sb == NULL) {
+        KNI_ThrowNew(midpIllegalStateException, NULL);
+    } else {
+        retval = sb->length;
+    }
+
+    KNI_EndHandles();
+    KNI_ReturnInt(retval);
+}
+
+
+/**
+ * private native void getBytes0(int srcOffset, byte[] dst, int dstOffset,
+ *                               int length);
+ */
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_links_SharedBuffer_getBytes0(void)
+{
+    shared_buffer *sb;
+    jint srcOffset;
+    jint dstOffset;
+    jint length;
+
+    KNI_StartHandles(2);
+    KNI_DeclareHandle(thisObj);
+    KNI_DeclareHandle(dstObj);
+
+    KNI_GetThisPointer(thisObj);
+    srcOffset = KNI_GetParameterAsInt(1);
+    KNI_GetParameterAsObject(2, dstObj);
+    dstOffset = KNI_GetParameterAsInt(3);
+    length = KNI_GetParameterAsInt(4);
+    sb = getBufferPointer(thisObj);
+
+    /* bounds were checked by the caller against length() */
+    if (sb == NULL) {
+        KNI_ThrowNew(midpIllegalStateException, NULL);
+    } else {
+        KNI_SetRawArrayRegion(dstObj, dstOffset, length,
+            SHARED_BYTES(sb) + srcOffset);
+    }
+
+    KNI_EndHandles();
+    KNI_ReturnVoid();
+}
+
+
+/**
+ * public native void release();
+ */
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_links_SharedBuffer_release(void)
+{
+    shared_buffer *sb;
+
+    KNI_StartHandles(1);
+    KNI_DeclareHandle(thisObj);
+
+    KNI_GetThisPointer(thisObj);
+    sb = getBufferPointer(thisObj);
+
+    /* ignore if released twice */
+    if (sb != NULL) {
+        setBufferPointer(thisObj, NULL);
+        sb_decref(sb);
+    }
+
+    KNI_EndHandles();
+    KNI_ReturnVoid();
+}
+
+
+/**
+ * private native void finalize();
+ */
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_links_SharedBuffer_finalize(void)
+{
+    Java_com_sun_midp_links_SharedBuffer_release();
+}
+
+
 /**
  * Cleans up this portal entry. Frees the array of pointers to rendezvous 
  * points and sets the count to -1. If the count is already -1, does 
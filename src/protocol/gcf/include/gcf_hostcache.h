@@ -0,0 +1,111 @@
+/*
+ *  
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/**
+ * @file
+ * @ingroup network
+ *
+ * Cache of resolved host names shared by the socket and datagram
+ * protocols. Successful lookups are kept for a while, failed ones for
+ * a shorter while, so that repeated connections to the same host do not
+ * each wait for the resolver.
+ */
+
+#ifndef _GCF_HOSTCACHE_H_
+#define _GCF_HOSTCACHE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** The host name is not in the cache. */
+#define HOST_CACHE_MISS     0
+/** The host name is in the cache with its address. */
+#define HOST_CACHE_HIT      1
+/** The host name is in the cache as one that could not be resolved. */
+#define HOST_CACHE_NEGATIVE 2
+
+/**
+ * Looks up a host name in the cache.
+ *
+ * @param host the host name
+ * @param ipBytes receives the address on a hit
+ * @param maxLen size of <tt>ipBytes</tt>
+ * @param pLen receives the length of the address on a hit
+ *
+ * @return HOST_CACHE_HIT, HOST_CACHE_NEGATIVE or HOST_CACHE_MISS
+ */
+int hostCacheLookup(const char* host, unsigned char* ipBytes, int maxLen,
+                    int* pLen);
+
+/**
+ * Adds the result of a lookup to the cache.
+ *
+ * @param host the host name
+ * @param ipBytes the address, ignored if <tt>len</tt> is negative
+ * @param len length of the address, negative if the name could not
+ *            be resolved
+ */
+void hostCacheAdd(const char* host, const unsigned char* ipBytes, int len);
+
+/**
+ * Starts resolving a host name, the same as
+ * <tt>pcsl_network_gethostbyname_start</tt>, but answers from the cache
+ * when it can and caches what the resolver returns.
+ *
+ * @param host the host name
+ * @param ipBytes receives the address
+ * @param maxLen size of <tt>ipBytes</tt>
+ * @param pLen receives the length of the address
+ * @param pHandle receives the handle to wait with on PCSL_NET_WOULDBLOCK
+ * @param pContext receives the context to wait with on PCSL_NET_WOULDBLOCK
+ *
+ * @return PCSL_NET_SUCCESS, PCSL_NET_WOULDBLOCK, or an error status
+ */
+int hostCacheResolveStart(const char* host, unsigned char* ipBytes,
+                          int maxLen, int* pLen, void** pHandle,
+                          void** pContext);
+
+/**
+ * Finishes resolving a host name after the thread is unblocked, the same
+ * as <tt>pcsl_network_gethostbyname_finish</tt>, and caches the result.
+ *
+ * @param ipBytes receives the address
+ * @param maxLen size of <tt>ipBytes</tt>
+ * @param pLen receives the length of the address
+ * @param handle the handle the lookup was waited for with
+ * @param context the context the lookup was waited for with
+ *
+ * @return PCSL_NET_SUCCESS, PCSL_NET_WOULDBLOCK, or an error status
+ */
+int hostCacheResolveFinish(unsigned char* ipBytes, int maxLen, int* pLen,
+                           void* handle, void* context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GCF_HOSTCACHE_H_ */
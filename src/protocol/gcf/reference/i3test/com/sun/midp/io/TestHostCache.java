@@ -0,0 +1,166 @@
+/*
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+package com.sun.midp.io;
+
+import com.sun.midp.i3test.TestCase;
+
+/**
+ * Tests the native cache of resolved host names. The cache is run with
+ * a stub resolver that only knows names starting with "loopback".
+ */
+public class TestHostCache extends TestCase {
+    /** Time in milliseconds a resolved address is kept. */
+    static final int TTL = 1000;
+
+    /** Time in milliseconds a failed lookup is kept. */
+    static final int NEGATIVE_TTL = 500;
+
+    /** Extra time to wait for an entry to expire. */
+    static final int MARGIN = 500;
+
+    /**
+     * Empties the cache and switches between the stub and the real
+     * resolver.
+     *
+     * @param stub <tt>true</tt> to use the stub resolver
+     * @param ttl time in milliseconds a resolved address is kept
+     * @param negativeTtl time in milliseconds a failed lookup is kept
+     */
+    private static native void useStubResolver(boolean stub, int ttl,
+                                               int negativeTtl);
+
+    /**
+     * Resolves a host name through the cache.
+     *
+     * @param host the host name
+     * @param ipBytes receives the address
+     * @return length of the address, -1 if the name could not be resolved
+     */
+    private static native int resolve(String host, byte[] ipBytes);
+
+    /**
+     * Gets the number of lookups the stub resolver was asked for.
+     *
+     * @return number of lookups since useStubResolver was called
+     */
+    private static native int getResolverCalls();
+
+    /**
+     * Waits for the given time.
+     *
+     * @param ms time in milliseconds
+     */
+    static void sleep(long ms) {
+        try {
+            Thread.sleep(ms);
+        } catch (InterruptedException e) {
+            // ignoring
+        }
+    }
+
+    /**
+     * Checks that a name resolves to the loopback address.
+     *
+     * @param host the host name
+     */
+    void assertLoopback(String host) {
+        byte[] ipBytes = new byte[16];
+
+        assertEquals("length", 4, resolve(host, ipBytes));
+        assertEquals("byte 0", 127, ipBytes[0]);
+        assertEquals("byte 1", 0, ipBytes[1]);
+        assertEquals("byte 2", 0, ipBytes[2]);
+        assertEquals("byte 3", 1, ipBytes[3]);
+    }
+
+    /**
+     * Tests that a resolved name is answered from the cache until
+     * it expires.
+     */
+    void testHit() {
+        useStubResolver(true, TTL, NEGATIVE_TTL);
+
+        assertLoopback("loopback.test");
+        assertEquals("first lookup", 1, getResolverCalls());
+
+        assertLoopback("loopback.test");
+        assertLoopback("LOOPBACK.TEST");
+        assertEquals("cached lookups", 1, getResolverCalls());
+
+        assertLoopback("loopback2.test");
+        assertEquals("other name", 2, getResolverCalls());
+    }
+
+    /**
+     * Tests that an expired name is resolved again.
+     */
+    void testExpiry() {
+        useStubResolver(true, TTL, NEGATIVE_TTL);
+
+        assertLoopback("loopback.test");
+        sleep(TTL + MARGIN);
+
+        assertLoopback("loopback.test");
+        assertEquals("lookup after expiry", 2, getResolverCalls());
+
+        assertLoopback("loopback.test");
+        assertEquals("cached again", 2, getResolverCalls());
+    }
+
+    /**
+     * Tests that a failed lookup is cached for the shorter time.
+     */
+    void testNegative() {
+        byte[] ipBytes = new byte[16];
+
+        useStubResolver(true, TTL, NEGATIVE_TTL);
+
+        assertEquals("unknown", -1, resolve("unknown.test", ipBytes));
+        assertEquals("first lookup", 1, getResolverCalls());
+
+        assertEquals("cached unknown", -1, resolve("unknown.test", ipBytes));
+        assertEquals("cached failure", 1, getResolverCalls());
+
+        sleep(NEGATIVE_TTL + MARGIN);
+
+        assertEquals("expired unknown", -1, resolve("unknown.test", ipBytes));
+        assertEquals("lookup after expiry", 2, getResolverCalls());
+    }
+
+    /**
+     * Runs all the tests.
+     */
+    public void runTests() throws Throwable {
+        try {
+            declare("testHit");
+            testHit();
+            declare("testExpiry");
+            testExpiry();
+            declare("testNegative");
+            testNegative();
+        } finally {
+            useStubResolver(false, 0, 0);
+        }
+    }
+}
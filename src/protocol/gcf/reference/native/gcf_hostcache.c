@@ -0,0 +1,500 @@
+/*
+ *  
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+#include <string.h>
+
+#include <kni.h>
+#include <midpServices.h>
+#include <midp_libc_ext.h>
+#include <midp_properties_port.h>
+#include <pcsl_network.h>
+#include <gcf_hostcache.h>
+
+#if ENABLE_I3_TEST
+    #include <midpError.h>
+    #include <midpUtilKni.h>
+#endif
+
+/** Number of host names kept in the cache. */
+#define HOST_CACHE_SIZE 16
+
+/** Number of lookups that can wait for the resolver at the same time. */
+#define HOST_CACHE_PENDING_SIZE 4
+
+/** Default time in milliseconds a resolved address is kept. */
+#define HOST_CACHE_DEFAULT_TTL 60000
+
+/** Default time in milliseconds a failed lookup is kept. */
+#define HOST_CACHE_DEFAULT_NEGATIVE_TTL 10000
+
+/** A cached lookup. */
+typedef struct _HostCacheEntry {
+    /** Host name, empty if the entry is free */
+    char name[MAX_HOST_LENGTH];
+    /** Address of the host */
+    unsigned char ipBytes[MAX_ADDR_LENGTH];
+    /** Length of the address, -1 if the name could not be resolved */
+    int len;
+    /** Time the entry expires at */
+    jlong expires;
+    /** Time the entry was last used, for replacement */
+    jlong lastUsed;
+} HostCacheEntry;
+
+/** A lookup waiting for the resolver. */
+typedef struct _HostCachePending {
+    /** Handle the lookup is waited for with, NULL if the slot is free */
+    void* handle;
+    /** Host name being resolved */
+    char name[MAX_HOST_LENGTH];
+} HostCachePending;
+
+/** The cached lookups. */
+static HostCacheEntry hostCache[HOST_CACHE_SIZE];
+
+/** The lookups waiting for the resolver. */
+static HostCachePending hostCachePending[HOST_CACHE_PENDING_SIZE];
+
+/** Time in milliseconds a resolved address is kept, 0 if not read yet. */
+static int hostCacheTtl = 0;
+
+/** Time in milliseconds a failed lookup is kept. */
+static int hostCacheNegativeTtl = 0;
+
+#if ENABLE_I3_TEST
+/** Type of pcsl_network_gethostbyname_start. */
+typedef int (*HostCacheResolver)(char* host, unsigned char* ipBytes,
+                                 int maxLen, int* pLen, void** pHandle,
+                                 void** pContext);
+
+/** Resolver the cache starts lookups with, replaced by the i3test. */
+static HostCacheResolver hostCacheResolver =
+    pcsl_network_gethostbyname_start;
+
+/** Number of lookups started with the stub resolver. */
+static int hostCacheStubCalls = 0;
+#else
+#define hostCacheResolver pcsl_network_gethostbyname_start
+#endif
+
+/**
+ * Reads the cache times from the configuration the first time the
+ * cache is used.
+ */
+static void
+hostCacheInit(void) {
+    if (hostCacheTtl != 0) {
+        return;
+    }
+
+    hostCacheTtl = getInternalPropertyInt("com.sun.midp.io.j2me.dns.ttl");
+    if (hostCacheTtl <= 0) {
+        hostCacheTtl = HOST_CACHE_DEFAULT_TTL;
+    }
+
+    hostCacheNegativeTtl =
+        getInternalPropertyInt("com.sun.midp.io.j2me.dns.negative_ttl");
+    if (hostCacheNegativeTtl <= 0) {
+        hostCacheNegativeTtl = HOST_CACHE_DEFAULT_NEGATIVE_TTL;
+    }
+}
+
+/**
+ * Finds the cache entry of a host name.
+ *
+ * @param host the host name
+ *
+ * @return the entry or NULL if the name is not cached
+ */
+static HostCacheEntry*
+hostCacheFind(const char* host) {
+    int i;
+
+    for (i = 0; i < HOST_CACHE_SIZE; i++) {
+        if (hostCache[i].name[0] != '\0' &&
+                midp_strcasecmp(hostCache[i].name, host) == 0) {
+            return &hostCache[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Looks up a host name in the cache.
+ *
+ * @param host the host name
+ * @param ipBytes receives the address on a hit
+ * @param maxLen size of <tt>ipBytes</tt>
+ * @param pLen receives the length of the address on a hit
+ *
+ * @return HOST_CACHE_HIT, HOST_CACHE_NEGATIVE or HOST_CACHE_MISS
+ */
+int
+hostCacheLookup(const char* host, unsigned char* ipBytes, int maxLen,
+                int* pLen) {
+    HostCacheEntry* entry = hostCacheFind(host);
+    jlong now;
+
+    if (entry == NULL) {
+        return HOST_CACHE_MISS;
+    }
+
+    now = midp_getCurrentTime();
+    if (now >= entry->expires) {
+        entry->name[0] = '\0';
+        return HOST_CACHE_MISS;
+    }
+
+    entry->lastUsed = now;
+
+    if (entry->len < 0) {
+        return HOST_CACHE_NEGATIVE;
+    }
+
+    if (entry->len > maxLen) {
+        return HOST_CACHE_MISS;
+    }
+
+    memcpy(ipBytes, entry->ipBytes, entry->len);
+    *pLen = entry->len;
+    return HOST_CACHE_HIT;
+}
+
+/**
+ * Adds the result of a lookup to the cache. The entry replaced is the
+ * one of the same name, else a free or expired one, else the one used
+ * least recently.
+ *
+ * @param host the host name
+ * @param ipBytes the address, ignored if <tt>len</tt> is negative
+ * @param len length of the address, negative if the name could not
+ *            be resolved
+ */
+void
+hostCacheAdd(const char* host, const unsigned char* ipBytes, int len) {
+    HostCacheEntry* entry;
+    jlong now;
+    int i;
+
+    if (strlen(host) >= MAX_HOST_LENGTH || len > MAX_ADDR_LENGTH) {
+        return;
+    }
+
+    hostCacheInit();
+    now = midp_getCurrentTime();
+
+    entry = hostCacheFind(host);
+    if (entry == NULL) {
+        entry = &hostCache[0];
+        for (i = 0; i < HOST_CACHE_SIZE; i++) {
+            if (hostCache[i].name[0] == '\0' ||
+                    now >= hostCache[i].expires) {
+                entry = &hostCache[i];
+                break;
+            }
+
+            if (hostCache[i].lastUsed < entry->lastUsed) {
+                entry = &hostCache[i];
+            }
+        }
+
+        strcpy(entry->name, host);
+    }
+
+    if (len < 0) {
+        entry->len = -1;
+        entry->expires = now + hostCacheNegativeTtl;
+    } else {
+        memcpy(entry->ipBytes, ipBytes, len);
+        entry->len = len;
+        entry->expires = now + hostCacheTtl;
+    }
+
+    entry->lastUsed = now;
+}
+
+/**
+ * Remembers the host name of a lookup that has to be finished after
+ * the thread is unblocked, when the name is no longer at hand. If all
+ * slots are taken the result of the lookup is simply not cached.
+ *
+ * @param handle the handle the lookup is waited for with
+ * @param host the host name, or NULL to forget the name remembered
+ *             for the handle
+ */
+static void
+hostCacheSetPending(void* handle, const char* host) {
+    int i;
+
+    for (i = 0; i < HOST_CACHE_PENDING_SIZE; i++) {
+        if (hostCachePending[i].handle == handle) {
+            hostCachePending[i].handle = NULL;
+            break;
+        }
+    }
+
+    if (host == NULL || handle == NULL || strlen(host) >= MAX_HOST_LENGTH) {
+        return;
+    }
+
+    for (i = 0; i < HOST_CACHE_PENDING_SIZE; i++) {
+        if (hostCachePending[i].handle == NULL) {
+            hostCachePending[i].handle = handle;
+            strcpy(hostCachePending[i].name, host);
+            return;
+        }
+    }
+}
+
+/**
+ * Adds the result of a lookup started with hostCacheSetPending.
+ * Does nothing if no host name was remembered for the handle.
+ *
+ * @param handle the handle the lookup was waited for with
+ * @param ipBytes the address, ignored if <tt>len</tt> is negative
+ * @param len length of the address, negative if the name could not
+ *            be resolved
+ */
+static void
+hostCacheFinishPending(void* handle, const unsigned char* ipBytes, int len) {
+    int i;
+
+    for (i = 0; i < HOST_CACHE_PENDING_SIZE; i++) {
+        if (hostCachePending[i].handle == handle) {
+            hostCachePending[i].handle = NULL;
+            hostCacheAdd(hostCachePending[i].name, ipBytes, len);
+            return;
+        }
+    }
+}
+
+/**
+ * Starts resolving a host name, the same as
+ * <tt>pcsl_network_gethostbyname_start</tt>, but answers from the cache
+ * when it can and caches what the resolver returns.
+ *
+ * @param host the host name
+ * @param ipBytes receives the address
+ * @param maxLen size of <tt>ipBytes</tt>
+ * @param pLen receives the length of the address
+ * @param pHandle receives the handle to wait with on PCSL_NET_WOULDBLOCK
+ * @param pContext receives the context to wait with on PCSL_NET_WOULDBLOCK
+ *
+ * @return PCSL_NET_SUCCESS, PCSL_NET_WOULDBLOCK, or an error status
+ */
+int
+hostCacheResolveStart(const char* host, unsigned char* ipBytes, int maxLen,
+                      int* pLen, void** pHandle, void** pContext) {
+    int status;
+
+    if (host == NULL) {
+        return pcsl_network_gethostbyname_start((char*)host, ipBytes, maxLen,
+                                                pLen, pHandle, pContext);
+    }
+
+    switch (hostCacheLookup(host, ipBytes, maxLen, pLen)) {
+    case HOST_CACHE_HIT:
+        return PCSL_NET_SUCCESS;
+
+    case HOST_CACHE_NEGATIVE:
+        return PCSL_NET_IOERROR;
+    }
+
+    status = hostCacheResolver((char*)host, ipBytes, maxLen,
+                               pLen, pHandle, pContext);
+    if (status == PCSL_NET_SUCCESS) {
+        hostCacheAdd(host, ipBytes, *pLen);
+    } else if (status == PCSL_NET_WOULDBLOCK) {
+        hostCacheSetPending(*pHandle, host);
+    } else if (status == PCSL_NET_IOERROR) {
+        hostCacheAdd(host, NULL, -1);
+    }
+
+    return status;
+}
+
+/**
+ * Finishes resolving a host name after the thread is unblocked, the same
+ * as <tt>pcsl_network_gethostbyname_finish</tt>, and caches the result.
+ *
+ * @param ipBytes receives the address
+ * @param maxLen size of <tt>ipBytes</tt>
+ * @param pLen receives the length of the address
+ * @param handle the handle the lookup was waited for with
+ * @param context the context the lookup was waited for with
+ *
+ * @return PCSL_NET_SUCCESS, PCSL_NET_WOULDBLOCK, or an error status
+ */
+int
+hostCacheResolveFinish(unsigned char* ipBytes, int maxLen, int* pLen,
+                       void* handle, void* context) {
+    int status;
+
+    status = pcsl_network_gethostbyname_finish(ipBytes, maxLen, pLen,
+                                               handle, context);
+    if (status == PCSL_NET_SUCCESS) {
+        hostCacheFinishPending(handle, ipBytes, *pLen);
+    } else if (status == PCSL_NET_IOERROR) {
+        hostCacheFinishPending(handle, NULL, -1);
+    } else if (status != PCSL_NET_WOULDBLOCK) {
+        /* not a lookup result, only forget the name */
+        hostCacheSetPending(handle, NULL);
+    }
+
+    return status;
+}
+
+#if ENABLE_I3_TEST
+/**
+ * Resolver used by the i3test instead of the network. Names starting
+ * with "loopback" resolve to 127.0.0.1 at once, all other names fail.
+ *
+ * @param host the host name
+ * @param ipBytes receives the address
+ * @param maxLen size of <tt>ipBytes</tt>
+ * @param pLen receives the length of the address
+ * @param pHandle not used
+ * @param pContext not used
+ *
+ * @return PCSL_NET_SUCCESS or PCSL_NET_IOERROR
+ */
+static int
+hostCacheStubResolver(char* host, unsigned char* ipBytes, int maxLen,
+                      int* pLen, void** pHandle, void** pContext) {
+    (void)pHandle;
+    (void)pContext;
+
+    hostCacheStubCalls++;
+
+    if (strncmp(host, "loopback", 8) != 0 || maxLen < 4) {
+        return PCSL_NET_IOERROR;
+    }
+
+    ipBytes[0] = 127;
+    ipBytes[1] = 0;
+    ipBytes[2] = 0;
+    ipBytes[3] = 1;
+    *pLen = 4;
+    return PCSL_NET_SUCCESS;
+}
+
+/**
+ * Empties the cache and switches between the stub and the real
+ * resolver. With the real resolver the cache times are read from the
+ * configuration again.
+ * <p>
+ * Java declaration:
+ * <pre>
+ *     useStubResolver(ZII)V
+ * </pre>
+ *
+ * @param stub <tt>true</tt> to use the stub resolver
+ * @param ttl time in milliseconds a resolved address is kept
+ * @param negativeTtl time in milliseconds a failed lookup is kept
+ */
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_io_TestHostCache_useStubResolver(void) {
+    jboolean stub = KNI_GetParameterAsBoolean(1);
+
+    memset(hostCache, 0, sizeof (hostCache));
+    memset(hostCachePending, 0, sizeof (hostCachePending));
+    hostCacheStubCalls = 0;
+
+    if (stub) {
+        hostCacheResolver = hostCacheStubResolver;
+        hostCacheTtl = KNI_GetParameterAsInt(2);
+        hostCacheNegativeTtl = KNI_GetParameterAsInt(3);
+    } else {
+        hostCacheResolver = pcsl_network_gethostbyname_start;
+        hostCacheTtl = 0;
+        hostCacheNegativeTtl = 0;
+    }
+
+    KNI_ReturnVoid();
+}
+
+/**
+ * Resolves a host name through the cache.
+ * <p>
+ * Java declaration:
+ * <pre>
+ *     resolve(Ljava/lang/String;[B)I
+ * </pre>
+ *
+ * @param host the host name
+ * @param ipBytes receives the address
+ *
+ * @return length of the address, -1 if the name could not be resolved
+ */
+KNIEXPORT KNI_RETURNTYPE_INT
+Java_com_sun_midp_io_TestHostCache_resolve(void) {
+    int len = -1;
+    int status = PCSL_NET_INVALID;
+    unsigned char ipBytes[MAX_ADDR_LENGTH];
+    void* context = NULL;
+    void* pcslHandle = NULL;
+
+    KNI_StartHandles(2);
+    KNI_DeclareHandle(ipAddressObject);
+
+    KNI_GetParameterAsObject(2, ipAddressObject);
+
+    GET_PARAMETER_AS_PCSL_STRING(1, host)
+        const jbyte * const host_bytes = pcsl_string_get_utf8_data(&host);
+        status = hostCacheResolveStart((const char*)host_bytes,
+                                       ipBytes, MAX_ADDR_LENGTH, &len,
+                                       &pcslHandle, &context);
+
+        pcsl_string_release_utf8_data(host_bytes, &host);
+    RELEASE_PCSL_STRING_PARAMETER
+
+    if (status == PCSL_NET_SUCCESS &&
+            len <= (int)KNI_GetArrayLength(ipAddressObject)) {
+        KNI_SetRawArrayRegion(ipAddressObject, 0, len, (jbyte *)ipBytes);
+    } else {
+        len = -1;
+    }
+
+    KNI_EndHandles();
+    KNI_ReturnInt((jint)len);
+}
+
+/**
+ * Gets the number of lookups the stub resolver was asked for.
+ * <p>
+ * Java declaration:
+ * <pre>
+ *     getResolverCalls()I
+ * </pre>
+ *
+ * @return number of lookups since useStubResolver was called
+ */
+KNIEXPORT KNI_RETURNTYPE_INT
+Java_com_sun_midp_io_TestHostCache_getResolverCalls(void) {
+    KNI_ReturnInt((jint)hostCacheStubCalls);
+}
+#endif /* ENABLE_I3_TEST */
@@ -0,0 +1,436 @@
+/*
+ *   
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+package com.sun.midp.io.j2me.http;
+
+import java.io.InputStream;
+import java.io.IOException;
+
+/**
+ * Decodes an HTTP response body sent with the gzip or deflate content
+ * coding (RFC 2616, section 3.5) as it is read. The body is inflated
+ * a buffer at a time, so it is never held in memory as a whole, and
+ * its check sum is verified when its end is reached.
+ * <p>
+ * Once decoding has failed the stream stays failed: every later read
+ * throws an IOException rather than returning a truncated body.
+ */
+final class ContentDecoder extends InputStream {
+    /** Value of the Accept-Encoding field listing the supported codings. */
+    static final String ACCEPT_ENCODING = "gzip, deflate";
+
+    /** Flag of a gzip header telling that a header CRC follows. */
+    private static final int GZIP_FHCRC = 2;
+    /** Flag of a gzip header telling that an extra field follows. */
+    private static final int GZIP_FEXTRA = 4;
+    /** Flag of a gzip header telling that a file name follows. */
+    private static final int GZIP_FNAME = 8;
+    /** Flag of a gzip header telling that a comment follows. */
+    private static final int GZIP_FCOMMENT = 16;
+    /** Flags of a gzip header that are reserved. */
+    private static final int GZIP_RESERVED = 0xe0;
+
+    /** Largest prime below 65536, the modulus of ADLER32. */
+    private static final int ADLER_BASE = 65521;
+
+    /** CRC-32 of each byte value, built on first use. */
+    private static int[] crcTable;
+
+    /** Inflates the deflate data of the encoded body. */
+    private Inflater inflater;
+    /** True if the body is gzip, false if it is deflate. */
+    private boolean gzip;
+    /** True if the deflate body is a zlib stream, not raw deflate. */
+    private boolean zlib;
+    /** True once the header of the body has been read. */
+    private boolean started;
+    /** True once the end of the body has been reached. */
+    private boolean finished;
+    /** Why decoding failed, null if it did not. */
+    private String failure;
+
+    /** CRC-32 of the decoded data of the current gzip member. */
+    private int crc;
+    /** Length of the decoded data of the current gzip member. */
+    private int size;
+    /** Low half of the ADLER32 of the decoded zlib data. */
+    private int adlerA;
+    /** High half of the ADLER32 of the decoded zlib data. */
+    private int adlerB;
+
+    /** Buffer of the single byte read. */
+    private byte[] oneByte = new byte[1];
+
+    /**
+     * Creates a decoder.
+     *
+     * @param coding value of the Content-Encoding field, one of the
+     *               supported codings
+     * @param in stream to read the encoded body from
+     */
+    ContentDecoder(String coding, InputStream in) {
+        gzip = !coding.equalsIgnoreCase("deflate");
+        inflater = new Inflater(in);
+    }
+
+    /**
+     * Tells if a content coding can be decoded.
+     *
+     * @param coding value of the Content-Encoding field
+     * @return true if the coding is gzip or deflate
+     */
+    static boolean isSupported(String coding) {
+        return coding.equalsIgnoreCase("gzip") ||
+            coding.equalsIgnoreCase("x-gzip") ||
+            coding.equalsIgnoreCase("deflate");
+    }
+
+    /**
+     * Reads the next byte of the decoded body.
+     *
+     * @return the byte, or -1 at the end of the body
+     * @exception IOException if the body cannot be read or decoded
+     */
+    public int read() throws IOException {
+        if (read(oneByte, 0, 1) < 0) {
+            return -1;
+        }
+
+        return oneByte[0] & 0xff;
+    }
+
+    /**
+     * Reads decoded data of the body. Blocks until some data has been
+     * decoded, but returns what is decoded without waiting for more of
+     * the body to arrive.
+     *
+     * @param b buffer for the data
+     * @param off offset in <code>b</code> to store the data at
+     * @param len maximum number of bytes to read
+     * @return number of bytes read, or -1 at the end of the body
+     * @exception IOException if the body cannot be read or decoded
+     */
+    public int read(byte[] b, int off, int len) throws IOException {
+        if (failure != null) {
+            throw new IOException(failure);
+        }
+
+        if (off < 0 || len < 0 || off + len > b.length) {
+            throw new IndexOutOfBoundsException();
+        }
+
+        if (len == 0) {
+            return 0;
+        }
+
+        try {
+            return decode(b, off, len);
+        } catch (IOException e) {
+            failure = e.getMessage();
+            if (failure == null) {
+                failure = "invalid encoded content";
+            }
+
+            throw e;
+        }
+    }
+
+    /**
+     * Decodes data into a buffer, reading the header and trailer of the
+     * body as they are reached.
+     *
+     * @param b buffer for the data
+     * @param off offset in <code>b</code> to store the data at
+     * @param len maximum number of bytes to read, at least 1
+     * @return number of bytes read, or -1 at the end of the body
+     * @exception IOException if the body cannot be read or decoded
+     */
+    private int decode(byte[] b, int off, int len) throws IOException {
+        int count;
+
+        if (finished) {
+            return -1;
+        }
+
+        if (!started) {
+            readHeader();
+            started = true;
+        }
+
+        for (;;) {
+            count = inflater.inflate(b, off, len);
+            if (count >= 0) {
+                break;
+            }
+
+            readTrailer();
+
+            if (!gzip || inflater.peekByte(0) != 0x1f) {
+                /*
+                 * Skip what follows the encoded data, so that the
+                 * connection is left at the end of the body.
+                 */
+                while (inflater.readByte() >= 0) {
+                    /* not part of the encoded data */
+                }
+
+                finished = true;
+                return -1;
+            }
+
+            /* a gzip body can hold several members, one after the other */
+            inflater.reset();
+            readHeader();
+        }
+
+        if (gzip) {
+            updateCrc(b, off, count);
+            size += count;
+        } else if (zlib) {
+            updateAdler(b, off, count);
+        }
+
+        return count;
+    }
+
+    /**
+     * Reads the header of a gzip member, or of a zlib stream. Deflate
+     * content should be a zlib stream, but raw deflate data is accepted
+     * as well, since some servers send that.
+     *
+     * @exception IOException if the header is not valid
+     */
+    private void readHeader() throws IOException {
+        int flags;
+
+        if (!gzip) {
+            int cmf = inflater.peekByte(0);
+            int flg = inflater.peekByte(1);
+
+            /*
+             * CM 8, a window of at most 32 KB, no preset dictionary and
+             * a valid check sum
+             */
+            if (cmf >= 0 && flg >= 0 && (cmf & 0x0f) == 8 &&
+                    (cmf >> 4) <= 7 && (flg & 0x20) == 0 &&
+                    ((cmf << 8) | flg) % 31 == 0) {
+                inflater.readByte();
+                inflater.readByte();
+                zlib = true;
+                adlerA = 1;
+                adlerB = 0;
+            }
+
+            return;
+        }
+
+        if (readHeaderByte() != 0x1f || readHeaderByte() != 0x8b ||
+                readHeaderByte() != 8) {
+            throw new IOException("invalid gzip content");
+        }
+
+        flags = readHeaderByte();
+        if ((flags & GZIP_RESERVED) != 0) {
+            throw new IOException("invalid gzip content");
+        }
+
+        /* MTIME, XFL and OS */
+        skipHeaderBytes(6);
+
+        if ((flags & GZIP_FEXTRA) != 0) {
+            skipHeaderBytes(readHeaderByte() | (readHeaderByte() << 8));
+        }
+
+        if ((flags & GZIP_FNAME) != 0) {
+            skipZeroTerminated();
+        }
+
+        if ((flags & GZIP_FCOMMENT) != 0) {
+            skipZeroTerminated();
+        }
+
+        if ((flags & GZIP_FHCRC) != 0) {
+            skipHeaderBytes(2);
+        }
+
+        crc = 0xffffffff;
+        size = 0;
+    }
+
+    /**
+     * Reads the trailer that follows the deflate data and checks the
+     * decoded data against it: the CRC-32 and length of a gzip member,
+     * or the ADLER32 of a zlib stream.
+     *
+     * @exception IOException if the decoded data does not match
+     */
+    private void readTrailer() throws IOException {
+        if (gzip) {
+            if (readTrailerIntLE() != ~crc || readTrailerIntLE() != size) {
+                throw new IOException("invalid gzip content");
+            }
+        } else if (zlib) {
+            int adler = (readTrailerByte() << 24) | (readTrailerByte() << 16) |
+                        (readTrailerByte() << 8) | readTrailerByte();
+
+            if (adler != ((adlerB << 16) | adlerA)) {
+                throw new IOException("invalid deflate content");
+            }
+        }
+    }
+
+    /**
+     * Reads a byte of a gzip header.
+     *
+     * @return the byte
+     * @exception IOException if the body ends first
+     */
+    private int readHeaderByte() throws IOException {
+        int c = inflater.readByte();
+
+        if (c < 0) {
+            throw new IOException("invalid gzip content");
+        }
+
+        return c;
+    }
+
+    /**
+     * Skips bytes of a gzip header.
+     *
+     * @param count number of bytes to skip
+     * @exception IOException if the body ends first
+     */
+    private void skipHeaderBytes(int count) throws IOException {
+        while (count-- > 0) {
+            readHeaderByte();
+        }
+    }
+
+    /**
+     * Skips a zero terminated string of a gzip header.
+     *
+     * @exception IOException if the body ends first
+     */
+    private void skipZeroTerminated() throws IOException {
+        while (readHeaderByte() != 0) {
+            /* skip the character */
+        }
+    }
+
+    /**
+     * Reads a byte of the trailer.
+     *
+     * @return the byte
+     * @exception IOException if the body ends first
+     */
+    private int readTrailerByte() throws IOException {
+        int c = inflater.readByte();
+
+        if (c < 0) {
+            throw new IOException("truncated encoded content");
+        }
+
+        return c;
+    }
+
+    /**
+     * Reads a four byte integer of a gzip trailer, stored least
+     * significant byte first.
+     *
+     * @return the integer
+     * @exception IOException if the body ends first
+     */
+    private int readTrailerIntLE() throws IOException {
+        return readTrailerByte() | (readTrailerByte() << 8) |
+               (readTrailerByte() << 16) | (readTrailerByte() << 24);
+    }
+
+    /**
+     * Adds decoded data to the CRC-32 that gzip records for it
+     * (ISO 3309).
+     *
+     * @param b buffer holding the data
+     * @param off offset of the data in <code>b</code>
+     * @param len length of the data
+     */
+    private void updateCrc(byte[] b, int off, int len) {
+        int[] table = crcTable;
+        int c = crc;
+
+        if (table == null) {
+            table = new int[256];
+
+            for (int n = 0; n < 256; n++) {
+                int k = n;
+
+                for (int i = 0; i < 8; i++) {
+                    k = (k & 1) != 0 ? 0xedb88320 ^ (k >>> 1) : k >>> 1;
+                }
+
+                table[n] = k;
+            }
+
+            crcTable = table;
+        }
+
+        for (int i = off; i < off + len; i++) {
+            c = table[(c ^ b[i]) & 0xff] ^ (c >>> 8);
+        }
+
+        crc = c;
+    }
+
+    /**
+     * Adds decoded data to the ADLER32 check sum that zlib records for
+     * it.
+     *
+     * @param b buffer holding the data
+     * @param off offset of the data in <code>b</code>
+     * @param len length of the data
+     */
+    private void updateAdler(byte[] b, int off, int len) {
+        int a = adlerA;
+        int s = adlerB;
+
+        while (len > 0) {
+            /* 3854 bytes can be summed before the sums can overflow */
+            int count = len < 3854 ? len : 3854;
+
+            len -= count;
+            while (count-- > 0) {
+                a += b[off++] & 0xff;
+                s += a;
+            }
+
+            a %= ADLER_BASE;
+            s %= ADLER_BASE;
+        }
+
+        adlerA = a;
+        adlerB = s;
+    }
+}
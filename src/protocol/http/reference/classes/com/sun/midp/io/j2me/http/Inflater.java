@@ -0,0 +1,706 @@
+/*
+ *   
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+package com.sun.midp.io.j2me.http;
+
+import java.io.InputStream;
+import java.io.IOException;
+
+/**
+ * Inflates raw deflate data (RFC 1951) as it is read from a stream.
+ * Only as much compressed data is read as is needed for the output
+ * asked for, and the memory used does not depend on the size of the
+ * data: besides the code tables it is the 32 KB window that back
+ * references are copied from.
+ */
+final class Inflater {
+    /** Size of the window of previous output, the largest distance. */
+    private static final int WINDOW_SIZE = 32768;
+
+    /** Longest Huffman code. */
+    private static final int MAX_BITS = 15;
+
+    /** Length of the codes that are decoded with one table lookup. */
+    private static final int FAST_BITS = 9;
+
+    /** A new block header has to be read. */
+    private static final int MODE_HEADER = 0;
+    /** Inside a stored block. */
+    private static final int MODE_STORED = 1;
+    /** Inside a block compressed with Huffman codes. */
+    private static final int MODE_HUFFMAN = 2;
+    /** The last block has been inflated. */
+    private static final int MODE_DONE = 3;
+
+    /** Base of each length code 257..285. */
+    private static final short[] LENGTH_BASE = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+
+    /** Number of extra bits of each length code. */
+    private static final byte[] LENGTH_EXTRA = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+        3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+    };
+
+    /** Base of each distance code. */
+    private static final short[] DIST_BASE = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+        8193, 12289, 16385, 24577
+    };
+
+    /** Number of extra bits of each distance code. */
+    private static final byte[] DIST_EXTRA = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+        7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+    };
+
+    /** Order in which the code length code lengths are sent. */
+    private static final byte[] CODE_LENGTH_ORDER = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
+
+    /** Literal/length codes of the fixed Huffman blocks, built on use. */
+    private static Huffman fixedLiterals;
+    /** Distance codes of the fixed Huffman blocks, built on use. */
+    private static Huffman fixedDistances;
+
+    /** Stream the compressed data is read from. */
+    private InputStream in;
+    /** Compressed data read ahead from the stream. */
+    private byte[] inBuf = new byte[512];
+    /** Offset of the next byte of <code>inBuf</code> to use. */
+    private int inPos;
+    /** Number of valid bytes in <code>inBuf</code>. */
+    private int inLen;
+
+    /** Bits read from the input and not used yet, lowest bit first. */
+    private int bitBuf;
+    /** Number of valid bits in <code>bitBuf</code>. */
+    private int bitCount;
+
+    /** What is being inflated, one of the MODE_ constants. */
+    private int mode;
+    /** True if the current block is the last one. */
+    private boolean lastBlock;
+    /** Bytes left in the current stored block. */
+    private int storedLeft;
+    /** Literal/length codes of the current block. */
+    private Huffman literals;
+    /** Distance codes of the current block. */
+    private Huffman distances;
+
+    /** Previous output, the source of back references. */
+    private byte[] window = new byte[WINDOW_SIZE];
+    /** Position in the window of the next output byte. */
+    private int windowPos;
+    /** Number of valid bytes in the window. */
+    private int windowFill;
+    /** Bytes left to copy of the current back reference. */
+    private int copyLen;
+    /** Distance of the current back reference. */
+    private int copyDist;
+
+    /**
+     * Creates an inflater.
+     *
+     * @param in stream to read the compressed data from
+     */
+    Inflater(InputStream in) {
+        this.in = in;
+    }
+
+    /**
+     * Prepares for inflating another deflate stream that follows the
+     * current one in the input.
+     */
+    void reset() {
+        mode = MODE_HEADER;
+        lastBlock = false;
+        windowFill = 0;
+        copyLen = 0;
+    }
+
+    /**
+     * Inflates data into a buffer. Blocks until at least one byte has
+     * been inflated or the end of the deflate data is reached, but not
+     * for more input once some bytes have been inflated.
+     *
+     * @param b buffer for the inflated data
+     * @param off offset in <code>b</code> to store the data at
+     * @param len maximum number of bytes to inflate, at least 1
+     * @return number of bytes inflated, -1 after the last block
+     * @exception IOException if the compressed data is invalid or
+     *            truncated, or cannot be read
+     */
+    int inflate(byte[] b, int off, int len) throws IOException {
+        int n = 0;
+
+        while (n < len) {
+            if (n > 0 && copyLen == 0 && inPos == inLen) {
+                /* return what is ready rather than wait for more input */
+                break;
+            }
+
+            if (copyLen > 0) {
+                int count = copyLen < len - n ? copyLen : len - n;
+                int from = (windowPos - copyDist) & (WINDOW_SIZE - 1);
+
+                copyLen -= count;
+                while (count-- > 0) {
+                    byte c = window[from];
+
+                    from = (from + 1) & (WINDOW_SIZE - 1);
+                    window[windowPos] = c;
+                    windowPos = (windowPos + 1) & (WINDOW_SIZE - 1);
+                    b[off + n++] = c;
+                }
+
+                continue;
+            }
+
+            if (mode == MODE_HUFFMAN) {
+                int symbol = literals.decode(this);
+
+                if (symbol < 256) {
+                    putByte((byte)symbol);
+                    b[off + n++] = (byte)symbol;
+                } else if (symbol == 256) {
+                    endBlock();
+                } else {
+                    readBackReference(symbol);
+                }
+            } else if (mode == MODE_STORED) {
+                if (storedLeft == 0) {
+                    endBlock();
+                } else {
+                    int count = readStored(b, off + n,
+                        storedLeft < len - n ? storedLeft : len - n);
+
+                    storedLeft -= count;
+                    n += count;
+                }
+            } else if (mode == MODE_HEADER) {
+                readBlockHeader();
+            } else {
+                break;
+            }
+
+        }
+
+        if (n == 0 && mode == MODE_DONE) {
+            return -1;
+        }
+
+        return n;
+    }
+
+    /**
+     * Reads a byte that follows the deflate data, or precedes it, such
+     * as a header or trailer byte.
+     *
+     * @return the byte, or -1 at the end of the input
+     * @exception IOException if the input cannot be read
+     */
+    int readByte() throws IOException {
+        if (bitCount >= 8) {
+            int c = bitBuf & 0xff;
+
+            bitBuf >>>= 8;
+            bitCount -= 8;
+            return c;
+        }
+
+        return nextInputByte();
+    }
+
+    /**
+     * Looks at a byte ahead of the deflate data without reading it.
+     *
+     * @param index index of the byte from the current position
+     * @return the byte, or -1 if the input ends before it
+     * @exception IOException if the input cannot be read
+     */
+    int peekByte(int index) throws IOException {
+        while (inLen - inPos <= index) {
+            int count;
+
+            if (inPos > 0) {
+                System.arraycopy(inBuf, inPos, inBuf, 0, inLen - inPos);
+                inLen -= inPos;
+                inPos = 0;
+            }
+
+            count = in.read(inBuf, inLen, inBuf.length - inLen);
+            if (count <= 0) {
+                return -1;
+            }
+
+            inLen += count;
+        }
+
+        return inBuf[inPos + index] & 0xff;
+    }
+
+    /**
+     * Reads the next byte of the input.
+     *
+     * @return the byte, or -1 at the end of the input
+     * @exception IOException if the input cannot be read
+     */
+    private int nextInputByte() throws IOException {
+        if (inPos == inLen) {
+            inPos = 0;
+            inLen = in.read(inBuf, 0, inBuf.length);
+            if (inLen <= 0) {
+                inLen = 0;
+                return -1;
+            }
+        }
+
+        return inBuf[inPos++] & 0xff;
+    }
+
+    /**
+     * Makes sure the bit buffer holds a number of bits.
+     *
+     * @param count number of bits needed, at most 24
+     * @exception IOException if the input ends first
+     */
+    private void needBits(int count) throws IOException {
+        while (bitCount < count) {
+            int c = nextInputByte();
+
+            if (c < 0) {
+                throw new IOException("truncated deflate content");
+            }
+
+            bitBuf |= c << bitCount;
+            bitCount += 8;
+        }
+    }
+
+    /**
+     * Fills the bit buffer up to a number of bits, as far as the input
+     * goes.
+     *
+     * @param count number of bits wanted, at most 24
+     * @return number of bits in the buffer
+     * @exception IOException if the input cannot be read
+     */
+    int peekBits(int count) throws IOException {
+        while (bitCount < count) {
+            int c = nextInputByte();
+
+            if (c < 0) {
+                break;
+            }
+
+            bitBuf |= c << bitCount;
+            bitCount += 8;
+        }
+
+        return bitCount;
+    }
+
+    /**
+     * Gets the bits in the bit buffer, lowest first.
+     *
+     * @return the bit buffer
+     */
+    int getBitBuffer() {
+        return bitBuf;
+    }
+
+    /**
+     * Drops bits from the bit buffer.
+     *
+     * @param count number of bits to drop
+     */
+    void dropBits(int count) {
+        bitBuf >>>= count;
+        bitCount -= count;
+    }
+
+    /**
+     * Reads bits from the input.
+     *
+     * @param count number of bits to read, at most 24
+     * @return the bits, the first one read in the lowest bit
+     * @exception IOException if the input ends first
+     */
+    int readBits(int count) throws IOException {
+        int bits;
+
+        needBits(count);
+        bits = bitBuf & ((1 << count) - 1);
+        bitBuf >>>= count;
+        bitCount -= count;
+        return bits;
+    }
+
+    /**
+     * Stores an output byte in the window.
+     *
+     * @param c the byte
+     */
+    private void putByte(byte c) {
+        window[windowPos] = c;
+        windowPos = (windowPos + 1) & (WINDOW_SIZE - 1);
+        if (windowFill < WINDOW_SIZE) {
+            windowFill++;
+        }
+    }
+
+    /**
+     * Ends the current block. After the last block the rest of the
+     * current byte is skipped, so that what follows can be read with
+     * <code>readByte</code>.
+     */
+    private void endBlock() {
+        if (lastBlock) {
+            dropBits(bitCount & 7);
+            mode = MODE_DONE;
+        } else {
+            mode = MODE_HEADER;
+        }
+    }
+
+    /**
+     * Reads the length and distance of a back reference and sets it up
+     * to be copied.
+     *
+     * @param symbol the length code, 257..285
+     * @exception IOException if the data is invalid or truncated
+     */
+    private void readBackReference(int symbol) throws IOException {
+        int length;
+        int dist;
+
+        symbol -= 257;
+        if (symbol >= LENGTH_BASE.length) {
+            throw new IOException("invalid deflate content");
+        }
+
+        length = LENGTH_BASE[symbol] + readBits(LENGTH_EXTRA[symbol]);
+
+        symbol = distances.decode(this);
+        if (symbol >= DIST_BASE.length) {
+            throw new IOException("invalid deflate content");
+        }
+
+        dist = DIST_BASE[symbol] + readBits(DIST_EXTRA[symbol]);
+        if (dist > windowFill) {
+            throw new IOException("invalid deflate content");
+        }
+
+        windowFill += length;
+        if (windowFill > WINDOW_SIZE) {
+            windowFill = WINDOW_SIZE;
+        }
+
+        copyLen = length;
+        copyDist = dist;
+    }
+
+    /**
+     * Copies data of a stored block.
+     *
+     * @param b buffer for the data
+     * @param off offset in <code>b</code> to store the data at
+     * @param len number of bytes to copy, at least 1
+     * @return number of bytes copied
+     * @exception IOException if the data is truncated
+     */
+    private int readStored(byte[] b, int off, int len) throws IOException {
+        int count;
+
+        if (bitCount >= 8 || inPos == inLen) {
+            /* whole bytes left in the bit buffer, or nothing buffered */
+            int c = readByte();
+
+            if (c < 0) {
+                throw new IOException("truncated deflate content");
+            }
+
+            b[off] = (byte)c;
+            putByte((byte)c);
+            return 1;
+        }
+
+        count = inLen - inPos < len ? inLen - inPos : len;
+        System.arraycopy(inBuf, inPos, b, off, count);
+        inPos += count;
+
+        for (int i = 0; i < count; i++) {
+            putByte(b[off + i]);
+        }
+
+        return count;
+    }
+
+    /**
+     * Reads the header of the next block.
+     *
+     * @exception IOException if the data is invalid or truncated
+     */
+    private void readBlockHeader() throws IOException {
+        int type;
+
+        lastBlock = readBits(1) != 0;
+        type = readBits(2);
+
+        if (type == 0) {
+            int len;
+
+            dropBits(bitCount & 7);
+            len = readBits(16);
+            if ((readBits(16) ^ 0xffff) != len) {
+                throw new IOException("invalid deflate content");
+            }
+
+            storedLeft = len;
+            mode = MODE_STORED;
+        } else if (type == 1) {
+            if (fixedLiterals == null) {
+                byte[] lengths = new byte[288];
+                Huffman fixed;
+                int i;
+
+                for (i = 0; i < 144; i++) {
+                    lengths[i] = 8;
+                }
+
+                for (; i < 256; i++) {
+                    lengths[i] = 9;
+                }
+
+                for (; i < 280; i++) {
+                    lengths[i] = 7;
+                }
+
+                for (; i < 288; i++) {
+                    lengths[i] = 8;
+                }
+
+                fixed = new Huffman(lengths, 0, 288);
+
+                for (i = 0; i < 30; i++) {
+                    lengths[i] = 5;
+                }
+
+                /* set last, another thread may be checking it */
+                fixedDistances = new Huffman(lengths, 0, 30);
+                fixedLiterals = fixed;
+            }
+
+            literals = fixedLiterals;
+            distances = fixedDistances;
+            mode = MODE_HUFFMAN;
+        } else if (type == 2) {
+            readDynamicCodes();
+            mode = MODE_HUFFMAN;
+        } else {
+            throw new IOException("invalid deflate content");
+        }
+    }
+
+    /**
+     * Reads the Huffman codes of a block with dynamic codes.
+     *
+     * @exception IOException if the data is invalid or truncated
+     */
+    private void readDynamicCodes() throws IOException {
+        int numLiterals = readBits(5) + 257;
+        int numDistances = readBits(5) + 1;
+        int numCodeLengths = readBits(4) + 4;
+        byte[] lengths = new byte[numLiterals + numDistances];
+        Huffman codeLengths;
+        int i;
+
+        if (numLiterals > 286 || numDistances > 30) {
+            throw new IOException("invalid deflate content");
+        }
+
+        for (i = 0; i < numCodeLengths; i++) {
+            lengths[CODE_LENGTH_ORDER[i]] = (byte)readBits(3);
+        }
+
+        codeLengths = new Huffman(lengths, 0, 19);
+
+        for (i = 0; i < 19; i++) {
+            lengths[i] = 0;
+        }
+
+        i = 0;
+        while (i < lengths.length) {
+            int symbol = codeLengths.decode(this);
+            int repeat;
+            byte value = 0;
+
+            if (symbol < 16) {
+                lengths[i++] = (byte)symbol;
+                continue;
+            }
+
+            if (symbol == 16) {
+                if (i == 0) {
+                    throw new IOException("invalid deflate content");
+                }
+
+                value = lengths[i - 1];
+                repeat = 3 + readBits(2);
+            } else if (symbol == 17) {
+                repeat = 3 + readBits(3);
+            } else {
+                repeat = 11 + readBits(7);
+            }
+
+            if (i + repeat > lengths.length) {
+                throw new IOException("invalid deflate content");
+            }
+
+            while (repeat-- > 0) {
+                lengths[i++] = value;
+            }
+        }
+
+        if (lengths[256] == 0) {
+            /* there must be an end of block code */
+            throw new IOException("invalid deflate content");
+        }
+
+        literals = new Huffman(lengths, 0, numLiterals);
+        distances = new Huffman(lengths, numLiterals, numDistances);
+    }
+
+    /**
+     * A canonical Huffman code. Codes up to <code>FAST_BITS</code> long
+     * are decoded with one table lookup, longer ones bit by bit.
+     */
+    private static final class Huffman {
+        /** Number of codes of each length. */
+        private short[] count = new short[MAX_BITS + 1];
+        /** Symbols ordered by code. */
+        private short[] symbols;
+        /**
+         * Symbol and code length of each <code>FAST_BITS</code> bit
+         * pattern, <code>(symbol << 4) | length</code>, or 0 if the
+         * code is longer.
+         */
+        private int[] fast = new int[1 << FAST_BITS];
+
+        /**
+         * Builds the code from the code lengths of its symbols.
+         *
+         * @param lengths code length of each symbol, 0 if not used
+         * @param off offset of the first symbol in <code>lengths</code>
+         * @param num number of symbols
+         * @exception IOException if the lengths do not form a code
+         */
+        Huffman(byte[] lengths, int off, int num) throws IOException {
+            short[] offsets = new short[MAX_BITS + 2];
+            int left = 1;
+            int code = 0;
+
+            symbols = new short[num];
+
+            for (int i = 0; i < num; i++) {
+                count[lengths[off + i]]++;
+            }
+
+            for (int len = 1; len <= MAX_BITS; len++) {
+                left = (left << 1) - count[len];
+                if (left < 0) {
+                    throw new IOException("invalid deflate content");
+                }
+            }
+
+            for (int len = 1; len <= MAX_BITS; len++) {
+                offsets[len + 1] = (short)(offsets[len] + count[len]);
+            }
+
+            for (int i = 0; i < num; i++) {
+                if (lengths[off + i] != 0) {
+                    symbols[offsets[lengths[off + i]]++] = (short)i;
+                }
+            }
+
+            /* the table of short codes, indexed by the code bits reversed */
+            for (int len = 1, index = 0; len <= FAST_BITS; len++) {
+                for (int i = 0; i < count[len]; i++, code++, index++) {
+                    int reversed = 0;
+
+                    for (int bit = 0; bit < len; bit++) {
+                        reversed |= ((code >> bit) & 1) << (len - 1 - bit);
+                    }
+
+                    for (int j = reversed; j < fast.length; j += 1 << len) {
+                        fast[j] = (symbols[index] << 4) | len;
+                    }
+                }
+
+                code <<= 1;
+            }
+        }
+
+        /**
+         * Decodes the next symbol.
+         *
+         * @param inflater the inflater to read the bits from
+         * @return the symbol
+         * @exception IOException if the data is invalid or truncated
+         */
+        int decode(Inflater inflater) throws IOException {
+            int available = inflater.peekBits(FAST_BITS);
+            int entry = fast[inflater.getBitBuffer() & ((1 << FAST_BITS) - 1)];
+            int code = 0;
+            int first = 0;
+            int index = 0;
+
+            if (entry != 0 && (entry & 0xf) <= available) {
+                inflater.dropBits(entry & 0xf);
+                return entry >> 4;
+            }
+
+            for (int len = 1; len <= MAX_BITS; len++) {
+                code |= inflater.readBits(1);
+                if (code - count[len] < first) {
+                    return symbols[index + (code - first)];
+                }
+
+                index += count[len];
+                first += count[len];
+                first <<= 1;
+                code <<= 1;
+            }
+
+            throw new IOException("invalid deflate content");
+        }
+    }
+}
@@ -117,6 +117,8 @@ public class Protocol extends ConnectionBaseAdapter
 
     /** Default size for input buffer. */
     private static int inputBufferSize = 256;
+    /** Size of the buffer status, header and chunk size lines are read in. */
+    private static final int SCAN_BUFFER_SIZE = 512;
     /** Default size for output buffer. */
     private static int outputBufferSize = 2048;
     /** How much data can be put in the output buffer. */
@@ -133,6 +135,8 @@ public class Protocol extends ConnectionBaseAdapter
     protected static StreamConnectionPool connectionPool; 
     /** True if com.sun.midp.io.http.force_non_persistent = true. */
     private static boolean nonPersistentFlag;
+    /** False if com.sun.midp.io.http.decode_content = false. */
+    private static boolean decodeContentFlag = true;
     /**
      * The methods other than openPrim need to know that the
      * permission occurred. com.sun.midp.io.j2me.https.Protocol
@@ -172,6 +176,15 @@ public class Protocol extends ConnectionBaseAdapter
             nonPersistentFlag = true;
         }
 
+        /*
+         * Compressed responses are asked for and decoded as they are read
+         * unless this is turned off.
+         */
+        flag = Configuration.getProperty("com.sun.midp.io.http.decode_content");
+        if ((flag != null) && (flag.equals("false"))) {
+            decodeContentFlag = false;
+        }
+
         /*
          * Get the  maximum number of persistent connections
          * from the configuration file if there is one.
@@ -281,6 +294,25 @@ public class Protocol extends ConnectionBaseAdapter
     private int bytesleft;
     /** Number of bytes read from the internal input stream buffer. */ 
     private int bytesread;     
+    /**
+     * Buffer that status, header and chunk size lines are scanned in.
+     * It is filled from the stream in bulk; body reads take the bytes
+     * left in it before reading the stream again.
+     */
+    private byte[] scanbuf;
+    /** Offset of the first unconsumed byte in the scan buffer. */
+    private int scanpos;
+    /** Offset just past the last valid byte in the scan buffer. */
+    private int scanend;
+    /** The stream whose bytes are in the scan buffer. */
+    private InputStream scanStream;
+    /** Characters of a line being converted from the scan buffer. */
+    private char[] scanchars;
+    /**
+     * True if readChunkSizeNonBlocking has consumed the CRLF that ends
+     * the current chunk but not yet the next chunk size.
+     */
+    private boolean chunkCRLFSkipped;
     /** Buffered data output for content length calculation. */
     private byte[] writebuf;         
     /** Number of bytes of data that need to be written from the buffer. */
@@ -296,6 +328,13 @@ public class Protocol extends ConnectionBaseAdapter
      * pool, forcing an IOException on the read thread.
      */
     private boolean readInProgress;
+    /**
+     * True if the request asked for compressed content on its own, so
+     * that the response body is decoded before the application sees it.
+     */
+    private boolean acceptEncodingAdded;
+    /** Decoder of the response body, null if it was not encoded. */
+    private ContentDecoder contentDecoder;
 
     /**
      * Create a new instance of this class and intialize variables.
@@ -316,6 +355,8 @@ public class Protocol extends ConnectionBaseAdapter
         }
 
         readbuf = new byte[inputBufferSize];
+        scanbuf = new byte[SCAN_BUFFER_SIZE];
+        scanchars = new char[SCAN_BUFFER_SIZE];
     }
 
     /**
@@ -511,8 +552,32 @@ public class Protocol extends ConnectionBaseAdapter
     protected int readBytes(byte b[], int off, int len)
         throws IOException {
 
+        if (contentDecoder != null) {
+            /* the decoder reads the encoded body with readBodyBytes */
+            return contentDecoder.read(b, off, len);
+        }
+
+        return readBodyBytes(b, off, len);
+    }
+
+    /**
+     * Reads up to <code>len</code> bytes of the response body as it was
+     * received, without decoding it.
+     *
+     * @param      b     the buffer into which the data is read.
+     * @param      off   the start offset in array <code>b</code>
+     *                   at which the data is written.
+     * @param      len   the maximum number of bytes to read.
+     * @return     the total number of bytes read into the buffer, or
+     *             <code>-1</code> if there is no more data because the end of
+     *             the stream has been reached.
+     * @exception  IOException  if an I/O error occurs.
+     */
+    private int readBodyBytes(byte b[], int off, int len)
+        throws IOException {
+
         int rc;
-        
+
         /*
          * Be consistent about returning EOF once encountered.
          */
@@ -553,9 +618,9 @@ public class Protocol extends ConnectionBaseAdapter
                     /*
                      * No need to buffer, if the caller has given a big buffer.
                      */
-                    rc = streamInput.read(b, off, len);
+                    rc = readStream(streamInput, b, off, len);
                 } else {
-                    rc = streamInput.read(readbuf, 0, inputBufferSize);
+                    rc = readStream(streamInput, readbuf, 0, inputBufferSize);
                     bytesleft = rc;
                     bytesread = 0;
                 }
@@ -641,7 +706,12 @@ public class Protocol extends ConnectionBaseAdapter
          * Only after all the headers have been processed can
          * an accurate available count be provided.
          */
-        if (!requestFinished || eof) {
+        if (!requestFinished || contentDecoder != null) {
+            /* an encoded body cannot be decoded without blocking */
+            return 0;
+        }
+
+        if (eof) {
             return 0;
         }
 
@@ -665,7 +735,7 @@ public class Protocol extends ConnectionBaseAdapter
          * Otherwise rely on the lower level stream available
          * count for the nonchunked input stream.
          */
-        bytesAvailable =  streamInput.available();
+        bytesAvailable = scannedBytes(streamInput) + streamInput.available();
         if (chunksize <= bytesAvailable) {
             return chunksize;
         }
@@ -675,9 +745,8 @@ public class Protocol extends ConnectionBaseAdapter
 
 
     /** 
-     * Read a chunk size header into the readLine buffer
-     * without blocking. The stringbuffer is populated
-     * with characters one at a time. This routine is design
+     * Read a chunk size header into the scan buffer
+     * without blocking. This routine is designed
      * so that a partial chunk size header could be read
      * and then completed by a blocking read of the chunk 
      * or a subsequent call to available.
@@ -685,67 +754,46 @@ public class Protocol extends ConnectionBaseAdapter
      * @return available data that can be read
      */
     int readChunkSizeNonBlocking() throws IOException {
+        int i;
+        int size;
+        int len;
+
         /*
-         * Check the underlying stream to see how many bytes are
-         * available. Do not read beyond the available characters,
-         * because that would block.
+         * Buffer only the bytes the underlying stream has available,
+         * reading beyond them would block.
          */
-        int len = streamInput.available();
-        
-        /* Reset the last character from the current readLine buffer. */
-        int sblen = stringbuffer.length();
-        char lastchar = '\0';
-        if (sblen > 0) {
-            lastchar = stringbuffer.charAt(sblen - 1);
+        setScanStream(streamInput);
+        fillScanBuffer(false);
+
+        if (!chunkCRLFSkipped) {
+            /* Consume the CRLF that ends the chunk read last. */
+            if (scanend - scanpos < 2) {
+                return 0;
+            }
+
+            if (scanbuf[scanpos] != '\r' || scanbuf[scanpos + 1] != '\n') {
+                throw new IOException("missing the CRLF at the end of a chunk");
+            }
+
+            scanpos += 2;
+            chunkCRLFSkipped = true;
         }
 
-        int size = -1;
-        /*
-         * Loop through the available characters until a full 
-         * chunk size header is in the readLine buffer.
-         */
-        for (; len > 0; len--) {
-            char c = (char) streamInput.read();
-            
-            if (lastchar == '\r' && c == '\n') {
-                // remove the '\r' from the buffer
-                stringbuffer.setLength(stringbuffer.length() - 1);
-
-                if (stringbuffer.length() > 0) {
-                    // this is a size, not the CRLF at the end of a chunk
-                    try {
-                        String temp = stringbuffer.toString();
-                        int semi = temp.indexOf(';');
-
-                        // skip extensions
-                        if (semi > 0) {
-                            temp = temp.substring(0, semi);
-                        }
-
-                        /*
-                         * Reset the string buffer length so readline() will
-                         * not parse this line.
-                         */
-                        stringbuffer.setLength(0);
-
-                        size = Integer.parseInt(temp, 16);
-                    } catch (NumberFormatException nfe) {
-                        throw new IOException(
-                            "invalid chunk size number format");
-                    }
-                    break;
-                }
-            } else {
-                stringbuffer.append(c);
-                lastchar = c;
+        /* Parse the size only once its whole line has been received. */
+        for (i = scanpos; i < scanend; i++) {
+            if (scanbuf[i] == '\n') {
+                break;
             }
         }
-        
-        if (size < 0) {
+
+        if (i == scanend) {
             // did not get the size
             return 0;
         }
 
+        size = parseChunkSize(readLine(streamInput));
+        chunkCRLFSkipped = false;
+
         /*
          * Update the chunksize and the total bytes that have been
          * read from the chunk. This will trigger the next call to
@@ -764,6 +812,7 @@ public class Protocol extends ConnectionBaseAdapter
          * otherwise return the remainder of the available
          * bytes (e.g. partial chunk).
          */
+        len = scannedBytes(streamInput) + streamInput.available();
         return (chunksize < len ? chunksize : len);
         
     }
@@ -844,18 +893,18 @@ public class Protocol extends ConnectionBaseAdapter
                 /*
                  * No need to buffer, if the caller has given a big buffer.
                  */
-                rc = streamInput.read(b, off, bytesToRead);
+                rc = readStream(streamInput, b, off, bytesToRead);
 
             } else if (len >= inputBufferSize) {
                 /*
                  * No need to buffer, if the caller has given a big buffer.
                  */
-                rc = streamInput.read(b, off, len);
+                rc = readStream(streamInput, b, off, len);
             } else {
                 if (inputBufferSize >= bytesToRead) {
-                    rc = streamInput.read(readbuf, 0, bytesToRead);
+                    rc = readStream(streamInput, readbuf, 0, bytesToRead);
                 } else {
-                    rc = streamInput.read(readbuf, 0, inputBufferSize);
+                    rc = readStream(streamInput, readbuf, 0, inputBufferSize);
                 }
 
                 bytesleft = rc;
@@ -893,35 +942,44 @@ public class Protocol extends ConnectionBaseAdapter
      * @return size of the buffered read
      */
     private int readChunkSize() throws IOException {
-        int size = -1;
+        String chunk = null;
 
         try {
-            String chunk = null;
+            chunk = readLine(streamInput);
+        } catch (IOException ioe) {
+            /* throw new IOException(ioe.getMessage()); */
+        }
 
-            try {
-                chunk = readLine(streamInput);
-            } catch (IOException ioe) {
-                /* throw new IOException(ioe.getMessage()); */
-            }
+        if (chunk == null) {
+            throw new IOException("No Chunk Size");
+        }
 
-            if (chunk == null) {
-                throw new IOException("No Chunk Size");
-            }
+        return parseChunkSize(chunk);
+    }
 
-            int i;
-            for (i = 0; i < chunk.length(); i++) {
-                char ch = chunk.charAt(i);
-                if (Character.digit(ch, 16) == -1)
-                    break;
-            }
+    /** 
+     * Parses a chunk size line: a hex length optionally followed by
+     * extensions, which are ignored.
+     *
+     * @param chunk the chunk size line without the CRLF
+     * @return the chunk size
+     * @exception IOException if the line does not start with a hex number
+     */
+    private static int parseChunkSize(String chunk) throws IOException {
+        int i;
 
-            /* look at extensions?.... */
-            size = Integer.parseInt(chunk.substring(0, i), 16);
+        for (i = 0; i < chunk.length(); i++) {
+            char ch = chunk.charAt(i);
+            if (Character.digit(ch, 16) == -1)
+                break;
+        }
+
+        /* look at extensions?.... */
+        try {
+            return Integer.parseInt(chunk.substring(0, i), 16);
         } catch (NumberFormatException e) {
             throw new IOException("invalid chunk size number format");
         }
-        
-        return size;
     }
     
     /**
@@ -933,43 +991,25 @@ public class Protocol extends ConnectionBaseAdapter
     private void skipEndOfChunkCRLF() throws IOException { 
         int ch;
 
-        if (stringbuffer.length() > 1) {
-            /*
-             * readChunkSizeNonBlocking does not leave CRLF in the buffer
-             * so assume that the ending CRLF has been skipped already
-             */
+        if (chunkCRLFSkipped) {
+            /* readChunkSizeNonBlocking has consumed the CRLF already. */
+            chunkCRLFSkipped = false;
             return;
         }
 
-        // readChunkSizeNonBlocking could have left a \r single in the buffer
-        if (stringbuffer.length() == 1) {
-            if (stringbuffer.charAt(0) != '\r') {
-                // assume that the ending CRLF has been skipped already
-                return;
-            }
-             
-            // remove the '\r'
-            stringbuffer.setLength(0);
-            ch = streamInput.read();
-            if (ch != '\n') {
-                throw new IOException("missing the LF of an expected CRLF");
-            }
-
-            return;
-        }
-                
-        ch = streamInput.read();
+        ch = readScannedByte();
         if (ch != '\r') {
             /*
-             * assume readChunkSizeNonBlocking has read the end of the chunk
-             * and that this is the next chunk size, so put the char in the
-             * buffer for readChunkSize and return
+             * No CRLF after the chunk, leave the character
+             * for readChunkSize
              */
-            stringbuffer.append((char)ch);
+            if (ch >= 0) {
+                scanpos--;
+            }
             return;
         }
 
-        ch = streamInput.read();
+        ch = readScannedByte();
         if (ch != '\n') {
             throw new IOException("missing the LF of an expected CRLF");
         }
@@ -1541,8 +1581,7 @@ public class Protocol extends ConnectionBaseAdapter
             bytesToRetry = bytesToWrite;
 
             try {
-                startRequest();
-                sendRequestBody();
+                startRequestWithBody();
 
                 if (readResponseHeader) {
                     finishRequestGetResponseHeader();
@@ -1557,7 +1596,7 @@ public class Protocol extends ConnectionBaseAdapter
                 }
 
                 try {
-                    connectionPool.remove(
+                    getConnectionPool().remove(
                         (StreamConnectionElement)streamConnection);
                 } catch (Exception e) {
                     // do not over throw the previous exception
@@ -1574,8 +1613,7 @@ public class Protocol extends ConnectionBaseAdapter
                 streamOutput = null;
                 bytesToWrite = bytesToRetry;
 
-                startRequest();
-                sendRequestBody();
+                startRequestWithBody();
 
                 if (readResponseHeader) {
                     finishRequestGetResponseHeader();
@@ -1645,6 +1683,23 @@ public class Protocol extends ConnectionBaseAdapter
         streamInput = streamConnection.openDataInputStream();
     }
 
+    /** 
+     * Same as startRequest but sends the buffered request body as well.
+     * When the request is new, its headers and body are handed to the
+     * transport in one gathered write.
+     *
+     * @exception IOException is thrown if the connection cannot be opened
+     */
+    private void startRequestWithBody() throws IOException {
+        if (streamConnection != null) {
+            sendRequestBody();
+            return;
+        }
+
+        streamConnect();
+        sendRequestBody(getRequestHeader());
+    }
+
     /**
      * Gets the underlying stream connection.
      *
@@ -1662,6 +1717,15 @@ public class Protocol extends ConnectionBaseAdapter
      * @exception IOException is thrown if the connection cannot be opened
      */
     private void sendRequestHeader() throws IOException {
+        streamOutput.write(getRequestHeader());
+    }
+
+    /**
+     * Builds the request line and the header fields of the request.
+     *
+     * @return the request line and header bytes, ending with an empty line
+     */
+    private byte[] getRequestHeader() {
         StringBuffer reqLine;
         String filename;
         int numberOfKeys;
@@ -1815,10 +1879,23 @@ public class Protocol extends ConnectionBaseAdapter
                 reqLine.append("\r\n");
             }
         }
+
+        /*
+         * If enabled and the application does not negotiate the content
+         * coding itself, ask for compressed content and decode it
+         * transparently.
+         */
+        if (decodeContentFlag &&
+                reqProperties.getPropertyIgnoreCase("Accept-Encoding") == null) {
+            reqLine.append("Accept-Encoding: ");
+            reqLine.append(ContentDecoder.ACCEPT_ENCODING);
+            reqLine.append("\r\n");
+            acceptEncodingAdded = true;
+        }
         
         reqLine.append("\r\n");
 
-        streamOutput.write(reqLine.toString().getBytes());
+        return reqLine.toString().getBytes();
     }
 
     /**
@@ -1827,12 +1904,28 @@ public class Protocol extends ConnectionBaseAdapter
      * @exception IOException 
      */
     protected void sendRequestBody() throws IOException {
+        sendRequestBody(null);
+    }
+
+    /**
+     * Write the http request body bytes to the output stream, preceded
+     * by the request header if one is given.
+     *
+     * @param header request header to send first or null
+     *
+     * @exception IOException 
+     */
+    private void sendRequestBody(byte[] header) throws IOException {
 
         int start;
         int endOfData;
         int length;
 
         if ((writebuf == null) || (bytesToWrite == 0)) {
+            if (header != null) {
+                streamOutput.write(header);
+            }
+
             return;
         }
 
@@ -1878,10 +1971,49 @@ public class Protocol extends ConnectionBaseAdapter
             length += 2;
         }           
 
-        streamOutput.write(writebuf, start, length);
+        if (header == null) {
+            streamOutput.write(writebuf, start, length);
+        } else {
+            writeGathered(header, writebuf, start, length);
+        }
+
         bytesToWrite = 0;
     }
 
+    /**
+     * Writes the request header and a part of the body. A TCP transport
+     * sends both with one native call, so that they leave in as few
+     * segments as possible; other transports get two writes.
+     *
+     * @param header request header
+     * @param b the body data
+     * @param off the start offset in the data
+     * @param len the number of body bytes to write
+     *
+     * @exception IOException if an I/O error occurs
+     */
+    private void writeGathered(byte[] header, byte[] b, int off, int len)
+            throws IOException {
+        StreamConnection sc = streamConnection;
+
+        if (sc instanceof StreamConnectionElement) {
+            sc = ((StreamConnectionElement)sc).getBaseConnection();
+        }
+
+        if (sc instanceof com.sun.midp.io.j2me.socket.Protocol) {
+            byte[][] data = {header, b};
+            int[] offsets = {0, off};
+            int[] lengths = {header.length, len};
+
+            ((com.sun.midp.io.j2me.socket.Protocol)sc).writeGathered(data,
+                offsets, lengths, data.length);
+            return;
+        }
+
+        streamOutput.write(header);
+        streamOutput.write(b, off, len);
+    }
+
     /**
      * Finish the http request and reads the response headers.
      *
@@ -1928,6 +2060,103 @@ public class Protocol extends ConnectionBaseAdapter
             readResponseMessage(streamInput);
             readHeaders(streamInput);
         }
+
+        checkContentCoding();
+    }
+
+    /**
+     * Checks if the response body was sent compressed because the
+     * request asked for it on its own. If so, the headers are updated to
+     * describe the decoded body, whose length is not known until it is
+     * read, and the body is decoded as it is read. Responses that have
+     * no body are left alone.
+     */
+    private void checkContentCoding() {
+        String coding;
+
+        if (!acceptEncodingAdded || eof || responseCode == HTTP_NO_CONTENT ||
+                responseCode == HTTP_NOT_MODIFIED) {
+            return;
+        }
+
+        coding = headerFields.getPropertyIgnoreCase("Content-Encoding");
+        if (coding == null || !ContentDecoder.isSupported(coding.trim())) {
+            return;
+        }
+
+        contentDecoder = new ContentDecoder(coding.trim(),
+                                            new BodyInputStream());
+        contentLength = -1;
+        headerFields.removeProperty(findHeaderKey("Content-Encoding"));
+        headerFields.removeProperty(findHeaderKey("Content-Length"));
+    }
+
+    /**
+     * The response body as it was received, the input of the content
+     * decoder.
+     */
+    private class BodyInputStream extends InputStream {
+        /** Buffer of the single byte read. */
+        private byte[] oneByte = new byte[1];
+
+        /**
+         * Reads the next byte of the body.
+         *
+         * @return the byte, or -1 at the end of the body
+         * @exception IOException if an I/O error occurs
+         */
+        public int read() throws IOException {
+            if (readBodyBytes(oneByte, 0, 1) < 0) {
+                return -1;
+            }
+
+            return oneByte[0] & 0xff;
+        }
+
+        /**
+         * Reads bytes of the body.
+         *
+         * @param b buffer for the data
+         * @param off offset in <code>b</code> to store the data at
+         * @param len maximum number of bytes to read
+         * @return number of bytes read, or -1 at the end of the body
+         * @exception IOException if an I/O error occurs
+         */
+        public int read(byte[] b, int off, int len) throws IOException {
+            return readBodyBytes(b, off, len);
+        }
+    }
+
+    /**
+     * Finds how a response header field name was spelled by the server.
+     *
+     * @param name the field name in any case
+     * @return the field name as received, or <code>name</code> if the
+     *         field was not received
+     */
+    private String findHeaderKey(String name) {
+        for (int i = 0; i < headerFields.size(); i++) {
+            String key = headerFields.getKeyAt(i);
+
+            if (key.equalsIgnoreCase(name)) {
+                return key;
+            }
+        }
+
+        return name;
+    }
+
+    /**
+     * Gets the pool that persistent connections of this protocol are
+     * kept in.
+     * <p>
+     * A subclass with connections that are more expensive to set up
+     * can override this method to keep them in a pool of their own.
+     *
+     * @return persistent connection pool
+     */
+    protected StreamConnectionPool getConnectionPool() {
+        return connectionPool;
     }
 
     /**
@@ -1948,7 +2177,7 @@ public class Protocol extends ConnectionBaseAdapter
             throw new SecurityException();
         }
 
-        sc = connectionPool.get(classSecurityToken, protocol,
+        sc = getConnectionPool().get(classSecurityToken, protocol,
                                               url.host, url.port);
 
         if (sc != null) {
@@ -2091,7 +2320,7 @@ public class Protocol extends ConnectionBaseAdapter
         
         if (bytesToRead > 0) {
             byte[] b = new byte[bytesToRead];
-            is.read(b, 0, bytesToRead);
+            readStream(is, b, 0, bytesToRead);
         }
 
         int errorGroup = responseCode / 100;
@@ -2219,6 +2448,7 @@ public class Protocol extends ConnectionBaseAdapter
         bytesread = 0;
         totalbytesread = 0;
         chunkedIn = false;
+        chunkCRLFSkipped = false;
         eof = false;
 
         
@@ -2327,8 +2557,10 @@ public class Protocol extends ConnectionBaseAdapter
     }
 
     /**
-     * Uses the shared stringbuffer to read a line terminated by CRLF 
-     * and return it as string. Blocks until the line is done or end of
+     * Reads a line terminated by CRLF and returns it as string.
+     * The line end is searched for in the scan buffer, which is refilled
+     * from the stream in bulk; the shared stringbuffer collects lines
+     * that do not fit in it. Blocks until the line is done or end of
      * stream.
      *
      * @param     in  InputStream to read the data
@@ -2336,24 +2568,30 @@ public class Protocol extends ConnectionBaseAdapter
      * @exception IOException if error encountered while reading headers
      */
     private String readLine(InputStream in) throws IOException {
-        int c;
+        int i;
+
+        setScanStream(in);
 
         try {
             for (;;) {
-                c = in.read();
-                if (c < 0) {
-                    return null;
+                for (i = scanpos; i < scanend; i++) {
+                    if (scanbuf[i] == '\n') {
+                        break;
+                    }
                 }
 
-                if (c == '\r') {
-                    continue;
-                }
+                appendScanned(i);
 
-                if (c == '\n') {
+                if (i < scanend) {
+                    /* Skip the LF as well. */
+                    scanpos = i + 1;
                     break;
                 }
 
-                stringbuffer.append((char)c);
+                scanpos = scanend;
+                if (fillScanBuffer(true) < 0) {
+                    return null;
+                }
             }
 
             /* Return a whole line and reset the string buffer. */
@@ -2365,6 +2603,140 @@ public class Protocol extends ConnectionBaseAdapter
         }
     }
 
+    /**
+     * Appends the scan buffer bytes from the current position up to the
+     * given offset to the shared stringbuffer, dropping CR characters.
+     *
+     * @param end offset just past the last byte to append
+     */
+    private void appendScanned(int end) {
+        int count = 0;
+
+        for (int i = scanpos; i < end; i++) {
+            byte b = scanbuf[i];
+
+            if (b != '\r') {
+                scanchars[count++] = (char)(b & 0xff);
+            }
+        }
+
+        if (count > 0) {
+            stringbuffer.append(scanchars, 0, count);
+        }
+    }
+
+    /**
+     * Makes the scan buffer hold bytes of the given stream, dropping
+     * any bytes buffered from another stream.
+     *
+     * @param in the stream to scan
+     */
+    private void setScanStream(InputStream in) {
+        if (scanStream != in) {
+            scanStream = in;
+            scanpos = 0;
+            scanend = 0;
+        }
+    }
+
+    /**
+     * Returns the number of bytes of the given stream waiting in the
+     * scan buffer.
+     *
+     * @param in the stream
+     * @return number of buffered bytes
+     */
+    private int scannedBytes(InputStream in) {
+        return (scanStream == in) ? (scanend - scanpos) : 0;
+    }
+
+    /**
+     * Moves the unconsumed bytes to the start of the scan buffer and
+     * fills the rest of it from the scanned stream.
+     *
+     * @param block true to wait for data, false to read only the bytes
+     *              available without blocking
+     * @return number of bytes added or -1 at the end of stream
+     * @exception IOException if an I/O error occurs
+     */
+    private int fillScanBuffer(boolean block) throws IOException {
+        int count;
+
+        if (scanpos > 0) {
+            System.arraycopy(scanbuf, scanpos, scanbuf, 0, scanend - scanpos);
+            scanend -= scanpos;
+            scanpos = 0;
+        }
+
+        count = scanbuf.length - scanend;
+        if (!block) {
+            int available = scanStream.available();
+
+            if (available < count) {
+                count = available;
+            }
+        }
+
+        if (count == 0) {
+            return 0;
+        }
+
+        count = scanStream.read(scanbuf, scanend, count);
+        if (count > 0) {
+            scanend += count;
+        }
+
+        return count;
+    }
+
+    /**
+     * Reads one byte of the input stream through the scan buffer.
+     *
+     * @return the byte or -1 at the end of stream
+     * @exception IOException if an I/O error occurs
+     */
+    private int readScannedByte() throws IOException {
+        setScanStream(streamInput);
+
+        while (scanpos == scanend) {
+            if (fillScanBuffer(true) < 0) {
+                return -1;
+            }
+        }
+
+        return scanbuf[scanpos++] & 0xff;
+    }
+
+    /**
+     * Reads from the given stream, taking the bytes left in the scan
+     * buffer first.
+     *
+     * @param      in    the stream to read
+     * @param      b     the buffer into which the data is read.
+     * @param      off   the start offset in array <code>b</code>
+     * @param      len   the maximum number of bytes to read.
+     * @return     the number of bytes read, or <code>-1</code> at the end
+     *             of stream
+     * @exception  IOException  if an I/O error occurs.
+     */
+    private int readStream(InputStream in, byte b[], int off, int len)
+        throws IOException {
+        int buffered = scannedBytes(in);
+
+        if (buffered == 0) {
+            return in.read(b, off, len);
+        }
+
+        if (len > buffered) {
+            len = buffered;
+        }
+
+        System.arraycopy(scanbuf, scanpos, b, off, len);
+        scanpos += len;
+
+        return len;
+    }
+
     /**
      * Close the OutputStream and transition to connected state.
      *
@@ -2435,7 +2807,7 @@ public class Protocol extends ConnectionBaseAdapter
                 
             if (streamConnection instanceof StreamConnectionElement) {
                 // we got this connection from the pool
-                connectionPool.remove(
+                getConnectionPool().remove(
                         (StreamConnectionElement)streamConnection);
             } else {
                 disconnect(streamConnection);
@@ -2447,14 +2819,14 @@ public class Protocol extends ConnectionBaseAdapter
 
         if (streamConnection instanceof StreamConnectionElement) {
             // we got this connection from the pool
-            connectionPool.returnForReuse(
+            getConnectionPool().returnForReuse(
                    (StreamConnectionElement)streamConnection);
             connReused = true;
             return;
         }
 
         // save the connection for reuse
-        if (!connectionPool.add(protocol, url.host, url.port,
+        if (!getConnectionPool().add(protocol, url.host, url.port,
                  streamConnection, streamOutput, streamInput)) {
             // pool full, disconnect
             disconnect(streamConnection);
@@ -93,8 +93,8 @@ public class StreamConnectionPool {
      * @param connectionLingerTime how many milliseconds a connection should
      *       stay in the pool after its last use
      */
-    StreamConnectionPool(int number_of_connections,
-                         long connectionLingerTime) {
+    public StreamConnectionPool(int number_of_connections,
+                                long connectionLingerTime) {
         this.m_max_connections = number_of_connections;
         this.m_connectionLingerTime = connectionLingerTime;
         m_connections = new Vector(m_max_connections);
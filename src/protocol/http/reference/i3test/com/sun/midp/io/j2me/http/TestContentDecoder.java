@@ -0,0 +1,232 @@
+/*
+ *  
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+package com.sun.midp.io.j2me.http;
+
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
+import java.io.InputStream;
+import java.io.IOException;
+
+import com.sun.midp.i3test.TestCase;
+
+/**
+ * Tests decoding of gzip and deflate content codings.
+ */
+public class TestContentDecoder extends TestCase {
+
+    /** Plain text that was compressed to produce the data below. */
+    static final String PLAIN =
+        "hello, hello, hello, compressed world\n" +
+        "hello, hello, hello, compressed world\n" +
+        "hello, hello, hello, compressed world\n" +
+        "hello, hello, hello, compressed world\n";
+
+    /** PLAIN with gzip content coding. */
+    static final byte[] GZIP = {
+        31, -117, 8, 0, 0, 0, 0, 0, 2, 3, -53, 72, -51, -55, -55, -41,
+        81, -56, 64, -95, -110, -13, 115, 11, -118, 82, -117, -117, 83, 83,
+        20, -54, -13, -117, 114, 82, -72, 50, -24, -82, 10, 0, 6, 120,
+        70, 101, -104, 0, 0, 0
+    };
+
+    /** PLAIN with deflate content coding (zlib format). */
+    static final byte[] DEFLATE = {
+        120, -100, -53, 72, -51, -55, -55, -41, 81, -56, 64, -95, -110, -13,
+        115, 11, -118, 82, -117, -117, 83, 83, 20, -54, -13, -117, 114, 82,
+        -72, 50, -24, -82, 10, 0, 81, 4, 54, -99
+    };
+
+    /**
+     * Decodes content, reading it a few bytes at a time.
+     *
+     * @param coding the content coding
+     * @param data the encoded content
+     * @param off offset of the content in <code>data</code>
+     * @param len length of the content
+     * @return the decoded content
+     * @exception IOException if the content cannot be decoded
+     */
+    static String decode(String coding, byte[] data, int off, int len)
+            throws IOException {
+        InputStream in = new ContentDecoder(coding,
+            new ByteArrayInputStream(data, off, len));
+        ByteArrayOutputStream out = new ByteArrayOutputStream();
+        byte[] buf = new byte[7];
+        int count;
+
+        while ((count = in.read(buf, 0, buf.length)) > 0) {
+            out.write(buf, 0, count);
+        }
+
+        return new String(out.toByteArray());
+    }
+
+    /**
+     * Tells if decoding content throws an IOException.
+     *
+     * @param coding the content coding
+     * @param data the encoded content
+     * @return true if an IOException was thrown
+     */
+    static boolean decodeFails(String coding, byte[] data) {
+        try {
+            decode(coding, data, 0, data.length);
+        } catch (IOException e) {
+            return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * Tests which content codings are recognized.
+     */
+    void testSupported() {
+        assertTrue("gzip", ContentDecoder.isSupported("gzip"));
+        assertTrue("x-gzip", ContentDecoder.isSupported("x-gzip"));
+        assertTrue("deflate", ContentDecoder.isSupported("DEFLATE"));
+        assertTrue("identity", !ContentDecoder.isSupported("identity"));
+        assertTrue("compress", !ContentDecoder.isSupported("compress"));
+    }
+
+    /**
+     * Tests decoding of gzip content, of one member and of two.
+     */
+    void testGzip() throws IOException {
+        byte[] twice = new byte[GZIP.length * 2];
+
+        assertEquals("gzip", PLAIN, decode("gzip", GZIP, 0, GZIP.length));
+
+        System.arraycopy(GZIP, 0, twice, 0, GZIP.length);
+        System.arraycopy(GZIP, 0, twice, GZIP.length, GZIP.length);
+        assertEquals("two members", PLAIN + PLAIN,
+                     decode("gzip", twice, 0, twice.length));
+    }
+
+    /**
+     * Tests decoding of deflate content, as a zlib stream and as raw
+     * deflate data.
+     */
+    void testDeflate() throws IOException {
+        assertEquals("zlib", PLAIN,
+                     decode("deflate", DEFLATE, 0, DEFLATE.length));
+
+        /* without the CMF, FLG header and the ADLER32 trailer */
+        assertEquals("raw", PLAIN,
+                     decode("deflate", DEFLATE, 2, DEFLATE.length - 6));
+    }
+
+    /**
+     * Tests that a zlib header announcing a window larger than 32 KB is
+     * not taken for one, so the data is inflated as raw deflate data.
+     */
+    void testLargeWindow() {
+        byte[] data = new byte[DEFLATE.length];
+
+        /* CINFO 8, with a valid FCHECK */
+        System.arraycopy(DEFLATE, 0, data, 0, DEFLATE.length);
+        data[0] = -120;
+        data[1] = 28;
+
+        assertTrue("large window", decodeFails("deflate", data));
+    }
+
+    /**
+     * Tests that truncated content is reported as an IOException, and
+     * that every later read fails as well.
+     */
+    void testTruncated() throws IOException {
+        InputStream in = new ContentDecoder("gzip",
+            new ByteArrayInputStream(GZIP, 0, 30));
+        byte[] buf = new byte[PLAIN.length()];
+        boolean thrown = false;
+
+        try {
+            while (in.read(buf, 0, buf.length) > 0) {
+                /* read until the data runs out */
+            }
+        } catch (IOException e) {
+            thrown = true;
+        }
+
+        assertTrue("truncated", thrown);
+
+        thrown = false;
+        try {
+            in.read();
+        } catch (IOException e) {
+            thrown = true;
+        }
+
+        assertTrue("read after failure", thrown);
+    }
+
+    /**
+     * Tests that content that does not match its check sum is reported
+     * as an IOException.
+     */
+    void testCorrupted() {
+        byte[] gzip = new byte[GZIP.length];
+        byte[] deflate = new byte[DEFLATE.length];
+
+        System.arraycopy(GZIP, 0, gzip, 0, GZIP.length);
+        gzip[GZIP.length - 8] ^= 1;
+        assertTrue("gzip CRC", decodeFails("gzip", gzip));
+
+        System.arraycopy(GZIP, 0, gzip, 0, GZIP.length);
+        gzip[GZIP.length - 4] ^= 1;
+        assertTrue("gzip ISIZE", decodeFails("gzip", gzip));
+
+        System.arraycopy(DEFLATE, 0, deflate, 0, DEFLATE.length);
+        deflate[DEFLATE.length - 1] ^= 1;
+        assertTrue("deflate ADLER32", decodeFails("deflate", deflate));
+    }
+
+    /**
+     * Runs all the tests.
+     */
+    public void runTests() throws Throwable {
+        declare("testSupported");
+        testSupported();
+
+        declare("testGzip");
+        testGzip();
+
+        declare("testDeflate");
+        testDeflate();
+
+        declare("testLargeWindow");
+        testLargeWindow();
+
+        declare("testTruncated");
+        testTruncated();
+
+        declare("testCorrupted");
+        testCorrupted();
+    }
+
+}
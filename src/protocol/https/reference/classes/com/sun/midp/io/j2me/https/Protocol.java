@@ -207,6 +207,29 @@ public class Protocol extends com.sun.midp.io.j2me.http.Protocol
     /** Underlying SSL connection. */
     private SSLStreamConnection sslConnection;
 
+    /**
+     * Established SSL sessions kept for reuse, keyed by host and port.
+     * Separate from the HTTP pool so that plain connections never push
+     * out a session that took a full handshake to set up.
+     */
+    private static StreamConnectionPool sessionPool;
+
+    /** Get the configuration values for this class. */
+    static {
+        int maxSessions;
+        long sessionLingerTime;
+
+        maxSessions = Configuration.getNonNegativeIntProperty(
+            "com.sun.midp.io.https.max_persistent_connections", 4);
+
+        sessionLingerTime = (long)Configuration.getNonNegativeIntProperty(
+            "com.sun.midp.io.https.persistent_connection_linger_time",
+            60000);
+
+        sessionPool = new StreamConnectionPool(maxSessions,
+                                               sessionLingerTime);
+    }
+
     /**
      * Create a new instance of this class. Override the some of the values
      * in our super class.
@@ -321,6 +344,15 @@ public class Protocol extends com.sun.midp.io.j2me.http.Protocol
         super.setRequestField(key, value);
     }
 
+    /**
+     * Gets the pool established SSL sessions are kept in.
+     *
+     * @return SSL session pool
+     */
+    protected StreamConnectionPool getConnectionPool() {
+        return sessionPool;
+    }
+
     /**
      * Connect to the underlying secure socket transport.
      * Perform the SSL handshake and then proceeded to the underlying
@@ -341,8 +373,8 @@ public class Protocol extends com.sun.midp.io.j2me.http.Protocol
             throw new SecurityException();
         }
 
-        sc = connectionPool.get(classSecurityToken, protocol,
-                                url.host, url.port);
+        sc = sessionPool.get(classSecurityToken, protocol,
+                             url.host, url.port);
 
         if (sc != null) {
             return sc;
@@ -28,26 +28,23 @@ package com.sun.midp.io.j2me.pipe;
 import com.sun.midp.io.j2me.pipe.serviceProtocol.PipeServiceProtocol;
 import com.sun.midp.io.ConnectionBaseAdapter;
 import com.sun.midp.io.pipe.PipeConnection;
-import com.sun.midp.links.ClosedLinkException;
 import com.sun.midp.links.Link;
-import com.sun.midp.links.LinkMessage;
 import java.io.IOException;
 import java.io.InputStream;
-import java.io.InterruptedIOException;
 import javax.microedition.io.Connection;
 import com.sun.midp.security.SecurityToken;
-import java.util.Vector;
 import javax.microedition.io.Connector;
 
 /**
- * Implementation of PipeConnection interface. Uses Links as bearer. Uses
- * com.sun.midp.io.j2me.pipe.serviceProtocol.* for organazing messaging over
- * bearer.
+ * Implementation of PipeConnection interface. Uses stream Links as bearer:
+ * the bytes travel through a native ring buffer shared by the two isolates,
+ * and closing the output stream closes the outbound link, which the peer
+ * sees as end of stream once it has read the remaining bytes. Uses
+ * com.sun.midp.io.j2me.pipe.serviceProtocol.* for setting up the links.
  */
 class PipeClientConnectionImpl extends ConnectionBaseAdapter implements PipeConnection {
 
     private static final boolean DEBUG = false;
-    private static final String CLOSE_OUTPUT_COMMAND = "closeOutputStream";
     private PipeServiceProtocol pipe;
     private SecurityToken token;
     private Object suiteId;
@@ -55,13 +52,6 @@ class PipeClientConnectionImpl extends ConnectionBaseAdapter implements PipeConn
     private String version;
     private Link sendLink;
     private Link receiveLink;
-    private Thread receiverThread;
-    private Receiver receiver;
-    private Vector receiveQueue = new Vector(1);
-    private int topReceivedMsgOffset;
-    private IOException receiveStatus = new IOException();
-    private int receiveQueueByteCount;
-    private boolean receivedEOF;
 
     PipeClientConnectionImpl(SecurityToken token, PipeServiceProtocol pipe) {
         this.pipe = pipe;
@@ -82,14 +72,6 @@ class PipeClientConnectionImpl extends ConnectionBaseAdapter implements PipeConn
         sendLink = pipe.getOutboundLink();
 
         initStreamConnection(mode);
-
-        if (mode == Connector.READ || mode == Connector.READ_WRITE) {
-            receiver = new Receiver();
-            receiverThread = new Thread(receiver);
-            receiveStatus = null;
-            receiverThread.start();
-        }
-
     }
 
     public InputStream openInputStream() throws IOException {
@@ -105,11 +87,6 @@ class PipeClientConnectionImpl extends ConnectionBaseAdapter implements PipeConn
         super.notifyClosedInput();
 
         receiveLink.close();
-
-        if (receiveStatus == null) {
-            // input was closed by application, not because of receiver failure
-            receiveStatus = new IOException();
-        }
     }
 
     protected void notifyClosedOutput() {
@@ -136,113 +113,34 @@ class PipeClientConnectionImpl extends ConnectionBaseAdapter implements PipeConn
         if (DEBUG)
             debugPrint("disconnected");
 
-        synchronized (receiver) {
-            receiver.notify();
-        }
+        // wakes up a reader or writer blocked on the ring
+        receiveLink.close();
+        sendLink.close();
     }
 
     public int available() throws IOException {
+        int count = receiveLink.available();
 
         if (DEBUG)
-            debugPrint("available " + receiveQueueByteCount + " bytes");
+            debugPrint("available " + count + " bytes");
 
-        return receiveQueueByteCount;
+        return count;
     }
 
-    protected synchronized int readBytes(byte[] b, int off, int len) throws IOException {
+    protected int readBytes(byte[] b, int off, int len) throws IOException {
         if (DEBUG)
             debugPrint("readBytes len=" + len + ", can read " + (iStreams > 0));
 
-        if (iStreams == 0) {
-            if (DEBUG)
-                debugPrint("readBytes input closed. isEOF " + receivedEOF +
-                        ", status " + receiveStatus);
-
-            if (receivedEOF)
-                return -1;
-
-            throw receiveStatus;
-        }
-
-        int originalOffset = off;
-        synchronized (receiver) {
-
-            while (len > 0) {
-                if (receiveQueue.size() == 0) {
-                    // need more bytes, check if receiver is running
-                    if (receiveStatus == null && !receivedEOF) {
-                        // fine, now wait for data to come
-                        if (DEBUG)
-                            debugPrint("readBytes: waiting for Receiver");
-                        try {
-                            receiver.wait();
-                        } catch (InterruptedException ex) {
-                            try {
-                                closeInputStream();
-                            } catch (IOException iOException) {
-                                // ignore
-                            }
-                            throw new InterruptedIOException(ex.toString());
-                        }
-                    }
-
-                    // check receiver status once more finish processing if no more
-                    // data could be obtained
-                    if (receiveStatus != null || receivedEOF) {
-                        if (DEBUG)
-                            debugPrint("readBytes: Receiver finshed with " + receiveStatus);
-                        // we've got receiver stopped and no more data. close input
-                        try {
-                            closeInputStream();
-                        } catch (IOException iOException) {
-                            // ignore
-                        }
-
-                        if (receivedEOF) {
-                            break;
-                        } else {
-                            throw receiveStatus;
-                        }
-                    }
-                }
-
-                // get bytes from receive queue
-                byte[] bufferedMsg = (byte[]) receiveQueue.elementAt(0);
-                int chunkSize = bufferedMsg.length - topReceivedMsgOffset;
-                if (DEBUG)
-                    debugPrint("readBytes: fetching data. " + chunkSize + " bytes available in message");
-                if (chunkSize >= len) {
-                    chunkSize = len;
-                }
-                System.arraycopy(bufferedMsg, topReceivedMsgOffset, b, off, chunkSize);
-                topReceivedMsgOffset += chunkSize;
-                if (topReceivedMsgOffset == bufferedMsg.length) {
-                    receiveQueue.removeElementAt(0);
-                    topReceivedMsgOffset = 0;
-                }
-                if (DEBUG)
-                    debugPrint("readBytes len=" + len + ", read " + chunkSize);
-                len -= chunkSize;
-                off += chunkSize;
-                receiveQueueByteCount -= chunkSize;
-
-                if (receiveQueue.size() == 0) {
-                    // check if we've provided requested data
-                    // readBytes should block only if no data is available
-                    // if single byte has been read it should return
-
-                    break;
-                }
-            }
-        }
+        if (iStreams == 0)
+            throw new IOException();
 
+        // blocks only while the ring is empty, returns -1 after peer closed
+        int bytesRead = receiveLink.read(b, off, len);
 
         if (DEBUG)
-            debugPrint("readBytes: read " + (off - originalOffset) + " bytes");
-
-        int bytesRead = off - originalOffset;
+            debugPrint("readBytes: read " + bytesRead + " bytes");
 
-        return bytesRead == 0 ? -1 : bytesRead;
+        return bytesRead;
     }
 
     private void debugPrint(String msg) {
@@ -256,31 +154,14 @@ class PipeClientConnectionImpl extends ConnectionBaseAdapter implements PipeConn
         if (oStreams == 0)
             throw new IOException();
 
-        if (len == 0)
-            return 0;
-
-        LinkMessage lm = LinkMessage.newDataMessage(b, off, len);
-        if (DEBUG)
-            debugPrint("writeBytes: sending message");
-        sendLink.send(lm);
+        // blocks only while the ring is full
+        sendLink.write(b, off, len);
 
         if (DEBUG)
             debugPrint("writeBytes: wrote " + len + " bytes");
         return len;
     }
 
-    protected void closeOutputStream() throws IOException {
-        if (sendLink.isOpen()) {
-            try {
-                LinkMessage lm = LinkMessage.newStringMessage(CLOSE_OUTPUT_COMMAND);
-                sendLink.send(lm);
-            } catch (IOException ex) {
-                // ignore
-            }
-        }
-        super.closeOutputStream();
-    }
-
     public String getRequestedServerVersion() {
         return version;
     }
@@ -288,52 +169,4 @@ class PipeClientConnectionImpl extends ConnectionBaseAdapter implements PipeConn
     public String getServerName() {
         return serverName;
     }
-
-    private class Receiver implements Runnable {
-
-        public void run() {
-
-            while (!receivedEOF && receiveStatus == null) {
-                LinkMessage lm;
-                byte[] data = null;
-                try {
-                    if (DEBUG)
-                        debugPrint("Receiver waiting");
-                    lm = receiveLink.receive();
-                    if (DEBUG)
-                        debugPrint("Receiver got message");
-
-                    if (lm.containsString()) {
-                        String command = lm.extractString();
-                        if (CLOSE_OUTPUT_COMMAND.equals(command)) {
-                            receivedEOF = true;
-                        } else {
-                            // we should never get here but for the sake of consistency let's handle
-                            // this case
-                            receiveStatus = new IOException("Unsupported: " + command);
-                        }
-                    } else {
-                        data = lm.extractData();
-                    }
-
-                } catch (IOException iOException) {
-                    if (DEBUG)
-                        debugPrint("Receiver got exception " + iOException);
-                    receiveStatus = iOException;
-                    if (receiveStatus instanceof ClosedLinkException)
-                        receivedEOF = true;
-                }
-
-                synchronized (this) {
-                    if (data != null) {
-                        receiveQueue.addElement(data);
-                        receiveQueueByteCount += data.length;
-                    }
-                    notify();
-                }
-            }
-            if (DEBUG)
-                debugPrint("Receiver finished");
-        }
-    }
 }
@@ -59,6 +59,8 @@ public class PipeServiceProtocol {
     static final int MAGIC_OK = 0x49587011;
     static final int MAGIC_FAIL = 0x49587012;
     static final int MAGIC_WOULDBLOCK = 0x49587013;
+    /** Size of the ring buffer behind each pipe data link, in bytes. */
+    static final int DATA_LINK_BUFFER_SIZE = 4096;
     private static final boolean DEBUG = false;
     private static long nextEndpointIdToIssue;
     private int debugInstanceId;
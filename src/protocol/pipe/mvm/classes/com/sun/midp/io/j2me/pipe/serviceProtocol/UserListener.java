@@ -191,8 +191,10 @@ public class UserListener implements SystemServiceConnectionListener {
             fail("The requested server is not accepting connections");
         } else {
             serverPipe.setAcceptLink(null);
-            Link linkToClient = Link.newLink(server, client);
-            Link linkFromClient = Link.newLink(client, server);
+            Link linkToClient = Link.newStreamLink(server, client,
+                    PipeServiceProtocol.DATA_LINK_BUFFER_SIZE);
+            Link linkFromClient = Link.newStreamLink(client, server,
+                    PipeServiceProtocol.DATA_LINK_BUFFER_SIZE);
             SystemServiceLinkMessage linkMsg;
             SystemServiceDataMessage dataMsg;
             DataOutput out;
@@ -88,6 +88,15 @@ public class Protocol
         return n;
     }
 
+    public void writeGathered(byte[][] b, int[] off, int[] len, int count)
+                   throws IOException {
+
+        super.writeGathered(b, off, len, count);
+        for (int i = 0; i < count; i++) {
+            write0(md, b[i], off[i], len[i]);
+        }
+    }
+
     public void setSocketOption(byte option, int value)
                          throws IOException {
         super.setSocketOption(option, value);
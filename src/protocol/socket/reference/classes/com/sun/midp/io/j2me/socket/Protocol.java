@@ -75,6 +75,13 @@ public class Protocol extends NetworkConnectionBase
      */
     private int handle = -1;
 
+    /**
+     * True if the push registry may hold data that arrived for this
+     * connection before it was accepted. Set and cleared only by
+     * native code.
+     */
+    private boolean pushDataPending;
+
     /** Lock object for reading from the socket */
     private final Object readerLock = new Object();
 
@@ -524,6 +531,56 @@ public class Protocol extends NetworkConnectionBase
         }
     }
 
+    /**
+     * Writes several byte array segments to the socket in order, as if
+     * by consecutive calls to <code>writeBytes</code>. The segments are
+     * handed to the network in one native call, so that for instance
+     * HTTP request headers and body do not leave in separate TCP
+     * segments. Whatever that call could not send without blocking is
+     * finished with ordinary writes.
+     *
+     * @param      b      the segment buffers
+     * @param      off    the start offset of each segment in its buffer
+     * @param      len    the number of bytes of each segment
+     * @param      count  the number of segments
+     * @exception  IOException  if an I/O error occurs.
+     */
+    public void writeGathered(byte b[][], int off[], int len[], int count)
+            throws IOException {
+        int written;
+
+        for (int i = 0; i < count; i++) {
+            if (off[i] < 0 || len[i] < 0 || off[i] + len[i] > b[i].length) {
+                throw new IndexOutOfBoundsException();
+            }
+        }
+
+        synchronized (writerLock) {
+            written = writev0(b, off, len, count);
+
+            for (int i = 0; i < count; i++) {
+                int start = off[i];
+                int left = len[i];
+
+                if (written >= left) {
+                    written -= left;
+                    continue;
+                }
+
+                start += written;
+                left -= written;
+                written = 0;
+
+                while (left > 0) {
+                    int n = write0(b[i], start, left);
+
+                    start += n;
+                    left -= n;
+                }
+            }
+        }
+    }
+
     /**
      * Called once by the child output stream. The output side of the socket
      * will be shutdown and then the parent method will be called.
@@ -722,6 +779,21 @@ public class Protocol extends NetworkConnectionBase
     private native int write0(byte b[], int off, int len)
         throws IOException;
 
+    /**
+     * Writes several segments to the open socket connection with one
+     * gathered send, without blocking.
+     *
+     * @param      b      the segment buffers
+     * @param      off    the start offset of each segment in its buffer
+     * @param      len    the number of bytes of each segment
+     * @param      count  the number of segments
+     * @return     the total number of bytes written, 0 if the send
+     *             would block or gathered sends are not supported
+     * @exception  IOException  if an I/O error occurs.
+     */
+    private native int writev0(byte b[][], int off[], int len[], int count)
+        throws IOException;
+
     /**
      * Gets the number of bytes that can be read without blocking.
      *
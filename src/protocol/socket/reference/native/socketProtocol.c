@@ -40,12 +40,20 @@
 #include <midpResourceLimit.h>
 #include <string.h>
 #include <pcsl_network.h>
+#include <gcf_hostcache.h>
 #include <midp_thread.h>
 #include <midp_libc_ext.h>
 #include <kni_globals.h>
 #include <midpUtilKni.h>
 #include <midp_net_events.h>
 
+#if ENABLE_SOCKET_WRITEV
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 #define SOCK_ANC_INC_NETWORK_INDICATOR \
     ANC_INC_NETWORK_INDICATOR \
     getMidpSocketProtocolPtr(thisObject)->pendingConnections++;
@@ -65,6 +73,9 @@
 typedef struct Java_com_sun_midp_io_j2me_socket_Protocol _socketProtocol;
 #define getMidpSocketProtocolPtr(handle) (unhand(_socketProtocol,(handle)))
 
+/** Maximum number of segments sent by one gathered write. */
+#define MAX_GATHERED_SEGMENTS 8
+
 /**
  * Opens a TCP connection to a server.
  * <p>
@@ -116,6 +127,7 @@ Java_com_sun_midp_io_j2me_socket_Protocol_open0(void) {
 
             if (status == PCSL_NET_SUCCESS) {
                 getMidpSocketProtocolPtr(thisObject)->handle = (jint)pcslHandle;
+                midp_register_socket_handle(pcslHandle);
                 if (midpIncResourceCount(RSC_TYPE_TCP_CLI, 1) == 0) {
                     REPORT_INFO(LC_PROTOCOL, "Resource limit update error"); 
                 }
@@ -134,6 +146,7 @@ Java_com_sun_midp_io_j2me_socket_Protocol_open0(void) {
             } else if (status == PCSL_NET_WOULDBLOCK) {
                 SOCK_ANC_INC_NETWORK_INDICATOR;
                 getMidpSocketProtocolPtr(thisObject)->handle = (jint)pcslHandle;
+                midp_register_socket_handle(pcslHandle);
                 if (midpIncResourceCount(RSC_TYPE_TCP_CLI, 1) == 0) {
                     REPORT_INFO(LC_PROTOCOL, "Resource limit update error"); 
                 }
@@ -226,7 +239,12 @@ Java_com_sun_midp_io_j2me_socket_Protocol_read0(void) {
     REPORT_INFO3(LC_PROTOCOL, "socket::read0 o=%d l=%d fd=%d\n",
                  offset, length, (int)pcslHandle);
 
-    if (pcslHandle != INVALID_HANDLE) {
+    /*
+     * Only connections handed over by the push registry can have
+     * a cached packet, others go straight to the platform.
+     */
+    if (pcslHandle != INVALID_HANDLE &&
+            getMidpSocketProtocolPtr(thisObject)->pushDataPending) {
         int ipAddress;
         int port;
 
@@ -235,6 +253,11 @@ Java_com_sun_midp_io_j2me_socket_Protocol_read0(void) {
         bytesRead = pushgetcachedpacket((int)pcslHandle, &ipAddress, &port,
             (char*)&(JavaByteArray(bufferObject)[offset]), length);
         SNI_END_RAW_POINTERS;
+
+        if (bytesRead < 0) {
+            /* The cache has been drained, nothing more will be put there. */
+            getMidpSocketProtocolPtr(thisObject)->pushDataPending = KNI_FALSE;
+        }
     }
 
     if (bytesRead <= 0) {
@@ -428,6 +451,106 @@ Java_com_sun_midp_io_j2me_socket_Protocol_write0(void) {
     KNI_ReturnInt((jint)bytesWritten);
 }
 
+/**
+ * Writes several segments to the open socket connection with one
+ * gathered send. The send never blocks: the bytes it could not send
+ * are left for write0, which waits for the socket to become writable.
+ * <p>
+ * Java declaration:
+ * <pre>
+ *     writev0([[B[I[II)I
+ * </pre>
+ *
+ * @param b the segment buffers
+ * @param off the start offset of each segment in its buffer
+ * @param len the number of bytes of each segment
+ * @param count the number of segments; only the first
+ *              <tt>MAX_GATHERED_SEGMENTS</tt> are sent
+ *
+ * @return the total number of bytes written, 0 if none could be sent
+ *         without blocking or the platform has no gathered sends
+ */
+KNIEXPORT KNI_RETURNTYPE_INT
+Java_com_sun_midp_io_j2me_socket_Protocol_writev0(void) {
+    int count;
+    void *pcslHandle;
+    int bytesWritten = 0;
+
+    count = (int)KNI_GetParameterAsInt(4);
+
+    KNI_StartHandles(5);
+
+    KNI_DeclareHandle(buffersObject);
+    KNI_DeclareHandle(offsetsObject);
+    KNI_DeclareHandle(lengthsObject);
+    KNI_DeclareHandle(bufferObject);
+    KNI_DeclareHandle(thisObject);
+    KNI_GetThisPointer(thisObject);
+    KNI_GetParameterAsObject(1, buffersObject);
+    KNI_GetParameterAsObject(2, offsetsObject);
+    KNI_GetParameterAsObject(3, lengthsObject);
+
+    pcslHandle = (void *)(getMidpSocketProtocolPtr(thisObject)->handle);
+
+    REPORT_INFO2(LC_PROTOCOL, "socket::writev0 count=%d fd=%d\n", 
+                 count, pcslHandle);
+
+    if (count > MAX_GATHERED_SEGMENTS) {
+        count = MAX_GATHERED_SEGMENTS;
+    }
+
+    if (INVALID_HANDLE == pcslHandle) {
+        KNI_ThrowNew(midpIOException, 
+                     "invalid handle during socket::writev");
+    } else if (count > 0) {
+#if ENABLE_SOCKET_WRITEV
+        struct iovec iov[MAX_GATHERED_SEGMENTS];
+        struct msghdr msg;
+        int fd = (int)pcslHandle;
+        int i;
+
+        memset(&msg, 0, sizeof (msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
+        SNI_BEGIN_RAW_POINTERS;
+        for (i = 0; i < count; i++) {
+            KNI_GetObjectArrayElement(buffersObject, (jint)i, bufferObject);
+            iov[i].iov_base = (char*)&(JavaByteArray(bufferObject)
+                [KNI_GetIntArrayElement(offsetsObject, (jint)i)]);
+            iov[i].iov_len =
+                (size_t)KNI_GetIntArrayElement(lengthsObject, (jint)i);
+        }
+
+        do {
+            bytesWritten = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (bytesWritten < 0 && errno == EINTR);
+        SNI_END_RAW_POINTERS;
+
+        if (bytesWritten < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                /* Nothing sent, write0 will wait for the socket. */
+                bytesWritten = 0;
+            } else {
+                midp_snprintf(gKNIBuffer, KNI_BUFFER_SIZE,
+                        "IOError %d during socket:: writev \n", errno);
+                bytesWritten = 0;
+                KNI_ThrowNew(midpIOException, gKNIBuffer);
+            }
+        }
+#else
+        /* No gathered sends here, write0 sends each segment. */
+        (void)bufferObject;
+#endif
+    }
+
+    REPORT_INFO1(LC_PROTOCOL, "socket::writev0 bytesWritten=%d\n", 
+                 bytesWritten);
+    KNI_EndHandles();
+
+    KNI_ReturnInt((jint)bytesWritten);
+}
+
 /**
  * Gets the number of bytes that can be read without blocking.
  * <p>
@@ -441,6 +564,7 @@ Java_com_sun_midp_io_j2me_socket_Protocol_write0(void) {
 KNIEXPORT KNI_RETURNTYPE_INT
 Java_com_sun_midp_io_j2me_socket_Protocol_available0(void) {
     void *pcslHandle;
+    jboolean pushDataPending;
     int bytesAvailable = 0;
 
     KNI_StartHandles(1);
@@ -448,6 +572,7 @@ Java_com_sun_midp_io_j2me_socket_Protocol_available0(void) {
     KNI_GetThisPointer(thisObject);
     
     pcslHandle = (void *)(getMidpSocketProtocolPtr(thisObject)->handle);
+    pushDataPending = getMidpSocketProtocolPtr(thisObject)->pushDataPending;
 
     KNI_EndHandles();
 
@@ -459,7 +584,9 @@ Java_com_sun_midp_io_j2me_socket_Protocol_available0(void) {
         int status;
 
         /* Check the push cache for a waiting packet. */
-        bytesAvailable = pushcacheddatasize((int)pcslHandle);
+        if (pushDataPending) {
+            bytesAvailable = pushcacheddatasize((int)pcslHandle);
+        }
         if (bytesAvailable <= 0) {
             status = pcsl_socket_available(pcslHandle, &bytesAvailable);
             /* status is only PCSL_NET_SUCCESS or PCSL_NET_IOERROR */
@@ -508,6 +635,7 @@ Java_com_sun_midp_io_j2me_socket_Protocol_close0(void) {
             KNI_ThrowNew(midpIOException,
                 "invalid handle during socket::close");
         } else {
+            midp_unregister_socket_handle(pcslHandle);
             status = pcsl_socket_close_start(pcslHandle, &context);
 
             getMidpSocketProtocolPtr(thisObject)->handle =
@@ -573,6 +701,7 @@ Java_com_sun_midp_io_j2me_socket_Protocol_finalize(void) {
     REPORT_INFO1(LC_PROTOCOL, "socket::finalize handle=%d\n", pcslHandle);
 
     if (INVALID_HANDLE != pcslHandle) {
+        midp_unregister_socket_handle(pcslHandle);
         status = pcsl_socket_close_start(pcslHandle, &context);
 
         getMidpSocketProtocolPtr(thisObject)->handle = (jint)INVALID_HANDLE;
@@ -634,8 +763,8 @@ Java_com_sun_midp_io_j2me_socket_Protocol_getIpNumber0(void) {
     if (info == NULL) {  /* First invocation */
         GET_PARAMETER_AS_PCSL_STRING(1, host)
             const jbyte * const host_bytes = pcsl_string_get_utf8_data(&host);
-            status = pcsl_network_gethostbyname_start(
-                    (char*)host_bytes,
+            status = hostCacheResolveStart(
+                    (const char*)host_bytes,
                     ipBytes, MAX_ADDR_LENGTH, &len, &pcslHandle, &context);
 
             pcsl_string_release_utf8_data(host_bytes, &host);
@@ -646,8 +775,8 @@ Java_com_sun_midp_io_j2me_socket_Protocol_getIpNumber0(void) {
         /* All but windows implementations of pcsl_network_gethostbyname_finish */
         /*  ignore context parameter. Windows one expects status code there. */
         context = (void*)info->status;
-        status = pcsl_network_gethostbyname_finish(ipBytes, MAX_ADDR_LENGTH,
-                                                  &len, pcslHandle, context);
+        status = hostCacheResolveFinish(ipBytes, MAX_ADDR_LENGTH,
+                                        &len, pcslHandle, context);
     }
 
     if (status == PCSL_NET_SUCCESS) {
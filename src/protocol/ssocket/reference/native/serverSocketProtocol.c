@@ -42,8 +42,13 @@
 #include <midp_logging.h>
 #include <midpResourceLimit.h>
 #include <midp_thread.h>
+#include <midp_net_events.h>
 #include <suitestore_common.h>
 
+#if ENABLE_SERVER_SOCKET_BACKLOG
+#include <midpMalloc.h>
+#endif
+
 /**
  * @file
  *
@@ -59,6 +64,192 @@ typedef struct Java_com_sun_midp_io_j2me_serversocket_Socket _serversocketProtoc
 typedef struct Java_com_sun_midp_io_j2me_socket_Protocol _socketProtocol;
 #define getMidpSocketProtocolPtr(handle) (unhand(_socketProtocol,(handle)))
 
+#if ENABLE_SERVER_SOCKET_BACKLOG
+
+/** Number of connections that can be accepted ahead for a server socket. */
+#define ACCEPT_QUEUE_SIZE 4
+
+/**
+ * Number of TCP client sockets that accepting ahead leaves to the
+ * application under the resource limit.
+ */
+#define ACCEPT_QUEUE_RESERVE ACCEPT_QUEUE_SIZE
+
+/**
+ * Connections accepted for a server socket but not yet handed to Java.
+ * They are already counted against the TCP client resource limit.
+ */
+typedef struct _AcceptQueue {
+    /** Handle of the server socket */
+    int serverHandle;
+    /** Number of queued connections */
+    int count;
+    /** Handles of the queued connections, oldest first */
+    void* handles[ACCEPT_QUEUE_SIZE];
+    /** Queue of the next server socket */
+    struct _AcceptQueue* next;
+} AcceptQueue;
+
+/** Accept queues of the server sockets that have accepted connections. */
+static AcceptQueue* acceptQueueList = NULL;
+
+/**
+ * Finds the accept queue of a server socket.
+ *
+ * @param serverHandle handle of the server socket
+ * @param create KNI_TRUE to create the queue if there is none
+ *
+ * @return the queue, or NULL if there is none or it cannot be created
+ */
+static AcceptQueue*
+findAcceptQueue(int serverHandle, int create) {
+    AcceptQueue* q;
+
+    for (q = acceptQueueList; q != NULL; q = q->next) {
+        if (q->serverHandle == serverHandle) {
+            return q;
+        }
+    }
+
+    if (create) {
+        q = (AcceptQueue*)midpMalloc(sizeof (AcceptQueue));
+        if (q != NULL) {
+            q->serverHandle = serverHandle;
+            q->count = 0;
+            q->next = acceptQueueList;
+            acceptQueueList = q;
+        }
+    }
+
+    return q;
+}
+
+/**
+ * Takes the oldest connection accepted ahead for a server socket.
+ *
+ * @param serverHandle handle of the server socket
+ *
+ * @return the connection handle, or -1 if none is queued
+ */
+static void*
+acceptQueueTake(int serverHandle) {
+    AcceptQueue* q = findAcceptQueue(serverHandle, KNI_FALSE);
+    void* connectionHandle;
+    int i;
+
+    if (q == NULL || q->count == 0) {
+        return (void*)-1;
+    }
+
+    connectionHandle = q->handles[0];
+    q->count--;
+    for (i = 0; i < q->count; i++) {
+        q->handles[i] = q->handles[i + 1];
+    }
+
+    return connectionHandle;
+}
+
+/**
+ * Accepts the connections still pending on a server socket, so that
+ * the next accept0 calls need not wait for another network event.
+ * Stops when the queue is full, nothing is pending, or the TCP client
+ * resource limit is nearly reached, so that connections accepted ahead
+ * do not take the last client sockets from the application.
+ * <p>
+ * Server sockets owned by push are not accepted ahead for: on check-in
+ * the pending connections are left to push, which filters them and
+ * launches the MIDlet.
+ *
+ * @param serverHandle handle of the server socket
+ */
+static void
+acceptQueueFill(int serverHandle) {
+    AcceptQueue* q;
+    void* connectionHandle;
+    void* context = NULL;
+    int status;
+
+    if (pushownsfd(serverHandle)) {
+        return;
+    }
+
+    q = findAcceptQueue(serverHandle, KNI_TRUE);
+    if (q == NULL) {
+        return;
+    }
+
+    while (q->count < ACCEPT_QUEUE_SIZE &&
+           midpCheckResourceLimit(RSC_TYPE_TCP_CLI,
+                                  ACCEPT_QUEUE_RESERVE + 1) != 0) {
+        status = pcsl_serversocket_accept_start((void*)serverHandle,
+                                                &connectionHandle, &context);
+        if (status != PCSL_NET_SUCCESS) {
+            break;
+        }
+
+        if (midpIncResourceCount(RSC_TYPE_TCP_CLI, 1) == 0) {
+            REPORT_INFO(LC_PROTOCOL,
+                        "serversocket: Resource limit update error");
+        }
+
+        midp_register_socket_handle(connectionHandle);
+        q->handles[q->count++] = connectionHandle;
+    }
+
+    REPORT_INFO2(LC_PROTOCOL, "serversocket::accept handle=%d queued=%d\n",
+                 serverHandle, q->count);
+}
+
+/**
+ * Closes the connections accepted ahead for a server socket that is
+ * being closed and releases its queue. Push-owned server sockets
+ * never have connections queued.
+ *
+ * @param serverHandle handle of the server socket
+ */
+static void
+acceptQueueClose(int serverHandle) {
+    AcceptQueue** pq;
+    AcceptQueue* q;
+    void* context;
+    int i;
+
+    for (pq = &acceptQueueList; *pq != NULL; pq = &(*pq)->next) {
+        if ((*pq)->serverHandle == serverHandle) {
+            break;
+        }
+    }
+
+    q = *pq;
+    if (q == NULL) {
+        return;
+    }
+
+    *pq = q->next;
+
+    for (i = 0; i < q->count; i++) {
+        context = NULL;
+        midp_unregister_socket_handle(q->handles[i]);
+        if (pcsl_socket_close_start(q->handles[i], &context) ==
+                PCSL_NET_WOULDBLOCK) {
+            /* blocking close is not waited for here */
+            REPORT_INFO1(LC_PROTOCOL,
+                         "serversocket: queued connection 0x%x blocked\n",
+                         q->handles[i]);
+        }
+
+        if (midpDecResourceCount(RSC_TYPE_TCP_CLI, 1) == 0) {
+            REPORT_INFO(LC_PROTOCOL,
+                        "serversocket: Resource limit update error");
+        }
+    }
+
+    midpFree(q);
+}
+
+#endif /* ENABLE_SERVER_SOCKET_BACKLOG */
+
 /**
  * Opens a server socket connection on the given port.  If successful,
  * stores a handle directly into the nativeHandle field.  If unsuccessful,
@@ -141,6 +332,7 @@ Java_com_sun_midp_io_j2me_serversocket_Socket_open0(void) {
 
             if (status == PCSL_NET_SUCCESS) {
                 getMidpServerSocketProtocolPtr(thisObject)->nativeHandle = (jint)pcslHandle;
+                midp_register_socket_handle(pcslHandle);
                 REPORT_INFO2(LC_PROTOCOL,
                              "serversocket::open port = %d handle = %d\n",
                              port, pcslHandle);
@@ -202,6 +394,10 @@ Java_com_sun_midp_io_j2me_serversocket_Socket_close0(void) {
         if (serverSocketHandle == (int)INVALID_HANDLE) {
             REPORT_INFO(LC_PROTOCOL, "serversocket::close Invalid handle\n");
         } else {
+#if ENABLE_SERVER_SOCKET_BACKLOG
+            acceptQueueClose(serverSocketHandle);
+#endif
+
             /*
              * The pushcheckin() function returns -1 on error.  If pushcheckin()
              * was successful, socket was checked back into the push registry, and
@@ -211,6 +407,7 @@ Java_com_sun_midp_io_j2me_serversocket_Socket_close0(void) {
              * IMPL NOTE: how to do resource accounting for the push case?
              */
             if (pushcheckin(serverSocketHandle) == -1) {
+                midp_unregister_socket_handle((void*)serverSocketHandle);
                 status = pcsl_socket_close_start((void*)serverSocketHandle,
                                                  &context);
                 resUpdate = 1;
@@ -291,6 +488,7 @@ Java_com_sun_midp_io_j2me_serversocket_Socket_accept0(void) {
     void* connectionHandle = INVALID_HANDLE;
     int status = PCSL_NET_INVALID;
     int processStatus = KNI_FALSE;
+    jboolean fromPush = KNI_FALSE;
     void *context = NULL;
 
     KNI_StartHandles(2);
@@ -321,6 +519,16 @@ Java_com_sun_midp_io_j2me_serversocket_Socket_accept0(void) {
              * IMPL NOTE: how to do resource accounting for the push case?
              */
             connectionHandle = (void*)pushcheckoutaccept(serverSocketHandle);
+            fromPush = (connectionHandle != (void*)-1);
+#if ENABLE_SERVER_SOCKET_BACKLOG
+            if (connectionHandle == (void*)-1) {
+                /*
+                 * Take a connection accepted by an earlier call; it has
+                 * been counted against the resource limit already.
+                 */
+                connectionHandle = acceptQueueTake(serverSocketHandle);
+            }
+#endif
             if (connectionHandle == (void*)-1) {
                 /*
                  * An incoming socket connection counts against the client socket
@@ -370,6 +578,14 @@ Java_com_sun_midp_io_j2me_serversocket_Socket_accept0(void) {
                     REPORT_INFO(LC_PROTOCOL,
                                 "serversocket: Resource limit update error");
                 }
+                midp_register_socket_handle(connectionHandle);
+#if ENABLE_SERVER_SOCKET_BACKLOG
+                /*
+                 * Connections come in bursts; accept the rest of the
+                 * burst now instead of one per network event.
+                 */
+                acceptQueueFill(serverSocketHandle);
+#endif
             } else if (status == PCSL_NET_WOULDBLOCK) {
                 midp_thread_wait(NETWORK_READ_SIGNAL,
                                  serverSocketHandle, context);
@@ -393,6 +609,9 @@ Java_com_sun_midp_io_j2me_serversocket_Socket_accept0(void) {
              */
             (getMidpSocketProtocolPtr(socketObject))->handle =
                 (jint)connectionHandle;
+            /* Only a pushed connection may have data in the push cache. */
+            (getMidpSocketProtocolPtr(socketObject))->pushDataPending =
+                fromPush;
         }
     }
 
@@ -426,7 +645,11 @@ Java_com_sun_midp_io_j2me_serversocket_Socket_finalize(void) {
         serverSocketHandle);
 
     if (serverSocketHandle != (int)INVALID_HANDLE) {
+#if ENABLE_SERVER_SOCKET_BACKLOG
+        acceptQueueClose(serverSocketHandle);
+#endif
         if (pushcheckin(serverSocketHandle) == -1) {
+            midp_unregister_socket_handle((void*)serverSocketHandle);
             status = pcsl_socket_close_start(
                 (void*)serverSocketHandle, &context);
             if (midpDecResourceCount(RSC_TYPE_TCP_SER, 1) == 0) {
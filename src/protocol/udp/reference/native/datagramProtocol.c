@@ -24,6 +24,11 @@
  * information or have any questions.
  */
 
+#if ENABLE_DATAGRAM_RECVMMSG
+/* recvmmsg is a GNU extension */
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 
 #include <kni.h>
@@ -39,12 +44,21 @@
 #include <midpMalloc.h>
 #include <string.h>
 #include <pcsl_network.h>
+#include <gcf_hostcache.h>
 #include <midp_thread.h>
 #include <midp_libc_ext.h>
 #include <kni_globals.h>
 #include <pcsl_memory.h>
 #include <suitestore_common.h>
 #include <midpUtilKni.h>
+#include <midp_net_events.h>
+
+#if ENABLE_DATAGRAM_RECVMMSG
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
 
 /**
  * @file
@@ -57,6 +71,208 @@
 typedef struct Java_com_sun_midp_io_j2me_datagram_Protocol _datagramProtocol;
 #define getMidpDatagramProtocolPtr(handle) (unhand(_datagramProtocol,(handle)))
 
+#if ENABLE_DATAGRAM_RECVMMSG
+
+/** Number of datagrams that can be read ahead for one connection. */
+#define DATAGRAM_READ_AHEAD 4
+
+/**
+ * Capacity of a read-ahead slot, the largest payload of an IPv4
+ * datagram that fits an Ethernet frame. Datagrams are only read ahead
+ * for receive calls whose buffer is not larger than this.
+ */
+#define DATAGRAM_SLOT_SIZE 1472
+
+/**
+ * Datagrams received for a connection by a batched receive but not yet
+ * handed to Java.
+ */
+typedef struct _DatagramReadAhead {
+    /** Native handle of the connection */
+    int handle;
+    /** Index of the next datagram to hand out */
+    int next;
+    /** Number of datagrams not yet handed out */
+    int count;
+    /** Raw IPv4 address of the sender of each datagram */
+    int ipAddress[DATAGRAM_READ_AHEAD];
+    /** Port of the sender of each datagram */
+    int port[DATAGRAM_READ_AHEAD];
+    /** Number of bytes of each datagram */
+    int length[DATAGRAM_READ_AHEAD];
+    /** Data of each datagram */
+    char data[DATAGRAM_READ_AHEAD][DATAGRAM_SLOT_SIZE];
+    /** Read-ahead of the next connection */
+    struct _DatagramReadAhead *nextEntry;
+} DatagramReadAhead;
+
+/** Read-ahead buffers of the connections that have used batching. */
+static DatagramReadAhead *datagramReadAheadList = NULL;
+
+/**
+ * Finds the read-ahead buffer of a connection.
+ *
+ * @param handle native handle of the connection
+ * @return the buffer or NULL if the connection has none
+ */
+static DatagramReadAhead*
+datagramFindReadAhead(int handle) {
+    DatagramReadAhead *p;
+
+    for (p = datagramReadAheadList; p != NULL; p = p->nextEntry) {
+        if (p->handle == handle) {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Releases the read-ahead buffer of a connection being closed, dropping
+ * any datagrams not handed out.
+ *
+ * @param handle native handle of the connection
+ */
+static void
+datagramFreeReadAhead(int handle) {
+    DatagramReadAhead **pp;
+
+    for (pp = &datagramReadAheadList; *pp != NULL; pp = &(*pp)->nextEntry) {
+        if ((*pp)->handle == handle) {
+            DatagramReadAhead *p = *pp;
+
+            *pp = p->nextEntry;
+            midpFree(p);
+            return;
+        }
+    }
+}
+
+/**
+ * Copies the sender address out of a received socket address.
+ *
+ * @param addr the address filled in by the receive
+ * @param pIpAddress receives the raw IPv4 address
+ * @param pPort receives the port
+ */
+static void
+datagramGetSender(struct sockaddr_in *addr, int *pIpAddress, int *pPort) {
+    memcpy(pIpAddress, &addr->sin_addr.s_addr, MAX_ADDR_LENGTH);
+    *pPort = ntohs(addr->sin_port);
+}
+
+/**
+ * Hands out the next datagram read ahead for a connection. If there is
+ * none, receives whatever the socket has queued, up to one datagram for
+ * the caller and DATAGRAM_READ_AHEAD more, with one recvmmsg call that
+ * does not block.
+ * <p>
+ * The read-ahead buffer is only allocated once a receive has found a
+ * datagram already waiting, so connections that always wait for their
+ * datagrams in PCSL do not hold one. Nothing is read ahead on a
+ * connection owned by push: the connection goes back to push when it
+ * is closed, and the datagrams the application has not seen must still
+ * be on the socket then.
+ * <p>
+ * A datagram larger than the caller's buffer is truncated, the same as
+ * with an ordinary receive; a read-ahead datagram is truncated to the
+ * slot size, which is at least the caller's buffer size.
+ *
+ * @param handle native handle of the connection
+ * @param pIpAddress receives the raw IPv4 address of the sender
+ * @param pPort receives the port of the sender
+ * @param buffer buffer for the datagram data
+ * @param length size of the buffer
+ * @return number of bytes received, or -1 if no datagram is waiting or
+ *         the receive failed; the caller then receives through PCSL
+ *         to wait or report the error
+ */
+static int
+datagramReceiveBatched(int handle, int *pIpAddress, int *pPort,
+                       char *buffer, int length) {
+    DatagramReadAhead *p = datagramFindReadAhead(handle);
+    struct mmsghdr msgs[DATAGRAM_READ_AHEAD + 1];
+    struct iovec iov[DATAGRAM_READ_AHEAD + 1];
+    struct sockaddr_in addrs[DATAGRAM_READ_AHEAD + 1];
+    int readAhead;
+    int nmsgs;
+    int received;
+    int i;
+
+    if (p != NULL && p->count > 0) {
+        int n = p->length[p->next];
+
+        if (n > length) {
+            n = length;
+        }
+
+        memcpy(buffer, p->data[p->next], n);
+        *pIpAddress = p->ipAddress[p->next];
+        *pPort = p->port[p->next];
+        p->next++;
+        p->count--;
+        return n;
+    }
+
+    readAhead = !pushownsfd(handle);
+
+    nmsgs = 1;
+    if (p != NULL && readAhead && length <= DATAGRAM_SLOT_SIZE) {
+        nmsgs += DATAGRAM_READ_AHEAD;
+    }
+
+    memset(msgs, 0, nmsgs * sizeof (struct mmsghdr));
+    for (i = 0; i < nmsgs; i++) {
+        if (i == 0) {
+            iov[i].iov_base = buffer;
+            iov[i].iov_len = (size_t)length;
+        } else {
+            iov[i].iov_base = p->data[i - 1];
+            iov[i].iov_len = DATAGRAM_SLOT_SIZE;
+        }
+
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_in);
+    }
+
+    do {
+        received = recvmmsg(handle, msgs, nmsgs, MSG_DONTWAIT, NULL);
+    } while (received < 0 && errno == EINTR);
+
+    if (received <= 0) {
+        return -1;
+    }
+
+    if (p == NULL && readAhead) {
+        p = (DatagramReadAhead*)midpMalloc(sizeof (DatagramReadAhead));
+        if (p != NULL) {
+            p->handle = handle;
+            p->next = 0;
+            p->count = 0;
+            p->nextEntry = datagramReadAheadList;
+            datagramReadAheadList = p;
+        }
+    }
+
+    for (i = 1; i < received; i++) {
+        datagramGetSender(&addrs[i], &p->ipAddress[i - 1], &p->port[i - 1]);
+        p->length[i - 1] = (int)msgs[i].msg_len;
+    }
+
+    if (received > 1) {
+        p->next = 0;
+        p->count = received - 1;
+    }
+
+    datagramGetSender(&addrs[0], pIpAddress, pPort);
+    return (int)msgs[0].msg_len;
+}
+
+#endif /* ENABLE_DATAGRAM_RECVMMSG */
+
 /**
  * Opens a datagram connection on the given port.
  * <p>
@@ -139,8 +355,10 @@ Java_com_sun_midp_io_j2me_datagram_Protocol_open0(void) {
                 }
                 getMidpDatagramProtocolPtr(thisObject)->nativeHandle
                     = (jint)socketHandle;
+                midp_register_socket_handle(socketHandle);
                 ANC_DEC_NETWORK_INDICATOR;
             } else if (status == PCSL_NET_WOULDBLOCK) {
+                midp_register_socket_handle(socketHandle);
                 midp_thread_wait(NETWORK_WRITE_SIGNAL, (int)socketHandle,
                     context);
             } else {
@@ -339,6 +557,21 @@ Java_com_sun_midp_io_j2me_datagram_Protocol_receive0(void) {
             &port, (char*)&(JavaByteArray(bufferObject)[offset]), length);
         SNI_END_RAW_POINTERS;
 
+#if ENABLE_DATAGRAM_RECVMMSG
+        if (bytesReceived < 0 && info == NULL) {
+            /*
+             * Take a datagram read ahead earlier, or receive all waiting
+             * datagrams with one call. Only when none is waiting does
+             * PCSL read below and block the thread.
+             */
+            SNI_BEGIN_RAW_POINTERS;
+            bytesReceived = datagramReceiveBatched((int)socketHandle,
+                &ipAddress, &port,
+                (char*)&(JavaByteArray(bufferObject)[offset]), length);
+            SNI_END_RAW_POINTERS;
+        }
+#endif
+
         if (bytesReceived < 0) {
             int status;
             unsigned char ipBytes[MAX_ADDR_LENGTH];
@@ -386,7 +619,7 @@ Java_com_sun_midp_io_j2me_datagram_Protocol_receive0(void) {
                 ANC_DEC_NETWORK_INDICATOR;
             }
         } else {
-            /* push gave us a datagram */
+            /* push or the read-ahead gave us a datagram */
             lres = pack_recv_retval(ipAddress, port, bytesReceived);
         }
     } else {
@@ -440,6 +673,10 @@ Java_com_sun_midp_io_j2me_datagram_Protocol_close0(void) {
             if (info == NULL) {
                 /* first invocation */
                 ANC_INC_NETWORK_INDICATOR;
+#if ENABLE_DATAGRAM_RECVMMSG
+                datagramFreeReadAhead((int)socketHandle);
+#endif
+                midp_unregister_socket_handle(socketHandle);
                 status = pcsl_datagram_close_start(socketHandle, &context);
 
                 getMidpDatagramProtocolPtr(thisObject)->nativeHandle =
@@ -559,8 +796,8 @@ Java_com_sun_midp_io_j2me_datagram_Protocol_getIpNumber(void) {
         GET_PARAMETER_AS_PCSL_STRING(1, host)
             const jbyte * const host_bytes = pcsl_string_get_utf8_data(&host);
 
-            status = pcsl_network_gethostbyname_start(
-                   (char*)host_bytes,
+            status = hostCacheResolveStart(
+                   (const char*)host_bytes,
                     ipBytes, MAX_ADDR_LENGTH, &len, &handle, &context);
 
             pcsl_string_release_utf8_data(host_bytes, &host);
@@ -572,8 +809,8 @@ Java_com_sun_midp_io_j2me_datagram_Protocol_getIpNumber(void) {
         /* All but windows implementations of pcsl_network_gethostbyname_finish */
         /*  ignore context parameter. Windows one expects status code there. */
         context = (void*)info->status;
-        status = pcsl_network_gethostbyname_finish(ipBytes, MAX_ADDR_LENGTH,
-                                                  &len, handle, context);
+        status = hostCacheResolveFinish(ipBytes, MAX_ADDR_LENGTH,
+                                        &len, handle, context);
     }
 
     if (status == PCSL_NET_SUCCESS) {
@@ -723,6 +960,10 @@ Java_com_sun_midp_io_j2me_datagram_Protocol_finalize(void) {
 
     if (handle != INVALID_HANDLE) {
         if (pushcheckin((int)handle) == -1) {
+#if ENABLE_DATAGRAM_RECVMMSG
+            datagramFreeReadAhead((int)handle);
+#endif
+            midp_unregister_socket_handle(handle);
             status = pcsl_datagram_close_start(handle, &context);
             if (status == PCSL_NET_SUCCESS) {
                 if (midpDecResourceCount(RSC_TYPE_UDP, 1) == 0) {
@@ -108,6 +108,14 @@ int pushcheckout(char* protocol, int port, char* store);
  */
 int pushcheckin(int fd);
 
+/**
+ * Check if a handle belongs to a push connection, checked out or not.
+ * @param fd The handle to look up
+ * @return <tt>1</tt> if the handle is owned by the push registry, or
+ * <tt>0</tt> otherwise
+ */
+int pushownsfd(int fd);
+
 /**
  * Given the connection string and a port number, look up 
  * the push entry and return its filter.
@@ -59,6 +59,7 @@
 #include <midp_libc_ext.h>
 #include <kni_globals.h>
 #include <midp_thread.h>
+#include <midp_net_events.h>
 #include <pcsl_network.h>
 #include <pcsl_socket.h>
 #include <pcsl_serversocket.h>
@@ -108,10 +109,29 @@ PCSL_DEFINE_STATIC_ASCII_STRING_LITERAL_START(ALARM_LIST_FILENAME)
 {'a', 'l', 'a', 'r', 'm', 'l', 'i', 's', 't', '.', 't', 'x', 't', '\0'}
 PCSL_DEFINE_STATIC_ASCII_STRING_LITERAL_END(ALARM_LIST_FILENAME);
 
+/** Filename to journal push connection changes. ("pushlist.jnl") */
+PCSL_DEFINE_STATIC_ASCII_STRING_LITERAL_START(PUSH_JOURNAL_FILENAME)
+{'p', 'u', 's', 'h', 'l', 'i', 's', 't', '.', 'j', 'n', 'l', '\0'}
+PCSL_DEFINE_STATIC_ASCII_STRING_LITERAL_END(PUSH_JOURNAL_FILENAME);
+
+/** Filename to journal alarm changes. ("alarmlist.jnl") */
+PCSL_DEFINE_STATIC_ASCII_STRING_LITERAL_START(ALARM_JOURNAL_FILENAME)
+{'a', 'l', 'a', 'r', 'm', 'l', 'i', 's', 't', '.', 'j', 'n', 'l', '\0'}
+PCSL_DEFINE_STATIC_ASCII_STRING_LITERAL_END(ALARM_JOURNAL_FILENAME);
+
 /** Pathname for persistent push connection list. */
 static pcsl_string pushpathname = PCSL_STRING_NULL_INITIALIZER;
 /** Pathname for persistent alarm notification list. */
 static pcsl_string alarmpathname = PCSL_STRING_NULL_INITIALIZER;
+/** Pathname for the journal of push connection list changes. */
+static pcsl_string pushjournalpathname = PCSL_STRING_NULL_INITIALIZER;
+/** Pathname for the journal of alarm notification list changes. */
+static pcsl_string alarmjournalpathname = PCSL_STRING_NULL_INITIALIZER;
+
+/** Number of records in the push journal since the last checkpoint. */
+static int pushJournalRecords = 0;
+/** Number of records in the alarm journal since the last checkpoint. */
+static int alarmJournalRecords = 0;
 
 /** Pointer to error message. */
 static char *errStr = NULL;
@@ -119,6 +139,16 @@ static char *errStr = NULL;
 /* Maximum buffer size for line parsing. */
 #define MAX_LINE 512
 
+/*
+ * Registry changes are appended to a journal as one line per change,
+ * the entry text prefixed with one of the record types below. After
+ * JOURNAL_CHECKPOINT_RECORDS changes the list file is rewritten and
+ * the journal is emptied.
+ */
+#define JOURNAL_ADD '+'
+#define JOURNAL_REMOVE '-'
+#define JOURNAL_CHECKPOINT_RECORDS 32
+
 /**
  * The internal representation of a datagram or TCP packet.
  * Datagrams read by the push mechanism are buffered in the push
@@ -137,6 +167,28 @@ typedef struct _packetentry {
     char buffer[MAX_CACHED_DATA_SIZE];
 } PacketEntry;
 
+/** The filter accepts every address. */
+#define FILTER_ANY 0
+/** The filter accepts the addresses that match a value under a mask. */
+#define FILTER_MASK 1
+/** The filter is matched against the address text by checkfilter(). */
+#define FILTER_PATTERN 2
+
+/**
+ * A push filter compiled when the entry is registered. Filters made of
+ * four literal or wildcard octets, optionally followed by a CIDR prefix
+ * length, become a value and a mask of an IPv4 address. Other filters
+ * keep being matched as strings.
+ */
+typedef struct _pushfilter {
+    /** One of FILTER_ANY, FILTER_MASK or FILTER_PATTERN. */
+    int kind;
+    /** Address bits required by a FILTER_MASK filter. */
+    unsigned int value;
+    /** Address bits compared by a FILTER_MASK filter. */
+    unsigned int mask;
+} PushFilter;
+
 /**
  * The internal representation of an entry in the Push Registry list. When
  * the push registry is initialized, the persistent push registry is read
@@ -153,6 +205,8 @@ typedef struct _pushentry {
     char *storagename;
     /** The filter with which to filter ip addresses. */
     char *filter;
+    /** The filter compiled for matching. */
+    PushFilter compiledFilter;
     /** The socket to listen to. */
     int fd;
     /** The socket to use for the connection. */
@@ -181,6 +235,12 @@ typedef struct _pushentry {
     /** True if this entry is a JSR 257 (NFC) entry. */
     jboolean isNFCEntry;
 #endif
+    /** Next entry in the same bucket of the handle index. */
+    struct _pushentry *nextByFd;
+    /** Handle the entry is indexed under, <tt>-1</tt> if not indexed. */
+    int indexedFd;
+    /** Registration order, entries added later have larger numbers. */
+    unsigned int seq;
 } PushEntry;
 
 /**
@@ -215,6 +275,43 @@ typedef struct _alarmentry {
 static PushEntry *pushlist = NULL;
 static AlarmEntry *alarmlist = NULL;
 
+/** Number of buckets in the push handle index, a power of two. */
+#define PUSH_INDEX_SIZE 64
+
+/** Maps a handle to its bucket in the push handle index. */
+#define PUSH_INDEX_BUCKET(fd) \
+    ((((unsigned int)(fd) >> 3) ^ ((unsigned int)(fd) >> 9)) & \
+     (PUSH_INDEX_SIZE - 1))
+
+/**
+ * Push entries hashed by the handle they listen on. Network events are
+ * matched against the registry through this index instead of walking
+ * the whole list.
+ */
+static PushEntry *pushFdIndex[PUSH_INDEX_SIZE];
+
+/** Source of the registration order numbers of push entries. */
+static unsigned int pushSequence = 0;
+
+/** Number of push entries holding a cached packet. */
+static int pushCachedCount = 0;
+
+/** Number of push entries waiting for data on an accepted socket. */
+static int pushWaitingCount = 0;
+
+/** Raw address of the last datagram sender converted to text. */
+static unsigned char pushLastSenderBytes[MAX_ADDR_LENGTH];
+
+/** Text form of pushLastSenderBytes, empty before the first conversion. */
+static char pushLastSender[MAX_HOST_LENGTH];
+
+/**
+ * Set when pushpoll() may have something to do: a push entry has to be
+ * reopened or a push or alarm event has been received. Cleared by
+ * pushpoll() when it finds nothing to report.
+ */
+static jboolean pushPollPending = KNI_TRUE;
+
 typedef enum {
     NET_STATUS_DOWN       = -3,
     NET_STATUS_GOING_DOWN = -2, /* network finalization is in progress */
@@ -246,13 +343,28 @@ static void pushListFree();
 static void alarmListFree();
 static int parsePushList(int);
 static int parseAlarmList(int);
+static int pushListAdd(char *value);
+static int alarmListAdd(char *value);
+static jboolean pushjournal(char type, char *value);
+static jboolean alarmjournal(char type, char *value);
+static int journalReplay(const pcsl_string *path, jboolean isAlarm);
 static int checkfilter(char *filter, char *ip);
+static void compilefilter(char *filter, PushFilter *compiled);
+static int pushfilteraccepts(PushEntry *pe, unsigned char *ipBytes,
+                             char *ip);
+static char *pushSenderAddress(unsigned char *ipBytes);
 static void pushcheckinentry(PushEntry *p);
 static void pushcleanupentry(PushEntry *p);
 static void pushDeleteSuiteNoVM(SuiteIdType id);
 static void pushDeleteSuiteLive(SuiteIdType id);
 static int pushOpenInternal(int startListening);
 static void pushDeleteEntry(PushEntry *p, PushEntry **pPrevNext);
+static void pushIndexEntry(PushEntry *p);
+static void pushUnindexEntry(PushEntry *p);
+static void pushSetState(PushEntry *p, int state);
+static PacketEntry* pushAllocCachedData(PushEntry *p);
+static void pushFreeCachedData(PushEntry *p);
+static PushEntry* pushFindByFd(int fd);
 static void alarmstart(AlarmEntry *entry, jlong alarm);
 static long readLine(char** ppszError, int handle, char* buffer, long length);
 
@@ -448,11 +560,17 @@ static void pushAddNetworkNotifier(PushEntry* pe) {
      * So add a notifier only if its not WMA connection.
      */
     if (!pe->isWMAEntry) {
-        /* Push only needs to know if a socket has data. */
+        /*
+         * Push only needs to know if a socket has data. Data may have
+         * arrived before the notifier was added, so the handle is
+         * registered again to have it reported.
+         */
         if (pushIsDatagramConnection(pe->value)) {
             pcsl_add_network_notifier((void *)pe->fd, PCSL_NET_CHECK_READ);
+            midp_register_socket_handle((void *)pe->fd);
         } else if (pushIsSocketConnection(pe->value)) {
             pcsl_add_network_notifier((void *)pe->fd, PCSL_NET_CHECK_ACCEPT);
+            midp_register_socket_handle((void *)pe->fd);
         }
     }
 }
@@ -493,7 +611,11 @@ static int pushOpenInternal(int startListening) {
          */
         if (PCSL_STRING_OK != pcsl_string_cat(
                                              storage_get_root(INTERNAL_STORAGE_ID),
-                                             &ALARM_LIST_FILENAME, &alarmpathname)) {
+                                             &ALARM_LIST_FILENAME, &alarmpathname) ||
+            PCSL_STRING_OK != pcsl_string_cat(
+                                             storage_get_root(INTERNAL_STORAGE_ID),
+                                             &ALARM_JOURNAL_FILENAME,
+                                             &alarmjournalpathname)) {
             alarm_status = -1;
         } else {
             alarm_status = alarmopen();
@@ -502,6 +624,7 @@ static int pushOpenInternal(int startListening) {
         if (alarm_status != 0) {
             REPORT_ERROR(LC_PROTOCOL, "Error: alarm open failed");
             pcsl_string_free(&alarmpathname);
+            pcsl_string_free(&alarmjournalpathname);
         }
 
     }
@@ -514,9 +637,15 @@ static int pushOpenInternal(int startListening) {
          */
         if (PCSL_STRING_OK != pcsl_string_cat(
                                              storage_get_root(INTERNAL_STORAGE_ID),
-                                             &PUSH_LIST_FILENAME, &pushpathname)) {
+                                             &PUSH_LIST_FILENAME, &pushpathname) ||
+            PCSL_STRING_OK != pcsl_string_cat(
+                                             storage_get_root(INTERNAL_STORAGE_ID),
+                                             &PUSH_JOURNAL_FILENAME,
+                                             &pushjournalpathname)) {
             push_status = -1;
         } else {
+            status = 0;
+
             /* Now read the registered connections. */
             pushfd = storage_open(&errStr, &pushpathname, OPEN_READ);
             if (errStr == NULL) {
@@ -526,33 +655,42 @@ static int pushOpenInternal(int startListening) {
                 /* Close the storage handle */
                 storageClose (&errStr, pushfd);
                 storageFreeError(errStr);
-
-                /*
-                 * IMPL_NOTE: don't check for -1 because in this case some
-                 * entries can be read anyway
-                 */
-                if (status != -2) { /* out of memory */
-                    if (startListening) {
-                        pushStartListening();
-                    }
-                } else {
-                    push_status = -1;
-                }
             } else {
                 REPORT_WARN1(LC_PROTOCOL,
                              "Warning: could not open push registration file: %s",
                              errStr);
                 /* 
-                 * This is normal until the first push registration
-                 * is created.
+                 * This is normal until the first checkpoint of
+                 * the push registrations.
                  */
                 storageFreeError(errStr);
             }
+
+            /* Apply the changes made after the file was written. */
+            if (status != -2) {
+                status = journalReplay(&pushjournalpathname, KNI_FALSE);
+                if (status == -2) {
+                    pushListFree();
+                }
+            }
+
+            /*
+             * IMPL_NOTE: don't check for -1 because in this case some
+             * entries can be read anyway
+             */
+            if (status != -2) { /* out of memory */
+                if (startListening) {
+                    pushStartListening();
+                }
+            } else {
+                push_status = -1;
+            }
         }
 
         if (push_status != 0) {
             REPORT_ERROR(LC_PROTOCOL, "Error: push open failed");
             pcsl_string_free(&pushpathname);
+            pcsl_string_free(&pushjournalpathname);
         }
     }
 
@@ -571,11 +709,14 @@ void pushclose() {
 #endif
     pcsl_string_free(&pushpathname);
     pcsl_string_free(&alarmpathname);
+    pcsl_string_free(&pushjournalpathname);
+    pcsl_string_free(&alarmjournalpathname);
 }
 
 /**
  * Saves the in memory cache of push registrations to a persistent
- * file for use in subsequent runs.
+ * file for use in subsequent runs. The journal is emptied once the
+ * file has been written.
  */
 static void pushsave() {
     int  pushfd;
@@ -595,7 +736,90 @@ static void pushsave() {
                      "Warning: could not write push registration file: %s",
                      errStr);
         storageFreeError(errStr);
+        return;
+    }
+
+    if (errStr != NULL) {
+        /* Keep the journal, the file may be incomplete. */
+        storageFreeError(errStr);
+        return;
+    }
+
+    if (storage_file_exists(&pushjournalpathname)) {
+        storage_delete_file(&errStr, &pushjournalpathname);
+        storageFreeError(errStr);
+    }
+    pushJournalRecords = 0;
+}
+
+/**
+ * Appends a record to a registry journal.
+ *
+ * @param path pathname of the journal
+ * @param type <tt>JOURNAL_ADD</tt> or <tt>JOURNAL_REMOVE</tt>
+ * @param value full-text registry entry
+ * @return <tt>0</tt> if successful, <tt>-1</tt> otherwise
+ */
+static int journalAppend(const pcsl_string *path, char type, char *value) {
+    int fd;
+    int length = strlen(value);
+    long size;
+    char *record;
+    char *closeErr = NULL;
+
+    /* Write the record at once so that only a crash can cut it short. */
+    record = (char *)midpMalloc(length + 2);
+    if (record == NULL) {
+        return -1;
+    }
+
+    record[0] = type;
+    memcpy(record + 1, value, length);
+    record[length + 1] = '\n';
+
+    fd = storage_open(&errStr, path, OPEN_READ_WRITE);
+    if (errStr == NULL) {
+        size = storageSizeOf(&errStr, fd);
+        if (errStr == NULL) {
+            storagePosition(&errStr, fd, size);
+        }
+        if (errStr == NULL) {
+            storageWrite(&errStr, fd, record, length + 2);
+        }
+        storageClose(&closeErr, fd);
+        storageFreeError(closeErr);
+    }
+
+    midpFree(record);
+
+    if (errStr != NULL) {
+        REPORT_WARN1(LC_PROTOCOL,
+                     "Warning: could not write registration journal: %s",
+                     errStr);
+        storageFreeError(errStr);
+        errStr = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Records a change of the push registrations in the journal.
+ *
+ * @param type <tt>JOURNAL_ADD</tt> or <tt>JOURNAL_REMOVE</tt>
+ * @param value full-text push entry
+ * @return <tt>KNI_TRUE</tt> if the journal is full or could not be
+ *         written, the caller must then call pushsave() once the change
+ *         has been made to the push list
+ */
+static jboolean pushjournal(char type, char *value) {
+    if (journalAppend(&pushjournalpathname, type, value) != 0) {
+        return KNI_TRUE;
     }
+
+    return (++pushJournalRecords >= JOURNAL_CHECKPOINT_RECORDS) ?
+        KNI_TRUE : KNI_FALSE;
 }
 
 /**
@@ -733,6 +957,7 @@ int pushadd(char *str) {
     pe->value = midpStrdup(str);
     pe->storagename = midpStrdup(pushstorage(str, 3));
     pe->filter = pushfilter(str);
+    compilefilter(pe->filter, &pe->compiledFilter);
 
     if ((pe->value == NULL) || (pe->storagename == NULL) ||
             (pe->filter == NULL)) {
@@ -752,6 +977,9 @@ int pushadd(char *str) {
     pe->isWMAEntry = KNI_FALSE;
     pe->isWMAMessCached = KNI_FALSE;
     pe->appID = NULL;
+    pe->nextByFd = NULL;
+    pe->indexedFd = -1;
+    pe->seq = pushSequence++;
 
 #if ENABLE_JSR_180
     pe->isSIPEntry = KNI_FALSE;
@@ -789,15 +1017,19 @@ int pushadd(char *str) {
          * there is a chance network is just not up yet.
          */
     } else {
-        pe->state = CHECKED_IN;
+        pushSetState(pe, CHECKED_IN);
         pushAddNetworkNotifier(pe);
     }
 
     pe->next = pushlist;
     pushlist = pe;
     pushlength++;
+    pushIndexEntry(pe);
+    pushPollPending = KNI_TRUE;
 
-    pushsave();
+    if (pushjournal(JOURNAL_ADD, pe->value)) {
+        pushsave();
+    }
 
     return 0;
 }
@@ -816,6 +1048,7 @@ int pushdel(char *str, char *store) {
     PushEntry *p;
     PushEntry **pPrevNext = &pushlist;
     PushEntry *tmp;
+    jboolean checkpoint;
 
     /* Find the entry to remove. */
     for (p = pushlist; p != NULL ; p = tmp) {
@@ -828,8 +1061,11 @@ int pushdel(char *str, char *store) {
 #if ENABLE_JSR_82
             bt_push_unregister_url(str);
 #endif
+            checkpoint = pushjournal(JOURNAL_REMOVE, p->value);
             pushDeleteEntry(p, pPrevNext);
-            pushsave();
+            if (checkpoint) {
+                pushsave();
+            }
             return 0;
         }
 
@@ -848,6 +1084,9 @@ int pushdel(char *str, char *store) {
  */
 static void pushDeleteEntry(PushEntry *p, PushEntry **pPrevNext) {
     void *context = NULL;
+
+    pushUnindexEntry(p);
+
     if (p->fd != -1) {
         /*
          * Cleanup any connections before closing
@@ -860,6 +1099,7 @@ static void pushDeleteEntry(PushEntry *p, PushEntry **pPrevNext) {
             /* closing will disconnect any socket notifiers */
             if (pushIsSocketConnection(p->value)) {
 #if ENABLE_SERVER_SOCKET
+                midp_unregister_socket_handle((void*)(p->fd));
                 pcsl_socket_close_start((void*)(p->fd), &context);
                 /* Update the resource count */
                 if (midpDecResourceCount(RSC_TYPE_TCP_SER, 1) == 0) {
@@ -868,6 +1108,7 @@ static void pushDeleteEntry(PushEntry *p, PushEntry **pPrevNext) {
                 }
 #endif
             } else if (pushIsDatagramConnection(p->value)) {
+                midp_unregister_socket_handle((void *)p->fd);
                 pcsl_datagram_close_start((void *)p->fd, &context);
                 /* Update the resource count */
                 if (midpDecResourceCount(RSC_TYPE_UDP, 1) == 0) {
@@ -890,7 +1131,7 @@ static void pushDeleteEntry(PushEntry *p, PushEntry **pPrevNext) {
         p->fd = -1;
     }
 
-    p->state = AVAILABLE;
+    pushSetState(p, AVAILABLE);
 
     midpFree(p->value);
     p->value = NULL;
@@ -901,6 +1142,9 @@ static void pushDeleteEntry(PushEntry *p, PushEntry **pPrevNext) {
     midpFree(p->storagename);
     p->storagename = NULL;
 
+    /* A checked out entry may still hold data the MIDlet did not read. */
+    pushFreeCachedData(p);
+
     /* Remove the registration entry from the list. */
     *pPrevNext = p->next;
 
@@ -910,6 +1154,126 @@ static void pushDeleteEntry(PushEntry *p, PushEntry **pPrevNext) {
 
 }
 
+/**
+ * Puts the entry into the handle index under its current handle.
+ * Has to be called whenever the <tt>fd</tt> field of a listed entry
+ * may have changed.
+ *
+ * @param p The push entry to index
+ */
+static void pushIndexEntry(PushEntry *p) {
+    PushEntry **bucket;
+
+    if (p->indexedFd == p->fd) {
+        return;
+    }
+
+    pushUnindexEntry(p);
+
+    if (p->fd != -1) {
+        bucket = &pushFdIndex[PUSH_INDEX_BUCKET(p->fd)];
+        p->nextByFd = *bucket;
+        *bucket = p;
+        p->indexedFd = p->fd;
+    }
+}
+
+/**
+ * Removes the entry from the handle index.
+ *
+ * @param p The push entry to remove
+ */
+static void pushUnindexEntry(PushEntry *p) {
+    PushEntry **pPrevNext;
+
+    if (p->indexedFd == -1) {
+        return;
+    }
+
+    for (pPrevNext = &pushFdIndex[PUSH_INDEX_BUCKET(p->indexedFd)];
+            *pPrevNext != NULL; pPrevNext = &(*pPrevNext)->nextByFd) {
+        if (*pPrevNext == p) {
+            *pPrevNext = p->nextByFd;
+            break;
+        }
+    }
+
+    p->nextByFd = NULL;
+    p->indexedFd = -1;
+}
+
+/**
+ * Changes the state of a listed push entry, keeping the counters
+ * consulted by the registry lookups up to date.
+ *
+ * @param p The push entry
+ * @param state The new state
+ */
+static void pushSetState(PushEntry *p, int state) {
+    if (p->state == WAITING_DATA) {
+        pushWaitingCount--;
+    }
+
+    if (state == WAITING_DATA) {
+        pushWaitingCount++;
+    } else if (state == AVAILABLE || state == RECEIVED_EVENT) {
+        pushPollPending = KNI_TRUE;
+    }
+
+    p->state = state;
+}
+
+/**
+ * Finds the entry listening on the given handle. Entries of a shared
+ * connection use the same handle, in that case the one closest to the
+ * head of the push list is returned.
+ *
+ * @param fd The handle to look for
+ * @return the push entry, or <tt>NULL</tt> if there is none
+ */
+static PushEntry* pushFindByFd(int fd) {
+    PushEntry *p;
+    PushEntry *found = NULL;
+
+    for (p = pushFdIndex[PUSH_INDEX_BUCKET(fd)]; p != NULL; p = p->nextByFd) {
+        if (p->fd == fd && (found == NULL || p->seq > found->seq)) {
+            found = p;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Allocates the buffer for a packet cached on behalf of the entry.
+ *
+ * @param p The push entry
+ * @return the new packet buffer, or <tt>NULL</tt> if out of memory
+ */
+static PacketEntry* pushAllocCachedData(PushEntry *p) {
+    pushFreeCachedData(p);
+
+    p->pCachedData = (PacketEntry*)midpMalloc(sizeof (PacketEntry));
+    if (p->pCachedData != NULL) {
+        pushCachedCount++;
+    }
+
+    return p->pCachedData;
+}
+
+/**
+ * Releases the packet cached on behalf of the entry, if any.
+ *
+ * @param p The push entry
+ */
+static void pushFreeCachedData(PushEntry *p) {
+    if (p->pCachedData != NULL) {
+        midpFree(p->pCachedData);
+        p->pCachedData = NULL;
+        pushCachedCount--;
+    }
+}
+
 /**
  * Returns the number of buffered bytes for the given socket.
  *
@@ -919,6 +1283,10 @@ static void pushDeleteEntry(PushEntry *p, PushEntry **pPrevNext) {
 int pushcacheddatasize(int fd) {
     PushEntry *p;
 
+    if (pushCachedCount == 0) {
+        return -1;
+    }
+
     for (p = pushlist; p != NULL ; p = p->next) {
         if ((p->fd == fd && p->pCachedData != NULL) ||
             (p->fdAccepted == fd && p->pCachedData != NULL)) {
@@ -944,6 +1312,11 @@ int pushgetcachedpacket(int fd, int *ip, int *sndport, char *buf, int len) {
     PushEntry *p;
     int length = -1;
 
+    /* Every socket read comes here, most of them with nothing cached. */
+    if (pushCachedCount == 0) {
+        return -1;
+    }
+
     /* Find the entry to pass off the open file descriptor. */
     for (p = pushlist; p != NULL; p = p->next) {
         if (((p->fd == fd && p->fdAccepted == -1) || (p->fdAccepted == fd)) &&
@@ -967,8 +1340,7 @@ int pushgetcachedpacket(int fd, int *ip, int *sndport, char *buf, int len) {
             if (p->pCachedData->offs >= p->pCachedData->length) {
                 p->fdAccepted = -1;
                 /* Destroy the cached entry after it has been read. */
-                midpFree(p->pCachedData);
-                p->pCachedData = NULL;
+                pushFreeCachedData(p);
             }
 
             return length;
@@ -988,12 +1360,11 @@ int pushcheckoutaccept(int fd) {
     int temp;
 
     /* Find the entry to pass off the open file descriptor. */
-    for (p = pushlist; p != NULL ; p = p->next) {
-        if (p->fd == fd) {
-            temp = p->fdsock;
-            p->fdsock = -1;
-            return temp;
-        }
+    p = pushFindByFd(fd);
+    if (p != NULL) {
+        temp = p->fdsock;
+        p->fdsock = -1;
+        return temp;
     }
 
     return -1;
@@ -1074,7 +1445,7 @@ int pushcheckout(char* protocol, int port, char * store) {
                 pcsl_remove_network_notifier((void*)fd, PCSL_NET_CHECK_READ);
             }
 
-            p->state = CHECKED_OUT;
+            pushSetState(p, CHECKED_OUT);
 
             return fd;
         }
@@ -1093,19 +1464,28 @@ int pushcheckin(int fd) {
     PushEntry *p;
 
     /* Find the entry to check in the open file descriptor. */
-    for (p = pushlist; p != NULL ; p = p->next) {
-        if (p->fd == fd) {
-            if (p->state == CHECKED_OUT) {
-                pushcheckinentry(p);
-            }
-
-            return 0;
+    p = pushFindByFd(fd);
+    if (p != NULL) {
+        if (p->state == CHECKED_OUT) {
+            pushcheckinentry(p);
         }
+
+        return 0;
     }
 
     return -1;
 }
 
+/**
+ * Checks if a handle belongs to a push connection, checked out or not.
+ * @param fd The handle to look up
+ * @return <tt>1</tt> if the handle is owned by the push registry, or
+ * <tt>0</tt> otherwise
+ */
+int pushownsfd(int fd) {
+    return pushFindByFd(fd) != NULL;
+}
+
 /**
  * Checks in all the push connections. Used to cleanup by runMIDletWithArgs.
  */
@@ -1178,6 +1558,7 @@ pushcheckinbymidlet(SuiteIdType suiteId, char* pszClassName) {
             bt_handle_t handle = bt_push_start_server(&port);
             if (handle != BT_INVALID_HANDLE) {
                 p->fd = (int)handle;
+                pushIndexEntry(p);
             }
             continue;
         }
@@ -1230,7 +1611,7 @@ static void pushcheckinentry(PushEntry *pe) {
     pushcleanupentry(pe);
 
     if (pe->fd != -1) {
-        pe->state = CHECKED_IN;
+        pushSetState(pe, CHECKED_IN);
         pushAddNetworkNotifier(pe);
     }
 }
@@ -1253,6 +1634,7 @@ static void pushcleanupentry(PushEntry *p) {
 #if ENABLE_SERVER_SOCKET
         void *context;
 
+        midp_unregister_socket_handle((void*)(p->fdsock));
         pcsl_socket_close_start((void*)(p->fdsock), &context);
         /*
          * Update the resource count
@@ -1269,10 +1651,7 @@ static void pushcleanupentry(PushEntry *p) {
     }
 
     /* Remove the cached datagram (if any). */
-    if (p->pCachedData != NULL) {
-        midpFree(p->pCachedData);
-        p->pCachedData = NULL;
-    }
+    pushFreeCachedData(p);
 }
 
 #if ENABLE_JSR_180
@@ -1384,13 +1763,12 @@ static char* pushApplySipFilter(PushEntry* pushp) {
                    and last entry of shared connections chain */
                 pushcheckinentry(next);
                 /* and clear chached data for shared connection */
-                midpFree(pushp->pCachedData);
-                pushp->pCachedData = NULL;
+                pushFreeCachedData(pushp);
                 break;
             } else if (pushp == next) {
                 /*  mark first chain element as checked in and look for
                     next element */
-                next->state = CHECKED_IN;
+                pushSetState(next, CHECKED_IN);
             } else {
                 /*  keep the state for the rest:
                     non-sip and  intermediate chanin member */
@@ -1405,7 +1783,7 @@ static char* pushApplySipFilter(PushEntry* pushp) {
     midpFree(sender);
 
     if (found && LAUNCH_PENDING != next->state) {
-        next->state = LAUNCH_PENDING;
+        pushSetState(next, LAUNCH_PENDING);
         return midpStrdup(next->value);
     }
 
@@ -1442,7 +1820,7 @@ static char* pushAcceptConnection(PushEntry* pushp, int prevState) {
         REPORT_INFO(LC_PROTOCOL, "(Push)Resource limit exceeded for"
                     " TCP client sockets");
         pushp->fdsock = -1;
-        pushp->state = prevState;
+        pushSetState(pushp, prevState);
         return NULL;
     }
 
@@ -1470,13 +1848,14 @@ static char* pushAcceptConnection(PushEntry* pushp, int prevState) {
         if (checkForEndOfHeader(pushp->pCachedData->buffer, 
                                 MAX_CACHED_DATA_SIZE)){
             pushp->fdAccepted = pushp->fdsock;
-            pushp->state = prevState;
+            pushSetState(pushp, prevState);
             return pushApplySipFilter(pushp);
         } else {
-            pushp->state = WAITING_DATA;
+            pushSetState(pushp, WAITING_DATA);
             /* wait for end of header */
             pcsl_add_network_notifier((void *)pushp->fdsock,
                                       PCSL_NET_CHECK_READ);
+            midp_register_socket_handle((void *)pushp->fdsock);
         }
         /* wait for end of header */
         return NULL;
@@ -1511,6 +1890,7 @@ static char* pushAcceptConnection(PushEntry* pushp, int prevState) {
     }
 
     pushp->fdsock = (int)clientHandle;
+    midp_register_socket_handle(clientHandle);
 
     pcsl_socket_getremoteaddr((void *)pushp->fdsock, ipAddress);
 
@@ -1519,8 +1899,7 @@ static char* pushAcceptConnection(PushEntry* pushp, int prevState) {
         unsigned char ipBytes[MAX_ADDR_LENGTH];
 
 
-        pushp->pCachedData = (PacketEntry*) midpMalloc(sizeof (PacketEntry));
-        if (pushp->pCachedData == NULL) {
+        if (pushAllocCachedData(pushp) == NULL) {
             pushcheckinentry(pushp);
             return NULL;
         }
@@ -1558,15 +1937,16 @@ static char* pushAcceptConnection(PushEntry* pushp, int prevState) {
             if (checkForEndOfHeader(pushp->pCachedData->buffer, 
                                     MAX_CACHED_DATA_SIZE)){
                 pushp->fdAccepted = pushp->fdsock;
-                pushp->state = prevState;
+                pushSetState(pushp, prevState);
             return pushApplySipFilter(pushp);
             }
             /* notifier will be added below */
         }
         if (status == PCSL_NET_WOULDBLOCK) {
-            pushp->state = WAITING_DATA;
+            pushSetState(pushp, WAITING_DATA);
             pcsl_add_network_notifier((void *)pushp->fdsock,
                                       PCSL_NET_CHECK_READ);
+            midp_register_socket_handle((void *)pushp->fdsock);
             return NULL;
         } else {
             pushcheckinentry(pushp);
@@ -1576,7 +1956,7 @@ static char* pushAcceptConnection(PushEntry* pushp, int prevState) {
 #endif
         /* Datagram and Socket connections use the IP filter. */
         /* SIP has its own filtering mechanism applied above. */
-        if (checkfilter(pushp->filter, ipAddress)) {
+        if (pushfilteraccepts(pushp, NULL, ipAddress)) {
         return midpStrdup(pushp->value);
     }
 
@@ -1605,184 +1985,179 @@ char *pushfindfd(int fd) {
     AlarmEntry *alarmp;
     AlarmEntry *alarmtmp;
     char *alarmentry = NULL;
-    char ipAddress[MAX_HOST_LENGTH];
     int status;
     unsigned char ipBytes[MAX_ADDR_LENGTH];
     void *context = NULL;
 
     /* Find the entry to pass off the open file descriptor. */
-    for (pushp = pushlist; pushp != NULL ; pushp = pushp->next) {
-        if ((pushp->fd == (int)fd)) {
-            for (pushtmp = pushp; pushtmp != NULL; pushtmp = pushtmp->next) {
-                if ((pushtmp->fd == fd) &&
-                    (pushtmp->state == LAUNCH_PENDING)) {
-                    /*
-                     * Some MIDlet is launching and expecting to
-                     * read from this fd. Don't steal its traffic.
-                     */
-                    return NULL;
-                }
+    pushp = pushFindByFd(fd);
+    if (pushp != NULL) {
+        for (pushtmp = pushFdIndex[PUSH_INDEX_BUCKET(fd)]; pushtmp != NULL;
+                pushtmp = pushtmp->nextByFd) {
+            if ((pushtmp->fd == fd) &&
+                (pushtmp->state == LAUNCH_PENDING)) {
+                /*
+                 * Some MIDlet is launching and expecting to
+                 * read from this fd. Don't steal its traffic.
+                 */
+                return NULL;
             }
+        }
 
-            temp_state = pushp->state;
-            pushp->state = LAUNCH_PENDING;
+        temp_state = pushp->state;
+        pushSetState(pushp, LAUNCH_PENDING);
 
 #ifdef ENABLE_JSR_82
-            if (bt_is_bluetooth_url(pushp->value)) {
-                bt_pushid_t id = bt_push_find_server((bt_handle_t)fd);
-                if (id != BT_INVALID_PUSH_HANDLE) {
-                    if (bt_push_accept(id, pushp->filter,
-                                       (bt_handle_t *)(void*)&pushp->fdsock)) {
-                        return midpStrdup(pushp->value);
-                    }
+        if (bt_is_bluetooth_url(pushp->value)) {
+            bt_pushid_t id = bt_push_find_server((bt_handle_t)fd);
+            if (id != BT_INVALID_PUSH_HANDLE) {
+                if (bt_push_accept(id, pushp->filter,
+                                   (bt_handle_t *)(void*)&pushp->fdsock)) {
+                    return midpStrdup(pushp->value);
                 }
-                pushcheckinentry(pushp);
-                return NULL;
             }
+            pushcheckinentry(pushp);
+            return NULL;
+        }
 #endif
 
+        /*
+         * Check the push filter, to see if this connection
+         * is acceptable.
+         */
+        if (strncmp(pushp->value, "datagram://:", 12) == 0) {
             /*
-             * Check the push filter, to see if this connection
-             * is acceptable.
+             * Read the datagram and save it til the application reads it.
+             * This is a one datagram message queue.
              */
-            if (strncmp(pushp->value, "datagram://:", 12) == 0) {
-                /*
-                 * Read the datagram and save it til the application reads it.
-                 * This is a one datagram message queue.
-                 */
-                pushp->pCachedData = (PacketEntry*)
-                                     midpMalloc(sizeof (PacketEntry));
-                if (pushp->pCachedData == NULL) {
-                    pushcheckinentry(pushp);
-                    return NULL;
-                }
-
-                pushp->pCachedData->offs = 0;
-
-                status = pcsl_datagram_read_finish(
-                                                  (void *)pushp->fd,
-                                                  ipBytes,
-                                                  &(pushp->pCachedData->senderport),
-                                                  pushp->pCachedData->buffer,
-                                                  MAX_CACHED_DATA_SIZE,
-                                                  &(pushp->pCachedData->length),
-                                                  context);
-
-                if (status != PCSL_NET_SUCCESS) {
-                    /*
-                     * Receive failed - no data available.
-                     * cancel the launch pending
-                     * set listening state to CHECKED_IN
-                     * to prevent forever loop
-                     */
-                    pushcheckinentry(pushp);
-                    return NULL;
-                }
-
-                /* Set the raw IP address */
-                memcpy(&(pushp->pCachedData->ipAddress),
-                       ipBytes, MAX_ADDR_LENGTH);
+            if (pushAllocCachedData(pushp) == NULL) {
+                pushcheckinentry(pushp);
+                return NULL;
+            }
 
-                memset(ipAddress, '\0', MAX_HOST_LENGTH);
-                strcpy(ipAddress, pcsl_inet_ntoa(&ipBytes));
+            pushp->pCachedData->offs = 0;
 
-                /* Datagram and Socket connections use the IP filter. */
-                if (checkfilter(pushp->filter, ipAddress)) {
-                    return midpStrdup(pushp->value);
-                }
+            status = pcsl_datagram_read_finish(
+                                              (void *)pushp->fd,
+                                              ipBytes,
+                                              &(pushp->pCachedData->senderport),
+                                              pushp->pCachedData->buffer,
+                                              MAX_CACHED_DATA_SIZE,
+                                              &(pushp->pCachedData->length),
+                                              context);
 
+            if (status != PCSL_NET_SUCCESS) {
                 /*
-                 * Dispose of the filtered push request.
-                 * Release any cached datagrams.
+                 * Receive failed - no data available.
+                 * cancel the launch pending
+                 * set listening state to CHECKED_IN
+                 * to prevent forever loop
                  */
                 pushcheckinentry(pushp);
                 return NULL;
+            }
+
+            /* Set the raw IP address */
+            memcpy(&(pushp->pCachedData->ipAddress),
+                   ipBytes, MAX_ADDR_LENGTH);
+
+            /*
+             * Datagram and Socket connections use the IP filter. The
+             * address is only converted to text if the filter needs it.
+             */
+            if (pushfilteraccepts(pushp, ipBytes, NULL)) {
+                return midpStrdup(pushp->value);
+            }
+
+            /*
+             * Dispose of the filtered push request.
+             * Release any cached datagrams.
+             */
+            pushcheckinentry(pushp);
+            return NULL;
 #if ENABLE_SERVER_SOCKET
-            } else if (pushIsSocketConnection(pushp->value)) {
-                return pushAcceptConnection(pushp, temp_state);
+        } else if (pushIsSocketConnection(pushp->value)) {
+            return pushAcceptConnection(pushp, temp_state);
 #endif
-            }
+        }
 #if ENABLE_JSR_180
-            /* Check for JSR180 SIP/SIPS connections (UDP). */
-            else if (pushp->isSIPEntry) {
+        /* Check for JSR180 SIP/SIPS connections (UDP). */
+        else if (pushp->isSIPEntry) {
 
-                /* Special case: shared connection. Cached datagram is stored 
-                   at first push entry buffer */
-                /*
-                 * Read the SIP datagram and save it til the
-                 * application reads it.
-                 * This is a one SIP datagram message queue.
-                 */
-                pushp->pCachedData = (PacketEntry*)
-                                     midpMalloc(sizeof (PacketEntry));
-                if (pushp->pCachedData == NULL) {
-                    pushcheckinentry(pushp);
-                    return NULL;
-                }
+            /* Special case: shared connection. Cached datagram is stored 
+               at first push entry buffer */
+            /*
+             * Read the SIP datagram and save it til the
+             * application reads it.
+             * This is a one SIP datagram message queue.
+             */
+            if (pushAllocCachedData(pushp) == NULL) {
+                pushcheckinentry(pushp);
+                return NULL;
+            }
 
-                pushp->pCachedData->offs = 0;
+            pushp->pCachedData->offs = 0;
 
-                status = pcsl_datagram_read_finish(
-                                                  (void *)pushp->fd,
-                                                  ipBytes,
-                                                  &(pushp->pCachedData->senderport),
-                                                  pushp->pCachedData->buffer,
-                                                  MAX_CACHED_DATA_SIZE,
-                                                  &(pushp->pCachedData->length),
-                                                  context);
+            status = pcsl_datagram_read_finish(
+                                              (void *)pushp->fd,
+                                              ipBytes,
+                                              &(pushp->pCachedData->senderport),
+                                              pushp->pCachedData->buffer,
+                                              MAX_CACHED_DATA_SIZE,
+                                              &(pushp->pCachedData->length),
+                                              context);
 
-                if (status != PCSL_NET_SUCCESS) {
-                    /*
-                     * Receive failed - no data available.
-                     * cancel the launch pending
-                     */
-                    pushcheckinentry(pushp);
-                    return NULL;
-                }
+            if (status != PCSL_NET_SUCCESS) {
+                /*
+                 * Receive failed - no data available.
+                 * cancel the launch pending
+                 */
+                pushcheckinentry(pushp);
+                return NULL;
+            }
 
-                /* Set the raw IP address */
-                memcpy(&(pushp->pCachedData->ipAddress),
-                       ipBytes, MAX_ADDR_LENGTH);
+            /* Set the raw IP address */
+            memcpy(&(pushp->pCachedData->ipAddress),
+                   ipBytes, MAX_ADDR_LENGTH);
 
-                REPORT_INFO1(LC_PROTOCOL,
-                             "SIP Push Message: %s",
-                             pushp->pCachedData->buffer);
-                /* restore state that will be processed separately at 
-                   pushApplySipFilter */
-                pushp->state = temp_state;
+            REPORT_INFO1(LC_PROTOCOL,
+                         "SIP Push Message: %s",
+                         pushp->pCachedData->buffer);
+            /* restore state that will be processed separately at 
+               pushApplySipFilter */
+            pushSetState(pushp, temp_state);
 
-                return pushApplySipFilter(pushp);
-            }
+            return pushApplySipFilter(pushp);
+        }
 #endif
 
 #if ENABLE_JSR_257
-            else if(pushp->isNFCEntry) {
-                char *entry = pushp->value;
-                if(strncmp(entry, "ndef:",5) == 0) {
-                    return pcsl_mem_strdup(entry);
-                } else {
-                    return NULL;
-                }
-            }        
+        else if(pushp->isNFCEntry) {
+            char *entry = pushp->value;
+            if(strncmp(entry, "ndef:",5) == 0) {
+                return pcsl_mem_strdup(entry);
+            } else {
+                return NULL;
+            }
+        }        
 #endif 
 
 #if (ENABLE_JSR_205 || ENABLE_JSR_120)
-            else{
-                /*
-                 * Return a valid push entry, if the WMA message has been
-                 * succesfully received (which for sms, mms includes a
-                 * filter check); otherwise return NULL.
-                 */
-                if (pushp->isWMAMessCached){
-                    return getWmaPushEntry(pushp->value);
-                } else{
-                    pushp->state = temp_state;
-                    return NULL;
-                }
-            }
-#endif
-            return NULL;
+        else{
+            /*
+             * Return a valid push entry, if the WMA message has been
+             * succesfully received (which for sms, mms includes a
+             * filter check); otherwise return NULL.
+             */
+            if (pushp->isWMAMessCached){
+                return getWmaPushEntry(pushp->value);
+            } else{
+                pushSetState(pushp, temp_state);
+                return NULL;
+            }
         }
+#endif
+        return NULL;
     }
 
     /*
@@ -2017,7 +2392,6 @@ char *pushfindsuite(char *store, int available){
 static int parsePushList(int pushfd){
     char buffer[MAX_LINE+1];
     char *errStr = NULL;
-    PushEntry *pe;
 
     /* Read a line at a time */
     while (readLine(&errStr, pushfd, buffer, sizeof(buffer)) != 0){
@@ -2030,50 +2404,10 @@ static int parsePushList(int pushfd){
             return -1;
         }
 
-        pe = (PushEntry *) midpMalloc (sizeof(PushEntry));
-
-        if (pe == NULL){
+        if (pushListAdd(buffer) != 0){
             pushListFree();
             return -2;
         }
-
-        pe->next = pushlist;
-        pe->value = midpStrdup(buffer);
-        pe->storagename = midpStrdup(pushstorage(pe->value, 3));
-
-        if ((pe->value == NULL) || (pe->storagename == NULL)){
-            midpFree(pe->value);
-            midpFree(pe->storagename);
-            midpFree(pe);
-            pushListFree();
-            return -2;
-        } else{
-            pe->filter = pushfilter(pe->value);
-            pe->fd = -1;
-            pe->fdsock = -1;
-            pe->fdAccepted = -1;
-            pe->state = AVAILABLE;
-            pe->pCachedData = NULL;
-            pe->isWMAEntry = KNI_FALSE;
-            pe->isWMAMessCached = KNI_FALSE;
-            pe->appID = NULL;
-#if ENABLE_JSR_180
-            pe->isSIPEntry = KNI_FALSE;
-            pe->isShared = KNI_FALSE;
-#endif
-
-#if ENABLE_JSR_257
-            pe->isNFCEntry = KNI_FALSE;
-#endif
-
-        }
-
-        /*
-         * Add the new entry to the top of the push cached
-         * list.
-         */
-        pushlist = pe;
-        pushlength++;
     }
 
     /* This check is required for the case when readLine() didn't put
@@ -2095,14 +2429,76 @@ static void pushStartListening(){
     for (pe = pushlist; pe != NULL ; pe = pe->next){
         if (pe->state == AVAILABLE){
             pushProcessPort(pe);
+            pushIndexEntry(pe);
             if (pe->fd != -1){
-                pe->state = CHECKED_IN;
+                pushSetState(pe, CHECKED_IN);
                 pushAddNetworkNotifier(pe);
             }
         }
     }
 }
 
+/**
+ * Creates a push entry for a line of the push registry and adds it to
+ * the top of the push cached list. The connection is not opened.
+ *
+ * @param value full-text push entry
+ * @return <tt>0</tt> if successful, <tt>-2</tt> if out of memory
+ */
+static int pushListAdd(char *value){
+    PushEntry *pe;
+
+    pe = (PushEntry *) midpMalloc (sizeof(PushEntry));
+
+    if (pe == NULL){
+        return -2;
+    }
+
+    pe->next = pushlist;
+    pe->value = midpStrdup(value);
+    pe->storagename = midpStrdup(pushstorage(pe->value, 3));
+
+    if ((pe->value == NULL) || (pe->storagename == NULL)){
+        midpFree(pe->value);
+        midpFree(pe->storagename);
+        midpFree(pe);
+        return -2;
+    } else{
+        pe->filter = pushfilter(pe->value);
+        compilefilter(pe->filter, &pe->compiledFilter);
+        pe->fd = -1;
+        pe->fdsock = -1;
+        pe->fdAccepted = -1;
+        pe->state = AVAILABLE;
+        pe->pCachedData = NULL;
+        pe->isWMAEntry = KNI_FALSE;
+        pe->isWMAMessCached = KNI_FALSE;
+        pe->appID = NULL;
+        pe->nextByFd = NULL;
+        pe->indexedFd = -1;
+        pe->seq = pushSequence++;
+#if ENABLE_JSR_180
+        pe->isSIPEntry = KNI_FALSE;
+        pe->isShared = KNI_FALSE;
+#endif
+
+#if ENABLE_JSR_257
+        pe->isNFCEntry = KNI_FALSE;
+#endif
+
+    }
+
+    /*
+     * Add the new entry to the top of the push cached
+     * list.
+     */
+    pushlist = pe;
+    pushlength++;
+    pushPollPending = KNI_TRUE;
+
+    return 0;
+}
+
 /**
  * Parses the URL port.
  *
@@ -2375,6 +2771,7 @@ static int pushProcessPort(PushEntry* pe){
 
             if (status == PCSL_NET_SUCCESS){
                 pe->fd = (int) handle;
+                midp_register_socket_handle(handle);
                 /* Update the resource count  */
                 if (midpIncResourceCount(RSC_TYPE_UDP, 1) == 0){
                     REPORT_INFO(LC_PROTOCOL, "(Push)Datagrams: Resource"
@@ -2404,6 +2801,7 @@ static int pushProcessPort(PushEntry* pe){
 
             if (status == PCSL_NET_SUCCESS){
                 pe->fd = (int) handle;
+                midp_register_socket_handle(handle);
 
                 /* Update the resource count  */
                 if (midpIncResourceCount(RSC_TYPE_TCP_SER, 1) == 0){
@@ -2463,6 +2861,203 @@ static int pushProcessPort(PushEntry* pe){
     return(pe->fd != -1) ? 0 : -1;
 }
 
+/**
+ * Parses one octet of a filter or an IPv4 address: up to three
+ * decimal digits with a value not above 255.
+ *
+ * @param pp address of the text pointer, advanced past the octet
+ * @param pOctet where to store the value
+ * @return <tt>1</tt> if an octet was parsed, <tt>0</tt> otherwise
+ */
+static int parseoctet(char **pp, unsigned int *pOctet){
+    char *p = *pp;
+    unsigned int octet = 0;
+    int digits = 0;
+
+    while (*p >= '0' && *p <= '9' && digits < 3){
+        octet = octet * 10 + (*p - '0');
+        digits++;
+        p++;
+    }
+
+    if (digits == 0 || octet > 255 || (*p >= '0' && *p <= '9')){
+        return 0;
+    }
+
+    *pp = p;
+    *pOctet = octet;
+    return 1;
+}
+
+/**
+ * Converts a dotted IPv4 address to an integer, the first octet in the
+ * most significant byte.
+ *
+ * @param ip the address text
+ * @param pAddress where to store the address
+ * @return <tt>1</tt> if the text is an IPv4 address, <tt>0</tt> otherwise
+ */
+static int parseaddress(char *ip, unsigned int *pAddress){
+    unsigned int address = 0;
+    unsigned int octet;
+    int i;
+
+    for (i = 0; i < 4; i++){
+        if (i > 0 && *ip++ != '.'){
+            return 0;
+        }
+        if (!parseoctet(&ip, &octet)){
+            return 0;
+        }
+        address = (address << 8) | octet;
+    }
+
+    if (*ip != '\0'){
+        return 0;
+    }
+
+    *pAddress = address;
+    return 1;
+}
+
+/**
+ * Compiles a push filter string. An octet of the filter may be a
+ * number, "*" or "???"; the last octet may be followed by "/" and
+ * a prefix length. Anything else is left to checkfilter().
+ *
+ * @param filter The filter string
+ * @param compiled The compiled filter
+ */
+static void compilefilter(char *filter, PushFilter *compiled){
+    char *p = filter;
+    unsigned int value = 0;
+    unsigned int mask = 0;
+    unsigned int octet;
+    unsigned int prefix;
+    int i;
+
+    compiled->kind = FILTER_PATTERN;
+    compiled->value = 0;
+    compiled->mask = 0;
+
+    if (filter == NULL){
+        return;
+    }
+
+    if (strcmp(filter, "*") == 0){
+        compiled->kind = FILTER_ANY;
+        return;
+    }
+
+    for (i = 0; i < 4; i++){
+        if (i > 0 && *p++ != '.'){
+            return;
+        }
+
+        value <<= 8;
+        mask <<= 8;
+
+        if (*p == '*' && (p[1] == '.' || p[1] == '\0' || p[1] == '/')){
+            p++;
+        } else if (strncmp(p, "???", 3) == 0 &&
+                   (p[3] == '.' || p[3] == '\0' || p[3] == '/')){
+            p += 3;
+        } else if (parseoctet(&p, &octet)){
+            value |= octet;
+            mask |= 0xff;
+        } else{
+            return;
+        }
+    }
+
+    if (*p == '/'){
+        p++;
+        if (!parseoctet(&p, &prefix) || prefix > 32){
+            return;
+        }
+        mask &= (prefix == 0) ? 0 : (0xffffffffU << (32 - prefix));
+    }
+
+    if (*p != '\0'){
+        return;
+    }
+
+    compiled->kind = FILTER_MASK;
+    compiled->value = value & mask;
+    compiled->mask = mask;
+}
+
+/**
+ * Checks the incoming IP address against the compiled filter of a
+ * push entry.
+ *
+ * @param pe The push entry
+ * @param ipBytes The raw incoming address, or <tt>NULL</tt> if only
+ *        the text form is known
+ * @param ip The incoming address text, or <tt>NULL</tt> to convert
+ *        <tt>ipBytes</tt> if the filter needs the text
+ * @return <tt>1</tt> if the comparison is successful, <tt>0</tt> if it fails
+ */
+static int pushfilteraccepts(PushEntry *pe, unsigned char *ipBytes,
+                             char *ip){
+    unsigned int address;
+
+    switch (pe->compiledFilter.kind){
+    case FILTER_ANY:
+        return 1;
+
+    case FILTER_MASK:
+        if (ipBytes != NULL && MAX_ADDR_LENGTH == 4){
+            address = ((unsigned int)ipBytes[0] << 24) |
+                      ((unsigned int)ipBytes[1] << 16) |
+                      ((unsigned int)ipBytes[2] << 8) |
+                       (unsigned int)ipBytes[3];
+            return (address & pe->compiledFilter.mask) ==
+                   pe->compiledFilter.value;
+        }
+
+        if (ip == NULL && ipBytes != NULL){
+            ip = pushSenderAddress(ipBytes);
+        }
+
+        if (ip == NULL || !parseaddress(ip, &address)){
+            /* Not an IPv4 address, let the string matcher decide. */
+            break;
+        }
+        return (address & pe->compiledFilter.mask) ==
+               pe->compiledFilter.value;
+
+    default:
+        break;
+    }
+
+    if (ip == NULL && ipBytes != NULL){
+        ip = pushSenderAddress(ipBytes);
+    }
+
+    return checkfilter(pe->filter, ip);
+}
+
+/**
+ * Converts the raw address of a datagram sender to text. The text of
+ * the last sender is kept, so a stream of datagrams from one sender is
+ * converted only once.
+ *
+ * @param ipBytes The raw address
+ * @return the address text, valid until the next call
+ */
+static char *pushSenderAddress(unsigned char *ipBytes){
+    if (pushLastSender[0] == '\0' ||
+            memcmp(pushLastSenderBytes, ipBytes, MAX_ADDR_LENGTH) != 0){
+        memcpy(pushLastSenderBytes, ipBytes, MAX_ADDR_LENGTH);
+        strncpy(pushLastSender, pcsl_inet_ntoa(ipBytes),
+                MAX_HOST_LENGTH - 1);
+        pushLastSender[MAX_HOST_LENGTH - 1] = '\0';
+    }
+
+    return pushLastSender;
+}
+
 /**
  * Checks the incoming IP address against the push filter.
  * @param filter The filter string to be used
@@ -2592,7 +3187,8 @@ static void pushListFree(){
  * Find blocking thread for a given socket push handle. Walks through the
  * registry of push entries for a handle that matches the argument. If one is
  * found, its push entry state is set to RECEIVED_EVENT and the handle is
- * returned.
+ * returned. Like in <tt>pushFindByFd</tt>, when entries of a shared
+ * connection match, the one closest to the head of the push list is used.
  *
  * @param handle The handle to test for in the push registry
  * @return <tt>0</tt> if no entry is found. Otherwise, <tt>handle</tt> is
@@ -2600,14 +3196,30 @@ static void pushListFree(){
  */
 int findPushBlockedHandle(int handle){
     PushEntry *pushp, *pushtmp;
-    if (pushlength > 0 ){
+    PushEntry *found = NULL;
+
+    /* index buckets are not in list order, compare the sequence numbers */
+    for (pushp = pushFdIndex[PUSH_INDEX_BUCKET(handle)]; pushp != NULL;
+            pushp = pushp->nextByFd) {
+        if (handle == pushp->fd &&
+            pushp->state != CHECKED_OUT &&
+            pushp->state != LAUNCH_PENDING &&
+            (found == NULL || pushp->seq > found->seq)) {
+            found = pushp;
+        }
+    }
+
+    if (found != NULL) {
+        pushSetState(found, RECEIVED_EVENT);
+        return handle;
+    }
+
+    /* Accepted sockets are not indexed, look for them only if awaited. */
+    if (pushWaitingCount > 0) {
         for (pushp = pushlist; pushp != NULL; pushp = pushtmp){
             pushtmp = pushp->next;
-            if ((handle == pushp->fd &&
-                 pushp->state != CHECKED_OUT &&
-                 pushp->state != LAUNCH_PENDING) ||
-                (handle == pushp->fdsock && pushp->state == WAITING_DATA)){
-                pushp->state = RECEIVED_EVENT;
+            if (handle == pushp->fdsock && pushp->state == WAITING_DATA){
+                pushSetState(pushp, RECEIVED_EVENT);
                 return handle;
             }
         }
@@ -2636,6 +3248,7 @@ int findPushTimerBlockedHandle(int handle){
         /* alarmp->state == AVAILABLE iff timer has been canceled or updated */
         if ((handle == alarmp->timerHandle) && (alarmp->state == CHECKED_IN)){
             alarmp->state = RECEIVED_EVENT;
+            pushPollPending = KNI_TRUE;
 
             return handle;
         }
@@ -2655,6 +3268,7 @@ int findPushTimerBlockedHandle(int handle){
 int pushpoll(){
     int i;
     PushEntry * pe;
+    jboolean retry;
 
     AlarmEntry *alarmp;
     AlarmEntry *alarmtmp;
@@ -2666,6 +3280,17 @@ int pushpoll(){
      *   3. check networking events.
      */
 
+    /*
+     * Nothing has been received and every entry is listening
+     * since the last poll found nothing to do.
+     */
+    if (!pushPollPending) {
+        midp_thread_wait(PUSH_SIGNAL, 0, 0);
+        return -1;
+    }
+
+    retry = KNI_FALSE;
+
     /* Find pending network push. */
     if (pushlength > 0 ){
         for (i = 0, pe = pushlist; i < pushlength && pe != NULL; i++){
@@ -2675,12 +3300,15 @@ int pushpoll(){
                  * so try again.
                  */
                 pushProcessPort(pe);
+                pushIndexEntry(pe);
                 if (pe->fd != -1){
                     REPORT_INFO1(LC_PUSH,
                                  "Push network signal on descriptor %x", pe->fd);
 
-                    pe->state = CHECKED_IN;
+                    pushSetState(pe, CHECKED_IN);
                     pushAddNetworkNotifier(pe);
+                } else {
+                    retry = KNI_TRUE;
                 }
             }
 
@@ -2702,6 +3330,9 @@ int pushpoll(){
         }
     }
 
+    /* Keep polling only while some entry still has to be reopened. */
+    pushPollPending = retry;
+
     /*
      * No push connections are ready or alarms are available,
      * so we are going to sleep for a while. The current thread
@@ -2760,6 +3391,7 @@ static void pushDeleteSuiteLive(SuiteIdType id){
     AlarmEntry *alarmnext;
     const pcsl_string* strId = midp_suiteid2pcsl_string(id);
     const char* pszID = (char*)pcsl_string_get_utf8_data(strId);
+    jboolean checkpoint = KNI_FALSE;
 
     if (pszID == NULL){
         return;
@@ -2772,6 +3404,9 @@ static void pushDeleteSuiteLive(SuiteIdType id){
 #if ENABLE_JSR_82
             bt_push_unregister_url(pushp->value);
 #endif
+            if (pushjournal(JOURNAL_REMOVE, pushp->value)) {
+                checkpoint = KNI_TRUE;
+            }
             pushDeleteEntry(pushp, pPrevNext);
             /* Do not change push prev next */
             continue;
@@ -2780,12 +3415,18 @@ static void pushDeleteSuiteLive(SuiteIdType id){
         pPrevNext = &pushp->next;
     }
 
-    pushsave();
+    if (checkpoint) {
+        pushsave();
+        checkpoint = KNI_FALSE;
+    }
 
     /* Find all of the alarm entries to remove. */
     for (alarmp = alarmlist; alarmp != NULL; alarmp = alarmnext){
         alarmnext = alarmp->next;
         if (strcmp(pszID, alarmp->storagename) == 0){
+            if (alarmjournal(JOURNAL_REMOVE, alarmp->midlet)) {
+                checkpoint = KNI_TRUE;
+            }
             *alarmpPrevNext = alarmp->next;
 
             midpFree(alarmp->midlet);
@@ -2799,7 +3440,9 @@ static void pushDeleteSuiteLive(SuiteIdType id){
         alarmpPrevNext = &alarmp->next;
     }
 
-    alarmsave();
+    if (checkpoint) {
+        alarmsave();
+    }
 
     pcsl_string_release_utf8_data((jbyte*)pszID, strId);
 }
@@ -2815,9 +3458,6 @@ static void pushDeleteSuiteLive(SuiteIdType id){
 static int parseAlarmList(int pushfd){
     char buffer[MAX_LINE+1];
     char *errStr = NULL;
-    jlong alarm  = 0;
-    AlarmEntry *pe = NULL;
-    char *p;
 
     /* Read a line at a time. */
     while ( readLine(&errStr, pushfd, buffer, sizeof(buffer)) != 0 ){
@@ -2830,60 +3470,231 @@ static int parseAlarmList(int pushfd){
             return -1;
         }
 
-        /* Find the alarm time field. */
-        for (p = buffer; *p != 0; p++){
-            if (*p == ','){
-                p++;
-                sscanf(p, PCSL_LLD, &alarm);
-                break;
-            }
+        if (alarmListAdd(buffer) != 0){
+            alarmListFree();
+            return -2;
         }
+    }
 
-        /*
+    /*
+     * This check is required for the case when readLine() didn't put
+     * any characters into the buffer and while() was not executed.
+     */
+    if (errStr != NULL){
+        REPORT_WARN1(LC_PROTOCOL,
+                     "Warning: could not read alarm registration: %s",
+                     errStr);
+        storageFreeError(errStr);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Creates an alarm entry for a line of the alarm registry, adds it to
+ * the top of the alarm cached list and starts its timer.
+ *
+ * @param value full-text alarm entry
+ * @return <tt>0</tt> if successful or the line has no alarm time,
+ *         <tt>-2</tt> if out of memory
+ */
+static int alarmListAdd(char *value){
+    jlong alarm  = 0;
+    AlarmEntry *pe = NULL;
+    char *p;
+
+    /* Find the alarm time field. */
+    for (p = value; *p != 0; p++){
+        if (*p == ','){
+            p++;
+            sscanf(p, PCSL_LLD, &alarm);
+            break;
+        }
+    }
+
+    /*
      * Check if the alarm time field was found
-     * and continue if it was not.
+     * and skip the line if it was not.
      */
-        if (*p == 0){
-            continue;
+    if (*p == 0){
+        return 0;
+    }
+
+    /* Create an alarm registry entry. */
+    pe = (AlarmEntry *) midpMalloc (sizeof(AlarmEntry));
+    if (pe == NULL){
+        return -2;
+    }
+
+    pe->next = alarmlist;
+    pe->midlet = midpStrdup(value);
+    pe->storagename = midpStrdup(pushstorage(pe->midlet, 2));
+
+    if ((pe->midlet == NULL) || (pe->storagename == NULL)){
+        midpFree(pe->midlet);
+        midpFree(pe->storagename);
+        midpFree(pe);
+        return -2;
+    }
+
+    alarmstart(pe, alarm);
+
+    /*
+     * Add the new entry to the top of the alarm cached
+     * list.
+     */
+    alarmlist = pe;
+
+    return 0;
+}
+
+/**
+ * Applies one journal record to the push or the alarm list. Records
+ * which are already reflected in the list are ignored, so replaying
+ * a journal over a list checkpointed after the journal was written
+ * gives the same result.
+ *
+ * @param record journal record
+ * @param isAlarm <tt>KNI_TRUE</tt> for a record of the alarm journal
+ * @return <tt>0</tt> if successful, <tt>-2</tt> if out of memory
+ */
+static int journalApply(char *record, jboolean isAlarm){
+    char *value = record + 1;
+    PushEntry *pushp;
+    PushEntry **pPrevNext = &pushlist;
+    AlarmEntry *alarmp;
+    AlarmEntry **alarmpPrevNext = &alarmlist;
+
+    if (isAlarm){
+        for (alarmp = alarmlist; alarmp != NULL; alarmp = alarmp->next){
+            if (strcmp(value, alarmp->midlet) == 0){
+                break;
+            }
+            alarmpPrevNext = &alarmp->next;
         }
 
-        /* Create an alarm registry entry. */
-        pe = (AlarmEntry *) midpMalloc (sizeof(AlarmEntry));
-        if (pe == NULL){
-            alarmListFree();
-            return -2;
+        if (record[0] == JOURNAL_ADD && alarmp == NULL){
+            return alarmListAdd(value);
         }
 
-        pe->next = alarmlist;
-        pe->midlet = midpStrdup(buffer);
-        alarmstart(pe, alarm);
-        pe->storagename = midpStrdup(pushstorage(pe->midlet, 2));
+        if (record[0] == JOURNAL_REMOVE && alarmp != NULL){
+            if (alarmp->timerHandle != 0){
+                destroyTimerHandle(alarmp->timerHandle);
+            }
+            *alarmpPrevNext = alarmp->next;
+            midpFree(alarmp->midlet);
+            midpFree(alarmp->storagename);
+            midpFree(alarmp);
+        }
+    } else{
+        for (pushp = pushlist; pushp != NULL; pushp = pushp->next){
+            if (strcmp(value, pushp->value) == 0){
+                break;
+            }
+            pPrevNext = &pushp->next;
+        }
 
-        if ((pe->midlet == NULL) || (pe->storagename == NULL)){
-            midpFree(pe->midlet);
-            midpFree(pe->storagename);
-            midpFree(pe);
-            alarmListFree();
-            return -2;
+        if (record[0] == JOURNAL_ADD && pushp == NULL){
+            return pushListAdd(value);
+        }
+
+        if (record[0] == JOURNAL_REMOVE && pushp != NULL){
+            pushDeleteEntry(pushp, pPrevNext);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Replays a registry journal over the list read from the registry
+ * file. A record cut short by an interrupted write is dropped. The
+ * list file is rewritten if the journal has grown to the checkpoint
+ * size.
+ *
+ * @param path pathname of the journal
+ * @param isAlarm <tt>KNI_TRUE</tt> for the alarm journal
+ * @return <tt>0</tt> if successful, <tt>-2</tt> if out of memory
+ */
+static int journalReplay(const pcsl_string *path, jboolean isAlarm){
+    char buffer[MAX_LINE+2];
+    char last = '\n';
+    char *errStr = NULL;
+    int records = 0;
+    long size;
+    int fd;
+
+    if (!storage_file_exists(path)){
+        return 0;
+    }
+
+    fd = storage_open(&errStr, path, OPEN_READ);
+    if (errStr != NULL){
+        REPORT_WARN1(LC_PROTOCOL,
+                     "Warning: could not open registration journal: %s",
+                     errStr);
+        storageFreeError(errStr);
+        return 0;
+    }
+
+    size = storageSizeOf(&errStr, fd);
+    if (errStr == NULL && size > 0){
+        storagePosition(&errStr, fd, size - 1);
+        if (errStr == NULL){
+            storageRead(&errStr, fd, &last, 1);
+        }
+        if (errStr == NULL){
+            storagePosition(&errStr, fd, 0);
+        }
+    }
+
+    while (errStr == NULL &&
+           readLine(&errStr, fd, buffer, sizeof(buffer)) != 0){
+        if (errStr != NULL){
+            break;
         }
 
         /*
-         * Add the new entry to the top of the alarm cached
-         * list.
+         * The last record is incomplete if the file ends mid-line.
+         * Drop it and checkpoint, so no record is appended to it.
          */
-        alarmlist = pe;
+        if (last != '\n' &&
+            storageRelativePosition(&errStr, fd, 0) >= size){
+            records = JOURNAL_CHECKPOINT_RECORDS;
+            break;
+        }
+
+        if (journalApply(buffer, isAlarm) != 0){
+            storageClose(&errStr, fd);
+            storageFreeError(errStr);
+            return -2;
+        }
+
+        records++;
     }
 
-    /*
-     * This check is required for the case when readLine() didn't put
-     * any characters into the buffer and while() was not executed.
-     */
     if (errStr != NULL){
         REPORT_WARN1(LC_PROTOCOL,
-                     "Warning: could not read alarm registration: %s",
+                     "Warning: could not read registration journal: %s",
                      errStr);
         storageFreeError(errStr);
-        return -1;
+        errStr = NULL;
+    }
+
+    storageClose(&errStr, fd);
+    storageFreeError(errStr);
+
+    if (isAlarm){
+        alarmJournalRecords = records;
+        if (records >= JOURNAL_CHECKPOINT_RECORDS){
+            alarmsave();
+        }
+    } else{
+        pushJournalRecords = records;
+        if (records >= JOURNAL_CHECKPOINT_RECORDS){
+            pushsave();
+        }
     }
 
     return 0;
@@ -2922,12 +3733,21 @@ static int alarmopen(){
         storageFreeError(errStr);
     }
 
+    /* Apply the changes made after the file was written. */
+    if (journalReplay(&alarmjournalpathname, KNI_TRUE) != 0){
+        REPORT_ERROR(LC_PROTOCOL,
+                     "Error: alarmopen out of memory when replaying alarm journal");
+        alarmListFree();
+        return -1;
+    }
+
     return 0;
 }
 
 /**
  * Saves the in memory cache of alarm registrations to a persistent
- * file for use in subsequent runs.
+ * file for use in subsequent runs. The journal is emptied once the
+ * file has been written.
  */
 static void alarmsave(){
     int pushfd;
@@ -2953,6 +3773,36 @@ static void alarmsave(){
         storageFreeError(errStr);
         return;
     }
+
+    if (errStr != NULL){
+        /* Keep the journal, the file may be incomplete. */
+        storageFreeError(errStr);
+        return;
+    }
+
+    if (storage_file_exists(&alarmjournalpathname)){
+        storage_delete_file(&errStr, &alarmjournalpathname);
+        storageFreeError(errStr);
+    }
+    alarmJournalRecords = 0;
+}
+
+/**
+ * Records a change of the alarm registrations in the journal.
+ *
+ * @param type <tt>JOURNAL_ADD</tt> or <tt>JOURNAL_REMOVE</tt>
+ * @param value full-text alarm entry
+ * @return <tt>KNI_TRUE</tt> if the journal is full or could not be
+ *         written, the caller must then call alarmsave() once the change
+ *         has been made to the alarm list
+ */
+static jboolean alarmjournal(char type, char *value){
+    if (journalAppend(&alarmjournalpathname, type, value) != 0){
+        return KNI_TRUE;
+    }
+
+    return (++alarmJournalRecords >= JOURNAL_CHECKPOINT_RECORDS) ?
+        KNI_TRUE : KNI_FALSE;
 }
 /**
  * Starts a timer for a single alarm entry.
@@ -2974,6 +3824,7 @@ static void alarmstart(AlarmEntry *entry, jlong alarm){
         /* if expired, flag the timer as triggered */
         entry->state = RECEIVED_EVENT;
         entry->timerHandle = 0;
+        pushPollPending = KNI_TRUE;
     }
 }
 
@@ -2996,6 +3847,7 @@ int alarmadd(char *str, jlong alarm, jlong *lastalarm){
     AlarmEntry *pe = NULL;
     char *ptr;
     int len;
+    jboolean checkpoint;
 
     /* Find the length of the midlet field. */
     for (ptr = str, len = 0; *ptr != 0 ; ptr++, len++){
@@ -3018,10 +3870,13 @@ int alarmadd(char *str, jlong alarm, jlong *lastalarm){
                 } else{
                     lastp->next = alarmp->next;
                 }
+                checkpoint = alarmjournal(JOURNAL_REMOVE, alarmp->midlet);
                 midpFree(alarmp->midlet);
                 midpFree(alarmp->storagename);
                 midpFree(alarmp);
-                alarmsave();
+                if (checkpoint){
+                    alarmsave();
+                }
             } else{
                 /*
          * Replace an entry.
@@ -3034,10 +3889,17 @@ int alarmadd(char *str, jlong alarm, jlong *lastalarm){
                     alarmp->timerHandle = 0;
                 }
                 /* Update alarm. */
+                checkpoint = alarmjournal(JOURNAL_REMOVE, alarmp->midlet);
                 midpFree(alarmp->midlet);
                 alarmp->midlet = midpStrdup(str);
                 alarmstart(alarmp,alarm);
-                alarmsave();
+                if (alarmp->midlet != NULL &&
+                        alarmjournal(JOURNAL_ADD, alarmp->midlet)){
+                    checkpoint = KNI_TRUE;
+                }
+                if (checkpoint){
+                    alarmsave();
+                }
             }
             *lastalarm = temp;
 
@@ -3074,7 +3936,9 @@ int alarmadd(char *str, jlong alarm, jlong *lastalarm){
         return -2;
     }
 
-    alarmsave();
+    if (alarmjournal(JOURNAL_ADD, pe->midlet)){
+        alarmsave();
+    }
     return 0 ;
 }
 
@@ -198,6 +198,17 @@ int pushcheckin(int fd) {
     return -1;
 }
 
+/**
+ * Checks if a handle belongs to a push connection, checked out or not.
+ * @param fd The handle to look up
+ * @return <tt>1</tt> if the handle is owned by the push registry, or
+ * <tt>0</tt> otherwise
+ */
+int pushownsfd(int fd) {
+    (void)fd;
+    return 0;
+}
+
 /**
  * Checks in all the push connections. Used to cleanup by runMIDletWithArgs.
  */
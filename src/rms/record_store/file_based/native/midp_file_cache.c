@@ -49,6 +49,15 @@ static MidpFileCache *mFileCache;
 /* Cache limit for a single file */
 static unsigned int fileCacheLimit = 0;
 
+/*
+ * Set while the block list is being changed or written out, when the
+ * blocks must not be reclaimed by a nested midpMalloc.
+ */
+static int fileCacheBusy = 0;
+
+static void midp_file_cache_flush_using_buffer(char** ppszError, int handle,
+                                               char* buf, long bufsize);
+
 /**
  * Test if region 1 that starts from position x1 with size s1
  * overlaps with region 2 that starts from position x2 with
@@ -134,6 +143,35 @@ static void initFileCacheLimit() {
     }
 }
 
+/**
+ * Reclaim routine of the file cache, registered with midpMalloc. Writes
+ * the cached blocks to the file without a merge buffer, so that nothing
+ * has to be allocated, and frees them.
+ *
+ * @param cache the file cache
+ * @param needed number of bytes wanted, the whole cache is written anyway
+ * @return number of bytes released
+ */
+static int reclaimFileCache(void* cache, int needed) {
+    char* pszError = NULL;
+    int released;
+
+    (void)needed;
+
+    if (cache != mFileCache || fileCacheBusy || mFileCache->blocks == NULL) {
+        return 0;
+    }
+
+    released = mFileCache->size;
+    midp_file_cache_flush_using_buffer(&pszError, mFileCache->handle,
+                                       NULL, 0);
+    if (pszError != NULL) {
+        storageFreeError(pszError);
+    }
+
+    return released - mFileCache->size;
+}
+
 /**
  * Flush the cache and stop current file caching.
  * Seek cached position for the case the file won't be closed after
@@ -143,6 +181,7 @@ static void midp_file_cache_finalize(char **ppszError, int stayOpen) {
     *ppszError = NULL;
 
     if (mFileCache != NULL) {
+        midpUnregisterReclaimProc(mFileCache);
         midp_file_cache_flush(ppszError, mFileCache->handle);
         /* Do no seek for the file that is either damaged or to be closed */
         if (*ppszError == NULL && stayOpen) {
@@ -244,6 +283,7 @@ void midp_file_cache_flush(char** ppszError, int handle) {
     /* allocate a buffer, as large as possible, but no larger than the cache */
     /* the buffer will be freed before the function returns */
     bufsize = mFileCache->size;
+    fileCacheBusy++;
     do {
          buf = (char*)midpMalloc(bufsize);
 
@@ -263,6 +303,7 @@ void midp_file_cache_flush(char** ppszError, int handle) {
             break;
          }
     } while(1);
+    fileCacheBusy--;
 }
 
 int midp_file_cache_open(char** ppszError, StorageIdType storageId,
@@ -282,6 +323,7 @@ int midp_file_cache_open(char** ppszError, StorageIdType storageId,
             mFileCache->cachedAvailableSpace = UNINITIALIZED_CACHED_VALUE;
             mFileCache->cachedFileSize = storageSizeOf(ppszError, h);
             mFileCache->blocks = NULL;
+            midpRegisterReclaimProc(mFileCache, reclaimFileCache);
         } else {
             /* More than one file is open. Available space can no longer been
              * cached. Stop caching completely. */
@@ -384,7 +426,10 @@ void midp_file_cache_write(char** ppszError, int handle,
     }
 
     /* Cache is not full, check if memory is full */
+    /* p must stay in the list, so the blocks cannot be reclaimed meanwhile */
+    fileCacheBusy++;
     b = (MidpFileCacheBlock *)midpMalloc(sizeof(MidpFileCacheBlock)+length);
+    fileCacheBusy--;
     if (b == NULL) {
         /* Out of memory. Write directly to storage */
         uncachedWrite(ppszError, handle, buffer, length);
@@ -0,0 +1,61 @@
+/*
+ *   
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+#ifndef HEADER_SHA256_H
+#define HEADER_SHA256_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <string.h>
+
+#define SHA256_CBLOCK	64
+#define SHA256_LAST_BLOCK  56
+#define SHA256_DIGEST_LENGTH 32
+
+/*
+ * SHA-256 context. Partial input blocks are buffered in data; num is
+ * the number of bytes buffered. Nl and Nh hold the low and high 32
+ * bits of the message length in bits.
+ */
+typedef struct SHA256state_st
+	{
+	unsigned int h[8];
+	unsigned int Nl,Nh;
+	unsigned char data[SHA256_CBLOCK];
+	int num;
+	} SHA256_CTX;
+
+void SHA256_Init(SHA256_CTX *c);
+void SHA256_Update(SHA256_CTX *c, unsigned char *data, unsigned long len);
+void SHA256_Final(unsigned char *md, SHA256_CTX *c);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif
@@ -32,18 +32,13 @@ package com.sun.midp.crypto;
 final class SHA extends MessageDigest {
     /*
      * The compute intensive operations are implemented in C
-     * based on the OpenSSL SHA code (from pilotSSLeay). Here we
-     * replicate the state the C code needs.
+     * based on the OpenSSL SHA code (from pilotSSLeay). The state
+     * the C code needs is kept in native memory for the lifetime of
+     * this object, so it is not copied in and out on every call.
      */
 
-    /** State needed for SHA hash. */
-    private int[] state = new int[5]; // h0 ... h4
-    /** State needed for SHA hash. */
-    private int[] num = new int[1];
-    /** State needed for SHA hash. */
-    private int[] count = new int[2]; // Nl and Nh 
-    /** State needed for SHA hash. */
-    private int[] data = new int[16]; // data block 
+    /** Native SHA context, set and used only by native code. */
+    private long nativeContext;
 
     /** Create SHA digest object. */
     SHA() {
@@ -70,18 +65,17 @@ final class SHA extends MessageDigest {
      * Resets the MessageDigest to the initial state for further use.
      */
     public void reset() {
-        // SHA1 initialization constants
-        state[0] = 0x67452301;
-        state[1] = 0xEFCDAB89;
-        state[2] = 0x98BADCFE;
-        state[3] = 0x10325476;
-        state[4] = 0xC3D2E1F0;
-        num[0] = 0;
-        count[0] = count[1] = 0;
-        for (int i = 0; i < data.length; i++)
-             data[i] = 0;
+        nativeReset();
     }
 
+    /**
+     * Allocates the native SHA context if this object has none yet and
+     * puts it in the initial state.
+     *
+     * @exception OutOfMemoryError if the context cannot be allocated
+     */
+    private native void nativeReset();
+
     /**
      * Accumulates a hash of the input data. This method is useful when
      * the input data to be hashed is not available in one byte array. 
@@ -97,22 +91,16 @@ final class SHA extends MessageDigest {
 
         // check parameters to avoid a VM crash
         int test = inBuf[inOff] + inBuf[inLen - 1] + inBuf[inOff + inLen - 1];
-        nativeUpdate(inBuf, inOff, inLen, state, num, count, data);
+        nativeUpdate(inBuf, inOff, inLen);
     }
 
     /**
-     * Accumulates a hash of the input data. This method is useful when
-     * the input data to be hashed is not available in one byte array. 
+     * Accumulates a hash of the input data in the native context.
      * @param inBuf input buffer of data to be hashed
      * @param inOff offset within inBuf where input data begins
      * @param inLen length (in bytes) of data to be hashed
-     * @param state internal hash state
-     * @param num internal hash state
-     * @param count internal hash state
-     * @param data internal hash state
      */
-    private static native void nativeUpdate(byte[] inBuf, int inOff, 
-	     int inLen, int[] state, int[] num, int[] count, int[] data);
+    private native void nativeUpdate(byte[] inBuf, int inOff, int inLen);
 
 
     /**
@@ -137,39 +125,43 @@ final class SHA extends MessageDigest {
         // check the parameters to prevent a VM crash
         int test = buf[offset] + buf[offset + getDigestLength() - 1];
         
-        nativeFinal(null, 0, 0, buf, offset, state, num, count, data);
+        nativeFinal(null, 0, 0, buf, offset);
         return getDigestLength();
     }
 
     /** 
      * Generates a hash of all/last input data. Completes and returns the
      * hash compuatation after performing final operations such as padding.
-     * The MessageDigest object is reset after this call. 
+     * The native context is reset after this call. 
      * @param inBuf input buffer of data to be hashed
      * @param inOff offset within inBuf where input data begins
      * @param inLen length (in bytes) of data to be hashed
      * @param outBuf output buffer where the hash should be placed
      * @param outOff offset within outBuf where the resulting hash begins
-     * @param state internal hash state
-     * @param num internal hash state
-     * @param count internal hash state
-     * @param data internal hash state
      */ 
-    private static native void nativeFinal(byte[] inBuf, int inOff, 
-		    int inLen, byte[] outBuf, int outOff,
-		    int[] state, int[] num, int[] count, int[] data);
+    private native void nativeFinal(byte[] inBuf, int inOff, int inLen,
+                                    byte[] outBuf, int outOff);
 
     /** 
      * Clones the MessageDigest object.
      * @return a clone of this object
      */
     public Object clone() {
-	SHA cpy = new SHA();
+        SHA cpy = new SHA();
 
-	System.arraycopy(this.state, 0, cpy.state, 0, this.state.length);
-	System.arraycopy(this.num, 0, cpy.num, 0, this.num.length);
-	System.arraycopy(this.count, 0, cpy.count, 0, this.count.length);
-	System.arraycopy(this.data, 0, cpy.data, 0, this.data.length);
-	return cpy;
+        cpy.nativeCopy(this);
+        return cpy;
     }
+
+    /**
+     * Copies the native context of another SHA object into this one.
+     *
+     * @param source object to copy the context from
+     */
+    private native void nativeCopy(SHA source);
+
+    /**
+     * Frees the native SHA context.
+     */
+    private native void finalize();
 }
@@ -0,0 +1,165 @@
+/*
+ *   
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+package com.sun.midp.crypto;
+
+/**
+ * Implements the SHA-256 message digest algorithm.
+ */ 
+final class SHA256 extends MessageDigest {
+    /*
+     * The compute intensive operations are implemented in C.
+     * The state the C code needs is kept in native memory for the
+     * lifetime of this object.
+     */
+
+    /** Native SHA-256 context, set and used only by native code. */
+    private long nativeContext;
+
+    /** Create SHA-256 digest object. */
+    SHA256() {
+        reset();
+    }
+
+    /** 
+     * Gets the message digest algorithm.
+     * @return algorithm implemented by this MessageDigest object
+     */
+    public String getAlgorithm() {
+        return "SHA-256";
+    }
+
+    /** 
+     * Gets the length (in bytes) of the hash.
+     * @return byte-length of the hash produced by this object
+     */
+    public int getDigestLength() {
+        return 32;
+    }
+
+    /** 
+     * Resets the MessageDigest to the initial state for further use.
+     */
+    public void reset() {
+        nativeReset();
+    }
+
+    /**
+     * Allocates the native SHA-256 context if this object has none yet
+     * and puts it in the initial state.
+     *
+     * @exception OutOfMemoryError if the context cannot be allocated
+     */
+    private native void nativeReset();
+
+    /**
+     * Accumulates a hash of the input data. This method is useful when
+     * the input data to be hashed is not available in one byte array. 
+     * @param inBuf input buffer of data to be hashed
+     * @param inOff offset within inBuf where input data begins
+     * @param inLen length (in bytes) of data to be hashed
+     * @see #doFinal(byte[], int, int, byte[], int)
+     */
+    public void update(byte[] inBuf, int inOff, int inLen) {
+        if (inLen == 0) {
+            return;
+        }
+
+        // check parameters to avoid a VM crash
+        int test = inBuf[inOff] + inBuf[inOff + inLen - 1];
+        nativeUpdate(inBuf, inOff, inLen);
+    }
+
+    /**
+     * Accumulates a hash of the input data in the native context.
+     * @param inBuf input buffer of data to be hashed
+     * @param inOff offset within inBuf where input data begins
+     * @param inLen length (in bytes) of data to be hashed
+     */
+    private native void nativeUpdate(byte[] inBuf, int inOff, int inLen);
+
+    /**
+     * Completes the hash computation by performing final operations
+     * such as padding. The digest is reset after this call is made.
+     *
+     * @param buf output buffer for the computed digest
+     *
+     * @param offset offset into the output buffer to begin storing the digest
+     *
+     * @param len number of bytes within buf allotted for the digest
+     *
+     * @return the number of bytes placed into <code>buf</code>
+     * 
+     * @exception DigestException if an error occurs.
+     */
+    public int digest(byte[] buf, int offset, int len) throws DigestException {
+        if (len < getDigestLength()) {
+            throw new DigestException("Buffer too short.");
+        }
+
+        // check the parameters to prevent a VM crash
+        int test = buf[offset] + buf[offset + getDigestLength() - 1];
+        
+        nativeFinal(null, 0, 0, buf, offset);
+        return getDigestLength();
+    }
+
+    /** 
+     * Generates a hash of all/last input data. Completes and returns the
+     * hash compuatation after performing final operations such as padding.
+     * The native context is reset after this call. 
+     * @param inBuf input buffer of data to be hashed
+     * @param inOff offset within inBuf where input data begins
+     * @param inLen length (in bytes) of data to be hashed
+     * @param outBuf output buffer where the hash should be placed
+     * @param outOff offset within outBuf where the resulting hash begins
+     */ 
+    private native void nativeFinal(byte[] inBuf, int inOff, int inLen,
+                                    byte[] outBuf, int outOff);
+
+    /** 
+     * Clones the MessageDigest object.
+     * @return a clone of this object
+     */
+    public Object clone() {
+        SHA256 cpy = new SHA256();
+
+        cpy.nativeCopy(this);
+        return cpy;
+    }
+
+    /**
+     * Copies the native context of another SHA256 object into this one.
+     *
+     * @param source object to copy the context from
+     */
+    private native void nativeCopy(SHA256 source);
+
+    /**
+     * Frees the native SHA-256 context.
+     */
+    private native void finalize();
+}
@@ -0,0 +1,170 @@
+/*
+ * 	
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+package com.sun.midp.crypto;
+
+import com.sun.midp.i3test.*;
+
+/**
+ * Unit tests for the MessageDigest implementations, using the
+ * FIPS 180-2 and RFC 1321 test vectors.
+ */
+public class TestMessageDigest extends TestCase {
+
+    /** One block message. */
+    static final String MSG_ABC = "abc";
+
+    /** Two block message from FIPS 180-2. */
+    static final String MSG_448 =
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+    /** Expected digests of MSG_ABC in MD5, SHA-1, SHA-256 order. */
+    static final String[] ABC_DIGESTS = {
+        "900150983cd24fb0d6963f7d28e17f72",
+        "a9993e364706816aba3e25717850c26c9cd0d89d",
+        "ba7816bf8f01cfea414140de5dae2223" +
+        "b00361a396177a9cb410ff61f20015ad"
+    };
+
+    /** Expected digests of MSG_448 in MD5, SHA-1, SHA-256 order. */
+    static final String[] MSG_448_DIGESTS = {
+        "8215ef0796a20bcaaae116d3876c664a",
+        "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+        "248d6a61d20638b8e5c026930c3e6039" +
+        "a33ce45964ff2167f6ecedd419db06c1"
+    };
+
+    /** Expected digests of 1000 'a' bytes in MD5, SHA-1, SHA-256 order. */
+    static final String[] A1000_DIGESTS = {
+        "cabe45dcc9ae5b66ba86600cca6b8ba8",
+        "291e9a6c66994949b57ba5e650361e98fc36b1ba",
+        "41edece42d63e8d9bf515a9ba6932e1c" +
+        "20cbc9f5a5d134645adb5db1b9737ea3"
+    };
+
+    /** Algorithms under test, in the order of the digest tables. */
+    static final String[] ALGORITHMS = { "MD5", "SHA-1", "SHA-256" };
+
+    /**
+     * Runs all tests.
+     */
+    public void runTests() throws Throwable {
+        declare("testVectors");
+        testVectors();
+        declare("testChunkedUpdate");
+        testChunkedUpdate();
+        declare("testClone");
+        testClone();
+    }
+
+    /**
+     * Hashes a whole message with one update call.
+     *
+     * @param md digest to use
+     * @param msg message bytes
+     *
+     * @return hex encoded digest
+     */
+    String hash(MessageDigest md, byte[] msg) throws DigestException {
+        byte[] out = new byte[md.getDigestLength()];
+
+        md.update(msg, 0, msg.length);
+        md.digest(out, 0, out.length);
+        return Util.hexEncode(out);
+    }
+
+    /**
+     * Checks the one and two block test vectors for every algorithm.
+     */
+    void testVectors() throws Exception {
+        for (int i = 0; i < ALGORITHMS.length; i++) {
+            MessageDigest md = MessageDigest.getInstance(ALGORITHMS[i]);
+
+            assertEquals(ALGORITHMS[i] + " \"abc\"", ABC_DIGESTS[i],
+                         hash(md, MSG_ABC.getBytes()));
+
+            // the digest must be reset after digest()
+            assertEquals(ALGORITHMS[i] + " 448-bit message",
+                         MSG_448_DIGESTS[i], hash(md, MSG_448.getBytes()));
+        }
+    }
+
+    /**
+     * Feeds a message spanning many blocks in pieces that do not line
+     * up with the block size.
+     */
+    void testChunkedUpdate() throws Exception {
+        byte[] msg = new byte[1000];
+        byte[] out = new byte[32];
+
+        for (int i = 0; i < msg.length; i++) {
+            msg[i] = (byte)'a';
+        }
+
+        for (int i = 0; i < ALGORITHMS.length; i++) {
+            MessageDigest md = MessageDigest.getInstance(ALGORITHMS[i]);
+            int off = 0;
+            int len = 1;
+
+            while (off < msg.length) {
+                if (len > msg.length - off) {
+                    len = msg.length - off;
+                }
+
+                md.update(msg, off, len);
+                off += len;
+                len += 7;
+            }
+
+            md.digest(out, 0, md.getDigestLength());
+            assertEquals(ALGORITHMS[i] + " chunked", A1000_DIGESTS[i],
+                Util.hexEncode(Util.cloneSubarray(out, 0,
+                                                  md.getDigestLength())));
+        }
+    }
+
+    /**
+     * Checks that a clone continues from the state of the original
+     * and that the two do not share a context afterwards.
+     */
+    void testClone() throws Exception {
+        byte[] head = MSG_448.substring(0, 30).getBytes();
+        byte[] tail = MSG_448.substring(30).getBytes();
+
+        for (int i = 0; i < ALGORITHMS.length; i++) {
+            MessageDigest md = MessageDigest.getInstance(ALGORITHMS[i]);
+            MessageDigest copy;
+
+            md.update(head, 0, head.length);
+            copy = (MessageDigest)md.clone();
+
+            assertEquals(ALGORITHMS[i] + " clone", MSG_448_DIGESTS[i],
+                         hash(copy, tail));
+            assertEquals(ALGORITHMS[i] + " original", MSG_448_DIGESTS[i],
+                         hash(md, tail));
+        }
+    }
+}
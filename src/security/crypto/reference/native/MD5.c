@@ -94,256 +94,229 @@
 
 #include <MD5.h>
 
-/* Implemented from RFC1321 The MD5 Message-Digest Algorithm */
+/* Implemented from RFC1321 The MD5 Message-Digest Algorithm
+ *
+ * The block function takes any number of 64-byte blocks straight from
+ * the caller's buffer, keeping the chaining values in locals across
+ * blocks. Only a partial block at either end of an update is copied
+ * into the context. The 64 steps are fully unrolled.
+ */
+
+/** A 32-bit word, whatever the width of unsigned long. */
+typedef unsigned int MD5_WORD;
+
+#define ROTATE(a,n)	(((a)<<(n))|((a)>>(32-(n))))
+
+/* Loads a little-endian word; any alignment of p is fine. */
+#define LOAD_LE32(p)	(((MD5_WORD)(p)[0]    )|((MD5_WORD)(p)[1]<< 8)| \
+			 ((MD5_WORD)(p)[2]<<16)|((MD5_WORD)(p)[3]<<24))
+
+#define STORE_LE32(p,l)	((p)[0]=(unsigned char)((l)    ), \
+			 (p)[1]=(unsigned char)((l)>> 8), \
+			 (p)[2]=(unsigned char)((l)>>16), \
+			 (p)[3]=(unsigned char)((l)>>24))
+
+/*
+#define	F(x,y,z)	(((x) & (y))  |  ((~(x)) & (z)))
+#define	G(x,y,z)	(((x) & (z))  |  ((y) & (~(z))))
+*/
+
+/* As pointed out by Wei Dai <weidai@eskimo.com>, the above can be
+ * simplified to the code below.  Wei attributes these optimisations
+ * to Peter Gutmann's SHS code, and he attributes it to Rich Schroeppel.
+ */
+#define	F(x,y,z)	((((y) ^ (z)) & (x)) ^ (z))
+#define	G(x,y,z)	((((x) ^ (y)) & (z)) ^ (y))
+#define	H(x,y,z)	((x) ^ (y) ^ (z))
+#define	I(x,y,z)	(((x) | (~(z))) ^ (y))
 
-static void md5_block(MD5_CTX *c, unsigned long *p);
+#define R0(a,b,c,d,k,s,t) { \
+	a+=((k)+(t)+F((b),(c),(d))); \
+	a=ROTATE(a,s); \
+	a+=b; };
 
-void MD5_Update(MD5_CTX *c, register unsigned char *data, unsigned long len)
-{
-	register ULONG *p;
-	int sw,sc;
-	ULONG l;
+#define R1(a,b,c,d,k,s,t) { \
+	a+=((k)+(t)+G((b),(c),(d))); \
+	a=ROTATE(a,s); \
+	a+=b; };
+
+#define R2(a,b,c,d,k,s,t) { \
+	a+=((k)+(t)+H((b),(c),(d))); \
+	a=ROTATE(a,s); \
+	a+=b; };
+
+#define R3(a,b,c,d,k,s,t) { \
+	a+=((k)+(t)+I((b),(c),(d))); \
+	a=ROTATE(a,s); \
+	a+=b; };
+
+static void md5_blocks(MD5_CTX *c, const unsigned char *data,
+		       unsigned long blocks)
+	{
+	MD5_WORD A,B,C,D;
+	MD5_WORD X[16];
+	int i;
+
+	A=(MD5_WORD)c->A;
+	B=(MD5_WORD)c->B;
+	C=(MD5_WORD)c->C;
+	D=(MD5_WORD)c->D;
+
+	for (; blocks != 0; blocks--, data+=MD5_CBLOCK)
+		{
+		MD5_WORD a=A,b=B,cc=C,d=D;
+
+		for (i=0; i<16; i++)
+			X[i]=LOAD_LE32(data+4*i);
+
+		/* Round 0 */
+		R0(a,b,cc,d,X[ 0], 7,0xd76aa478UL);
+		R0(d,a,b,cc,X[ 1],12,0xe8c7b756UL);
+		R0(cc,d,a,b,X[ 2],17,0x242070dbUL);
+		R0(b,cc,d,a,X[ 3],22,0xc1bdceeeUL);
+		R0(a,b,cc,d,X[ 4], 7,0xf57c0fafUL);
+		R0(d,a,b,cc,X[ 5],12,0x4787c62aUL);
+		R0(cc,d,a,b,X[ 6],17,0xa8304613UL);
+		R0(b,cc,d,a,X[ 7],22,0xfd469501UL);
+		R0(a,b,cc,d,X[ 8], 7,0x698098d8UL);
+		R0(d,a,b,cc,X[ 9],12,0x8b44f7afUL);
+		R0(cc,d,a,b,X[10],17,0xffff5bb1UL);
+		R0(b,cc,d,a,X[11],22,0x895cd7beUL);
+		R0(a,b,cc,d,X[12], 7,0x6b901122UL);
+		R0(d,a,b,cc,X[13],12,0xfd987193UL);
+		R0(cc,d,a,b,X[14],17,0xa679438eUL);
+		R0(b,cc,d,a,X[15],22,0x49b40821UL);
+		/* Round 1 */
+		R1(a,b,cc,d,X[ 1], 5,0xf61e2562UL);
+		R1(d,a,b,cc,X[ 6], 9,0xc040b340UL);
+		R1(cc,d,a,b,X[11],14,0x265e5a51UL);
+		R1(b,cc,d,a,X[ 0],20,0xe9b6c7aaUL);
+		R1(a,b,cc,d,X[ 5], 5,0xd62f105dUL);
+		R1(d,a,b,cc,X[10], 9,0x02441453UL);
+		R1(cc,d,a,b,X[15],14,0xd8a1e681UL);
+		R1(b,cc,d,a,X[ 4],20,0xe7d3fbc8UL);
+		R1(a,b,cc,d,X[ 9], 5,0x21e1cde6UL);
+		R1(d,a,b,cc,X[14], 9,0xc33707d6UL);
+		R1(cc,d,a,b,X[ 3],14,0xf4d50d87UL);
+		R1(b,cc,d,a,X[ 8],20,0x455a14edUL);
+		R1(a,b,cc,d,X[13], 5,0xa9e3e905UL);
+		R1(d,a,b,cc,X[ 2], 9,0xfcefa3f8UL);
+		R1(cc,d,a,b,X[ 7],14,0x676f02d9UL);
+		R1(b,cc,d,a,X[12],20,0x8d2a4c8aUL);
+		/* Round 2 */
+		R2(a,b,cc,d,X[ 5], 4,0xfffa3942UL);
+		R2(d,a,b,cc,X[ 8],11,0x8771f681UL);
+		R2(cc,d,a,b,X[11],16,0x6d9d6122UL);
+		R2(b,cc,d,a,X[14],23,0xfde5380cUL);
+		R2(a,b,cc,d,X[ 1], 4,0xa4beea44UL);
+		R2(d,a,b,cc,X[ 4],11,0x4bdecfa9UL);
+		R2(cc,d,a,b,X[ 7],16,0xf6bb4b60UL);
+		R2(b,cc,d,a,X[10],23,0xbebfbc70UL);
+		R2(a,b,cc,d,X[13], 4,0x289b7ec6UL);
+		R2(d,a,b,cc,X[ 0],11,0xeaa127faUL);
+		R2(cc,d,a,b,X[ 3],16,0xd4ef3085UL);
+		R2(b,cc,d,a,X[ 6],23,0x04881d05UL);
+		R2(a,b,cc,d,X[ 9], 4,0xd9d4d039UL);
+		R2(d,a,b,cc,X[12],11,0xe6db99e5UL);
+		R2(cc,d,a,b,X[15],16,0x1fa27cf8UL);
+		R2(b,cc,d,a,X[ 2],23,0xc4ac5665UL);
+		/* Round 3 */
+		R3(a,b,cc,d,X[ 0], 6,0xf4292244UL);
+		R3(d,a,b,cc,X[ 7],10,0x432aff97UL);
+		R3(cc,d,a,b,X[14],15,0xab9423a7UL);
+		R3(b,cc,d,a,X[ 5],21,0xfc93a039UL);
+		R3(a,b,cc,d,X[12], 6,0x655b59c3UL);
+		R3(d,a,b,cc,X[ 3],10,0x8f0ccc92UL);
+		R3(cc,d,a,b,X[10],15,0xffeff47dUL);
+		R3(b,cc,d,a,X[ 1],21,0x85845dd1UL);
+		R3(a,b,cc,d,X[ 8], 6,0x6fa87e4fUL);
+		R3(d,a,b,cc,X[15],10,0xfe2ce6e0UL);
+		R3(cc,d,a,b,X[ 6],15,0xa3014314UL);
+		R3(b,cc,d,a,X[13],21,0x4e0811a1UL);
+		R3(a,b,cc,d,X[ 4], 6,0xf7537e82UL);
+		R3(d,a,b,cc,X[11],10,0xbd3af235UL);
+		R3(cc,d,a,b,X[ 2],15,0x2ad7d2bbUL);
+		R3(b,cc,d,a,X[ 9],21,0xeb86d391UL);
+
+		A+=a;
+		B+=b;
+		C+=cc;
+		D+=d;
+		}
+
+	c->A=A;
+	c->B=B;
+	c->C=C;
+	c->D=D;
+	}
+
+void MD5_Update(MD5_CTX *c, unsigned char *data, unsigned long len)
+	{
+	unsigned char *buf=(unsigned char *)c->data;
+	unsigned long l;
+	unsigned long n;
 
 	if (len == 0) return;
 
-	l=(c->Nl+(len<<3))&0xffffffffL;
+	l=(c->Nl+(len<<3))&0xffffffffUL;
 	if (l < c->Nl) /* overflow */
 		c->Nh++;
-	c->Nh+=(len>>29);
+	c->Nh=(c->Nh+(len>>29))&0xffffffffUL;
 	c->Nl=l;
 
 	if (c->num != 0)
 		{
-		p=c->data;
-		sw=c->num>>2;
-		sc=c->num&0x03;
-
-		if ((c->num+len) >= MD5_CBLOCK)
-			{
-			l= p[sw];
-			p_c2l(data,l,sc);
-			p[sw++]=l;
-			for (; sw<MD5_LBLOCK; sw++)
-				{
-				c2l(data,l);
-				p[sw]=l;
-				}
-			len-=(MD5_CBLOCK-c->num);
-
-			md5_block(c,p);
-			c->num=0;
-			/* drop through and do the rest */
-			}
-		else
+		n=MD5_CBLOCK-c->num;
+		if (len < n)
 			{
-			int ew,ec;
-
+			memcpy(buf+c->num,data,len);
 			c->num+=(int)len;
-			if ((sc+len) < 4) /* ugly, add char's to a word */
-				{
-				l= p[sw];
-				p_c2l_p(data,l,sc,len);
-				p[sw]=l;
-				}
-			else
-				{
-				ew=(c->num>>2);
-				ec=(c->num&0x03);
-				l= p[sw];
-				p_c2l(data,l,sc);
-				p[sw++]=l;
-				for (; sw < ew; sw++)
-					{ c2l(data,l); p[sw]=l; }
-				if (ec)
-					{
-					c2l_p(data,l,ec);
-					p[sw]=l;
-					}
-				}
 			return;
 			}
+
+		memcpy(buf+c->num,data,n);
+		md5_blocks(c,buf,1);
+		data+=n;
+		len-=n;
+		c->num=0;
 		}
-	/* we now can process the input data in blocks of MD5_CBLOCK
-	 * chars and save the leftovers to c->data. */
-	p=c->data;
-	while (len >= MD5_CBLOCK)
+
+	n=len/MD5_CBLOCK;
+	if (n != 0)
 		{
-#if defined(L_ENDIAN) || defined(B_ENDIAN)
-		memcpy(p,data,MD5_CBLOCK);
-		data+=MD5_CBLOCK;
-#ifdef B_ENDIAN
-		for (sw=(MD5_LBLOCK/4); sw; sw--)
-			{
-			Endian_Reverse32(p[0]);
-			Endian_Reverse32(p[1]);
-			Endian_Reverse32(p[2]);
-			Endian_Reverse32(p[3]);
-			p+=4;
-			}
-#endif
-#else
-		for (sw=(MD5_LBLOCK/4); sw; sw--)
-			{
-			c2l(data,l); *(p++)=l;
-			c2l(data,l); *(p++)=l;
-			c2l(data,l); *(p++)=l;
-			c2l(data,l); *(p++)=l; 
-			} 
-#endif
-		p=c->data;
-		md5_block(c,p);
-		len-=MD5_CBLOCK;
+		md5_blocks(c,data,n);
+		data+=n*MD5_CBLOCK;
+		len-=n*MD5_CBLOCK;
 		}
-	sc=(int)len;
-	c->num=sc;
-	if (sc)
+
+	if (len != 0)
 		{
-		sw=sc>>2;	/* words to copy */
-#ifdef L_ENDIAN
-		p[sw]=0;
-		memcpy(p,data,sc);
-#else
-		sc&=0x03;
-		for ( ; sw; sw--)
-			{ c2l(data,l); *(p++)=l; }
-		c2l_p(data,l,sc);
-		*p=l;
-#endif
+		memcpy(buf,data,len);
+		c->num=(int)len;
 		}
-}
-
-static void md5_block(MD5_CTX *c, register ULONG *X)
-{
-	register ULONG A,B,C,D;
-
-	A=c->A;
-	B=c->B;
-	C=c->C;
-	D=c->D;
-
-	/* Round 0 */
-	R0(A,B,C,D,X[ 0], 7,0xd76aa478L);
-	R0(D,A,B,C,X[ 1],12,0xe8c7b756L);
-	R0(C,D,A,B,X[ 2],17,0x242070dbL);
-	R0(B,C,D,A,X[ 3],22,0xc1bdceeeL);
-	R0(A,B,C,D,X[ 4], 7,0xf57c0fafL);
-	R0(D,A,B,C,X[ 5],12,0x4787c62aL);
-	R0(C,D,A,B,X[ 6],17,0xa8304613L);
-	R0(B,C,D,A,X[ 7],22,0xfd469501L);
-	R0(A,B,C,D,X[ 8], 7,0x698098d8L);
-	R0(D,A,B,C,X[ 9],12,0x8b44f7afL);
-	R0(C,D,A,B,X[10],17,0xffff5bb1L);
-	R0(B,C,D,A,X[11],22,0x895cd7beL);
-	R0(A,B,C,D,X[12], 7,0x6b901122L);
-	R0(D,A,B,C,X[13],12,0xfd987193L);
-	R0(C,D,A,B,X[14],17,0xa679438eL);
-	R0(B,C,D,A,X[15],22,0x49b40821L);
-	/* Round 1 */
-	R1(A,B,C,D,X[ 1], 5,0xf61e2562L);
-	R1(D,A,B,C,X[ 6], 9,0xc040b340L);
-	R1(C,D,A,B,X[11],14,0x265e5a51L);
-	R1(B,C,D,A,X[ 0],20,0xe9b6c7aaL);
-	R1(A,B,C,D,X[ 5], 5,0xd62f105dL);
-	R1(D,A,B,C,X[10], 9,0x02441453L);
-	R1(C,D,A,B,X[15],14,0xd8a1e681L);
-	R1(B,C,D,A,X[ 4],20,0xe7d3fbc8L);
-	R1(A,B,C,D,X[ 9], 5,0x21e1cde6L);
-	R1(D,A,B,C,X[14], 9,0xc33707d6L);
-	R1(C,D,A,B,X[ 3],14,0xf4d50d87L);
-	R1(B,C,D,A,X[ 8],20,0x455a14edL);
-	R1(A,B,C,D,X[13], 5,0xa9e3e905L);
-	R1(D,A,B,C,X[ 2], 9,0xfcefa3f8L);
-	R1(C,D,A,B,X[ 7],14,0x676f02d9L);
-	R1(B,C,D,A,X[12],20,0x8d2a4c8aL);
-	/* Round 2 */
-	R2(A,B,C,D,X[ 5], 4,0xfffa3942L);
-	R2(D,A,B,C,X[ 8],11,0x8771f681L);
-	R2(C,D,A,B,X[11],16,0x6d9d6122L);
-	R2(B,C,D,A,X[14],23,0xfde5380cL);
-	R2(A,B,C,D,X[ 1], 4,0xa4beea44L);
-	R2(D,A,B,C,X[ 4],11,0x4bdecfa9L);
-	R2(C,D,A,B,X[ 7],16,0xf6bb4b60L);
-	R2(B,C,D,A,X[10],23,0xbebfbc70L);
-	R2(A,B,C,D,X[13], 4,0x289b7ec6L);
-	R2(D,A,B,C,X[ 0],11,0xeaa127faL);
-	R2(C,D,A,B,X[ 3],16,0xd4ef3085L);
-	R2(B,C,D,A,X[ 6],23,0x04881d05L);
-	R2(A,B,C,D,X[ 9], 4,0xd9d4d039L);
-	R2(D,A,B,C,X[12],11,0xe6db99e5L);
-	R2(C,D,A,B,X[15],16,0x1fa27cf8L);
-	R2(B,C,D,A,X[ 2],23,0xc4ac5665L);
-	/* Round 3 */
-	R3(A,B,C,D,X[ 0], 6,0xf4292244L);
-	R3(D,A,B,C,X[ 7],10,0x432aff97L);
-	R3(C,D,A,B,X[14],15,0xab9423a7L);
-	R3(B,C,D,A,X[ 5],21,0xfc93a039L);
-	R3(A,B,C,D,X[12], 6,0x655b59c3L);
-	R3(D,A,B,C,X[ 3],10,0x8f0ccc92L);
-	R3(C,D,A,B,X[10],15,0xffeff47dL);
-	R3(B,C,D,A,X[ 1],21,0x85845dd1L);
-	R3(A,B,C,D,X[ 8], 6,0x6fa87e4fL);
-	R3(D,A,B,C,X[15],10,0xfe2ce6e0L);
-	R3(C,D,A,B,X[ 6],15,0xa3014314L);
-	R3(B,C,D,A,X[13],21,0x4e0811a1L);
-	R3(A,B,C,D,X[ 4], 6,0xf7537e82L);
-	R3(D,A,B,C,X[11],10,0xbd3af235L);
-	R3(C,D,A,B,X[ 2],15,0x2ad7d2bbL);
-	R3(B,C,D,A,X[ 9],21,0xeb86d391L);
-
-	c->A+=A&0xffffffffL;
-	c->B+=B&0xffffffffL;
-	c->C+=C&0xffffffffL;
-	c->D+=D&0xffffffffL;
-}
+	}
 
 void MD5_Final(unsigned char *md, MD5_CTX *c)
-{
-	register int i,j;
-	register ULONG l;
-	register ULONG *p;
-	static unsigned char end[4]={0x80,0x00,0x00,0x00};
-	unsigned char *cp=end;
+	{
+	unsigned char *buf=(unsigned char *)c->data;
+	int n=c->num;
 
-	/* c->num should definitly have room for at least one more byte. */
-	p=c->data;
-	j=c->num;
-	i=j>>2;
-
-	/* purify often complains about the following line as an
-	 * Uninitialized Memory Read.  While this can be true, the
-	 * following p_c2l macro will reset l when that case is true.
-	 * This is because j&0x03 contains the number of 'valid' bytes
-	 * already in p[i].  If and only if j&0x03 == 0, the UMR will
-	 * occur but this is also the only time p_c2l will do
-	 * l= *(cp++) instead of l|= *(cp++)
-     */
-#ifdef PURIFY
-	if ((j&0x03) == 0) p[i]=0;
-#endif
-	l=p[i];
-	p_c2l(cp,l,j&0x03);
-	p[i]=l;
-	i++;
-	/* i is the next 'undefined word' */
-	if (c->num >= MD5_LAST_BLOCK)
+	buf[n++]=0x80;
+	if (n > MD5_LAST_BLOCK)
 		{
-		for (; i<MD5_LBLOCK; i++)
-			p[i]=0;
-		md5_block(c,p);
-		i=0;
+		memset(buf+n,0,MD5_CBLOCK-n);
+		md5_blocks(c,buf,1);
+		n=0;
 		}
-	for (; i<(MD5_LBLOCK-2); i++)
-		p[i]=0;
-	p[MD5_LBLOCK-2]=c->Nl;
-	p[MD5_LBLOCK-1]=c->Nh;
-	md5_block(c,p);
-	cp=md;
-	l=c->A; l2c(l,cp);
-	l=c->B; l2c(l,cp);
-	l=c->C; l2c(l,cp);
-	l=c->D; l2c(l,cp);
+	memset(buf+n,0,MD5_LAST_BLOCK-n);
+	STORE_LE32(buf+MD5_LAST_BLOCK,c->Nl);
+	STORE_LE32(buf+MD5_LAST_BLOCK+4,c->Nh);
+	md5_blocks(c,buf,1);
+
+	STORE_LE32(md   ,c->A);
+	STORE_LE32(md+ 4,c->B);
+	STORE_LE32(md+ 8,c->C);
+	STORE_LE32(md+12,c->D);
 
-	/* clear stuff, md5_block may be leaving some stuff on the stack
-	 * but I'm not worried :-) */
 	c->num=0;
-}
+	}
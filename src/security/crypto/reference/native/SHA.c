@@ -95,299 +95,357 @@
 
 /* 
  * Implemented from SHA-1 document - The Secure Hash Algorithm
+ *
+ * The block function takes any number of 64-byte blocks straight from
+ * the caller's buffer, keeping the chaining values in locals across
+ * blocks. Only a partial block at either end of an update is copied
+ * into the context. The 80 steps are fully unrolled over a 16-word
+ * rolling message schedule.
+ */
+
+#if ENABLE_SHA_NI
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/** A 32-bit word, whatever the width of unsigned long. */
+typedef unsigned int SHA_WORD;
+
+#define K_00_19	0x5a827999UL
+#define K_20_39 0x6ed9eba1UL
+#define K_40_59 0x8f1bbcdcUL
+#define K_60_79 0xca62c1d6UL
+
+#define ROTATE(a,n)	(((a)<<(n))|((a)>>(32-(n))))
+
+/* Loads a big-endian word; any alignment of p is fine. */
+#define LOAD_BE32(p)	(((SHA_WORD)(p)[0]<<24)|((SHA_WORD)(p)[1]<<16)| \
+			 ((SHA_WORD)(p)[2]<< 8)|((SHA_WORD)(p)[3]    ))
+
+#define STORE_BE32(p,l)	((p)[0]=(unsigned char)((l)>>24), \
+			 (p)[1]=(unsigned char)((l)>>16), \
+			 (p)[2]=(unsigned char)((l)>> 8), \
+			 (p)[3]=(unsigned char)((l)    ))
+
+/* As  pointed out by Wei Dai <weidai@eskimo.com>, F() below can be
+ * simplified to the code in F_00_19.  Wei attributes these optimisations
+ * to Peter Gutmann's SHS code, and he attributes it to Rich Schroeppel.
+ * #define F(x,y,z) (((x) & (y))  |  ((~(x)) & (z)))
+ * I've just become aware of another tweak to be made, again from Wei Dai,
+ * in F_40_59, (x&a)|(y&a) -> (x|y)&a
+ */
+#define	F_00_19(b,c,d)	((((c) ^ (d)) & (b)) ^ (d)) 
+#define	F_20_39(b,c,d)	((b) ^ (c) ^ (d))
+#define F_40_59(b,c,d)	(((b) & (c)) | (((b)|(c)) & (d))) 
+#define	F_60_79(b,c,d)	F_20_39(b,c,d)
+
+#define Xupdate(i) \
+	(X[(i)&0x0f]=ROTATE(X[((i)+13)&0x0f]^X[((i)+8)&0x0f]^ \
+			    X[((i)+2)&0x0f]^X[(i)&0x0f],1))
+
+/*
+ * One step. Instead of moving the five variables around, each step
+ * names them in a rotated order and only b and e change.
+ */
+#define BODY_00_15(i,a,b,c,d,e) \
+	(e)+=(X[i]=LOAD_BE32(data+4*(i)))+K_00_19+ROTATE((a),5)+ \
+	     F_00_19((b),(c),(d)); \
+	(b)=ROTATE((b),30);
+
+#define BODY_16_19(i,a,b,c,d,e) \
+	(e)+=Xupdate(i)+K_00_19+ROTATE((a),5)+F_00_19((b),(c),(d)); \
+	(b)=ROTATE((b),30);
+
+#define BODY_20_39(i,a,b,c,d,e) \
+	(e)+=Xupdate(i)+K_20_39+ROTATE((a),5)+F_20_39((b),(c),(d)); \
+	(b)=ROTATE((b),30);
+
+#define BODY_40_59(i,a,b,c,d,e) \
+	(e)+=Xupdate(i)+K_40_59+ROTATE((a),5)+F_40_59((b),(c),(d)); \
+	(b)=ROTATE((b),30);
+
+#define BODY_60_79(i,a,b,c,d,e) \
+	(e)+=Xupdate(i)+K_60_79+ROTATE((a),5)+F_60_79((b),(c),(d)); \
+	(b)=ROTATE((b),30);
+
+/* Five steps, after which the variables are back in their places. */
+#define BODY5(body,i) \
+	body((i)  ,A,B,C,D,E) \
+	body((i)+1,E,A,B,C,D) \
+	body((i)+2,D,E,A,B,C) \
+	body((i)+3,C,D,E,A,B) \
+	body((i)+4,B,C,D,E,A)
+
+static void sha1_blocks_c(SHA_WORD *h, const unsigned char *data,
+			  unsigned long blocks)
+	{
+	SHA_WORD A,B,C,D,E;
+	SHA_WORD X[16];
+
+	A=h[0];
+	B=h[1];
+	C=h[2];
+	D=h[3];
+	E=h[4];
+
+	for (; blocks != 0; blocks--, data+=SHA_CBLOCK)
+		{
+		BODY5(BODY_00_15, 0);
+		BODY5(BODY_00_15, 5);
+		BODY5(BODY_00_15,10);
+		BODY_00_15(15,A,B,C,D,E);
+		BODY_16_19(16,E,A,B,C,D);
+		BODY_16_19(17,D,E,A,B,C);
+		BODY_16_19(18,C,D,E,A,B);
+		BODY_16_19(19,B,C,D,E,A);
+
+		BODY5(BODY_20_39,20);
+		BODY5(BODY_20_39,25);
+		BODY5(BODY_20_39,30);
+		BODY5(BODY_20_39,35);
+
+		BODY5(BODY_40_59,40);
+		BODY5(BODY_40_59,45);
+		BODY5(BODY_40_59,50);
+		BODY5(BODY_40_59,55);
+
+		BODY5(BODY_60_79,60);
+		BODY5(BODY_60_79,65);
+		BODY5(BODY_60_79,70);
+		BODY5(BODY_60_79,75);
+
+		A=h[0]+=A;
+		B=h[1]+=B;
+		C=h[2]+=C;
+		D=h[3]+=D;
+		E=h[4]+=E;
+		}
+	}
+
+#if ENABLE_SHA_NI
+
+/**
+ * Tells if the CPU has the SHA extensions and the SSSE3 and SSE4.1
+ * instructions the SHA-NI block functions also use. Checked once.
+ *
+ * @return non-zero if the extensions can be used
+ */
+int SHA_HasCPUSupport(void)
+	{
+	static int support = -1;
+	unsigned int eax,ebx,ecx,edx;
+
+	if (support < 0)
+		{
+		support=0;
+		if (__get_cpuid(1,&eax,&ebx,&ecx,&edx) &&
+		    (ecx & bit_SSSE3) && (ecx & bit_SSE4_1) &&
+		    __get_cpuid_count(7,0,&eax,&ebx,&ecx,&edx) &&
+		    (ebx & bit_SHA))
+			support=1;
+		}
+
+	return support;
+	}
+
+/* Four steps of the x86 SHA-1 sequence; see the Intel SHA extensions
+ * paper. E0 and E1 take turns holding e plus the message words. */
+#define SHA1NI_QUAD(f,Ecur,Enext,Mcur,Mnext,Mprev,Mxor) \
+	Ecur=_mm_sha1nexte_epu32(Ecur,Mcur); \
+	Enext=ABCD; \
+	Mnext=_mm_sha1msg2_epu32(Mnext,Mcur); \
+	ABCD=_mm_sha1rnds4_epu32(ABCD,Ecur,f); \
+	Mprev=_mm_sha1msg1_epu32(Mprev,Mcur); \
+	Mxor=_mm_xor_si128(Mxor,Mcur);
+
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha1_blocks_ni(SHA_WORD *h, const unsigned char *data,
+			   unsigned long blocks)
+	{
+	__m128i ABCD,ABCD_SAVE,E0,E0_SAVE,E1;
+	__m128i MSG0,MSG1,MSG2,MSG3;
+	const __m128i MASK=_mm_set_epi64x(0x0001020304050607ULL,
+					  0x08090a0b0c0d0e0fULL);
+
+	ABCD=_mm_loadu_si128((const __m128i *)h);
+	ABCD=_mm_shuffle_epi32(ABCD,0x1B);
+	E0=_mm_set_epi32((int)h[4],0,0,0);
+
+	for (; blocks != 0; blocks--, data+=SHA_CBLOCK)
+		{
+		ABCD_SAVE=ABCD;
+		E0_SAVE=E0;
+
+		/* Steps 0-15 load the message. */
+		MSG0=_mm_loadu_si128((const __m128i *)(data));
+		MSG0=_mm_shuffle_epi8(MSG0,MASK);
+		E0=_mm_add_epi32(E0,MSG0);
+		E1=ABCD;
+		ABCD=_mm_sha1rnds4_epu32(ABCD,E0,0);
+
+		MSG1=_mm_loadu_si128((const __m128i *)(data+16));
+		MSG1=_mm_shuffle_epi8(MSG1,MASK);
+		E1=_mm_sha1nexte_epu32(E1,MSG1);
+		E0=ABCD;
+		ABCD=_mm_sha1rnds4_epu32(ABCD,E1,0);
+		MSG0=_mm_sha1msg1_epu32(MSG0,MSG1);
+
+		MSG2=_mm_loadu_si128((const __m128i *)(data+32));
+		MSG2=_mm_shuffle_epi8(MSG2,MASK);
+		E0=_mm_sha1nexte_epu32(E0,MSG2);
+		E1=ABCD;
+		ABCD=_mm_sha1rnds4_epu32(ABCD,E0,0);
+		MSG1=_mm_sha1msg1_epu32(MSG1,MSG2);
+		MSG0=_mm_xor_si128(MSG0,MSG2);
+
+		MSG3=_mm_loadu_si128((const __m128i *)(data+48));
+		MSG3=_mm_shuffle_epi8(MSG3,MASK);
+		SHA1NI_QUAD(0,E1,E0,MSG3,MSG0,MSG2,MSG1);
+
+		/* Steps 16-63 expand the message as they go. */
+		SHA1NI_QUAD(0,E0,E1,MSG0,MSG1,MSG3,MSG2);
+		SHA1NI_QUAD(1,E1,E0,MSG1,MSG2,MSG0,MSG3);
+		SHA1NI_QUAD(1,E0,E1,MSG2,MSG3,MSG1,MSG0);
+		SHA1NI_QUAD(1,E1,E0,MSG3,MSG0,MSG2,MSG1);
+		SHA1NI_QUAD(1,E0,E1,MSG0,MSG1,MSG3,MSG2);
+		SHA1NI_QUAD(1,E1,E0,MSG1,MSG2,MSG0,MSG3);
+		SHA1NI_QUAD(2,E0,E1,MSG2,MSG3,MSG1,MSG0);
+		SHA1NI_QUAD(2,E1,E0,MSG3,MSG0,MSG2,MSG1);
+		SHA1NI_QUAD(2,E0,E1,MSG0,MSG1,MSG3,MSG2);
+		SHA1NI_QUAD(2,E1,E0,MSG1,MSG2,MSG0,MSG3);
+		SHA1NI_QUAD(2,E0,E1,MSG2,MSG3,MSG1,MSG0);
+		SHA1NI_QUAD(3,E1,E0,MSG3,MSG0,MSG2,MSG1);
+
+		/* Steps 64-79 only finish the last message words. */
+		SHA1NI_QUAD(3,E0,E1,MSG0,MSG1,MSG3,MSG2);
+
+
+		E1=_mm_sha1nexte_epu32(E1,MSG1);
+		E0=ABCD;
+		MSG2=_mm_sha1msg2_epu32(MSG2,MSG1);
+		ABCD=_mm_sha1rnds4_epu32(ABCD,E1,3);
+		MSG3=_mm_xor_si128(MSG3,MSG1);
+
+		E0=_mm_sha1nexte_epu32(E0,MSG2);
+		E1=ABCD;
+		MSG3=_mm_sha1msg2_epu32(MSG3,MSG2);
+		ABCD=_mm_sha1rnds4_epu32(ABCD,E0,3);
+
+		E1=_mm_sha1nexte_epu32(E1,MSG3);
+		E0=ABCD;
+		ABCD=_mm_sha1rnds4_epu32(ABCD,E1,3);
+
+		E0=_mm_sha1nexte_epu32(E0,E0_SAVE);
+		ABCD=_mm_add_epi32(ABCD,ABCD_SAVE);
+		}
+
+	ABCD=_mm_shuffle_epi32(ABCD,0x1B);
+	_mm_storeu_si128((__m128i *)h,ABCD);
+	h[4]=(SHA_WORD)_mm_extract_epi32(E0,3);
+	}
+
+#endif /* ENABLE_SHA_NI */
+
+/**
+ * Runs the compression function over whole blocks.
+ *
+ * @param c context holding the chaining values
+ * @param data the blocks
+ * @param blocks number of blocks
  */
+static void sha1_blocks(SHA_CTX *c, const unsigned char *data,
+			unsigned long blocks)
+	{
+	SHA_WORD h[5];
 
-#define K_00_19	0x5a827999L
-#define K_20_39 0x6ed9eba1L
-#define K_40_59 0x8f1bbcdcL
-#define K_60_79 0xca62c1d6L
+	h[0]=(SHA_WORD)c->h0;
+	h[1]=(SHA_WORD)c->h1;
+	h[2]=(SHA_WORD)c->h2;
+	h[3]=(SHA_WORD)c->h3;
+	h[4]=(SHA_WORD)c->h4;
 
-static void sha1_block(SHA_CTX *c, register unsigned long *p);
+#if ENABLE_SHA_NI
+	if (SHA_HasCPUSupport())
+		sha1_blocks_ni(h,data,blocks);
+	else
+#endif
+		sha1_blocks_c(h,data,blocks);
 
+	c->h0=h[0];
+	c->h1=h[1];
+	c->h2=h[2];
+	c->h3=h[3];
+	c->h4=h[4];
+	}
 
-void SHA1_Update(c, data, len)
-SHA_CTX *c;
-register unsigned char *data;
-unsigned long len;
+void SHA1_Update(SHA_CTX *c, unsigned char *data, unsigned long len)
 	{
-	register ULONG *p;
-	int ew=0,ec=0,sw=0,sc=0;
-	ULONG l=0;
+	unsigned char *buf=(unsigned char *)c->data;
+	unsigned long l;
+	unsigned long n;
 
 	if (len == 0) return;
 
-	l=(c->Nl+(len<<3))&0xffffffff;
+	l=(c->Nl+(len<<3))&0xffffffffUL;
 	if (l < c->Nl) /* overflow */
 		c->Nh++;
-	c->Nh+=(len>>29);
+	c->Nh=(c->Nh+(len>>29))&0xffffffffUL;
 	c->Nl=l;
 
 	if (c->num != 0)
 		{
-		p=c->data;
-		sw=c->num>>2;
-		sc=c->num&0x03;
-
-		if ((c->num+len) >= SHA_CBLOCK)
-			{
-			l= p[sw];
-			p_c2nl(data,l,sc);
-			p[sw++]=l;
-			for (; sw<SHA_LBLOCK; sw++)
-				{
-				c2nl(data,l);
-				p[sw]=l;
-				}
-			len-=(SHA_CBLOCK-c->num);
-
-			sha1_block(c,p);
-			c->num=0;
-			/* drop through and do the rest */
-			}
-		else
+		n=SHA_CBLOCK-c->num;
+		if (len < n)
 			{
+			memcpy(buf+c->num,data,len);
 			c->num+=(int)len;
-			if ((sc+len) < 4) /* ugly, add char's to a word */
-				{
-				l= p[sw];
-				p_c2nl_p(data,l,sc,len);
-				p[sw]=l;
-				}
-			else
-				{
-				ew=(c->num>>2);
-				ec=(c->num&0x03);
-				l= p[sw];
-				p_c2nl(data,l,sc);
-				p[sw++]=l;
-				for (; sw < ew; sw++)
-					{ c2nl(data,l); p[sw]=l; }
-				if (ec)
-					{
-					c2nl_p(data,l,ec);
-					p[sw]=l;
-					}
-				}
 			return;
 			}
+
+		memcpy(buf+c->num,data,n);
+		sha1_blocks(c,buf,1);
+		data+=n;
+		len-=n;
+		c->num=0;
 		}
-	/* we now can process the input data in blocks of SHA_CBLOCK
-	 * chars and save the leftovers to c->data. */
-	p=c->data;
-	while (len >= SHA_CBLOCK)
+
+	n=len/SHA_CBLOCK;
+	if (n != 0)
 		{
-#if defined(B_ENDIAN) || defined(L_ENDIAN)
-		memcpy(p,data,SHA_CBLOCK);
-		data+=SHA_CBLOCK;
-#ifdef L_ENDIAN
-		for (sw=(SHA_LBLOCK/4); sw; sw--)
-			{
-			Endian_Reverse32(p[0]);
-			Endian_Reverse32(p[1]);
-			Endian_Reverse32(p[2]);
-			Endian_Reverse32(p[3]);
-			p+=4;
-			}
-#endif
-#else
-		for (sw=(SHA_BLOCK/4); sw; sw--)
-			{
-			c2nl(data,l); *(p++)=l;
-			c2nl(data,l); *(p++)=l;
-			c2nl(data,l); *(p++)=l;
-			c2nl(data,l); *(p++)=l;
-			}
-#endif
-		p=c->data;
-		sha1_block(c,p);
-		len-=SHA_CBLOCK;
+		sha1_blocks(c,data,n);
+		data+=n*SHA_CBLOCK;
+		len-=n*SHA_CBLOCK;
+		}
+
+	if (len != 0)
+		{
+		memcpy(buf,data,len);
+		c->num=(int)len;
 		}
-	ec=(int)len;
-	c->num=ec;
-	ew=(ec>>2);
-	ec&=0x03;
-
-	for (sw=0; sw < ew; sw++)
-		{ c2nl(data,l); p[sw]=l; }
-	c2nl_p(data,l,ec);
-	p[sw]=l;
-	}
-	
-void body_16_19(int i, ULONG *pa, ULONG *pb, ULONG *pc,
-			ULONG *pd, ULONG *pe, ULONG *pf, ULONG *X)
-{
-	unsigned long a,b,c,d,e,f;
-	/*copy state*/ 
-	a=*pa;b=*pb;c=*pc;d=*pd;e=*pe;f=*pf;
-	
-	Xupdate(f,i);
-	(f)+=(e);
-	(f)+=K_00_19;
-	(f)+=ROTATE((a),5);
-	(f)+=F_00_19((b),(c),(d));
-	(b)=ROTATE((b),30);	
-
-	/*copy state back*/
-	*pa=a;*pb=b;*pc=c;*pd=d;*pe=e;*pf=f;
-} 
-
-static void sha1_block(c, X)
-SHA_CTX *c;
-unsigned long *X;
-	{
-	/*register ULONG A,B,C,D,E,T;*/
-	unsigned long A,B,C,D,E,T;
-    
-	A=c->h0;
-	B=c->h1;
-	C=c->h2;
-	D=c->h3;
-	E=c->h4;
-
-    
-	BODY_00_15( 0,A,B,C,D,E,T);
-	BODY_00_15( 1,T,A,B,C,D,E);
-	BODY_00_15( 2,E,T,A,B,C,D);
-	BODY_00_15( 3,D,E,T,A,B,C);
-	BODY_00_15( 4,C,D,E,T,A,B);
-	BODY_00_15( 5,B,C,D,E,T,A);
-	BODY_00_15( 6,A,B,C,D,E,T);
-	BODY_00_15( 7,T,A,B,C,D,E);
-	BODY_00_15( 8,E,T,A,B,C,D);
-	BODY_00_15( 9,D,E,T,A,B,C);
-	BODY_00_15(10,C,D,E,T,A,B);
-	BODY_00_15(11,B,C,D,E,T,A);
-	BODY_00_15(12,A,B,C,D,E,T);
-	BODY_00_15(13,T,A,B,C,D,E);
-	BODY_00_15(14,E,T,A,B,C,D);
-	BODY_00_15(15,D,E,T,A,B,C);
-
-	/*
-	BODY_16_19(16,C,D,E,T,A,B);
-	BODY_16_19(17,B,C,D,E,T,A);
-	BODY_16_19(18,A,B,C,D,E,T);
-	BODY_16_19(19,T,A,B,C,D,E);
-	*/
-	
-	body_16_19(16,&C,&D,&E,&T,&A,&B,X);
-	body_16_19(17,&B,&C,&D,&E,&T,&A,X);
-	body_16_19(18,&A,&B,&C,&D,&E,&T,X);
-	body_16_19(19,&T,&A,&B,&C,&D,&E,X);
-
-	BODY_20_39(20,E,T,A,B,C,D);
-	BODY_20_39(21,D,E,T,A,B,C);
-	BODY_20_39(22,C,D,E,T,A,B);
-	BODY_20_39(23,B,C,D,E,T,A);
-	BODY_20_39(24,A,B,C,D,E,T);
-	BODY_20_39(25,T,A,B,C,D,E);
-	BODY_20_39(26,E,T,A,B,C,D);
-	BODY_20_39(27,D,E,T,A,B,C);
-	BODY_20_39(28,C,D,E,T,A,B);
-	BODY_20_39(29,B,C,D,E,T,A);
-	BODY_20_39(30,A,B,C,D,E,T);
-	BODY_20_39(31,T,A,B,C,D,E);
-	BODY_20_39(32,E,T,A,B,C,D);
-	BODY_20_39(33,D,E,T,A,B,C);
-	BODY_20_39(34,C,D,E,T,A,B);
-	BODY_20_39(35,B,C,D,E,T,A);
-	BODY_20_39(36,A,B,C,D,E,T);
-	BODY_20_39(37,T,A,B,C,D,E);
-	BODY_20_39(38,E,T,A,B,C,D);
-	BODY_20_39(39,D,E,T,A,B,C);
-
-	BODY_40_59(40,C,D,E,T,A,B);
-	BODY_40_59(41,B,C,D,E,T,A);
-	BODY_40_59(42,A,B,C,D,E,T);
-	BODY_40_59(43,T,A,B,C,D,E);
-	BODY_40_59(44,E,T,A,B,C,D);
-	BODY_40_59(45,D,E,T,A,B,C);
-	BODY_40_59(46,C,D,E,T,A,B);
-	BODY_40_59(47,B,C,D,E,T,A);
-	BODY_40_59(48,A,B,C,D,E,T);
-	BODY_40_59(49,T,A,B,C,D,E);
-	BODY_40_59(50,E,T,A,B,C,D);
-	BODY_40_59(51,D,E,T,A,B,C);
-	BODY_40_59(52,C,D,E,T,A,B);
-	BODY_40_59(53,B,C,D,E,T,A);
-	BODY_40_59(54,A,B,C,D,E,T);
-	BODY_40_59(55,T,A,B,C,D,E);
-	BODY_40_59(56,E,T,A,B,C,D);
-	BODY_40_59(57,D,E,T,A,B,C);
-	BODY_40_59(58,C,D,E,T,A,B);
-	BODY_40_59(59,B,C,D,E,T,A);
-
-	BODY_60_79(60,A,B,C,D,E,T);
-	BODY_60_79(61,T,A,B,C,D,E);
-	BODY_60_79(62,E,T,A,B,C,D);
-	BODY_60_79(63,D,E,T,A,B,C);
-	BODY_60_79(64,C,D,E,T,A,B);
-	BODY_60_79(65,B,C,D,E,T,A);
-	BODY_60_79(66,A,B,C,D,E,T);
-	BODY_60_79(67,T,A,B,C,D,E);
-	BODY_60_79(68,E,T,A,B,C,D);
-	BODY_60_79(69,D,E,T,A,B,C);
-	BODY_60_79(70,C,D,E,T,A,B);
-	BODY_60_79(71,B,C,D,E,T,A);
-	BODY_60_79(72,A,B,C,D,E,T);
-	BODY_60_79(73,T,A,B,C,D,E);
-	BODY_60_79(74,E,T,A,B,C,D);
-	BODY_60_79(75,D,E,T,A,B,C);
-	BODY_60_79(76,C,D,E,T,A,B);
-	BODY_60_79(77,B,C,D,E,T,A);
-	BODY_60_79(78,A,B,C,D,E,T);
-	BODY_60_79(79,T,A,B,C,D,E);
-
-	c->h0=(c->h0+E)&0xffffffff; 
-	c->h1=(c->h1+T)&0xffffffff;
-	c->h2=(c->h2+A)&0xffffffff;
-	c->h3=(c->h3+B)&0xffffffff;
-	c->h4=(c->h4+C)&0xffffffff;
 	}
 
-void SHA1_Final(md, c)
-unsigned char *md;
-SHA_CTX *c;
+void SHA1_Final(unsigned char *md, SHA_CTX *c)
 	{
-	register int i,j;
-	register ULONG l;
-	register ULONG *p;
-	static unsigned char end[4]={0x80,0x00,0x00,0x00};
-	unsigned char *cp=end;
-
-	/* c->num should definitly have room for at least one more byte. */
-	p=c->data;
-	j=c->num;
-	i=j>>2;
-#ifdef PURIFY
-	if ((j&0x03) == 0) p[i]=0;
-#endif
-	l=p[i];
-	p_c2nl(cp,l,j&0x03);
-	p[i]=l;
-	i++;
-	/* i is the next 'undefined word' */
-	if (c->num >= SHA_LAST_BLOCK)
+	unsigned char *buf=(unsigned char *)c->data;
+	int n=c->num;
+
+	buf[n++]=0x80;
+	if (n > SHA_LAST_BLOCK)
 		{
-		for (; i<SHA_LBLOCK; i++)
-			p[i]=0;
-		sha1_block(c,p);
-		i=0;
+		memset(buf+n,0,SHA_CBLOCK-n);
+		sha1_blocks(c,buf,1);
+		n=0;
 		}
-	for (; i<(SHA_LBLOCK-2); i++)
-		p[i]=0;
-	p[SHA_LBLOCK-2]=c->Nh;
-	p[SHA_LBLOCK-1]=c->Nl;
-	sha1_block(c,p);
-	cp=md;
-	l=c->h0; nl2c(l,cp);
-	l=c->h1; nl2c(l,cp);
-	l=c->h2; nl2c(l,cp);
-	l=c->h3; nl2c(l,cp);
-	l=c->h4; nl2c(l,cp);
-
-	/* clear stuff, sha1_block may be leaving some stuff on the stack
-	 * but I'm not worried :-) */
+	memset(buf+n,0,SHA_LAST_BLOCK-n);
+	STORE_BE32(buf+SHA_LAST_BLOCK,c->Nh);
+	STORE_BE32(buf+SHA_LAST_BLOCK+4,c->Nl);
+	sha1_blocks(c,buf,1);
+
+	STORE_BE32(md   ,c->h0);
+	STORE_BE32(md+ 4,c->h1);
+	STORE_BE32(md+ 8,c->h2);
+	STORE_BE32(md+12,c->h3);
+	STORE_BE32(md+16,c->h4);
+
 	c->num=0;
-/*	memset((char *)&c,0,sizeof(c));*/
 	}
-
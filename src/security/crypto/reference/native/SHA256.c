@@ -0,0 +1,359 @@
+/*
+ *   
+ *
+ * Copyright  1990-2007 Sun Microsystems, Inc. All Rights Reserved.
+ * DO NOT ALTER OR REMOVE COPYRIGHT NOTICES OR THIS FILE HEADER
+ * 
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License version
+ * 2 only, as published by the Free Software Foundation.
+ * 
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License version 2 for more details (a copy is
+ * included at /legal/license.txt).
+ * 
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this work; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ * 
+ * Please contact Sun Microsystems, Inc., 4150 Network Circle, Santa
+ * Clara, CA 95054 or visit www.sun.com if you need additional
+ * information or have any questions.
+ */
+
+/*
+ * Implemented from FIPS 180-2, Secure Hash Standard.
+ *
+ * Like SHA-1, the block function takes any number of blocks straight
+ * from the caller's buffer, and its 64 steps are unrolled over a
+ * 16-word rolling message schedule. On x86 CPUs with the SHA
+ * extensions the blocks go through those instead.
+ */
+
+#include <SHA.h>
+#include <SHA256.h>
+
+#if ENABLE_SHA_NI
+#include <immintrin.h>
+#endif
+
+typedef unsigned int SHA256_WORD;
+
+#define ROTR(x,n)	(((x)>>(n))|((x)<<(32-(n))))
+
+#define LOAD_BE32(p)	(((SHA256_WORD)(p)[0]<<24)|((SHA256_WORD)(p)[1]<<16)| \
+			 ((SHA256_WORD)(p)[2]<< 8)|((SHA256_WORD)(p)[3]    ))
+
+#define STORE_BE32(p,l)	((p)[0]=(unsigned char)((l)>>24), \
+			 (p)[1]=(unsigned char)((l)>>16), \
+			 (p)[2]=(unsigned char)((l)>> 8), \
+			 (p)[3]=(unsigned char)((l)    ))
+
+#define Ch(x,y,z)	(((x) & ((y) ^ (z))) ^ (z))
+#define Maj(x,y,z)	(((x) & (y)) | (((x) | (y)) & (z)))
+#define Sigma0(x)	(ROTR((x),2) ^ ROTR((x),13) ^ ROTR((x),22))
+#define Sigma1(x)	(ROTR((x),6) ^ ROTR((x),11) ^ ROTR((x),25))
+#define sigma0(x)	(ROTR((x),7) ^ ROTR((x),18) ^ ((x)>>3))
+#define sigma1(x)	(ROTR((x),17) ^ ROTR((x),19) ^ ((x)>>10))
+
+static const SHA256_WORD K256[64] = {
+	0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,
+	0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+	0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,
+	0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+	0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,
+	0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+	0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,
+	0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+	0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,
+	0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+	0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,
+	0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+	0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,
+	0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+	0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,
+	0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+	};
+
+/* Message word i, for i past the first 16. */
+#define Xupdate(i) \
+	(X[(i)&0x0f]+=sigma1(X[((i)+14)&0x0f])+X[((i)+9)&0x0f]+ \
+		      sigma0(X[((i)+1)&0x0f]))
+
+/*
+ * One step. The eight variables are named in a rotated order in each
+ * step, so only d and h change.
+ */
+#define ROUND(i,w,a,b,c,d,e,f,g,h) \
+	T1=(h)+Sigma1(e)+Ch((e),(f),(g))+K256[i]+(w); \
+	(d)+=T1; \
+	(h)=T1+Sigma0(a)+Maj((a),(b),(c));
+
+#define ROUND_00_15(i,a,b,c,d,e,f,g,h) \
+	ROUND(i,X[i]=LOAD_BE32(data+4*(i)),a,b,c,d,e,f,g,h)
+
+#define ROUND_16_63(i,a,b,c,d,e,f,g,h) \
+	ROUND(i,Xupdate(i),a,b,c,d,e,f,g,h)
+
+/* Eight steps, after which the variables are back in their places. */
+#define ROUND8(round,i) \
+	round((i)  ,A,B,C,D,E,F,G,H) \
+	round((i)+1,H,A,B,C,D,E,F,G) \
+	round((i)+2,G,H,A,B,C,D,E,F) \
+	round((i)+3,F,G,H,A,B,C,D,E) \
+	round((i)+4,E,F,G,H,A,B,C,D) \
+	round((i)+5,D,E,F,G,H,A,B,C) \
+	round((i)+6,C,D,E,F,G,H,A,B) \
+	round((i)+7,B,C,D,E,F,G,H,A)
+
+static void sha256_blocks_c(SHA256_WORD *s, const unsigned char *data,
+			    unsigned long blocks)
+	{
+	SHA256_WORD A,B,C,D,E,F,G,H,T1;
+	SHA256_WORD X[16];
+
+	A=s[0];
+	B=s[1];
+	C=s[2];
+	D=s[3];
+	E=s[4];
+	F=s[5];
+	G=s[6];
+	H=s[7];
+
+	for (; blocks != 0; blocks--, data+=SHA256_CBLOCK)
+		{
+		ROUND8(ROUND_00_15, 0);
+		ROUND8(ROUND_00_15, 8);
+		ROUND8(ROUND_16_63,16);
+		ROUND8(ROUND_16_63,24);
+		ROUND8(ROUND_16_63,32);
+		ROUND8(ROUND_16_63,40);
+		ROUND8(ROUND_16_63,48);
+		ROUND8(ROUND_16_63,56);
+
+		A=s[0]+=A;
+		B=s[1]+=B;
+		C=s[2]+=C;
+		D=s[3]+=D;
+		E=s[4]+=E;
+		F=s[5]+=F;
+		G=s[6]+=G;
+		H=s[7]+=H;
+		}
+	}
+
+#if ENABLE_SHA_NI
+
+/* Four steps of the x86 SHA-256 sequence; see the Intel SHA
+ * extensions paper. */
+#define SHA256NI_QUAD(i,Mcur) \
+	MSG=_mm_add_epi32(Mcur,_mm_loadu_si128((const __m128i *)&K256[i])); \
+	STATE1=_mm_sha256rnds2_epu32(STATE1,STATE0,MSG); \
+	MSG=_mm_shuffle_epi32(MSG,0x0E); \
+	STATE0=_mm_sha256rnds2_epu32(STATE0,STATE1,MSG);
+
+/* Computes the message words four steps ahead of Mcur. */
+#define SHA256NI_NEXT(Mcur,Mprev,Mnext) \
+	TMP=_mm_alignr_epi8(Mcur,Mprev,4); \
+	Mnext=_mm_add_epi32(Mnext,TMP); \
+	Mnext=_mm_sha256msg2_epu32(Mnext,Mcur);
+
+#define SHA256NI_LOAD(M,off) \
+	M=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data+(off))), \
+			   MASK);
+
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_blocks_ni(SHA256_WORD *s, const unsigned char *data,
+			     unsigned long blocks)
+	{
+	__m128i STATE0,STATE1,ABEF_SAVE,CDGH_SAVE;
+	__m128i MSG,TMP,MSG0,MSG1,MSG2,MSG3;
+	const __m128i MASK=_mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					  0x0405060700010203ULL);
+
+	/* The instructions want the state as ABEF and CDGH. */
+	TMP=_mm_loadu_si128((const __m128i *)&s[0]);
+	STATE1=_mm_loadu_si128((const __m128i *)&s[4]);
+	TMP=_mm_shuffle_epi32(TMP,0xB1);
+	STATE1=_mm_shuffle_epi32(STATE1,0x1B);
+	STATE0=_mm_alignr_epi8(TMP,STATE1,8);
+	STATE1=_mm_blend_epi16(STATE1,TMP,0xF0);
+
+	for (; blocks != 0; blocks--, data+=SHA256_CBLOCK)
+		{
+		ABEF_SAVE=STATE0;
+		CDGH_SAVE=STATE1;
+
+		SHA256NI_LOAD(MSG0, 0);
+		SHA256NI_QUAD( 0,MSG0);
+
+		SHA256NI_LOAD(MSG1,16);
+		SHA256NI_QUAD( 4,MSG1);
+		MSG0=_mm_sha256msg1_epu32(MSG0,MSG1);
+
+		SHA256NI_LOAD(MSG2,32);
+		SHA256NI_QUAD( 8,MSG2);
+		MSG1=_mm_sha256msg1_epu32(MSG1,MSG2);
+
+		SHA256NI_LOAD(MSG3,48);
+		SHA256NI_QUAD(12,MSG3);
+		SHA256NI_NEXT(MSG3,MSG2,MSG0);
+		MSG2=_mm_sha256msg1_epu32(MSG2,MSG3);
+
+		SHA256NI_QUAD(16,MSG0);
+		SHA256NI_NEXT(MSG0,MSG3,MSG1);
+		MSG3=_mm_sha256msg1_epu32(MSG3,MSG0);
+
+		SHA256NI_QUAD(20,MSG1);
+		SHA256NI_NEXT(MSG1,MSG0,MSG2);
+		MSG0=_mm_sha256msg1_epu32(MSG0,MSG1);
+
+		SHA256NI_QUAD(24,MSG2);
+		SHA256NI_NEXT(MSG2,MSG1,MSG3);
+		MSG1=_mm_sha256msg1_epu32(MSG1,MSG2);
+
+		SHA256NI_QUAD(28,MSG3);
+		SHA256NI_NEXT(MSG3,MSG2,MSG0);
+		MSG2=_mm_sha256msg1_epu32(MSG2,MSG3);
+
+		SHA256NI_QUAD(32,MSG0);
+		SHA256NI_NEXT(MSG0,MSG3,MSG1);
+		MSG3=_mm_sha256msg1_epu32(MSG3,MSG0);
+
+		SHA256NI_QUAD(36,MSG1);
+		SHA256NI_NEXT(MSG1,MSG0,MSG2);
+		MSG0=_mm_sha256msg1_epu32(MSG0,MSG1);
+
+		SHA256NI_QUAD(40,MSG2);
+		SHA256NI_NEXT(MSG2,MSG1,MSG3);
+		MSG1=_mm_sha256msg1_epu32(MSG1,MSG2);
+
+		SHA256NI_QUAD(44,MSG3);
+		SHA256NI_NEXT(MSG3,MSG2,MSG0);
+		MSG2=_mm_sha256msg1_epu32(MSG2,MSG3);
+
+		SHA256NI_QUAD(48,MSG0);
+		SHA256NI_NEXT(MSG0,MSG3,MSG1);
+		MSG3=_mm_sha256msg1_epu32(MSG3,MSG0);
+
+		SHA256NI_QUAD(52,MSG1);
+		SHA256NI_NEXT(MSG1,MSG0,MSG2);
+
+		SHA256NI_QUAD(56,MSG2);
+		SHA256NI_NEXT(MSG2,MSG1,MSG3);
+
+		SHA256NI_QUAD(60,MSG3);
+
+		STATE0=_mm_add_epi32(STATE0,ABEF_SAVE);
+		STATE1=_mm_add_epi32(STATE1,CDGH_SAVE);
+		}
+
+	TMP=_mm_shuffle_epi32(STATE0,0x1B);
+	STATE1=_mm_shuffle_epi32(STATE1,0xB1);
+	STATE0=_mm_blend_epi16(TMP,STATE1,0xF0);
+	STATE1=_mm_alignr_epi8(STATE1,TMP,8);
+
+	_mm_storeu_si128((__m128i *)&s[0],STATE0);
+	_mm_storeu_si128((__m128i *)&s[4],STATE1);
+	}
+
+#endif /* ENABLE_SHA_NI */
+
+static void sha256_blocks(SHA256_CTX *c, const unsigned char *data,
+			  unsigned long blocks)
+	{
+#if ENABLE_SHA_NI
+	if (SHA_HasCPUSupport())
+		{
+		sha256_blocks_ni(c->h,data,blocks);
+		return;
+		}
+#endif
+
+	sha256_blocks_c(c->h,data,blocks);
+	}
+
+void SHA256_Init(SHA256_CTX *c)
+	{
+	memset(c,0,sizeof (SHA256_CTX));
+	c->h[0]=0x6a09e667;
+	c->h[1]=0xbb67ae85;
+	c->h[2]=0x3c6ef372;
+	c->h[3]=0xa54ff53a;
+	c->h[4]=0x510e527f;
+	c->h[5]=0x9b05688c;
+	c->h[6]=0x1f83d9ab;
+	c->h[7]=0x5be0cd19;
+	}
+
+void SHA256_Update(SHA256_CTX *c, unsigned char *data, unsigned long len)
+	{
+	SHA256_WORD l;
+	unsigned long n;
+
+	if (len == 0) return;
+
+	l=c->Nl+(SHA256_WORD)(len<<3);
+	if (l < c->Nl) /* overflow */
+		c->Nh++;
+	c->Nh+=(SHA256_WORD)(len>>29);
+	c->Nl=l;
+
+	if (c->num != 0)
+		{
+		n=SHA256_CBLOCK-c->num;
+		if (len < n)
+			{
+			memcpy(c->data+c->num,data,len);
+			c->num+=(int)len;
+			return;
+			}
+
+		memcpy(c->data+c->num,data,n);
+		sha256_blocks(c,c->data,1);
+		data+=n;
+		len-=n;
+		c->num=0;
+		}
+
+	n=len/SHA256_CBLOCK;
+	if (n != 0)
+		{
+		sha256_blocks(c,data,n);
+		data+=n*SHA256_CBLOCK;
+		len-=n*SHA256_CBLOCK;
+		}
+
+	if (len != 0)
+		{
+		memcpy(c->data,data,len);
+		c->num=(int)len;
+		}
+	}
+
+void SHA256_Final(unsigned char *md, SHA256_CTX *c)
+	{
+	int n=c->num;
+	int i;
+
+	c->data[n++]=0x80;
+	if (n > SHA256_LAST_BLOCK)
+		{
+		memset(c->data+n,0,SHA256_CBLOCK-n);
+		sha256_blocks(c,c->data,1);
+		n=0;
+		}
+	memset(c->data+n,0,SHA256_LAST_BLOCK-n);
+	STORE_BE32(c->data+SHA256_LAST_BLOCK,c->Nh);
+	STORE_BE32(c->data+SHA256_LAST_BLOCK+4,c->Nl);
+	sha256_blocks(c,c->data,1);
+
+	for (i=0; i<8; i++)
+		STORE_BE32(md+4*i,c->h[i]);
+
+	c->num=0;
+	}
@@ -30,393 +30,389 @@
  * CLDC SPECIFICATION AND IS PROVIDED FOR ILLUSTRATIVE PURPOSES ONLY
  */
 
+#include <string.h>
+
 #include <kni.h>
 #include <sni.h>
 #include <commonKNIMacros.h>
 
 #include <midpError.h>
+#include <midpMalloc.h>
 #include <SHA.h>
+#include <SHA256.h>
 #include <MD5.h>
 #include <MD2.h>
 
-KNIEXPORT KNI_RETURNTYPE_VOID
-Java_com_sun_midp_crypto_MD2_nativeUpdate() {
-    unsigned long  inlen = KNI_GetParameterAsInt(3);
-    unsigned long  inoff = KNI_GetParameterAsInt(2);
-    int i, j;
-    MD2_CTX c;
+/*
+ * Each MessageDigest object owns a native context, allocated on first
+ * reset and freed by its finalizer. Its address is kept in the long
+ * field "nativeContext" of the object, so a pointer of any width fits.
+ */
 
-    KNI_StartHandles(5);
+/** Largest digest length of the supported algorithms. */
+#define MAX_DIGEST_LENGTH SHA256_DIGEST_LENGTH
 
-    KNI_DeclareHandle(data);
-    KNI_DeclareHandle(cksm);
-    KNI_DeclareHandle(num);
-    KNI_DeclareHandle(state);
-    KNI_DeclareHandle(inbuf);
+/** Puts a digest context in the initial state. */
+typedef void (*DigestInitFunc)(void* context);
 
-    KNI_GetParameterAsObject(7, data);
-    KNI_GetParameterAsObject(6, cksm);
-    KNI_GetParameterAsObject(5, num);
-    KNI_GetParameterAsObject(4, state);
-    KNI_GetParameterAsObject(1, inbuf);
+/** Hashes more data into a digest context. */
+typedef void (*DigestUpdateFunc)(void* context, unsigned char* data,
+                                 unsigned long len);
 
-    /* Copy the context in */
-    KNI_GetRawArrayRegion(num,  0,  4, (jbyte*)&(c.num));
-    KNI_GetRawArrayRegion(data, 0, 16, (jbyte*)&(c.data));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-	KNI_GetRawArrayRegion(cksm,  j,  4, (jbyte*)&(c.cksm[i]));
-        j += 4;
-    }
-    for (i = 0, j = 0 ; i < 16; i ++) {
-	KNI_GetRawArrayRegion(state,  j,  4, (jbyte*)&(c.state[i]));
-        j += 4;
-    }
-        
-    /* Do SHA Update */
-    SNI_BEGIN_RAW_POINTERS;
+/** Completes a digest, leaving the hash in md. */
+typedef void (*DigestFinalFunc)(unsigned char* md, void* context);
 
-    MD2_Update(&c, (unsigned char*)&(JavaByteArray(inbuf)[inoff]), inlen);
+static void shaInit(void* context) {
+    SHA_CTX* c = (SHA_CTX*)context;
 
-    SNI_END_RAW_POINTERS;
+    memset(c, 0, sizeof (SHA_CTX));
+    c->h0 = (unsigned long)0x67452301L;
+    c->h1 = (unsigned long)0xefcdab89L;
+    c->h2 = (unsigned long)0x98badcfeL;
+    c->h3 = (unsigned long)0x10325476L;
+    c->h4 = (unsigned long)0xc3d2e1f0L;
+}
 
-    /* Copy Context back */
-    KNI_SetRawArrayRegion(num,  0,  4, (jbyte*)&(c.num));
-    KNI_SetRawArrayRegion(data, 0, 16, (jbyte*)&(c.data));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-	KNI_SetRawArrayRegion(cksm,  j,  4, (jbyte*)&(c.cksm[i]));
-        j += 4;
-    }
-    for (i = 0, j = 0 ; i < 16; i ++) {
-	KNI_SetRawArrayRegion(state,  j,  4, (jbyte*)&(c.state[i]));
-        j += 4;
-    }
+static void shaUpdate(void* context, unsigned char* data,
+                      unsigned long len) {
+    SHA1_Update((SHA_CTX*)context, data, len);
+}
 
-    KNI_EndHandles();
-    KNI_ReturnVoid();
+static void shaFinal(unsigned char* md, void* context) {
+    SHA1_Final(md, (SHA_CTX*)context);
 }
 
-KNIEXPORT KNI_RETURNTYPE_VOID
-Java_com_sun_midp_crypto_MD2_nativeFinal() {
-    unsigned long outoff = KNI_GetParameterAsInt(5);
-    unsigned long  inlen = KNI_GetParameterAsInt(3);
-    unsigned long  inoff = KNI_GetParameterAsInt(2);
-    unsigned char md[16];
-    int i,j;
-    MD2_CTX c;
-        
-    KNI_StartHandles(6);
-
-    KNI_DeclareHandle(data);
-    KNI_DeclareHandle(cksm);
-    KNI_DeclareHandle(num);
-    KNI_DeclareHandle(state);
-    KNI_DeclareHandle(outbuf);
-    KNI_DeclareHandle(inbuf);
+static void sha256Init(void* context) {
+    SHA256_Init((SHA256_CTX*)context);
+}
 
-    KNI_GetParameterAsObject(9, data);
-    KNI_GetParameterAsObject(8, cksm);
-    KNI_GetParameterAsObject(7, num);
-    KNI_GetParameterAsObject(6, state);
-    KNI_GetParameterAsObject(4, outbuf);
-    KNI_GetParameterAsObject(1, inbuf);
+static void sha256Update(void* context, unsigned char* data,
+                         unsigned long len) {
+    SHA256_Update((SHA256_CTX*)context, data, len);
+}
 
-    /* Copy the context in */
-    KNI_GetRawArrayRegion(num,  0,  4, (jbyte*)&(c.num));
-    KNI_GetRawArrayRegion(data, 0, 16, (jbyte*)&(c.data));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-	KNI_GetRawArrayRegion(cksm,  j,  4, (jbyte*)&(c.cksm[i]));
-        j += 4;
-    }
-    for (i = 0, j = 0 ; i < 16; i ++) {
-	KNI_GetRawArrayRegion(state,  j,  4, (jbyte*)&(c.state[i]));
-        j += 4;
-    }
-        
-    /* Perform MD2Update if necessary */
-    if (inlen != 0) {
-	/* Do MD2 Update */
-        SNI_BEGIN_RAW_POINTERS;
+static void sha256Final(unsigned char* md, void* context) {
+    SHA256_Final(md, (SHA256_CTX*)context);
+}
 
-        MD2_Update(&c, (unsigned char*)&(JavaByteArray(inbuf)[inoff]), inlen);
+static void md5Init(void* context) {
+    MD5_CTX* c = (MD5_CTX*)context;
 
-        SNI_END_RAW_POINTERS;
-    }
+    memset(c, 0, sizeof (MD5_CTX));
+    c->A = (unsigned long)0x67452301L;
+    c->B = (unsigned long)0xefcdab89L;
+    c->C = (unsigned long)0x98badcfeL;
+    c->D = (unsigned long)0x10325476L;
+}
 
-    /* Create and initialize the mesage digest buffer */
-    for (i = 0; i < 16; i++) {
-        md[i] = 0;
-    }
+static void md5Update(void* context, unsigned char* data,
+                      unsigned long len) {
+    MD5_Update((MD5_CTX*)context, data, len);
+}
+
+static void md5Final(unsigned char* md, void* context) {
+    MD5_Final(md, (MD5_CTX*)context);
+}
 
-    /* Do MD2 final */
-    MD2_Final(md, &c);
+static void md2Init(void* context) {
+    memset(context, 0, sizeof (MD2_CTX));
+}
+
+static void md2Update(void* context, unsigned char* data,
+                      unsigned long len) {
+    MD2_Update((MD2_CTX*)context, data, len);
+}
+
+static void md2Final(unsigned char* md, void* context) {
+    MD2_Final(md, (MD2_CTX*)context);
+}
+
+/** Cached IDs of the "nativeContext" field of each digest class */
+static jfieldID md2ContextField = NULL;
+static jfieldID md5ContextField = NULL;
+static jfieldID shaContextField = NULL;
+static jfieldID sha256ContextField = NULL;
 
-    /* Copy the message digest into output buffer at offset outoff */
-    for (i = 0; i < 16; i++) {
-        KNI_SetRawArrayRegion(outbuf, i+outoff, 1, (jbyte*)&(md[i]));
+/**
+ * Gets the ID of the field holding the native context of a digest
+ * object, looking it up on first use only.
+ *
+ * @param object handle to the digest object
+ * @param classObject handle the class of the object is put in
+ * @param pField cached field ID of the class of the object
+ *
+ * @return field ID of "nativeContext"
+ */
+static jfieldID getContextField(jobject object, jobject classObject,
+                                jfieldID* pField) {
+    if (*pField == NULL) {
+        KNI_GetObjectClass(object, classObject);
+        *pField = KNI_GetFieldID(classObject, "nativeContext", "J");
     }
 
-    /* Reset the context */
-    c.num = 0;
-    for (i = 0 ; i < 16; i ++) {
-        c.data[i] = 0;
-        c.cksm[i] = 0;
-        c.state[i] = 0;
+    return *pField;
+}
+
+/**
+ * Gets the native context of a digest object.
+ *
+ * @param object handle to the digest object
+ * @param classObject handle the class of the object is put in
+ * @param pField cached field ID of the class of the object
+ *
+ * @return the context, NULL if the object has none
+ */
+static void* getContext(jobject object, jobject classObject,
+                        jfieldID* pField) {
+    return (void*)(long)KNI_GetLongField(object,
+        getContextField(object, classObject, pField));
+}
+
+/**
+ * Puts the native context of the digest object nativeReset() is called
+ * on in the initial state, allocating the context first if the object
+ * has none yet. Throws OutOfMemoryError if it cannot be allocated.
+ *
+ * @param pField cached field ID of the class of the object
+ * @param size size of the context
+ * @param init function that initializes the context
+ */
+static void digestReset(jfieldID* pField, int size, DigestInitFunc init) {
+    jfieldID field;
+    void* context;
+
+    KNI_StartHandles(2);
+    KNI_DeclareHandle(thisObject);
+    KNI_DeclareHandle(classObject);
+
+    KNI_GetThisPointer(thisObject);
+
+    field = getContextField(thisObject, classObject, pField);
+    context = (void*)(long)KNI_GetLongField(thisObject, field);
+    if (context == NULL) {
+        context = midpMalloc(size);
+        if (context != NULL) {
+            KNI_SetLongField(thisObject, field, (jlong)(long)context);
+        }
     }
 
-    /* Copy back the context for next use. */
-    KNI_SetRawArrayRegion(num,  0,  4, (jbyte*)&(c.num));
-    KNI_SetRawArrayRegion(data, 0, 16, (jbyte*)&(c.data));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-	KNI_SetRawArrayRegion(cksm,  j,  4, (jbyte*)&(c.cksm[i]));
-        j += 4;
+    if (context == NULL) {
+        KNI_ThrowNew(midpOutOfMemoryError, NULL);
+    } else {
+        init(context);
     }
-    for (i = 0, j = 0 ; i < 16; i ++) {
-	KNI_SetRawArrayRegion(state,  j,  4, (jbyte*)&(c.state[i]));
-        j += 4;
+
+    KNI_EndHandles();
+}
+
+/**
+ * Hashes the data passed to nativeUpdate(byte[] inBuf, int inOff,
+ * int inLen) into the native context of the digest object.
+ *
+ * @param pField cached field ID of the class of the object
+ * @param update function that hashes data into the context
+ */
+static void digestUpdate(jfieldID* pField, DigestUpdateFunc update) {
+    int inlen = KNI_GetParameterAsInt(3);
+    int inoff = KNI_GetParameterAsInt(2);
+    void* context;
+
+    KNI_StartHandles(3);
+    KNI_DeclareHandle(thisObject);
+    KNI_DeclareHandle(classObject);
+    KNI_DeclareHandle(inbuf);
+
+    KNI_GetThisPointer(thisObject);
+    KNI_GetParameterAsObject(1, inbuf);
+
+    context = getContext(thisObject, classObject, pField);
+    if (context == NULL) {
+        KNI_ThrowNew(midpIllegalStateException, NULL);
+    } else {
+        SNI_BEGIN_RAW_POINTERS;
+
+        update(context, (unsigned char*)&(JavaByteArray(inbuf)[inoff]),
+               (unsigned long)inlen);
+
+        SNI_END_RAW_POINTERS;
     }
 
     KNI_EndHandles();
-    KNI_ReturnVoid();
 }
 
-KNIEXPORT KNI_RETURNTYPE_VOID
-Java_com_sun_midp_crypto_MD5_nativeFinal() {
-    unsigned long outoff = KNI_GetParameterAsInt(5);
-    unsigned long  inlen = KNI_GetParameterAsInt(3);
-    unsigned long  inoff = KNI_GetParameterAsInt(2);
-    unsigned char md[16];
-    int i,j;
-    MD5_CTX c;
-
-    KNI_StartHandles(6);
-
-    KNI_DeclareHandle(data);
-    KNI_DeclareHandle(count);
-    KNI_DeclareHandle(num);
-    KNI_DeclareHandle(state);
+/**
+ * Completes the digest for nativeFinal(byte[] inBuf, int inOff,
+ * int inLen, byte[] outBuf, int outOff), puts the hash in outBuf and
+ * resets the native context.
+ *
+ * @param pField cached field ID of the class of the object
+ * @param digestLength length of the hash
+ * @param update function that hashes data into the context
+ * @param finish function that completes the digest
+ * @param init function that initializes the context
+ */
+static void digestFinal(jfieldID* pField, int digestLength,
+                        DigestUpdateFunc update, DigestFinalFunc finish,
+                        DigestInitFunc init) {
+    int outoff = KNI_GetParameterAsInt(5);
+    int inlen = KNI_GetParameterAsInt(3);
+    int inoff = KNI_GetParameterAsInt(2);
+    unsigned char md[MAX_DIGEST_LENGTH];
+    void* context;
+
+    KNI_StartHandles(4);
+    KNI_DeclareHandle(thisObject);
+    KNI_DeclareHandle(classObject);
     KNI_DeclareHandle(outbuf);
     KNI_DeclareHandle(inbuf);
 
-    KNI_GetParameterAsObject(9, data);
-    KNI_GetParameterAsObject(8, count);
-    KNI_GetParameterAsObject(7, num);
-    KNI_GetParameterAsObject(6, state);
+    KNI_GetThisPointer(thisObject);
     KNI_GetParameterAsObject(4, outbuf);
     KNI_GetParameterAsObject(1, inbuf);
 
-    /* Copy the context in */
-    KNI_GetRawArrayRegion(state,  0, 4, (jbyte*)&(c.A));
-    KNI_GetRawArrayRegion(state,  4, 4, (jbyte*)&(c.B));
-    KNI_GetRawArrayRegion(state,  8, 4, (jbyte*)&(c.C));
-    KNI_GetRawArrayRegion(state, 12, 4, (jbyte*)&(c.D));
-    KNI_GetRawArrayRegion(count,  0, 4, (jbyte*)&(c.Nl));
-    KNI_GetRawArrayRegion(count,  4, 4, (jbyte*)&(c.Nh));
-    KNI_GetRawArrayRegion(num,    0, 4, (jbyte*)&(c.num));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-        KNI_GetRawArrayRegion(data, j, 4, (jbyte*)&(c.data[i]));
-        j += 4;
-    }
-        
-    /* Perform MD5Update if necessary */
-    if (inlen != 0) {
-        /* Do MD5 Update */
-        SNI_BEGIN_RAW_POINTERS;
+    context = getContext(thisObject, classObject, pField);
+    if (context == NULL) {
+        KNI_ThrowNew(midpIllegalStateException, NULL);
+    } else {
+        if (inlen != 0) {
+            SNI_BEGIN_RAW_POINTERS;
 
-        MD5_Update(&c, (unsigned char*)&(JavaByteArray(inbuf)[inoff]), inlen);
-        
-        SNI_END_RAW_POINTERS;
+            update(context, (unsigned char*)&(JavaByteArray(inbuf)[inoff]),
+                   (unsigned long)inlen);
 
-    }
+            SNI_END_RAW_POINTERS;
+        }
+
+        finish(md, context);
+        KNI_SetRawArrayRegion(outbuf, outoff, digestLength, (jbyte*)md);
 
-    /* Create and initialize the mesage digest buffer */
-    for (i = 0; i < 16; i++) {
-        md[i] = 0;
+        /* Reset the context for next use. */
+        init(context);
     }
 
-    /* Do MD5 final */
-    MD5_Final(md, &c);
+    KNI_EndHandles();
+}
 
-    /* Copy the message digest into output buffer at offset outoff */
-    for (i = 0; i < 16; i++) {
-	KNI_SetRawArrayRegion(outbuf,  i+outoff, 1, (jbyte*)&(md[i]));
+/**
+ * Copies the native context of the digest object passed to
+ * nativeCopy() into the one of the object it is called on.
+ *
+ * @param pField cached field ID of the class of the objects
+ * @param size size of the context
+ */
+static void digestCopy(jfieldID* pField, int size) {
+    void* context;
+    void* source;
+
+    KNI_StartHandles(3);
+    KNI_DeclareHandle(thisObject);
+    KNI_DeclareHandle(classObject);
+    KNI_DeclareHandle(sourceObject);
+
+    KNI_GetThisPointer(thisObject);
+    KNI_GetParameterAsObject(1, sourceObject);
+
+    context = getContext(thisObject, classObject, pField);
+    source = getContext(sourceObject, classObject, pField);
+    if (context == NULL || source == NULL) {
+        KNI_ThrowNew(midpIllegalStateException, NULL);
+    } else {
+        memcpy(context, source, size);
     }
 
-    /* Reset the context */
-    c.A = (unsigned long)0x67452301L;
-    c.B = (unsigned long)0xefcdab89L;
-    c.C = (unsigned long)0x98badcfeL;
-    c.D = (unsigned long)0x10325476L;
-    c.Nl= 0;
-    c.Nh = 0;
-    c.num = 0;
-    for (i = 0; i < 16; i ++) {
-        c.data[i] = 0;
-    }
-        
-
-    /* Copy back the context for next use. */
-    KNI_SetRawArrayRegion(state,  0, 4, (jbyte*)&(c.A));
-    KNI_SetRawArrayRegion(state,  4, 4, (jbyte*)&(c.B));
-    KNI_SetRawArrayRegion(state,  8, 4, (jbyte*)&(c.C));
-    KNI_SetRawArrayRegion(state, 12, 4, (jbyte*)&(c.D));
-    KNI_SetRawArrayRegion(count,  0, 4, (jbyte*)&(c.Nl));
-    KNI_SetRawArrayRegion(count,  4, 4, (jbyte*)&(c.Nh));
-    KNI_SetRawArrayRegion(num,    0, 4, (jbyte*)&(c.num));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-        KNI_SetRawArrayRegion(data, j, 4, (jbyte*)&(c.data[i]));
-        j += 4;
-    }
-        
     KNI_EndHandles();
-    KNI_ReturnVoid();
 }
 
+/**
+ * Frees the native context of the digest object being finalized.
+ *
+ * @param pField cached field ID of the class of the object
+ */
+static void digestFinalize(jfieldID* pField) {
+    jfieldID field;
+    void* context;
 
-KNIEXPORT KNI_RETURNTYPE_VOID
-Java_com_sun_midp_crypto_MD5_nativeUpdate() {
-    unsigned long  inlen = KNI_GetParameterAsInt(3);
-    unsigned long  inoff = KNI_GetParameterAsInt(2);
-    int i, j;
-    MD5_CTX c;
-        
-    KNI_StartHandles(5);
-
-    KNI_DeclareHandle(data);
-    KNI_DeclareHandle(count);
-    KNI_DeclareHandle(num);
-    KNI_DeclareHandle(state);
-    KNI_DeclareHandle(inbuf);
+    KNI_StartHandles(2);
+    KNI_DeclareHandle(thisObject);
+    KNI_DeclareHandle(classObject);
 
-    KNI_GetParameterAsObject(7, data);
-    KNI_GetParameterAsObject(6, count);
-    KNI_GetParameterAsObject(5, num);
-    KNI_GetParameterAsObject(4, state);
-    KNI_GetParameterAsObject(1, inbuf);
+    KNI_GetThisPointer(thisObject);
 
-    /* Copy the context in */
-    KNI_GetRawArrayRegion(state,  0, 4, (jbyte*)&(c.A));
-    KNI_GetRawArrayRegion(state,  4, 4, (jbyte*)&(c.B));
-    KNI_GetRawArrayRegion(state,  8, 4, (jbyte*)&(c.C));
-    KNI_GetRawArrayRegion(state, 12, 4, (jbyte*)&(c.D));
-    KNI_GetRawArrayRegion(count,  0, 4, (jbyte*)&(c.Nl));
-    KNI_GetRawArrayRegion(count,  4, 4, (jbyte*)&(c.Nh));
-    KNI_GetRawArrayRegion(num,    0, 4, (jbyte*)&(c.num));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-        KNI_GetRawArrayRegion(data, j, 4, (jbyte*)&(c.data[i]));
-        j += 4;
+    field = getContextField(thisObject, classObject, pField);
+    context = (void*)(long)KNI_GetLongField(thisObject, field);
+    if (context != NULL) {
+        midpFree(context);
+        KNI_SetLongField(thisObject, field, (jlong)0);
     }
-        
-    /* Do MD5 Update */
-    SNI_BEGIN_RAW_POINTERS;
-
-    MD5_Update(&c, (unsigned char*)&(JavaByteArray(inbuf)[inoff]), inlen);
-
-    SNI_END_RAW_POINTERS;
-
-    /* Copy back the context for next use. */
-    KNI_SetRawArrayRegion(state,  0, 4, (jbyte*)&(c.A));
-    KNI_SetRawArrayRegion(state,  4, 4, (jbyte*)&(c.B));
-    KNI_SetRawArrayRegion(state,  8, 4, (jbyte*)&(c.C));
-    KNI_SetRawArrayRegion(state, 12, 4, (jbyte*)&(c.D));
-    KNI_SetRawArrayRegion(count,  0, 4, (jbyte*)&(c.Nl));
-    KNI_SetRawArrayRegion(count,  4, 4, (jbyte*)&(c.Nh));
-    KNI_SetRawArrayRegion(num,    0, 4, (jbyte*)&(c.num));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-        KNI_SetRawArrayRegion(data, j, 4, (jbyte*)&(c.data[i]));
-        j += 4;
-    }
-        
+
     KNI_EndHandles();
+}
+
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_MD2_nativeReset() {
+    digestReset(&md2ContextField, sizeof (MD2_CTX), md2Init);
     KNI_ReturnVoid();
 }
 
 KNIEXPORT KNI_RETURNTYPE_VOID
-Java_com_sun_midp_crypto_SHA_nativeFinal() {
-    unsigned long outoff = KNI_GetParameterAsInt(5);
-    unsigned long  inlen = KNI_GetParameterAsInt(3);
-    unsigned long  inoff = KNI_GetParameterAsInt(2);
-    unsigned char md[20];
-    int i, j;
-    SHA_CTX c;
-        
-    KNI_StartHandles(6);
-
-    KNI_DeclareHandle(data);
-    KNI_DeclareHandle(count);
-    KNI_DeclareHandle(num);
-    KNI_DeclareHandle(state);
-    KNI_DeclareHandle(outbuf);
-    KNI_DeclareHandle(inbuf);
+Java_com_sun_midp_crypto_MD2_nativeUpdate() {
+    digestUpdate(&md2ContextField, md2Update);
+    KNI_ReturnVoid();
+}
 
-    KNI_GetParameterAsObject(9, data);
-    KNI_GetParameterAsObject(8, count);
-    KNI_GetParameterAsObject(7, num);
-    KNI_GetParameterAsObject(6, state);
-    KNI_GetParameterAsObject(4, outbuf);
-    KNI_GetParameterAsObject(1, inbuf);
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_MD2_nativeFinal() {
+    digestFinal(&md2ContextField, MD2_DIGEST_LENGTH,
+                md2Update, md2Final, md2Init);
+    KNI_ReturnVoid();
+}
 
-    /* Copy the context in */
-    KNI_GetRawArrayRegion(state,  0, 4, (jbyte*)&(c.h0));
-    KNI_GetRawArrayRegion(state,  4, 4, (jbyte*)&(c.h1));
-    KNI_GetRawArrayRegion(state,  8, 4, (jbyte*)&(c.h2));
-    KNI_GetRawArrayRegion(state, 12, 4, (jbyte*)&(c.h3));
-    KNI_GetRawArrayRegion(state, 16, 4, (jbyte*)&(c.h4));
-    KNI_GetRawArrayRegion(count,  0, 4, (jbyte*)&(c.Nl));
-    KNI_GetRawArrayRegion(count,  4, 4, (jbyte*)&(c.Nh));
-    KNI_GetRawArrayRegion(num,    0, 4, (jbyte*)&(c.num));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-        KNI_GetRawArrayRegion(data, j, 4, (jbyte*)&(c.data[i]));
-        j += 4;
-    }
-        
-    /* Perform SHA update if necessary */
-    if (inlen != 0) {
-        /* Do SHA Update */
-        SNI_BEGIN_RAW_POINTERS;
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_MD2_nativeCopy() {
+    digestCopy(&md2ContextField, sizeof (MD2_CTX));
+    KNI_ReturnVoid();
+}
 
-        SHA1_Update(&c, (unsigned char*)&(JavaByteArray(inbuf)[inoff]), inlen);
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_MD2_finalize() {
+    digestFinalize(&md2ContextField);
+    KNI_ReturnVoid();
+}
 
-        SNI_END_RAW_POINTERS;
-    }
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_MD5_nativeReset() {
+    digestReset(&md5ContextField, sizeof (MD5_CTX), md5Init);
+    KNI_ReturnVoid();
+}
 
-    /* Create and initialize the mesage digest buffer */
-    for (i=0; i < 20; i++) {
-        md[i] = 0;
-    }
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_MD5_nativeUpdate() {
+    digestUpdate(&md5ContextField, md5Update);
+    KNI_ReturnVoid();
+}
+
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_MD5_nativeFinal() {
+    digestFinal(&md5ContextField, MD5_DIGEST_LENGTH,
+                md5Update, md5Final, md5Init);
+    KNI_ReturnVoid();
+}
 
-    /* Do SHA */
-    SHA1_Final(md, &c);
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_MD5_nativeCopy() {
+    digestCopy(&md5ContextField, sizeof (MD5_CTX));
+    KNI_ReturnVoid();
+}
 
-    /* Copy message digest into output buffer at offset outoff */
-    for (i = 0; i < 20; i++) {
-        KNI_SetRawArrayRegion(outbuf, i+outoff, 1, (jbyte*)&(md[i]));
-    }
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_MD5_finalize() {
+    digestFinalize(&md5ContextField);
+    KNI_ReturnVoid();
+}
 
-    /* Reset the context */
-    c.h0 = (unsigned long)0x67452301L;
-    c.h1 = (unsigned long)0xefcdab89L;
-    c.h2 = (unsigned long)0x98badcfeL;
-    c.h3 = (unsigned long)0x10325476L;
-    c.h4 = (unsigned long)0xc3d2e1f0L;
-    c.Nl = 0;
-    c.Nh = 0;
-    c.num = 0;
-        
-    /* Copy back the context for next use. */
-    KNI_SetRawArrayRegion(state,  0, 4, (jbyte*)&(c.h0));
-    KNI_SetRawArrayRegion(state,  4, 4, (jbyte*)&(c.h1));
-    KNI_SetRawArrayRegion(state,  8, 4, (jbyte*)&(c.h2));
-    KNI_SetRawArrayRegion(state, 12, 4, (jbyte*)&(c.h3));
-    KNI_SetRawArrayRegion(state, 16, 4, (jbyte*)&(c.h4));
-    KNI_SetRawArrayRegion(count,  0, 4, (jbyte*)&(c.Nl));
-    KNI_SetRawArrayRegion(count,  4, 4, (jbyte*)&(c.Nh));
-    KNI_SetRawArrayRegion(num,    0, 4, (jbyte*)&(c.num));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-        KNI_SetRawArrayRegion(data, j, 4, (jbyte*)&(c.data[i]));
-        j += 4;
-    }
-        
-    KNI_EndHandles();
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_SHA_nativeReset() {
+    digestReset(&shaContextField, sizeof (SHA_CTX), shaInit);
     KNI_ReturnVoid();
 }
 
@@ -426,68 +422,59 @@ Java_com_sun_midp_crypto_SHA_nativeFinal() {
  * @param inBuf input buffer of data to be hashed
  * @param inOff offset within inBuf where input data begins
  * @param inLen length (in bytes) of data to be hashed
- * @param state internal hash state
- * @param num internal hash state
- * @param count internal hash state
- * @param data internal hash state
  */
 KNIEXPORT KNI_RETURNTYPE_VOID
 Java_com_sun_midp_crypto_SHA_nativeUpdate() {
-    unsigned long  inlen = KNI_GetParameterAsInt(3);
-    unsigned long  inoff = KNI_GetParameterAsInt(2);
-    int i, j;
-    SHA_CTX c;
-        
-    KNI_StartHandles(5);
-
-    KNI_DeclareHandle(data);
-    KNI_DeclareHandle(count);
-    KNI_DeclareHandle(num);
-    KNI_DeclareHandle(state);
-    KNI_DeclareHandle(inbuf);
+    digestUpdate(&shaContextField, shaUpdate);
+    KNI_ReturnVoid();
+}
 
-    KNI_GetParameterAsObject(7, data);
-    KNI_GetParameterAsObject(6, count);
-    KNI_GetParameterAsObject(5, num);
-    KNI_GetParameterAsObject(4, state);
-    KNI_GetParameterAsObject(1, inbuf);
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_SHA_nativeFinal() {
+    digestFinal(&shaContextField, SHA_DIGEST_LENGTH,
+                shaUpdate, shaFinal, shaInit);
+    KNI_ReturnVoid();
+}
 
-    /* Copy the context in */
-    KNI_GetRawArrayRegion(state,  0, 4, (jbyte*)&(c.h0));
-    KNI_GetRawArrayRegion(state,  4, 4, (jbyte*)&(c.h1));
-    KNI_GetRawArrayRegion(state,  8, 4, (jbyte*)&(c.h2));
-    KNI_GetRawArrayRegion(state, 12, 4, (jbyte*)&(c.h3));
-    KNI_GetRawArrayRegion(state, 16, 4, (jbyte*)&(c.h4));
-    KNI_GetRawArrayRegion(count,  0, 4, (jbyte*)&(c.Nl));
-    KNI_GetRawArrayRegion(count,  4, 4, (jbyte*)&(c.Nh));
-    KNI_GetRawArrayRegion(num,    0, 4, (jbyte*)&(c.num));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-        KNI_GetRawArrayRegion(data, j, 4, (jbyte*)&(c.data[i]));
-        j += 4;
-    }
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_SHA_nativeCopy() {
+    digestCopy(&shaContextField, sizeof (SHA_CTX));
+    KNI_ReturnVoid();
+}
 
-    /* Do SHA Update */
-    SNI_BEGIN_RAW_POINTERS;
-
-    SHA1_Update(&c, (unsigned char*)&(JavaByteArray(inbuf)[inoff]), inlen);
-
-    SNI_END_RAW_POINTERS;
-
-    /* Copy Context back */
-    KNI_SetRawArrayRegion(state,  0, 4, (jbyte*)&(c.h0));
-    KNI_SetRawArrayRegion(state,  4, 4, (jbyte*)&(c.h1));
-    KNI_SetRawArrayRegion(state,  8, 4, (jbyte*)&(c.h2));
-    KNI_SetRawArrayRegion(state, 12, 4, (jbyte*)&(c.h3));
-    KNI_SetRawArrayRegion(state, 16, 4, (jbyte*)&(c.h4));
-    KNI_SetRawArrayRegion(count,  0, 4, (jbyte*)&(c.Nl));
-    KNI_SetRawArrayRegion(count,  4, 4, (jbyte*)&(c.Nh));
-    KNI_SetRawArrayRegion(num,    0, 4, (jbyte*)&(c.num));
-    for (i = 0, j = 0 ; i < 16; i ++) {
-        KNI_SetRawArrayRegion(data, j, 4, (jbyte*)&(c.data[i]));
-        j += 4;
-    }
-        
-    KNI_EndHandles();
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_SHA_finalize() {
+    digestFinalize(&shaContextField);
+    KNI_ReturnVoid();
+}
+
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_SHA256_nativeReset() {
+    digestReset(&sha256ContextField, sizeof (SHA256_CTX), sha256Init);
+    KNI_ReturnVoid();
+}
+
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_SHA256_nativeUpdate() {
+    digestUpdate(&sha256ContextField, sha256Update);
     KNI_ReturnVoid();
 }
 
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_SHA256_nativeFinal() {
+    digestFinal(&sha256ContextField, SHA256_DIGEST_LENGTH,
+                sha256Update, sha256Final, sha256Init);
+    KNI_ReturnVoid();
+}
+
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_SHA256_nativeCopy() {
+    digestCopy(&sha256ContextField, sizeof (SHA256_CTX));
+    KNI_ReturnVoid();
+}
+
+KNIEXPORT KNI_RETURNTYPE_VOID
+Java_com_sun_midp_crypto_SHA256_finalize() {
+    digestFinalize(&sha256ContextField);
+    KNI_ReturnVoid();
+}
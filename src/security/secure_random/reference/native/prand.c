@@ -25,11 +25,20 @@
  * information or have any questions.
  */
 
+#include <string.h>
+
 #include <kni.h>
 #include <secure_random_port.h>
 #include <pcsl_memory.h>
 #include <midpError.h>
 
+/**
+ * Size of the on-stack buffer used for requests that fit in it. The seed
+ * updates of PRand ask for 8 bytes, so the common case needs no heap
+ * allocation.
+ */
+#define RANDOM_BUFFER_SIZE 64
+
 /**
  * Perform a platform-defined procedure for obtaining random bytes and
  * store the obtained bytes into b, starting from index 0.
@@ -43,6 +52,7 @@ KNIEXPORT KNI_RETURNTYPE_BOOLEAN
 KNIDECL(com_sun_midp_crypto_PRand_getRandomBytes) {
     jint size;
     jboolean res = KNI_FALSE;
+    unsigned char localBuffer[RANDOM_BUFFER_SIZE];
     unsigned char* buffer;
 
     KNI_StartHandles(1);
@@ -51,19 +61,31 @@ KNIDECL(com_sun_midp_crypto_PRand_getRandomBytes) {
 
     size = KNI_GetParameterAsInt(2);
 
-    buffer = pcsl_mem_malloc(size);
-    if (0 == buffer) {
-        KNI_ThrowNew(midpOutOfMemoryError, NULL);
+    if (size < 0 || size > (jint)KNI_GetArrayLength(hBytes)) {
+        KNI_ThrowNew(midpArrayIndexOutOfBoundsException, NULL);
     } else {
-        int i;
-        res = get_random_bytes_port(buffer, size);
-        for(i=0; i<size; i++) {
-            KNI_SetByteArrayElement(hBytes,i,(jbyte)buffer[i]);
+        if (size <= RANDOM_BUFFER_SIZE) {
+            buffer = localBuffer;
+        } else {
+            buffer = pcsl_mem_malloc(size);
+        }
+
+        if (0 == buffer) {
+            KNI_ThrowNew(midpOutOfMemoryError, NULL);
+        } else {
+            res = get_random_bytes_port(buffer, size);
+            if (res) {
+                KNI_SetRawArrayRegion(hBytes, 0, size, (jbyte*)buffer);
+            }
+
+            /* do not leave seed material behind in native memory */
+            memset(buffer, 0, size);
+            if (buffer != localBuffer) {
+                pcsl_mem_free(buffer);
+            }
         }
-        pcsl_mem_free(buffer);
     }
     
     KNI_EndHandles();
     KNI_ReturnBoolean(res);
 }
-